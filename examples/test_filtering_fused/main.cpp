@@ -0,0 +1,80 @@
+/*
+
+PICCANTE Examples
+The hottest examples of Piccante:
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3.0 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    See the GNU Lesser General Public License
+    ( http://www.gnu.org/licenses/lgpl-3.0.html ) for more details.
+*/
+
+//This means that OpenGL acceleration layer is disabled
+#define PIC_DISABLE_OPENGL
+
+#include "piccante.hpp"
+
+
+bool compare(std::string name, pic::FilterNPasses *flt, pic::Image *img)
+{
+    flt->setFused(true);
+    pic::Image *out_f = flt->Process(pic::Single(img), NULL);
+
+    flt->setFused(false);
+    pic::Image *out_r = flt->Process(pic::Single(img), NULL);
+
+    float err = 0.0f;
+    int n = out_f->size();
+    for(int i = 0; i < n; i++) {
+        err = MAX(err, fabsf(out_f->data[i] - out_r->data[i]));
+    }
+
+    bool bOk = err <= 1e-5f;
+
+    printf("%s: %s (max error %e)\n", name.c_str(), bOk ? "Ok" : "FAILED", err);
+
+    delete out_f;
+    delete out_r;
+    return bOk;
+}
+
+int main()
+{
+    bool bOk = true;
+
+    pic::Image img(1, 301, 173, 3);
+    img.setRand(1);
+
+    float kernel[] = {0.05f, 0.1f, 0.2f, 0.3f, 0.2f, 0.1f, 0.05f};
+
+    for(int n = 2; n <= 7; n++) {
+        std::string size = pic::fromNumberToString(n);
+
+        pic::FilterConv2DSP flt(kernel, n);
+        bOk = compare("FilterConv2DSP " + size + "x" + size, &flt, &img) && bOk;
+
+        pic::FilterConv2DSP flt_xy(kernel, 3, kernel, n);
+        bOk = compare("FilterConv2DSP 3x" + size, &flt_xy, &img) && bOk;
+    }
+
+    pic::FilterGaussian2D flt_g(2.5f);
+    bOk = compare("FilterGaussian2D", &flt_g, &img) && bOk;
+
+    printf(bOk ? "All tests passed.\n" : "Some tests FAILED.\n");
+
+    return bOk ? 0 : 1;
+}
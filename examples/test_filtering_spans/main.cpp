@@ -0,0 +1,130 @@
+/*
+
+PICCANTE Examples
+The hottest examples of Piccante:
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3.0 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    See the GNU Lesser General Public License
+    ( http://www.gnu.org/licenses/lgpl-3.0.html ) for more details.
+*/
+
+//This means that OpenGL acceleration layer is disabled
+#define PIC_DISABLE_OPENGL
+
+#include "piccante.hpp"
+
+/**
+ * NoSpan disables the span kernel of a filter, so that every pixel is
+ * processed by its f.
+ */
+template<class T>
+class NoSpan: public T
+{
+public:
+    NoSpan() : T()
+    {
+    }
+
+    NoSpan(float a, float b) : T(a, b)
+    {
+    }
+
+    NoSpan(float *a, float b) : T(a, b)
+    {
+    }
+
+protected:
+    bool getSpanBorder(int & /*borderX*/, int & /*borderY*/)
+    {
+        return false;
+    }
+};
+
+bool compare(std::string name, pic::Filter *spans, pic::Filter *ref, pic::ImageVec src)
+{
+    pic::Image *out_s = spans->Process(src, NULL);
+    pic::Image *out_r = ref->Process(src, NULL);
+
+    bool bOk = out_s->isSimilarType(out_r);
+
+    float err = 0.0f;
+    if(bOk) {
+        int n = out_s->size();
+        for(int i = 0; i < n; i++) {
+            err = MAX(err, fabsf(out_s->data[i] - out_r->data[i]));
+        }
+
+        bOk = err <= 1e-6f;
+    }
+
+    printf("%s: %s (max error %e)\n", name.c_str(), bOk ? "Ok" : "FAILED", err);
+
+    delete out_s;
+    delete out_r;
+    return bOk;
+}
+
+int main()
+{
+    bool bOk = true;
+
+    for(int frames = 1; frames <= 3; frames += 2) {
+        for(int channels = 1; channels <= 3; channels++) {
+            printf("Frames: %d Channels: %d\n", frames, channels);
+
+            pic::Image img0(frames, 257, 131, channels);
+            pic::Image img1(frames, 257, 131, channels);
+            img0.setRand(1);
+            img1.setRand(2);
+            img0 -= 0.5f;
+
+            pic::FilterBackwardDifference bd;
+            NoSpan<pic::FilterBackwardDifference> bd_ref;
+            bOk = compare("FilterBackwardDifference", &bd, &bd_ref, pic::Single(&img0)) && bOk;
+
+            pic::FilterNSWE nswe;
+            NoSpan<pic::FilterNSWE> nswe_ref;
+            bOk = compare("FilterNSWE", &nswe, &nswe_ref, pic::Single(&img0)) && bOk;
+
+            pic::FilterZeroCrossing zc;
+            NoSpan<pic::FilterZeroCrossing> zc_ref;
+            bOk = compare("FilterZeroCrossing", &zc, &zc_ref, pic::Single(&img0)) && bOk;
+
+            float color[] = {0.1f, 0.2f, 0.3f};
+            pic::FilterColorDistance cd(color, 0.5f);
+            NoSpan<pic::FilterColorDistance> cd_ref(color, 0.5f);
+            bOk = compare("FilterColorDistance", &cd, &cd_ref, pic::Single(&img1)) && bOk;
+
+            pic::FilterAbsoluteDifference ad;
+            NoSpan<pic::FilterAbsoluteDifference> ad_ref;
+            bOk = compare("FilterAbsoluteDifference", &ad, &ad_ref, pic::Double(&img0, &img1)) && bOk;
+
+            pic::FilterLuminance lum;
+            NoSpan<pic::FilterLuminance> lum_ref;
+            bOk = compare("FilterLuminance", &lum, &lum_ref, pic::Single(&img1)) && bOk;
+
+            pic::FilterSimpleTMO tmo(2.2f, 1.0f);
+            NoSpan<pic::FilterSimpleTMO> tmo_ref(2.2f, 1.0f);
+            bOk = compare("FilterSimpleTMO", &tmo, &tmo_ref, pic::Single(&img1)) && bOk;
+        }
+    }
+
+    printf(bOk ? "All tests passed.\n" : "Some tests FAILED.\n");
+
+    return bOk ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+/*
+
+PICCANTE Examples
+The hottest examples of Piccante:
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3.0 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    See the GNU Lesser General Public License
+    ( http://www.gnu.org/licenses/lgpl-3.0.html ) for more details.
+*/
+
+//This means that OpenGL acceleration layer is disabled
+#define PIC_DISABLE_OPENGL
+
+#include "piccante.hpp"
+
+
+/**
+ * compact returns a copy of img stored as half float; ref is a float copy
+ * with the same values.
+ */
+pic::Image *compact(pic::Image *img, pic::Image *&ref)
+{
+    pic::Image *out = img->clone();
+    out->setStorage(pic::IS_HALF);
+    ref = out->promote();
+    return out;
+}
+
+float maxError(pic::Image *a, pic::Image *b)
+{
+    pic::Image *a_f = a->promote();
+    pic::Image *b_f = b->promote();
+
+    float err = 0.0f;
+
+    if(a_f->isSimilarType(b_f)) {
+        for(int i = 0; i < a_f->size(); i++) {
+            err = MAX(err, fabsf(a_f->data[i] - b_f->data[i]) / MAX(fabsf(b_f->data[i]), 1.0f));
+        }
+    } else {
+        err = 1e30f;
+    }
+
+    delete a_f;
+    delete b_f;
+    return err;
+}
+
+/**
+ * test runs flt on compact inputs, with a float and a compact output, and it
+ * compares the results with the ones on float inputs.
+ */
+bool test(std::string name, pic::Filter *flt, pic::ImageVec in, pic::ImageVec in_ref)
+{
+    pic::Image *out_ref = flt->Process(in_ref, NULL);
+    pic::Image *out = flt->Process(in, NULL);
+
+    pic::Image *out_c = out_ref->clone();
+    out_c->setStorage(pic::IS_HALF);
+    out_c = flt->Process(in, out_c);
+
+    float err = maxError(out, out_ref);
+    float err_c = maxError(out_c, out_ref);
+
+    //a half output is rounded to 11 bits
+    bool bOk = (err <= 1e-5f) && (err_c <= 1e-3f) && out_c->isCompact();
+
+    printf("%s: %s (max error %e, half output %e)\n", name.c_str(),
+           bOk ? "Ok" : "FAILED", err, err_c);
+
+    delete out_ref;
+    delete out;
+    delete out_c;
+    return bOk;
+}
+
+/**
+ * testStats computes statistics of img stored as storage, and it compares
+ * them with the ones of a float copy with the same values.
+ */
+bool testStats(std::string name, pic::Image *img, pic::IMAGE_STORAGE storage)
+{
+    pic::Image *img_c = img->clone();
+    img_c->setStorage(storage);
+    pic::Image *img_r = img_c->promote();
+
+    float *max_c = img_c->getMaxVal(NULL, NULL);
+    float *max_r = img_r->getMaxVal(NULL, NULL);
+    float *min_c = img_c->getMinVal(NULL, NULL);
+    float *min_r = img_r->getMinVal(NULL, NULL);
+    float *mean_c = img_c->getMeanVal(NULL, NULL);
+    float *mean_r = img_r->getMeanVal(NULL, NULL);
+
+    float err = 0.0f;
+
+    for(int i = 0; i < img->channels; i++) {
+        err = MAX(err, fabsf(max_c[i] - max_r[i]));
+        err = MAX(err, fabsf(min_c[i] - min_r[i]));
+        err = MAX(err, fabsf(mean_c[i] - mean_r[i]));
+    }
+
+    bool bOk = (err <= 1e-6f) && img_c->isCompact();
+
+    printf("Statistics (%s): %s (max error %e)\n", name.c_str(),
+           bOk ? "Ok" : "FAILED", err);
+
+    delete[] max_c;
+    delete[] max_r;
+    delete[] min_c;
+    delete[] min_r;
+    delete[] mean_c;
+    delete[] mean_r;
+    delete img_c;
+    delete img_r;
+    return bOk;
+}
+
+/**
+ * testStorage converts img to storage and back, and it checks that values
+ * are kept within the precision of storage.
+ */
+bool testStorage(std::string name, pic::Image *img, pic::IMAGE_STORAGE storage,
+                 float maxErr)
+{
+    pic::Image *img_c = img->clone();
+    img_c->setStorage(storage);
+    pic::Image *img_r = img_c->promote();
+
+    float err = maxError(img_r, img);
+    bool bOk = (err <= maxErr) && img_c->isCompact();
+
+    printf("Storage (%s): %s (max error %e)\n", name.c_str(),
+           bOk ? "Ok" : "FAILED", err);
+
+    delete img_c;
+    delete img_r;
+    return bOk;
+}
+
+int main()
+{
+    bool bOk = true;
+
+    pic::Image img(1, 96, 64, 3);
+    img.setRand(1);
+
+    bOk = testStorage("half", &img, pic::IS_HALF, 1e-3f) && bOk;
+    bOk = testStorage("uint16", &img, pic::IS_UINT16, 1e-4f) && bOk;
+    bOk = testStorage("uint8", &img, pic::IS_UINT8, 2e-3f) && bOk;
+
+    pic::Image guide(1, 96, 64, 1);
+    guide.setRand(2);
+
+    pic::Image psf(1, 5, 5, 1);
+    psf = 1.0f / 25.0f;
+
+    pic::Image *img_r, *guide_r, *psf_r;
+    pic::Image *img_c = compact(&img, img_r);
+    pic::Image *guide_c = compact(&guide, guide_r);
+    pic::Image *psf_c = compact(&psf, psf_r);
+
+    pic::FilterGaussian2D flt_gauss(2.0f);
+    bOk = test("FilterGaussian2D", &flt_gauss, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterLuminance flt_lum;
+    bOk = test("FilterLuminance", &flt_lum, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterGaussian2D flt_gauss_rec(2.0f, true);
+    bOk = test("FilterGaussian2D (recursive)", &flt_gauss_rec, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterBoxMean flt_box(3, 5);
+    bOk = test("FilterBoxMean", &flt_box, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterGuided flt_guided(4, 0.01f);
+    bOk = test("FilterGuided", &flt_guided, pic::Double(img_c, guide_c), pic::Double(img_r, guide_r)) && bOk;
+
+    pic::FilterGuidedAB flt_guided_ab(4, 0.01f);
+    bOk = test("FilterGuidedAB", &flt_guided_ab, pic::Double(img_c, guide_c), pic::Double(img_r, guide_r)) && bOk;
+
+    pic::FilterBilateral2DG flt_bg(4.0f, 0.1f);
+    bOk = test("FilterBilateral2DG", &flt_bg, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterBilateral2DPL flt_bpl(4.0f, 0.1f);
+    bOk = test("FilterBilateral2DPL", &flt_bpl, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterDeconvolution flt_deconv(3);
+    bOk = test("FilterDeconvolution", &flt_deconv, pic::Double(img_c, psf_c), pic::Double(img_r, psf_r)) && bOk;
+
+    pic::FilterIntegralImage flt_integral;
+    bOk = test("FilterIntegralImage", &flt_integral, pic::Single(guide_c), pic::Single(guide_r)) && bOk;
+
+    pic::FilterWLS flt_wls;
+    bOk = test("FilterWLS", &flt_wls, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    pic::FilterDiffGauss flt_dog(1.0f, 2.0f);
+    bOk = test("FilterDiffGauss", &flt_dog, pic::Single(img_c), pic::Single(img_r)) && bOk;
+
+    bOk = testStats("half", &img, pic::IS_HALF) && bOk;
+    bOk = testStats("uint8", &img, pic::IS_UINT8) && bOk;
+
+    //operators
+    pic::Image *a = img_c->clone();
+    pic::Image *a_r = img_r->clone();
+    *a += *guide_c;
+    *a_r += *guide_r;
+    *a *= 0.5f;
+    *a_r *= 0.5f;
+    *a -= *img_c;
+    *a_r -= *img_r;
+
+    float err = maxError(a, a_r);
+    bool bOps = (err <= 1e-3f) && a->isCompact();
+
+    pic::Image b = (*img_c) * 2.0f + (*guide_c);
+    pic::Image b_r = (*img_r) * 2.0f + (*guide_r);
+    err = MAX(err, maxError(&b, &b_r));
+    bOps = bOps && (err <= 1e-3f);
+
+    //an expression is evaluated once into a compact image
+    pic::Image *c = img_c->clone();
+    pic::Image *c_r = img_r->clone();
+    *c = (*c) * 0.5f + (*guide_c);
+    *c_r = (*c_r) * 0.5f + (*guide_r);
+    err = MAX(err, maxError(c, c_r));
+    bOps = bOps && (err <= 1e-3f) && c->isCompact();
+
+    printf("Image operators: %s (max error %e)\n", bOps ? "Ok" : "FAILED", err);
+    bOk = bOps && bOk;
+
+    delete a;
+    delete a_r;
+    delete c;
+    delete c_r;
+    delete img_c;
+    delete img_r;
+    delete guide_c;
+    delete guide_r;
+    delete psf_c;
+    delete psf_r;
+
+    printf(bOk ? "All tests passed.\n" : "Some tests FAILED.\n");
+
+    return bOk ? 0 : 1;
+}
@@ -23,6 +23,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "algorithms/camera_response_function.hpp"
 #include "algorithms/connected_components.hpp"
 #include "algorithms/discrete_cosine_transform.hpp"
+#include "algorithms/multigrid_solver.hpp"
 #include "algorithms/poisson_filling.hpp"
 #include "algorithms/poisson_solver.hpp"
 #include "algorithms/poisson_image_editing.hpp"
@@ -35,6 +36,9 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "algorithms/superpixels_slic.hpp"
 #include "algorithms/color_to_gray.hpp"
 #include "algorithms/histogram_matching.hpp"
+#include "algorithms/bilateral_grid.hpp"
+#include "algorithms/permutohedral_lattice.hpp"
+#include "algorithms/fft_convolution.hpp"
 #include "algorithms/bilateral_separation.hpp"
 #include "algorithms/grow_cut.hpp"
 #include "algorithms/live_wire.hpp"
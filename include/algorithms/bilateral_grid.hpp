@@ -0,0 +1,377 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_ALGORITHMS_BILATERAL_GRID_HPP
+#define PIC_ALGORITHMS_BILATERAL_GRID_HPP
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../util/math.hpp"
+#include "../util/span_ops.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace pic {
+
+/**
+ * @brief BILATERAL_GRID_PAD is the number of empty cells around each axis
+ * of the grid; it covers the support of the blur and of trilinear slicing,
+ * so that neither needs border checks.
+ */
+#define BILATERAL_GRID_PAD 2
+
+/**
+ * @brief The BilateralGrid class is the bilateral grid of Chen et al.
+ * (2007) after Paris and Durand (2006). Cells are stored as
+ * [y][x][r][channels + 1], where the last value counts the splatted
+ * pixels (homogeneous coordinate). The grid is kept between calls; it is
+ * reallocated only when its size changes.
+ */
+class BilateralGrid
+{
+protected:
+    int width, height, range, channels;
+    int rStride, xStride, yStride;
+    float s_S, s_R, minE, mul_E;
+
+    std::vector< float > grid, gridBlur;
+    std::vector< int > rowStart, colIndex, colCell;
+    std::vector< float > colWeight;
+
+    /**
+     * @brief getEdge
+     * @param data
+     * @param edgeChannels
+     * @return It returns the range coordinate of a pixel.
+     */
+    inline float getEdge(float *data, int edgeChannels)
+    {
+        float E = 0.0f;
+
+        for(int k = 0; k < edgeChannels; k++) {
+            E += data[k];
+        }
+
+        return (E * mul_E - minE) * s_R;
+    }
+
+    /**
+     * @brief getCell
+     * @param x
+     * @param y
+     * @param r
+     * @return It returns the offset of the cell (x, y, r), where
+     * coordinates do not include the padding.
+     */
+    inline int getCell(int x, int y, int r)
+    {
+        return (y + BILATERAL_GRID_PAD) * yStride +
+               (x + BILATERAL_GRID_PAD) * xStride +
+               (r + BILATERAL_GRID_PAD) * rStride;
+    }
+
+public:
+
+    BilateralGrid()
+    {
+        width = height = range = channels = 0;
+        rStride = xStride = yStride = 0;
+        s_S = s_R = 1.0f;
+        minE = 0.0f;
+        mul_E = 1.0f;
+    }
+
+    /**
+     * @brief getEdgeRange computes the minimum and the maximum of an edge
+     * image, i.e., of the mean of its channels.
+     * @param edge
+     * @param minE
+     * @param maxE
+     */
+    static void getEdgeRange(Image *edge, float &minE, float &maxE)
+    {
+        int n = edge->width * edge->height;
+        float mul_E = 1.0f / edge->channelsf;
+
+        minE = FLT_MAX;
+        maxE = -FLT_MAX;
+
+        for(int i = 0; i < n; i++) {
+            float *data = &edge->data[i * edge->channels];
+
+            float E = 0.0f;
+            for(int k = 0; k < edge->channels; k++) {
+                E += data[k];
+            }
+
+            E *= mul_E;
+            minE = MIN(minE, E);
+            maxE = MAX(maxE, E);
+        }
+    }
+
+    /**
+     * @brief setup computes the size of the grid, and it allocates it if
+     * the size has changed.
+     * @param imgWidth
+     * @param imgHeight
+     * @param channels is the number of channels of the base image.
+     * @param edgeChannels is the number of channels of the edge image;
+     * the edge is their mean.
+     * @param sigma_s
+     * @param sigma_r
+     * @param minE is the minimum of the edge.
+     * @param maxE is the maximum of the edge.
+     */
+    void setup(int imgWidth, int imgHeight, int channels, int edgeChannels,
+               float sigma_s, float sigma_r, float minE, float maxE)
+    {
+        this->s_S = 1.0f / MAX(sigma_s, 1e-6f);
+        this->s_R = 1.0f / MAX(sigma_r, 1e-6f);
+        this->mul_E = 1.0f / float(edgeChannels);
+        this->minE = minE;
+
+        int width = int(lround(float(imgWidth - 1) * s_S)) + 1;
+        int height = int(lround(float(imgHeight - 1) * s_S)) + 1;
+        int range = int(lround((maxE - minE) * s_R)) + 1;
+        channels++;
+
+        if((width != this->width) || (height != this->height) ||
+           (range != this->range) || (channels != this->channels)) {
+            this->width = width;
+            this->height = height;
+            this->range = range;
+            this->channels = channels;
+
+            rStride = channels;
+            xStride = (range + 2 * BILATERAL_GRID_PAD) * rStride;
+            yStride = (width + 2 * BILATERAL_GRID_PAD) * xStride;
+
+            int size = (height + 2 * BILATERAL_GRID_PAD) * yStride;
+
+            #ifdef PIC_DEBUG
+                //grid and gridBlur
+                float memory = float(2 * size) * float(sizeof(float));
+                printf("Grid Size: %d %d %d - Memory Mb: %3.2f\n", width,
+                       height, range, memory / (1024.0f * 1024.0f));
+            #endif
+
+            //padding cells have to be zero
+            grid.assign(size, 0.0f);
+            gridBlur.assign(size, 0.0f);
+        }
+
+        //rows and columns of pixels splatted into each row/column of the grid,
+        //and cells and weights of each column for slicing
+        rowStart.assign(height + 1, imgHeight);
+        for(int j = imgHeight - 1; j >= 0; j--) {
+            rowStart[lround(float(j) * s_S)] = j;
+        }
+
+        for(int y = height - 1; y >= 0; y--) {
+            rowStart[y] = MIN(rowStart[y], rowStart[y + 1]);
+        }
+
+        colIndex.resize(imgWidth);
+        colCell.resize(imgWidth);
+        colWeight.resize(imgWidth);
+        for(int i = 0; i < imgWidth; i++) {
+            float x = float(i) * s_S;
+            colIndex[i] = int(lround(x));
+            colCell[i] = int(x) * xStride;
+            colWeight[i] = x - floorf(x);
+        }
+    }
+
+    /**
+     * @brief splat accumulates base into the grid with nearest-neighbour
+     * weights. Grid rows are splatted in parallel: a grid row receives a
+     * contiguous set of image rows, so tasks do not write the same cells.
+     * @param base
+     * @param edge
+     */
+    void splat(Image *base, Image *edge)
+    {
+        memset(&grid[0], 0, sizeof(float) * grid.size());
+
+        int c = channels - 1;
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int y) {
+            for(int j = rowStart[y]; j < rowStart[y + 1]; j++) {
+                float *base_data = (*base)(0, j);
+                float *edge_data = (*edge)(0, j);
+
+                for(int i = 0; i < base->width; i++) {
+                    int r = int(lround(getEdge(&edge_data[i * edge->channels], edge->channels)));
+                    r = CLAMP(r, range);
+
+                    float *cell = &grid[getCell(colIndex[i], y, r)];
+                    float *pixel = &base_data[i * c];
+
+                    for(int k = 0; k < c; k++) {
+                        cell[k] += pixel[k];
+                    }
+
+                    cell[c] += 1.0f;
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief blur convolves the grid with a separable [1 4 6 4 1] / 16
+     * kernel along r, x, and y. Each pass runs on contiguous spans, and
+     * grid rows are processed in parallel.
+     */
+    void blur()
+    {
+        const float weights[] = {1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f,
+                                 4.0f / 16.0f, 1.0f / 16.0f};
+
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        //range: grid -> gridBlur
+        pool->parallelFor(height, [&](int y) {
+            for(int x = 0; x < width; x++) {
+                int ind = getCell(x, y, 0);
+                SpanOps::convolve(&gridBlur[ind], &grid[ind], range * rStride,
+                                  weights, 5, rStride);
+            }
+        });
+
+        //x: gridBlur -> grid
+        pool->parallelFor(height, [&](int y) {
+            int ind = getCell(0, y, -BILATERAL_GRID_PAD);
+            SpanOps::convolve(&grid[ind], &gridBlur[ind], width * xStride,
+                              weights, 5, xStride);
+        });
+
+        //y: grid -> gridBlur
+        pool->parallelFor(height, [&](int y) {
+            int ind = (y + BILATERAL_GRID_PAD) * yStride;
+            SpanOps::convolve(&gridBlur[ind], &grid[ind], yStride,
+                              weights, 5, yStride);
+        });
+    }
+
+    /**
+     * @brief slice interpolates the blurred grid trilinearly at each pixel
+     * and divides by the homogeneous coordinate; rows are processed in
+     * parallel.
+     * @param out
+     * @param edge
+     */
+    void slice(Image *out, Image *edge)
+    {
+        int c = channels - 1;
+
+        ThreadPool::getInstance()->parallelFor(out->height, [&](int j) {
+            std::vector< float > vOut(channels);
+
+            int nc = channels;
+            int rS = rStride;
+            int xS = xStride;
+            int yS = yStride;
+            int edgeChannels = edge->channels;
+            float maxR = float(range - 1);
+
+            float y = float(j) * s_S;
+            int y0 = int(y);
+            float dy = y - float(y0);
+
+            const float *grid_j = &gridBlur[getCell(0, y0, 0)];
+            float *out_data = (*out)(0, j);
+            float *edge_data = (*edge)(0, j);
+
+            for(int i = 0; i < out->width; i++) {
+                float r = getEdge(&edge_data[i * edgeChannels], edgeChannels);
+                r = CLAMPi(r, 0.0f, maxR);
+                int r0 = int(r);
+                float dr = r - float(r0);
+                float dx = colWeight[i];
+
+                //padding cells are zero, so x0 + 1, y0 + 1, r0 + 1 are safe
+                const float *g000 = grid_j + colCell[i] + r0 * rS;
+                const float *g010 = g000 + xS;
+                const float *g100 = g000 + yS;
+                const float *g110 = g100 + xS;
+
+                for(int k = 0; k < nc; k++) {
+                    float v00 = g000[k] + dr * (g000[k + rS] - g000[k]);
+                    float v01 = g010[k] + dr * (g010[k + rS] - g010[k]);
+                    float v10 = g100[k] + dr * (g100[k + rS] - g100[k]);
+                    float v11 = g110[k] + dr * (g110[k + rS] - g110[k]);
+
+                    float v0 = v00 + dx * (v01 - v00);
+                    float v1 = v10 + dx * (v11 - v10);
+
+                    vOut[k] = v0 + dy * (v1 - v0);
+                }
+
+                float *pixel = &out_data[i * c];
+
+                if(vOut[c] > 0.0f) {
+                    float w = 1.0f / vOut[c];
+
+                    for(int k = 0; k < c; k++) {
+                        pixel[k] = vOut[k] * w;
+                    }
+                } else {
+                    for(int k = 0; k < c; k++) {
+                        pixel[k] = 0.0f;
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief getWidth
+     * @return
+     */
+    int getWidth()
+    {
+        return width;
+    }
+
+    /**
+     * @brief getHeight
+     * @return
+     */
+    int getHeight()
+    {
+        return height;
+    }
+
+    /**
+     * @brief getRange
+     * @return
+     */
+    int getRange()
+    {
+        return range;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_ALGORITHMS_BILATERAL_GRID_HPP */
+
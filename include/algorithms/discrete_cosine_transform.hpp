@@ -18,34 +18,86 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_ALGORITHMS_DISCRETE_COSINE_TRANSFORM_HPP
 #define PIC_ALGORITHMS_DISCRETE_COSINE_TRANSFORM_HPP
 
+#include <string.h>
+#include <vector>
+
 #include "../image.hpp"
+#include "../util/dct.hpp"
+#include "../util/thread_pool.hpp"
 #include "../util/tile_list.hpp"
 
 namespace pic {
 
 /**
- * @brief The DCT class provides a reference
- * implementation for Discret Cosine Transform.
+ * @brief The DCT class computes the blockwise Discrete Cosine Transform,
+ * e.g., for compression and denoising. Blocks are transformed with a
+ * DCTPlan, and they are processed in parallel.
  */
 class DCT
 {
-public:
+protected:
 
     /**
-     * @brief DCT
+     * @brief processBlock computes the 2D DCT of a block.
+     * @param imgIn
+     * @param imgOut
+     * @param box is the block; pixels outside imgIn are clamped.
+     * @param plan
+     * @param bForward
+     * @param buffer is working memory of 2 * size * size * channels values.
      */
-    DCT()
+    static void processBlock(Image *imgIn, Image *imgOut, BBox &box,
+                             DCTPlan *plan, bool bForward, float *buffer)
     {
+        int size = plan->size();
+        int channels = imgIn->channels;
+        int len = size * channels;
+        float *bufX = buffer;
+        float *bufY = buffer + size * len;
+
+        //bufX is [x][y][channels]
+        for(int y = 0; y < size; y++) {
+            for(int x = 0; x < size; x++) {
+                memcpy(&bufX[x * len + y * channels], (*imgIn)(box.x0 + x, box.y0 + y),
+                       sizeof(float) * channels);
+            }
+        }
+
+        if(bForward) {
+            plan->forward(bufX, len, len);
+        } else {
+            plan->inverse(bufX, len, len);
+        }
+
+        //bufY is [y][x][channels]
+        for(int x = 0; x < size; x++) {
+            for(int y = 0; y < size; y++) {
+                memcpy(&bufY[y * len + x * channels], &bufX[x * len + y * channels],
+                       sizeof(float) * channels);
+            }
+        }
+
+        if(bForward) {
+            plan->forward(bufY, len, len);
+        } else {
+            plan->inverse(bufY, len, len);
+        }
+
+        for(int y = box.y0; y < box.y1; y++) {
+            memcpy((*imgOut)(box.x0, y), &bufY[(y - box.y0) * len],
+                   sizeof(float) * (box.x1 - box.x0) * channels);
+        }
     }
 
     /**
-     * @brief transform computes the forward DCT transformation.
-     * @param imgIn is an input image.
-     * @param imgOut is an output image; i.e. imgIn in the DCT domain.
-     * @param size is the size of blocks (size * size) for computing the DCT.
+     * @brief process
+     * @param imgIn
+     * @param imgOut
+     * @param size
+     * @param bForward
      * @return
      */
-    static Image *transform(Image *imgIn, Image *imgOut, int size = 8)
+    static Image *process(Image *imgIn, Image *imgOut, int size, bool bForward)
     {
         if(imgIn == NULL) {
             return imgOut;
@@ -59,68 +111,50 @@ public:
             size = 8;
         }
 
-        float size2 = float(size * 2);
-        float squareRoot2 = sqrtf(2.0f);
-        float squareRoot = sqrtf(2.0f / float(size));
-        float squareRootPow2 = squareRoot * squareRoot;
-
-        int channels = imgIn->channels;
+        DCTPlan *plan = DCTPlan::get(size);
 
         TileList tiles(size, imgOut->width, imgOut->height);
 
-        for(unsigned int t = 0; t < tiles.tiles.size(); t++) {
-            BBox box = tiles.getBBox(t);
-
-            for(int v = box.y0; v < box.y1; v++) {
-                int vr = v % size;
-
-                for(int u = box.x0; u < box.x1; u++) {
-                    int ur = u % size;
-
-                    float *dataOut = (*imgOut)(u, v);
+        ThreadPool *pool = ThreadPool::getInstance();
+        int nThreads = pool->getNumberOfThreads();
+        int nTiles = int(tiles.size());
+        int n = 2 * size * size * imgIn->channels;
 
-                    for(int p = 0; p < channels; p++) {
-                        dataOut[p] = 0.0f;
-                    }
+        //each task transforms a contiguous range of blocks
+        pool->parallelFor(nThreads, [&](int t) {
+            std::vector< float > buffer(n);
 
-                    for(int y = 0; y < size; y++) {
-                        int yi		=  y + box.y0;
-                        int	val		= vr * (2 * y + 1);
-                        float cosU	= cosf(C_PI * float(val) / size2);
+            int t0 = int((long long)(nTiles) * t / nThreads);
+            int t1 = int((long long)(nTiles) * (t + 1) / nThreads);
 
-                        for(int x = 0; x < size; x++) {
-                            int xi		=  x + box.x0;
-                            val			= ur * (2 * x + 1);
-                            float tot	= cosU * cosf(C_PI * float(val) / size2);
-
-                            float *dataIn = (*imgIn)(xi, yi);
-
-                            for(int p = 0; p < channels; p++) {
-                                dataOut[p] += tot * dataIn[p];
-                            }
-                        }
-                    }
+            for(int i = t0; i < t1; i++) {
+                BBox box = tiles.getBBox(i);
+                processBlock(imgIn, imgOut, box, plan, bForward, &buffer[0]);
+            }
+        });
 
-                    if(ur == 0) {
-                        for(int p = 0; p < channels; p++) {
-                            dataOut[p] /= squareRoot2;
-                        }
-                    }
+        return imgOut;
+    }
 
-                    if(vr == 0) {
-                        for(int p = 0; p < channels; p++) {
-                            dataOut[p] /= squareRoot2;
-                        }
-                    }
+public:
 
-                    for(int p = 0; p < channels; p++) {
-                        dataOut[p] *= squareRootPow2;
-                    }
-                }
-            }
-        }
+    /**
+     * @brief DCT
+     */
+    DCT()
+    {
+    }
 
-        return imgOut;
+    /**
+     * @brief transform computes the forward DCT transformation.
+     * @param imgIn is an input image.
+     * @param imgOut is an output image; i.e. imgIn in the DCT domain.
+     * @param size is the size of blocks (size * size) for computing the DCT.
+     * @return
+     */
+    static Image *transform(Image *imgIn, Image *imgOut, int size = 8)
+    {
+        return process(imgIn, imgOut, size, true);
     }
 
     /**
@@ -132,76 +166,7 @@ public:
      */
     static Image *inverse(Image *imgIn, Image *imgOut, int size = 8)
     {
-        if(imgIn == NULL) {
-            return imgOut;
-        }
-
-        if(imgOut == NULL) {
-            imgOut = imgIn->allocateSimilarOne();
-        }
-
-        if(size < 1) {
-            size = 8;
-        }
-
-        float size2 = float(size * 2);
-        float squareRoot2 = sqrtf(2.0f);
-        float squareRoot = sqrtf(2.0f / float(size));
-        float squareRootPow2 = squareRoot * squareRoot;
-
-        int channels = imgIn->channels;
-
-        TileList tiles(size, imgOut->width, imgOut->height);
-
-        for(unsigned int t = 0; t < tiles.tiles.size(); t++) {
-            BBox box = tiles.getBBox(t);
-
-            for(int y = box.y0; y < box.y1; y++) {
-                int yr = y % size;
-
-                for(int x = box.x0; x < box.x1; x++) {
-                    int xr = x % size;
-
-                    float *dataOut = (*imgOut)(x, y);
-
-                    for(int p = 0; p < channels; p++) {
-                        dataOut[p] = 0.0f;
-                    }
-
-                    for(int v = 0; v < size; v++) {
-                        int vi		= box.y0 + v;
-                        int	val		= v * (2 * yr + 1);
-                        float cosU	= cosf(C_PI * float(val) / size2);
-
-                        if(v == 0) {
-                            cosU /= squareRoot2;
-                        }
-
-                        for(int u = 0; u < size; u++) {
-                            int ui		= box.x0 + u;
-                            val			= u * (2 * xr + 1);
-                            float tot	= cosU * cosf(C_PI * float(val) / size2);
-
-                            if(u == 0) {
-                                tot /= squareRoot2;
-                            }
-
-                            float *dataIn = (*imgIn)(ui, vi);
-
-                            for(int p = 0; p < channels; p++) {
-                                dataOut[p] += tot * dataIn[p];
-                            }
-                        }
-                    }
-
-                    for(int p = 0; p < channels; p++) {
-                        dataOut[p] *= squareRootPow2;
-                    }
-                }
-            }
-        }
-
-        return imgOut;
+        return process(imgIn, imgOut, size, false);
     }
 };
 
@@ -0,0 +1,230 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_ALGORITHMS_FFT_CONVOLUTION_HPP
+#define PIC_ALGORITHMS_FFT_CONVOLUTION_HPP
+
+#include <math.h>
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../util/math.hpp"
+#include "../util/fft.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace pic {
+
+/**
+ * @brief FFT_CONVOLUTION_TILE is the largest FFT size (per axis) used by
+ * FFTConvolution; larger images are processed in overlapping tiles.
+ */
+#ifndef FFT_CONVOLUTION_TILE
+#define FFT_CONVOLUTION_TILE 1024
+#endif
+
+/**
+ * @brief The FFTConvolution class computes the same filter as
+ * FilterConv2D, out(x, y) = sum img(x + l, y + k) * kernel(l + hw, k + hh)
+ * with clamped coordinates, in the frequency domain. The image is split
+ * into tiles (overlap-save): a tile is gathered with a border of the size
+ * of the kernel, transformed, multiplied by the kernel spectrum, and
+ * transformed back; only the part of the tile without wrap-around is kept.
+ * Kernel spectra are computed in setup, so they are reused across calls.
+ */
+class FFTConvolution
+{
+protected:
+    int halfWidth, halfHeight, channels;
+    int tileWidth, tileHeight, validWidth, validHeight;
+
+    FFT2D fft;
+    std::vector< float > tile, tileRe, tileIm, kernelRe, kernelIm;
+
+    /**
+     * @brief getTileSize
+     * @param n is the size of the image.
+     * @param halfSize is the half size of the kernel.
+     * @param tile is the FFT size.
+     * @param valid is the number of output pixels of a tile.
+     */
+    static void getTileSize(int n, int halfSize, int &tile, int &valid)
+    {
+        int border = halfSize << 1;
+
+        //the number of tiles for the largest tile, which are then shrunk
+        //to cover n with as little padding as possible
+        int maxTile = MAX(FFT_CONVOLUTION_TILE, border << 2);
+        int nTiles = (n + maxTile - border - 1) / (maxTile - border);
+
+        tile = FFTPlan::getGoodSize((n + nTiles - 1) / nTiles + border);
+        valid = tile - border;
+    }
+
+public:
+
+    FFTConvolution()
+    {
+        halfWidth = halfHeight = channels = 0;
+        tileWidth = tileHeight = validWidth = validHeight = 0;
+    }
+
+    /**
+     * @brief isFaster estimates if the frequency domain is faster than
+     * the spatial domain for a kernel and an image.
+     * @param width
+     * @param height
+     * @param kernel
+     * @return
+     */
+    static bool isFaster(int width, int height, Image *kernel)
+    {
+        int hw = kernel->width >> 1;
+        int hh = kernel->height >> 1;
+
+        int tw, th, vw, vh;
+        getTileSize(width, hw, tw, vw);
+        getTileSize(height, hh, th, vh);
+
+        double nTiles = double((width + vw - 1) / vw) * double((height + vh - 1) / vh);
+        double area = double(tw) * double(th);
+
+        //costs per channel in spatial taps; FFT constants were measured
+        //against FilterConv2D, which is slower for multi-channel kernels
+        double spatial = double(width) * double(height) *
+                         double((2 * hw + 1) * (2 * hh + 1));
+
+        if(kernel->channels > 1) {
+            spatial *= 4.0;
+        }
+
+        double frequency = nTiles * area * 16.0 * log2(area);
+
+        return frequency < spatial;
+    }
+
+    /**
+     * @brief setup computes the tiles for an image, and the spectra of
+     * the kernel for each of its channels.
+     * @param width is the width of the image.
+     * @param height is the height of the image.
+     * @param kernel
+     */
+    void setup(int width, int height, Image *kernel)
+    {
+        halfWidth = kernel->width >> 1;
+        halfHeight = kernel->height >> 1;
+        channels = kernel->channels;
+
+        getTileSize(width, halfWidth, tileWidth, validWidth);
+        getTileSize(height, halfHeight, tileHeight, validHeight);
+
+        fft.setup(tileWidth, tileHeight);
+
+        int area = tileWidth * tileHeight;
+        tile.resize(area);
+        tileRe.resize(area);
+        tileIm.resize(area);
+        kernelRe.resize(area * channels);
+        kernelIm.resize(area * channels);
+
+        //taps are placed at (-l, -k) modulo the tile, so that the circular
+        //convolution computes a correlation as in FilterConv2D
+        for(int c = 0; c < channels; c++) {
+            std::fill(tile.begin(), tile.end(), 0.0f);
+
+            for(int k = -halfHeight; k <= halfHeight; k++) {
+                int y = (tileHeight - k) % tileHeight;
+
+                for(int l = -halfWidth; l <= halfWidth; l++) {
+                    int x = (tileWidth - l) % tileWidth;
+                    tile[y * tileWidth + x] += (*kernel)(l + halfWidth, k + halfHeight)[c];
+                }
+            }
+
+            fft.forwardReal(&tile[0], 1, &kernelRe[c * area], &kernelIm[c * area]);
+        }
+    }
+
+    /**
+     * @brief process convolves a channel of img; the result at (x, y) is
+     * passed to op(x, y, value), which is called in parallel on rows, so
+     * pointwise operations on the result are fused into the output pass.
+     * @param img
+     * @param channel
+     * @param op
+     */
+    template<class OP>
+    void process(Image *img, int channel, OP op)
+    {
+        int area = tileWidth * tileHeight;
+        const float *kRe = &kernelRe[(channel % channels) * area];
+        const float *kIm = &kernelIm[(channel % channels) * area];
+
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        for(int y0 = 0; y0 < img->height; y0 += validHeight) {
+            for(int x0 = 0; x0 < img->width; x0 += validWidth) {
+
+                //gather with clamped coordinates
+                pool->parallelFor(tileHeight, [&](int py) {
+                    int sy = CLAMP(y0 - halfHeight + py, img->height);
+                    float *src = img->data + sy * img->ystride + channel;
+                    float *dst = &tile[py * tileWidth];
+
+                    for(int px = 0; px < tileWidth; px++) {
+                        int sx = CLAMP(x0 - halfWidth + px, img->width);
+                        dst[px] = src[sx * img->xstride];
+                    }
+                });
+
+                fft.forwardReal(&tile[0], 1, &tileRe[0], &tileIm[0]);
+
+                pool->parallelFor(tileHeight, [&](int py) {
+                    int offset = py * tileWidth;
+                    float *re = &tileRe[offset];
+                    float *im = &tileIm[offset];
+
+                    for(int px = 0; px < tileWidth; px++) {
+                        float a = re[px];
+                        float b = im[px];
+                        re[px] = a * kRe[offset + px] - b * kIm[offset + px];
+                        im[px] = a * kIm[offset + px] + b * kRe[offset + px];
+                    }
+                });
+
+                fft.inverseReal(&tileRe[0], &tileIm[0], &tile[0], 1);
+
+                int w = MIN(validWidth, img->width - x0);
+                int h = MIN(validHeight, img->height - y0);
+
+                pool->parallelFor(h, [&](int py) {
+                    float *src = &tile[(py + halfHeight) * tileWidth + halfWidth];
+
+                    for(int px = 0; px < w; px++) {
+                        op(x0 + px, y0 + py, src[px]);
+                    }
+                });
+            }
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_ALGORITHMS_FFT_CONVOLUTION_HPP */
+
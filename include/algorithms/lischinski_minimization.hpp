@@ -30,8 +30,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #endif
 
+#include <vector>
+
 #include "../base.hpp"
 #include "../image.hpp"
+#include "../util/thread_pool.hpp"
+#include "../algorithms/multigrid_solver.hpp"
 
 namespace pic {
 /**
@@ -77,6 +81,13 @@ inline float LischinskiFunctionGauss(float Lcur, float Lref, float param[2])
  * @param alpha
  * @param lambda
  * @param LISCHINSKI_EPSILON
+ * @param bMatrixFree solves the system with a MultigridSolver instead of
+ * factoring it; without Eigen, it is always true.
+ * @param bWarmStart uses gOut as the initial guess (e.g., the previous frame
+ * of a video) in the matrix-free mode.
+ * @param tolerance is the relative residual at convergence in the
+ * matrix-free mode.
+ * @param preconditioner is the preconditioner of the matrix-free mode.
  * @return
  */
 PIC_INLINE Image *LischinskiMinimization(Image *L,
@@ -86,12 +97,77 @@ PIC_INLINE Image *LischinskiMinimization(Image *L,
                               Image *gOut = NULL,
                               float alpha = 1.0f,
                               float lambda = 0.4f,
-                              float LISCHINSKI_EPSILON = 1e-4f)
+                              float LISCHINSKI_EPSILON = 1e-4f,
+                              bool bMatrixFree = false,
+                              bool bWarmStart = false,
+                              float tolerance = 1e-7f,
+                              MULTIGRID_PRECONDITIONER preconditioner = MGP_VCYCLE)
 {
     if(L == NULL || g == NULL) {
         return gOut;
     }
 
+#ifdef PIC_DISABLE_EIGEN
+    bMatrixFree = true;
+#endif
+
+    if(bMatrixFree) {
+        int width = L->width;
+        int height = L->height;
+        int tot = height * width;
+
+        float param[2];
+        param[0] = alpha;
+        param[1] = lambda;
+
+        bool bPrevious = bWarmStart && (gOut != NULL) && gOut->isSimilarType(g);
+
+        if(gOut == NULL) {
+            gOut = g->allocateSimilarOne();
+        } else {
+            if(!gOut->isSimilarType(g)) {
+                gOut = g->allocateSimilarOne();
+            }
+        }
+
+        std::vector< float > wx(tot), wy(tot), c(tot), b(tot), x(tot);
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int i) {
+            for(int j = 0; j < width; j++) {
+                int indI = i * width + j;
+                float Lref = L->data[indI];
+
+                float omega_val = (omega == NULL) ? omega_global : omega->data[indI];
+
+                c[indI] = omega_val;
+                b[indI] = omega_val * g->data[indI];
+
+                wx[indI] = ((j + 1) < width) ?
+                           -LischinskiFunction(L->data[indI + 1], Lref, param, LISCHINSKI_EPSILON) : 0.0f;
+                wy[indI] = ((i + 1) < height) ?
+                           -LischinskiFunction(L->data[indI + width], Lref, param, LISCHINSKI_EPSILON) : 0.0f;
+
+                x[indI] = bPrevious ? (*gOut)(j, i)[0] : g->data[indI];
+            }
+        });
+
+        MultigridSolver solver;
+        solver.tolerance = tolerance;
+        solver.preconditioner = preconditioner;
+        solver.setup(width, height, &wx[0], &wy[0], &c[0]);
+        solver.solve(&x[0], &b[0]);
+
+        for(int i = 0; i < height; i++) {
+            int counter = i * width;
+
+            for(int j = 0; j < width; j++) {
+                (*gOut)(j, i)[0] = x[counter + j];
+            }
+        }
+
+        return gOut;
+    }
+
 #ifndef PIC_DISABLE_EIGEN
     bool bOmega = (omega == NULL);
 
@@ -0,0 +1,656 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_ALGORITHMS_MULTIGRID_SOLVER_HPP
+#define PIC_ALGORITHMS_MULTIGRID_SOLVER_HPP
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../base.hpp"
+#include "../util/math.hpp"
+#include "../util/span_ops.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace pic {
+
+/**
+ * @brief The MULTIGRID_PRECONDITIONER enum selects the preconditioner of
+ * MultigridSolver: MGP_JACOBI is the inverse of the diagonal, which is
+ * cheaper per iteration, and MGP_VCYCLE is a multigrid V-cycle, which
+ * needs a few iterations at any size.
+ */
+enum MULTIGRID_PRECONDITIONER {MGP_JACOBI, MGP_VCYCLE};
+
+/**
+ * @brief MULTIGRID_SOLVER_COARSEST is the maximum number of cells of the
+ * coarsest level, which is solved with Gauss-Seidel sweeps.
+ */
+#ifndef MULTIGRID_SOLVER_COARSEST
+#define MULTIGRID_SOLVER_COARSEST 64
+#endif
+
+/**
+ * @brief The MultigridSolver class solves A x = b, where A is a symmetric
+ * five-point operator on a width x height grid:
+ *
+ * (A x)(p) = (c(p) + sum_n w(p, n)) x(p) - sum_n w(p, n) x(n),
+ *
+ * with non-negative couplings w between 4-connected pixels, and a
+ * non-negative diagonal term c. Pixels outside the mask keep their value;
+ * i.e., they are Dirichlet boundary conditions. The operator is never
+ * assembled: the solver runs conjugate gradients preconditioned by a
+ * multigrid V-cycle or by Jacobi. Coarse levels are the Galerkin product of the
+ * operator with 2 x 2 aggregation, so they are five-point operators as
+ * well. Levels are stored with a border of zeros, and rows are processed
+ * in parallel.
+ */
+class MultigridSolver
+{
+protected:
+
+    /**
+     * @brief The Level struct stores the operator and the vectors of a
+     * level; arrays are (width + 2) x (height + 2).
+     */
+    struct Level
+    {
+        int width, height, pw;
+        std::vector< float > diag, invDiag, wx, wy;
+        std::vector< float > x, b, r;
+
+        //K-cycle vectors
+        std::vector< float > c, v;
+
+        /**
+         * @brief index
+         * @param i
+         * @param j
+         * @return It returns the offset of the pixel (i, j).
+         */
+        inline int index(int i, int j) const
+        {
+            return (j + 1) * pw + i + 1;
+        }
+    };
+
+    int width, height;
+    std::vector< Level > levels;
+
+    //couplings of the finest level including the ones to fixed pixels
+    std::vector< float > wx0, wy0, mask0;
+
+    //conjugate gradients
+    std::vector< float > x, r, z, zOld, p, q;
+    std::vector< double > partial;
+
+    /**
+     * @brief allocate
+     * @param level
+     * @param width
+     * @param height
+     */
+    static void allocate(Level &level, int width, int height)
+    {
+        level.width = width;
+        level.height = height;
+        level.pw = width + 2;
+
+        int n = (width + 2) * (height + 2);
+        level.diag.assign(n, 0.0f);
+        level.invDiag.assign(n, 0.0f);
+        level.wx.assign(n, 0.0f);
+        level.wy.assign(n, 0.0f);
+        level.x.assign(n, 0.0f);
+        level.b.assign(n, 0.0f);
+        level.r.assign(n, 0.0f);
+        level.c.assign(n, 0.0f);
+        level.v.assign(n, 0.0f);
+    }
+
+    /**
+     * @brief coarsen computes the Galerkin product of the operator of
+     * fine with 2 x 2 aggregation.
+     * @param fine
+     * @param coarse
+     */
+    static void coarsen(const Level &fine, Level &coarse)
+    {
+        allocate(coarse, (fine.width + 1) / 2, (fine.height + 1) / 2);
+
+        ThreadPool::getInstance()->parallelFor(coarse.height, [&](int j) {
+            for(int i = 0; i < coarse.width; i++) {
+                //children out of the grid fall into the border of zeros
+                int c00 = fine.index(2 * i, 2 * j);
+                int c01 = c00 + 1;
+                int c10 = c00 + fine.pw;
+                int c11 = c10 + 1;
+
+                int ind = coarse.index(i, j);
+
+                //couplings inside the aggregate are removed twice
+                float d = fine.diag[c00] + fine.diag[c01] +
+                          fine.diag[c10] + fine.diag[c11];
+                d -= 2.0f * (fine.wx[c00] + fine.wx[c10] +
+                             fine.wy[c00] + fine.wy[c01]);
+
+                coarse.diag[ind] = d;
+                coarse.invDiag[ind] = d > 0.0f ? 1.0f / d : 0.0f;
+
+                if(i < (coarse.width - 1)) {
+                    coarse.wx[ind] = fine.wx[c01] + fine.wx[c11];
+                }
+
+                if(j < (coarse.height - 1)) {
+                    coarse.wy[ind] = fine.wy[c10] + fine.wy[c11];
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief apply computes out = A in on a row.
+     * @param level
+     * @param wx
+     * @param wy
+     * @param in
+     * @param out
+     * @param j
+     */
+    static inline void applyRow(const Level &level, const float *wx, const float *wy,
+                                const float *in, float *out, int j)
+    {
+        int pw = level.pw;
+        int ind = level.index(0, j);
+        const float *d = &level.diag[ind];
+        const float *wx_j = &wx[ind];
+        const float *wy_j = &wy[ind];
+        const float *wy_u = wy_j - pw;
+        const float *in_j = &in[ind];
+        float *out_j = &out[ind];
+
+#ifndef PIC_DISABLE_EIGEN
+        int n = level.width;
+        Eigen::Map<Eigen::ArrayXf> o(out_j, n);
+        o = Eigen::Map<const Eigen::ArrayXf>(d, n) * Eigen::Map<const Eigen::ArrayXf>(in_j, n) -
+            Eigen::Map<const Eigen::ArrayXf>(wx_j, n) * Eigen::Map<const Eigen::ArrayXf>(in_j + 1, n) -
+            Eigen::Map<const Eigen::ArrayXf>(wx_j - 1, n) * Eigen::Map<const Eigen::ArrayXf>(in_j - 1, n) -
+            Eigen::Map<const Eigen::ArrayXf>(wy_j, n) * Eigen::Map<const Eigen::ArrayXf>(in_j + pw, n) -
+            Eigen::Map<const Eigen::ArrayXf>(wy_u, n) * Eigen::Map<const Eigen::ArrayXf>(in_j - pw, n);
+#else
+        for(int i = 0; i < level.width; i++) {
+            out_j[i] = d[i] * in_j[i] -
+                       wx_j[i] * in_j[i + 1] - wx_j[i - 1] * in_j[i - 1] -
+                       wy_j[i] * in_j[i + pw] - wy_u[i] * in_j[i - pw];
+        }
+#endif
+    }
+
+    /**
+     * @brief smooth runs a red-black Gauss-Seidel sweep on level.x;
+     * bReverse swaps the order of the colors, so that a sweep followed by
+     * a reversed one is symmetric.
+     * @param level
+     * @param bReverse
+     */
+    static void smooth(Level &level, bool bReverse)
+    {
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        for(int c = 0; c < 2; c++) {
+            int color = bReverse ? (1 - c) : c;
+
+            pool->parallelFor(level.height, [&](int j) {
+                int pw = level.pw;
+                int ind = level.index(0, j);
+                const float *invD = &level.invDiag[ind];
+                const float *wx_j = &level.wx[ind];
+                const float *wy_j = &level.wy[ind];
+                const float *wy_u = wy_j - pw;
+                const float *b_j = &level.b[ind];
+                float *x_j = &level.x[ind];
+
+                for(int i = (j + color) & 1; i < level.width; i += 2) {
+                    x_j[i] = invD[i] * (b_j[i] +
+                                        wx_j[i] * x_j[i + 1] + wx_j[i - 1] * x_j[i - 1] +
+                                        wy_j[i] * x_j[i + pw] + wy_u[i] * x_j[i - pw]);
+                }
+            });
+        }
+    }
+
+    /**
+     * @brief vcycle approximates the solution of A x = b at level l,
+     * starting from x = 0.
+     * @param l
+     */
+    void vcycle(int l)
+    {
+        Level &level = levels[l];
+
+        std::fill(level.x.begin(), level.x.end(), 0.0f);
+
+        if(l == int(levels.size() - 1)) {
+            for(int i = 0; i < MULTIGRID_SOLVER_COARSEST; i++) {
+                smooth(level, false);
+                smooth(level, true);
+            }
+
+            return;
+        }
+
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        smooth(level, false);
+
+        //restriction: sum of the residuals of the aggregate
+        pool->parallelFor(level.height, [&](int j) {
+            applyRow(level, &level.wx[0], &level.wy[0], &level.x[0], &level.r[0], j);
+
+            int ind = level.index(0, j);
+            for(int i = 0; i < level.width; i++) {
+                level.r[ind + i] = level.b[ind + i] - level.r[ind + i];
+            }
+        });
+
+        //children out of the grid fall into the border, where r is zero
+        Level &coarse = levels[l + 1];
+        pool->parallelFor(coarse.height, [&](int j) {
+            for(int i = 0; i < coarse.width; i++) {
+                int c00 = level.index(2 * i, 2 * j);
+                int c10 = c00 + level.pw;
+
+                coarse.b[coarse.index(i, j)] = level.r[c00] + level.r[c00 + 1] +
+                                               level.r[c10] + level.r[c10 + 1];
+            }
+        });
+
+        kcycle(l + 1);
+
+        //prolongation: the aggregate takes the correction of its parent
+        pool->parallelFor(level.height, [&](int j) {
+            int ind = level.index(0, j);
+            const float *xc = &coarse.x[coarse.index(0, j >> 1)];
+            const float *invD = &level.invDiag[ind];
+            float *x_j = &level.x[ind];
+
+            for(int i = 0; i < level.width; i++) {
+                //fixed pixels (invDiag = 0) are not corrected
+                x_j[i] += (invD[i] > 0.0f) ? xc[i >> 1] : 0.0f;
+            }
+        });
+
+        smooth(level, true);
+    }
+
+    /**
+     * @brief kcycle approximates the solution of A x = b at a coarse level l
+     * with two steps of flexible conjugate gradients preconditioned by
+     * vcycle (K-cycle, Notay and Vassilevski 2008). Aggregation misjudges
+     * the size of coarse corrections, so they are scaled to minimize the
+     * energy of the error.
+     * @param l
+     */
+    void kcycle(int l)
+    {
+        Level &level = levels[l];
+
+        vcycle(l);
+
+        if(l == int(levels.size() - 1)) {
+            return;
+        }
+
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        //first step: c = V(b), v = A c
+        level.c.swap(level.x);
+        pool->parallelFor(level.height, [&](int j) {
+            applyRow(level, &level.wx[0], &level.wy[0], &level.c[0], &level.v[0], j);
+        });
+
+        double rho1 = dot(level, level.c, level.v);
+        if(rho1 <= 0.0) {
+            std::fill(level.x.begin(), level.x.end(), 0.0f);
+            return;
+        }
+
+        double alpha1 = dot(level, level.c, level.b);
+        float a1 = float(alpha1 / rho1);
+
+        pool->parallelFor(level.height, [&](int j) {
+            int ind = level.index(0, j);
+            SpanOps::madd(&level.b[ind], &level.v[ind], -a1, level.width);
+        });
+
+        //second step: x = V(b - a1 v), r = A x
+        vcycle(l);
+
+        pool->parallelFor(level.height, [&](int j) {
+            applyRow(level, &level.wx[0], &level.wy[0], &level.x[0], &level.r[0], j);
+        });
+
+        double gamma = dot(level, level.x, level.v);
+        double beta = dot(level, level.x, level.r);
+        double alpha2 = dot(level, level.x, level.b);
+        double rho2 = beta - gamma * gamma / rho1;
+
+        float w1 = a1;
+        float w2 = 0.0f;
+
+        if(rho2 > 0.0) {
+            w1 = float((alpha1 - gamma * alpha2 / rho2) / rho1);
+            w2 = float(alpha2 / rho2);
+        }
+
+        pool->parallelFor(level.height, [&](int j) {
+            int ind = level.index(0, j);
+            SpanOps::assign(&level.x[ind], &level.x[ind], w2, level.width);
+            SpanOps::madd(&level.x[ind], &level.c[ind], w1, level.width);
+        });
+    }
+
+    /**
+     * @brief dot
+     * @param level
+     * @param a
+     * @param b
+     * @return It returns the dot product of a and b on level.
+     */
+    double dot(const Level &level, const std::vector< float > &a, const std::vector< float > &b)
+    {
+        int width = level.width;
+        int height = level.height;
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int j) {
+            int ind = level.index(0, j);
+
+#ifndef PIC_DISABLE_EIGEN
+            partial[j] = double((Eigen::Map<const Eigen::ArrayXf>(&a[ind], width) *
+                                 Eigen::Map<const Eigen::ArrayXf>(&b[ind], width)).sum());
+#else
+            double sum = 0.0;
+
+            for(int i = 0; i < width; i++) {
+                sum += double(a[ind + i]) * double(b[ind + i]);
+            }
+
+            partial[j] = sum;
+#endif
+        });
+
+        double sum = 0.0;
+        for(int j = 0; j < height; j++) {
+            sum += partial[j];
+        }
+
+        return sum;
+    }
+
+    /**
+     * @brief dot
+     * @param a
+     * @param b
+     * @return It returns the dot product of a and b on the finest level.
+     */
+    double dot(const std::vector< float > &a, const std::vector< float > &b)
+    {
+        return dot(levels[0], a, b);
+    }
+
+    /**
+     * @brief precondition computes z = M^-1 r.
+     */
+    void precondition()
+    {
+        Level &level = levels[0];
+
+        if(preconditioner == MGP_JACOBI) {
+            ThreadPool::getInstance()->parallelFor(height, [&](int j) {
+                int ind = level.index(0, j);
+
+                for(int i = 0; i < width; i++) {
+                    z[ind + i] = level.invDiag[ind + i] * r[ind + i];
+                }
+            });
+
+            return;
+        }
+
+        level.b.swap(r);
+        vcycle(0);
+        level.b.swap(r);
+        z.swap(level.x);
+    }
+
+public:
+
+    int maxIterations;
+    float tolerance;
+    MULTIGRID_PRECONDITIONER preconditioner;
+
+    MultigridSolver()
+    {
+        width = height = 0;
+        maxIterations = 1000;
+        tolerance = 1e-5f;
+        preconditioner = MGP_VCYCLE;
+    }
+
+    /**
+     * @brief setup builds the levels of the operator; the preconditioner
+     * has to be selected before.
+     * @param width
+     * @param height
+     * @param wx is the coupling between (i, j) and (i + 1, j); width * height values.
+     * @param wy is the coupling between (i, j) and (i, j + 1); width * height values.
+     * @param c is the diagonal term; if it is NULL, it is zero.
+     * @param mask marks the unknowns; if it is NULL, all pixels are unknowns.
+     */
+    void setup(int width, int height, const float *wx, const float *wy,
+               const float *c = NULL, const bool *mask = NULL)
+    {
+        if((width < 1) || (height < 1) || (wx == NULL) || (wy == NULL)) {
+            return;
+        }
+
+        this->width = width;
+        this->height = height;
+
+        if(levels.empty()) {
+            levels.resize(1);
+        }
+
+        Level &level = levels[0];
+        allocate(level, width, height);
+
+        int n = int(level.diag.size());
+        wx0.assign(n, 0.0f);
+        wy0.assign(n, 0.0f);
+        mask0.assign(n, 0.0f);
+
+        x.assign(n, 0.0f);
+        r.assign(n, 0.0f);
+        z.assign(n, 0.0f);
+        zOld.assign(n, 0.0f);
+        p.assign(n, 0.0f);
+        q.assign(n, 0.0f);
+        partial.resize(height);
+
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        pool->parallelFor(height, [&](int j) {
+            for(int i = 0; i < width; i++) {
+                int src = j * width + i;
+                int ind = level.index(i, j);
+
+                wx0[ind] = (i < (width - 1)) ? MAX(wx[src], 0.0f) : 0.0f;
+                wy0[ind] = (j < (height - 1)) ? MAX(wy[src], 0.0f) : 0.0f;
+                mask0[ind] = ((mask == NULL) || mask[src]) ? 1.0f : 0.0f;
+            }
+        });
+
+        pool->parallelFor(height, [&](int j) {
+            int pw = level.pw;
+
+            for(int i = 0; i < width; i++) {
+                int ind = level.index(i, j);
+
+                float d = wx0[ind] + wx0[ind - 1] + wy0[ind] + wy0[ind - pw];
+                if(c != NULL) {
+                    d += MAX(c[j * width + i], 0.0f);
+                }
+
+                level.diag[ind] = d;
+                level.invDiag[ind] = (mask0[ind] > 0.0f && d > 0.0f) ? 1.0f / d : 0.0f;
+
+                //the correction is zero at fixed pixels, so their couplings are dropped
+                level.wx[ind] = wx0[ind] * mask0[ind] * mask0[ind + 1];
+                level.wy[ind] = wy0[ind] * mask0[ind] * mask0[ind + pw];
+            }
+        });
+
+        //fixed pixels do not count in the coarse diagonal
+        pool->parallelFor(height, [&](int j) {
+            for(int i = 0; i < width; i++) {
+                int ind = level.index(i, j);
+                level.diag[ind] *= mask0[ind];
+            }
+        });
+
+        //coarse levels are needed only by the V-cycle
+        int nLevels = 1;
+        while((preconditioner == MGP_VCYCLE) &&
+              ((levels[nLevels - 1].width * levels[nLevels - 1].height) > MULTIGRID_SOLVER_COARSEST)) {
+            if(int(levels.size()) <= nLevels) {
+                levels.resize(nLevels + 1);
+            }
+
+            coarsen(levels[nLevels - 1], levels[nLevels]);
+            nLevels++;
+        }
+
+        levels.resize(nLevels);
+    }
+
+    /**
+     * @brief solve solves A x = b; x is the initial guess (e.g., the
+     * previous frame of a video), and it holds the values of fixed pixels.
+     * @param x_in_out is the solution; its pixels are stride floats apart.
+     * @param b is the right-hand side with the layout of x; if it is NULL,
+     * it is zero.
+     * @param stride
+     * @return It returns the number of iterations.
+     */
+    int solve(float *x_in_out, const float *b, int stride = 1)
+    {
+        if(levels.empty() || (x_in_out == NULL)) {
+            return 0;
+        }
+
+        Level &level = levels[0];
+        ThreadPool *pool = ThreadPool::getInstance();
+
+        //r = b - A x with all couplings, only at unknowns
+        pool->parallelFor(height, [&](int j) {
+            for(int i = 0; i < width; i++) {
+                x[level.index(i, j)] = x_in_out[(j * width + i) * stride];
+            }
+        });
+
+        pool->parallelFor(height, [&](int j) {
+            int ind = level.index(0, j);
+            int pw = level.pw;
+
+            for(int i = 0; i < width; i++) {
+                int k = ind + i;
+                float Ax = level.diag[k] * x[k] -
+                           wx0[k] * x[k + 1] - wx0[k - 1] * x[k - 1] -
+                           wy0[k] * x[k + pw] - wy0[k - pw] * x[k - pw];
+
+                float value = (b != NULL) ? b[(j * width + i) * stride] : 0.0f;
+                r[k] = mask0[k] * (value - Ax);
+
+                //q holds b for the stopping criterion
+                q[k] = mask0[k] * value;
+            }
+        });
+
+        double norm = MAX(sqrt(dot(q, q)), sqrt(dot(r, r)));
+        double threshold = double(tolerance) * norm;
+
+        int it = 0;
+
+        if(norm > 0.0) {
+            precondition();
+            p = z;
+            double rz = dot(r, z);
+
+            for(it = 1; it <= maxIterations; it++) {
+                pool->parallelFor(height, [&](int j) {
+                    applyRow(level, &level.wx[0], &level.wy[0], &p[0], &q[0], j);
+                });
+
+                double pq = dot(p, q);
+                if(pq <= 0.0) {
+                    break;
+                }
+
+                float a = float(rz / pq);
+
+                pool->parallelFor(height, [&](int j) {
+                    int ind = level.index(0, j);
+                    SpanOps::madd(&x[ind], &p[ind], a, width);
+                    SpanOps::madd(&r[ind], &q[ind], -a, width);
+                });
+
+                if(sqrt(dot(r, r)) <= threshold) {
+                    break;
+                }
+
+                //flexible (Polak-Ribiere) update, since the V-cycle is not
+                //a fixed linear operator
+                zOld.swap(z);
+                precondition();
+                double rz_new = dot(r, z);
+                float beta = float(MAX((rz_new - dot(r, zOld)) / rz, 0.0));
+                rz = rz_new;
+
+                pool->parallelFor(height, [&](int j) {
+                    int ind = level.index(0, j);
+                    SpanOps::assign(&p[ind], &p[ind], beta, width);
+                    SpanOps::madd(&p[ind], &z[ind], 1.0f, width);
+                });
+            }
+        }
+
+        pool->parallelFor(height, [&](int j) {
+            for(int i = 0; i < width; i++) {
+                x_in_out[(j * width + i) * stride] = x[level.index(i, j)];
+            }
+        });
+
+        return MIN(it, maxIterations);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_ALGORITHMS_MULTIGRID_SOLVER_HPP */
+
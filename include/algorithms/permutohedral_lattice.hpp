@@ -0,0 +1,806 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_ALGORITHMS_PERMUTOHEDRAL_LATTICE_HPP
+#define PIC_ALGORITHMS_PERMUTOHEDRAL_LATTICE_HPP
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "../base.hpp"
+#include "../image.hpp"
+#include "../util/math.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace pic {
+
+/**
+ * @brief The LatticeHashTable class maps the keys of lattice points, i.e.,
+ * d integer coordinates, to their values; it uses open addressing with
+ * linear probing, and it grows when it is half full.
+ */
+class LatticeHashTable
+{
+protected:
+    int d, vd, n;
+    unsigned int mask;
+
+    std::vector< int > keys, entries;
+    std::vector< float > values;
+
+    /**
+     * @brief hash
+     * @param key
+     * @return
+     */
+    inline unsigned int hash(const int *key) const
+    {
+        return hash(key, d);
+    }
+
+    /**
+     * @brief grow doubles the capacity, and it reinserts the entries.
+     */
+    void grow()
+    {
+        unsigned int capacity = (mask + 1) << 1;
+        mask = capacity - 1;
+        entries.assign(capacity, -1);
+
+        for(int i = 0; i < n; i++) {
+            unsigned int h = hash(&keys[i * d]) & mask;
+
+            while(entries[h] != -1) {
+                h = (h + 1) & mask;
+            }
+
+            entries[h] = i;
+        }
+    }
+
+public:
+
+    /**
+     * @brief hash
+     * @param key
+     * @param d is the number of coordinates of key.
+     * @return
+     */
+    static inline unsigned int hash(const int *key, int d)
+    {
+        unsigned int k = 0;
+
+        for(int i = 0; i < d; i++) {
+            k += (unsigned int)(key[i]);
+            k *= 2531011u;
+        }
+
+        return k;
+    }
+
+    LatticeHashTable()
+    {
+        d = vd = n = 0;
+        mask = 0;
+    }
+
+    /**
+     * @brief clear removes all entries; memory is kept.
+     * @param d is the number of coordinates of a key.
+     * @param vd is the number of values of an entry.
+     * @param capacity is a hint of the number of entries.
+     */
+    void clear(int d, int vd, int capacity = 1024)
+    {
+        this->d = d;
+        this->vd = vd;
+        n = 0;
+
+        unsigned int size = 16;
+        while(size < (unsigned int)(capacity << 1)) {
+            size <<= 1;
+        }
+
+        mask = size - 1;
+        entries.assign(size, -1);
+        keys.clear();
+        values.clear();
+    }
+
+    /**
+     * @brief find
+     * @param key
+     * @return It returns the index of key; -1 if key is not in the table.
+     */
+    inline int find(const int *key) const
+    {
+        unsigned int h = hash(key) & mask;
+
+        while(true) {
+            int e = entries[h];
+
+            if(e == -1) {
+                return -1;
+            }
+
+            if(memcmp(&keys[e * d], key, sizeof(int) * d) == 0) {
+                return e;
+            }
+
+            h = (h + 1) & mask;
+        }
+    }
+
+    /**
+     * @brief insert
+     * @param key
+     * @return It returns the index of key; key is inserted with zero values
+     * if it is not in the table.
+     */
+    inline int insert(const int *key)
+    {
+        return insert(key, hash(key));
+    }
+
+    /**
+     * @brief insert
+     * @param key
+     * @param h is the hash of key.
+     * @return It returns the index of key; key is inserted with zero values
+     * if it is not in the table.
+     */
+    inline int insert(const int *key, unsigned int h)
+    {
+        if(((n + 1) << 1) > int(mask + 1)) {
+            grow();
+        }
+
+        h &= mask;
+
+        while(true) {
+            int e = entries[h];
+
+            if(e == -1) {
+                entries[h] = n;
+                keys.insert(keys.end(), key, key + d);
+                values.resize(values.size() + vd, 0.0f);
+                return n++;
+            }
+
+            if(memcmp(&keys[e * d], key, sizeof(int) * d) == 0) {
+                return e;
+            }
+
+            h = (h + 1) & mask;
+        }
+    }
+
+    /**
+     * @brief size
+     * @return It returns the number of entries.
+     */
+    int size() const
+    {
+        return n;
+    }
+
+    /**
+     * @brief getKey
+     * @param i
+     * @return
+     */
+    const int *getKey(int i) const
+    {
+        return &keys[i * d];
+    }
+
+    /**
+     * @brief getValues
+     * @return
+     */
+    float *getValues()
+    {
+        return values.empty() ? NULL : &values[0];
+    }
+};
+
+/**
+ * @brief The PermutohedralLattice class is the permutohedral lattice of
+ * Adams et al. (2010) for Gaussian filtering in d dimensions, e.g., the
+ * joint bilateral filter with position (x, y) / sigma_s and the channels
+ * of a guide / sigma_r. A position splats onto the d + 1 vertices of its
+ * enclosing simplex, the lattice is blurred with [1 2 1] / 4 along each of
+ * the d + 1 lattice directions, and values are sliced back with the same
+ * barycentric weights. The cost is linear in the number of pixels and
+ * polynomial in d, instead of exponential as for a regular grid. Lattice
+ * points are split into shards by the hash of their keys, so that each
+ * shard is merged by its own task; the table of a shard is a region of
+ * entries, and points are numbered as by a serial merge.
+ */
+class PermutohedralLattice
+{
+protected:
+    int d, vd, n, shardBits, regionBits;
+    float invSigma_s, invSigma_r;
+
+    std::vector< float > scaleFactor, values, blurBuffer;
+    std::vector< int > canonical, keys, entries;
+
+    std::vector< LatticeHashTable > shards, bands;
+
+    /**
+     * @brief The Simplex struct stores the working memory of getSimplex.
+     */
+    struct Simplex
+    {
+        std::vector< float > position, elevated, delta, weights;
+        std::vector< int > greedy, rank, keys;
+
+        Simplex(int d)
+        {
+            position.resize(d);
+            elevated.resize(d + 1);
+            delta.resize(d + 1);
+            weights.resize(d + 2);
+            greedy.resize(d + 1);
+            rank.resize(d + 1);
+            keys.resize((d + 1) * d);
+        }
+    };
+
+    /**
+     * @brief getShard
+     * @param h is the hash of a key.
+     * @return It returns the shard of the key; the hash is mixed again,
+     * since its low bits index the table of the shard.
+     */
+    inline int getShard(unsigned int h) const
+    {
+        return int((h * 2654435761u) >> (32 - shardBits));
+    }
+
+    /**
+     * @brief find
+     * @param key
+     * @return It returns the index of key in values; -1 if key is not in
+     * the lattice.
+     */
+    inline int find(const int *key) const
+    {
+        unsigned int h = LatticeHashTable::hash(key, d);
+        unsigned int mask = (1u << regionBits) - 1;
+        const int *region = &entries[size_t(getShard(h)) << regionBits];
+
+        h &= mask;
+
+        while(true) {
+            int e = region[h];
+
+            if(e == -1) {
+                return -1;
+            }
+
+            if(memcmp(&keys[e * d], key, sizeof(int) * d) == 0) {
+                return e;
+            }
+
+            h = (h + 1) & mask;
+        }
+    }
+
+    /**
+     * @brief getPosition computes the position of a pixel in feature space.
+     * @param edge
+     * @param i
+     * @param j
+     * @param position
+     */
+    inline void getPosition(Image *edge, int i, int j, float *position)
+    {
+        position[0] = float(i) * invSigma_s;
+        position[1] = float(j) * invSigma_s;
+
+        float *data = (*edge)(i, j);
+
+        for(int k = 0; k < edge->channels; k++) {
+            position[k + 2] = data[k] * invSigma_r;
+        }
+    }
+
+    /**
+     * @brief getSimplex computes the keys of the vertices of the simplex
+     * enclosing s.position, and their barycentric weights.
+     * @param s
+     */
+    void getSimplex(Simplex &s)
+    {
+        //locals, since stores to the working memory could alias members
+        const int d = this->d;
+        const int d1 = d + 1;
+        const float invD1 = 1.0f / float(d1);
+        const float *position = &s.position[0];
+        const float *scale = &scaleFactor[0];
+
+        float *elevated = &s.elevated[0];
+        int *greedy = &s.greedy[0];
+        int *rank = &s.rank[0];
+
+        //elevation onto the hyperplane orthogonal to (1, ..., 1)
+        float sm = 0.0f;
+        for(int i = d; i > 0; i--) {
+            float cf = position[i - 1] * scale[i - 1];
+            elevated[i] = sm - float(i) * cf;
+            sm += cf;
+        }
+        elevated[0] = sm;
+
+        //closest remainder-0 point, and the differential
+        float *delta = &s.delta[0];
+        int sum = 0;
+        for(int i = 0; i <= d; i++) {
+            //rounding to the nearest multiple of d1 without ceilf/floorf
+            float v = elevated[i] * invD1 + 0.5f;
+            int down = int(v);
+            down -= (v < float(down)) ? 1 : 0;
+
+            greedy[i] = down * d1;
+            sum += greedy[i];
+            delta[i] = elevated[i] - float(greedy[i]);
+            rank[i] = 0;
+        }
+        sum /= d1;
+
+        //ranks of the differential
+        for(int i = 0; i < d; i++) {
+            for(int j = i + 1; j <= d; j++) {
+                int b = delta[i] < delta[j] ? 1 : 0;
+                rank[i] += b;
+                rank[j] += 1 - b;
+            }
+        }
+
+        //wrapping around if the point is not on the plane
+        if(sum > 0) {
+            for(int i = 0; i <= d; i++) {
+                if(rank[i] >= (d1 - sum)) {
+                    greedy[i] -= d1;
+                    rank[i] += sum - d1;
+                } else {
+                    rank[i] += sum;
+                }
+            }
+        } else {
+            if(sum < 0) {
+                for(int i = 0; i <= d; i++) {
+                    if(rank[i] < -sum) {
+                        greedy[i] += d1;
+                        rank[i] += d1 + sum;
+                    } else {
+                        rank[i] += sum;
+                    }
+                }
+            }
+        }
+
+        //barycentric weights
+        float *w = &s.weights[0];
+        for(int i = 0; i <= d1; i++) {
+            w[i] = 0.0f;
+        }
+
+        for(int i = 0; i <= d; i++) {
+            float t = (elevated[i] - float(greedy[i])) * invD1;
+            w[d - rank[i]] += t;
+            w[d1 - rank[i]] -= t;
+        }
+        w[0] += 1.0f + w[d1];
+
+        //keys of the vertices; the last coordinate is implied
+        const int *c = &canonical[0];
+        int *key = &s.keys[0];
+        for(int r = 0; r <= d; r++) {
+            for(int i = 0; i < d; i++) {
+                key[i] = greedy[i] + c[rank[i]];
+            }
+
+            key += d;
+            c += d1;
+        }
+    }
+
+    /**
+     * @brief splat splats base into the lattice. Bands of rows are splatted
+     * in parallel into their own tables, one for each shard; then, the
+     * tables of each shard are merged in parallel.
+     * @param base
+     * @param edge
+     */
+    void splat(Image *base, Image *edge)
+    {
+        int nThreads = ThreadPool::getInstance()->getNumberOfThreads();
+        int nBands = MIN(nThreads * 4, base->height);
+        nBands = MAX(nBands, 1);
+
+        shardBits = 1;
+        while((1 << shardBits) < (nThreads * 2)) {
+            shardBits++;
+        }
+
+        int nShards = 1 << shardBits;
+        bands.resize(nBands * nShards);
+
+        int c = vd - 1;
+
+        //points of each band in order of insertion, as shard + nShards * index
+        std::vector< std::vector< int > > order(nBands);
+
+        ThreadPool::getInstance()->parallelFor(nBands, [&](int b) {
+            int j0 = (base->height * b) / nBands;
+            int j1 = (base->height * (b + 1)) / nBands;
+
+            LatticeHashTable *band = &bands[b * nShards];
+
+            for(int k = 0; k < nShards; k++) {
+                band[k].clear(d, vd, ((base->width * (j1 - j0)) >> 4) / nShards);
+            }
+
+            Simplex s(d);
+
+            for(int j = j0; j < j1; j++) {
+                for(int i = 0; i < base->width; i++) {
+                    getPosition(edge, i, j, &s.position[0]);
+                    getSimplex(s);
+
+                    float *pixel = (*base)(i, j);
+
+                    for(int r = 0; r <= d; r++) {
+                        int *key = &s.keys[r * d];
+                        unsigned int h = LatticeHashTable::hash(key, d);
+                        int shard = getShard(h);
+                        LatticeHashTable &table = band[shard];
+
+                        int tableSize = table.size();
+                        int e = table.insert(key, h);
+
+                        if(e == tableSize) {
+                            order[b].push_back(shard + e * nShards);
+                        }
+
+                        float *v = table.getValues() + e * vd;
+                        float w = s.weights[r];
+
+                        for(int k = 0; k < c; k++) {
+                            v[k] += pixel[k] * w;
+                        }
+
+                        v[c] += w;
+                    }
+                }
+            }
+        });
+
+        //shards are disjoint, so they are merged in parallel; first is the
+        //index in the shard of a point of a band, or -1 if an earlier band
+        //has it
+        shards.resize(nShards);
+        std::vector< std::vector< int > > first(nBands * nShards);
+
+        ThreadPool::getInstance()->parallelFor(nShards, [&](int k) {
+            LatticeHashTable &table = shards[k];
+
+            int capacity = 0;
+            for(int b = 0; b < nBands; b++) {
+                capacity += bands[b * nShards + k].size();
+            }
+
+            table.clear(d, vd, capacity);
+
+            for(int b = 0; b < nBands; b++) {
+                LatticeHashTable &band = bands[b * nShards + k];
+                std::vector< int > &first_b = first[b * nShards + k];
+                float *bandValues = band.getValues();
+
+                first_b.resize(band.size());
+
+                for(int i = 0; i < band.size(); i++) {
+                    int tableSize = table.size();
+                    int e = table.insert(band.getKey(i));
+                    first_b[i] = (e == tableSize) ? e : -1;
+
+                    float *v = table.getValues() + e * vd;
+                    float *bv = bandValues + i * vd;
+
+                    for(int l = 0; l < vd; l++) {
+                        v[l] += bv[l];
+                    }
+                }
+            }
+        });
+
+        //points are numbered as by a serial merge of the bands, so that
+        //neighbors stay close in memory
+        std::vector< int > offsets(nBands + 1, 0);
+
+        ThreadPool::getInstance()->parallelFor(nBands, [&](int b) {
+            int count = 0;
+
+            for(unsigned int i = 0; i < order[b].size(); i++) {
+                int item = order[b][i];
+
+                if(first[b * nShards + (item % nShards)][item / nShards] != -1) {
+                    count++;
+                }
+            }
+
+            offsets[b + 1] = count;
+        });
+
+        for(int b = 0; b < nBands; b++) {
+            offsets[b + 1] += offsets[b];
+        }
+
+        std::vector< std::vector< int > > index(nShards);
+        int maxSize = 0;
+
+        for(int k = 0; k < nShards; k++) {
+            index[k].resize(shards[k].size());
+            maxSize = MAX(maxSize, shards[k].size());
+        }
+
+        ThreadPool::getInstance()->parallelFor(nBands, [&](int b) {
+            int counter = offsets[b];
+
+            for(unsigned int i = 0; i < order[b].size(); i++) {
+                int item = order[b][i];
+                int k = item % nShards;
+                int e = first[b * nShards + k][item / nShards];
+
+                if(e != -1) {
+                    index[k][e] = counter;
+                    counter++;
+                }
+            }
+        });
+
+        //the table of each shard is a region of entries
+        regionBits = 4;
+        while((1 << regionBits) < (maxSize << 1)) {
+            regionBits++;
+        }
+
+        n = offsets[nBands];
+        keys.resize(n * d);
+        values.resize(n * vd);
+        entries.assign(size_t(nShards) << regionBits, -1);
+
+        ThreadPool::getInstance()->parallelFor(nShards, [&](int k) {
+            LatticeHashTable &table = shards[k];
+
+            unsigned int mask = (1u << regionBits) - 1;
+            int *region = &entries[size_t(k) << regionBits];
+
+            for(int i = 0; i < table.size(); i++) {
+                const int *key = table.getKey(i);
+                int e = index[k][i];
+
+                memcpy(&keys[e * d], key, sizeof(int) * d);
+                memcpy(&values[e * vd], table.getValues() + i * vd, sizeof(float) * vd);
+
+                //keys are unique, so the first free slot is taken
+                unsigned int h = LatticeHashTable::hash(key, d) & mask;
+                while(region[h] != -1) {
+                    h = (h + 1) & mask;
+                }
+
+                region[h] = e;
+            }
+        });
+    }
+
+    /**
+     * @brief blur convolves the lattice with [1 2 1] / 4 along each lattice
+     * direction; lattice points are processed in parallel.
+     */
+    void blur()
+    {
+        if(n == 0) {
+            return;
+        }
+
+        blurBuffer.resize(n * vd);
+
+        float *oldValues = &values[0];
+        float *newValues = &blurBuffer[0];
+
+        int nChunks = (n + 4095) / 4096;
+
+        for(int j = 0; j <= d; j++) {
+            ThreadPool::getInstance()->parallelFor(nChunks, [&](int chunk) {
+                std::vector< int > n1(d), n2(d);
+
+                int i1 = MIN(n, (chunk + 1) * 4096);
+
+                for(int i = chunk * 4096; i < i1; i++) {
+                    const int *key = &keys[i * d];
+
+                    for(int k = 0; k < d; k++) {
+                        n1[k] = key[k] + 1;
+                        n2[k] = key[k] - 1;
+                    }
+
+                    if(j < d) {
+                        n1[j] = key[j] - d;
+                        n2[j] = key[j] + d;
+                    }
+
+                    int e1 = find(&n1[0]);
+                    int e2 = find(&n2[0]);
+
+                    float *v = oldValues + i * vd;
+                    float *nv = newValues + i * vd;
+
+                    for(int k = 0; k < vd; k++) {
+                        nv[k] = 0.5f * v[k];
+                    }
+
+                    if(e1 != -1) {
+                        float *v1 = oldValues + e1 * vd;
+
+                        for(int k = 0; k < vd; k++) {
+                            nv[k] += 0.25f * v1[k];
+                        }
+                    }
+
+                    if(e2 != -1) {
+                        float *v2 = oldValues + e2 * vd;
+
+                        for(int k = 0; k < vd; k++) {
+                            nv[k] += 0.25f * v2[k];
+                        }
+                    }
+                }
+            });
+
+            std::swap(oldValues, newValues);
+        }
+
+        if(oldValues != &values[0]) {
+            memcpy(&values[0], oldValues, sizeof(float) * n * vd);
+        }
+    }
+
+    /**
+     * @brief slice interpolates the lattice at each pixel, and it divides
+     * by the homogeneous coordinate; rows are processed in parallel.
+     * @param out
+     * @param edge
+     */
+    void slice(Image *out, Image *edge)
+    {
+        int c = vd - 1;
+
+        ThreadPool::getInstance()->parallelFor(out->height, [&](int j) {
+            Simplex s(d);
+            std::vector< float > vOut(vd);
+
+            for(int i = 0; i < out->width; i++) {
+                getPosition(edge, i, j, &s.position[0]);
+                getSimplex(s);
+
+                for(int k = 0; k < vd; k++) {
+                    vOut[k] = 0.0f;
+                }
+
+                for(int r = 0; r <= d; r++) {
+                    int e = find(&s.keys[r * d]);
+
+                    if(e != -1) {
+                        float *v = &values[e * vd];
+                        float w = s.weights[r];
+
+                        for(int k = 0; k < vd; k++) {
+                            vOut[k] += v[k] * w;
+                        }
+                    }
+                }
+
+                float *pixel = (*out)(i, j);
+
+                if(vOut[c] > 0.0f) {
+                    float w = 1.0f / vOut[c];
+
+                    for(int k = 0; k < c; k++) {
+                        pixel[k] = vOut[k] * w;
+                    }
+                } else {
+                    for(int k = 0; k < c; k++) {
+                        pixel[k] = 0.0f;
+                    }
+                }
+            }
+        });
+    }
+
+public:
+
+    PermutohedralLattice()
+    {
+        d = vd = n = 0;
+        shardBits = 1;
+        regionBits = 4;
+        invSigma_s = invSigma_r = 1.0f;
+    }
+
+    /**
+     * @brief filter computes a Gaussian filter of base in the space of
+     * (x / sigma_s, y / sigma_s, edge / sigma_r), i.e., a joint bilateral
+     * filter with an arbitrary number of guide channels.
+     * @param out
+     * @param base
+     * @param edge
+     * @param sigma_s
+     * @param sigma_r
+     */
+    void filter(Image *out, Image *base, Image *edge, float sigma_s, float sigma_r)
+    {
+        d = 2 + edge->channels;
+        vd = base->channels + 1;
+
+        //the lattice has a blur of standard deviation sqrt(2/3) (d + 1)
+        float invStdDev = sqrtf(2.0f / 3.0f) * float(d + 1);
+
+        invSigma_s = 1.0f / sigma_s;
+        invSigma_r = 1.0f / sigma_r;
+
+        scaleFactor.resize(d);
+        for(int i = 0; i < d; i++) {
+            scaleFactor[i] = invStdDev / sqrtf(float((i + 1) * (i + 2)));
+        }
+
+        //vertices of the canonical simplex
+        int d1 = d + 1;
+        canonical.resize(d1 * d1);
+        for(int i = 0; i <= d; i++) {
+            for(int j = 0; j <= (d - i); j++) {
+                canonical[i * d1 + j] = i;
+            }
+
+            for(int j = d - i + 1; j <= d; j++) {
+                canonical[i * d1 + j] = i - d1;
+            }
+        }
+
+        splat(base, edge);
+        blur();
+        slice(out, edge);
+    }
+
+    /**
+     * @brief size
+     * @return It returns the number of lattice points.
+     */
+    int size()
+    {
+        return n;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_ALGORITHMS_PERMUTOHEDRAL_LATTICE_HPP */
+
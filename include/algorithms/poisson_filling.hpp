@@ -18,12 +18,15 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_ALGORITHMS_POISSON_FILLING_HPP
 #define PIC_ALGORITHMS_POISSON_FILLING_HPP
 
+#include <vector>
+
 #include "../util/std_util.hpp"
 #include "../util/buffer.hpp"
 #include "../util/mask.hpp"
 #include "../util/array.hpp"
 #include "../util/math.hpp"
 #include "../image.hpp"
+#include "../algorithms/multigrid_solver.hpp"
 
 namespace pic {
 
@@ -35,6 +38,7 @@ class PoissonFilling
 protected:
     int maxIter;
     float threshold, value;
+    bool bMultigrid;
 
     bool *mask, *maskPoisson;
     Image *imgTmp;
@@ -140,9 +144,14 @@ public:
 
     /**
      * @brief PoissonFilling
+     * @param value is the value of pixels to be filled.
+     * @param bMultigrid solves the Laplace equation in the holes with a
+     * MultigridSolver instead of iterating the diffusion.
      */
-    PoissonFilling(float value)
+    PoissonFilling(float value, bool bMultigrid = false)
     {
+        this->bMultigrid = bMultigrid;
+
         imgTmp = NULL;
         mask = NULL;
         maskPoisson = NULL;
@@ -207,6 +216,21 @@ public:
             delete_vec_s(color);
         }
 
+        if(bMultigrid) {
+            //known pixels are the boundary conditions; borders are Neumann
+            int n = imgIn->nPixels();
+            std::vector< float > w(n, 1.0f);
+
+            MultigridSolver solver;
+            solver.setup(imgIn->width, imgIn->height, &w[0], &w[0], NULL, mask);
+
+            for(int k = 0; k < imgIn->channels; k++) {
+                solver.solve(&imgOut->data[k], NULL, imgIn->channels);
+            }
+
+            return imgOut;
+        }
+
         maskPoisson = Mask::clone(maskPoisson, mask, imgIn->nPixels(), 1);
 
         Image *work[2];
@@ -24,6 +24,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../image.hpp"
 #include "../util/std_util.hpp"
 #include "../filtering/filter_laplacian.hpp"
+#include "../algorithms/poisson_solver.hpp"
 
 #ifndef PIC_DISABLE_EIGEN
 
@@ -39,16 +40,59 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 namespace pic {
 
+/**
+ * @brief computePoissonImageEditingMultigrid solves Poisson image editing
+ * with computePoissonSolverMultigrid.
+ * @param source
+ * @param target
+ * @param mask
+ * @param ret
+ * @return
+ */
+PIC_INLINE Image *computePoissonImageEditingMultigrid(Image *source, Image *target, bool *mask, Image *ret = NULL)
+{
+    if((source == NULL) || (target == NULL) || (mask == NULL)) {
+        return NULL;
+    }
+
+    //allocate the output
+    if(ret == NULL) {
+        ret = target->clone();
+    }
+
+    Image *lap_source = FilterLaplacian::execute(source, NULL);
+
+    //target pixels outside the mask are the boundary conditions
+    Image *sol = target->clone();
+    computePoissonSolverMultigrid(lap_source, sol, mask);
+
+    int channels = target->channels;
+    for(int i = 0; i < target->nPixels(); i++) {
+        if(mask[i]) {
+            for(int k = 0; k < channels; k++) {
+                float val = sol->data[i * channels + k];
+                ret->data[i * channels + k] = val > 0.0f ? val : 0.0f;
+            }
+        }
+    }
+
+    delete_s(sol);
+    delete_s(lap_source);
+
+    return ret;
+}
+
 #ifndef PIC_DISABLE_EIGEN
 /**
- * @brief computePoissonImageEditing
+ * @brief computePoissonImageEditingCholesky solves Poisson image editing
+ * factoring the sparse matrix.
  * @param source
  * @param target
  * @param mask
  * @param ret
  * @return
  */
-PIC_INLINE Image *computePoissonImageEditing(Image *source, Image *target, bool *mask, Image *ret = NULL)
+PIC_INLINE Image *computePoissonImageEditingCholesky(Image *source, Image *target, bool *mask, Image *ret = NULL)
 {
     if((source == NULL) || (target == NULL) || (mask == NULL)) {
         return NULL;
@@ -222,6 +266,30 @@ PIC_INLINE Image *computePoissonImageEditing(Image *source, Image *target, bool
 }
 #endif
 
+/**
+ * @brief computePoissonImageEditing
+ * @param source
+ * @param target
+ * @param mask
+ * @param ret
+ * @param type is the backend; PST_DCT is not defined for masks, and it
+ * falls back to PST_MULTIGRID as PST_CHOLESKY without Eigen.
+ * @return
+ */
+PIC_INLINE Image *computePoissonImageEditing(Image *source, Image *target, bool *mask, Image *ret = NULL,
+                                             POISSON_SOLVER_TYPE type = PST_CHOLESKY)
+{
+#ifndef PIC_DISABLE_EIGEN
+    if(type == PST_CHOLESKY) {
+        return computePoissonImageEditingCholesky(source, target, mask, ret);
+    }
+#else
+    (void) type;
+#endif
+
+    return computePoissonImageEditingMultigrid(source, target, mask, ret);
+}
+
 } // end namespace pic
 
 #endif /* PIC_ALGORITHMS_POISSON_IMAGE_EDITING_HPP */
@@ -18,9 +18,17 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_ALGORITHMS_POISSON_SOLVER_HPP
 #define PIC_ALGORITHMS_POISSON_SOLVER_HPP
 
+#include <math.h>
+#include <vector>
+
 #include "../base.hpp"
 
 #include "../image.hpp"
+#include "../util/fft.hpp"
+#include "../util/dct.hpp"
+#include "../util/std_util.hpp"
+#include "../util/thread_pool.hpp"
+#include "../algorithms/multigrid_solver.hpp"
 
 #ifndef PIC_DISABLE_EIGEN
 
@@ -36,15 +44,25 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 namespace pic {
 
+/**
+ * @brief The POISSON_SOLVER_TYPE enum selects the backend of Poisson solvers:
+ * PST_CHOLESKY factors the sparse matrix (it requires Eigen),
+ * PST_DCT diagonalizes Neumann problems on the full image, and
+ * PST_MULTIGRID runs matrix-free conjugate gradients with a multigrid
+ * preconditioner.
+ */
+enum POISSON_SOLVER_TYPE {PST_CHOLESKY, PST_DCT, PST_MULTIGRID};
+
 #ifndef PIC_DISABLE_EIGEN
 
 /**
- * @brief computePoissonSolver
+ * @brief computePoissonSolverCholesky solves laplacian(ret) = f with zero
+ * Dirichlet boundary conditions, factoring the sparse matrix.
  * @param f
  * @param ret
  * @return
  */
-PIC_INLINE Image *computePoissonSolver(Image *f, Image *ret = NULL)
+PIC_INLINE Image *computePoissonSolverCholesky(Image *f, Image *ret = NULL)
 {
     if(f == NULL) {
         return NULL;
@@ -138,6 +156,259 @@ PIC_INLINE Image *computePoissonSolver(Image *f, Image *ret = NULL)
 
 #endif
 
+/**
+ * @brief computePoissonSolverDCTPass computes the DCT of len sequences of
+ * data (see DCTPlan) in parallel batches.
+ * @param plan
+ * @param data
+ * @param stride
+ * @param len
+ * @param bForward
+ */
+PIC_INLINE void computePoissonSolverDCTPass(DCTPlan *plan, float *data, int stride,
+                                            int len, bool bForward)
+{
+    int nBatches = (len + FFT_BATCH - 1) / FFT_BATCH;
+
+    ThreadPool::getInstance()->parallelFor(nBatches, [&](int i) {
+        int b0 = i * FFT_BATCH;
+        int n = MIN(FFT_BATCH, len - b0);
+
+        if(bForward) {
+            plan->forward(data + b0, stride, n);
+        } else {
+            plan->inverse(data + b0, stride, n);
+        }
+    });
+}
+
+/**
+ * @brief computePoissonSolverDCT solves laplacian(ret) = f with Neumann
+ * boundary conditions on the full image in O(n log n): the DCT diagonalizes
+ * the five-point Laplacian. The solution is defined up to a constant, and
+ * the returned one has zero mean.
+ * @param f
+ * @param ret
+ * @return
+ */
+PIC_INLINE Image *computePoissonSolverDCT(Image *f, Image *ret = NULL)
+{
+    if(f == NULL) {
+        return NULL;
+    }
+
+    if(ret == NULL) {
+        ret = f->allocateSimilarOne();
+    }
+
+    int width = f->width;
+    int height = f->height;
+    int channels = f->channels;
+
+    DCTPlan *planX = DCTPlan::get(width);
+    DCTPlan *planY = DCTPlan::get(height);
+
+    ThreadPool *pool = ThreadPool::getInstance();
+
+    //DCT along y: rows are the sequences, pixels and channels the batch
+    int rowLen = width * channels;
+    int colLen = height * channels;
+
+    if(ret != f) {
+        memcpy(ret->data, f->data, sizeof(float) * height * rowLen);
+    }
+
+    computePoissonSolverDCTPass(planY, ret->data, rowLen, rowLen, true);
+
+    //DCT along x on the transposed image
+    std::vector< float > tmp(width * colLen);
+
+    pool->parallelFor(height, [&](int j) {
+        for(int i = 0; i < width; i++) {
+            memcpy(&tmp[i * colLen + j * channels], &ret->data[j * rowLen + i * channels],
+                   sizeof(float) * channels);
+        }
+    });
+
+    computePoissonSolverDCTPass(planX, &tmp[0], colLen, colLen, true);
+
+    //eigenvalues of the Laplacian
+    std::vector< float > lambdaY(height);
+    for(int j = 0; j < height; j++) {
+        lambdaY[j] = 2.0f * float(cos(C_PI * double(j) / double(height))) - 2.0f;
+    }
+
+    pool->parallelFor(width, [&](int i) {
+        float lambdaX = 2.0f * float(cos(C_PI * double(i) / double(width))) - 2.0f;
+        float *data = &tmp[i * colLen];
+
+        for(int j = 0; j < height; j++) {
+            float lambda = lambdaX + lambdaY[j];
+            float scale = (lambda < 0.0f) ? (1.0f / lambda) : 0.0f;
+
+            for(int k = 0; k < channels; k++) {
+                data[j * channels + k] *= scale;
+            }
+        }
+    });
+
+    computePoissonSolverDCTPass(planX, &tmp[0], colLen, colLen, false);
+
+    pool->parallelFor(height, [&](int j) {
+        for(int i = 0; i < width; i++) {
+            memcpy(&ret->data[j * rowLen + i * channels], &tmp[i * colLen + j * channels],
+                   sizeof(float) * channels);
+        }
+    });
+
+    computePoissonSolverDCTPass(planY, ret->data, rowLen, rowLen, false);
+
+    return ret;
+}
+
+/**
+ * @brief computePoissonSolverMultigrid solves laplacian(ret) = f with a
+ * MultigridSolver. Pixels outside the image are zero (as in
+ * computePoissonSolverCholesky), and pixels of ret outside the mask are
+ * Dirichlet boundary conditions.
+ * @param f
+ * @param ret is the initial guess; if it is NULL, it is zero.
+ * @param mask marks the unknowns; if it is NULL, all pixels are unknowns.
+ * @param tolerance is the relative residual at convergence.
+ * @return
+ */
+PIC_INLINE Image *computePoissonSolverMultigrid(Image *f, Image *ret = NULL,
+                                                bool *mask = NULL,
+                                                float tolerance = 1e-5f)
+{
+    if(f == NULL) {
+        return NULL;
+    }
+
+    if(ret == NULL) {
+        ret = f->allocateSimilarOne();
+        ret->setZero();
+    }
+
+    //the unknowns and their neighbours are in [x0, x1) x [y0, y1)
+    int x0 = 0, y0 = 0, x1 = f->width, y1 = f->height;
+
+    if(mask != NULL) {
+        x0 = f->width;
+        y0 = f->height;
+        x1 = y1 = 0;
+
+        for(int j = 0; j < f->height; j++) {
+            for(int i = 0; i < f->width; i++) {
+                if(mask[j * f->width + i]) {
+                    x0 = MIN(x0, i - 1);
+                    y0 = MIN(y0, j - 1);
+                    x1 = MAX(x1, i + 2);
+                    y1 = MAX(y1, j + 2);
+                }
+            }
+        }
+
+        if((x1 <= x0) || (y1 <= y0)) {
+            return ret;
+        }
+
+        x0 = MAX(x0, 0);
+        y0 = MAX(y0, 0);
+        x1 = MIN(x1, f->width);
+        y1 = MIN(y1, f->height);
+    }
+
+    int width = x1 - x0;
+    int height = y1 - y0;
+    int n = width * height;
+
+    //unit couplings; c adds the zero neighbours outside the image
+    std::vector< float > w(n, 1.0f), c(n, 0.0f);
+    for(int j = 0; j < height; j++) {
+        for(int i = 0; i < width; i++) {
+            int u = x0 + i;
+            int v = y0 + j;
+            c[j * width + i] = float((u == 0) + (u == (f->width - 1)) +
+                                     (v == 0) + (v == (f->height - 1)));
+        }
+    }
+
+    bool *sub = NULL;
+    if(mask != NULL) {
+        sub = new bool[n];
+
+        for(int j = 0; j < height; j++) {
+            memcpy(&sub[j * width], &mask[(y0 + j) * f->width + x0], sizeof(bool) * width);
+        }
+    }
+
+    MultigridSolver solver;
+    solver.tolerance = tolerance;
+    solver.setup(width, height, &w[0], &w[0], &c[0], sub);
+
+    delete_vec_s(sub);
+
+    std::vector< float > x(n), b(n);
+
+    for(int k = 0; k < f->channels; k++) {
+        for(int j = 0; j < height; j++) {
+            for(int i = 0; i < width; i++) {
+                x[j * width + i] = (*ret)(x0 + i, y0 + j)[k];
+
+                //-laplacian is positive definite
+                b[j * width + i] = -(*f)(x0 + i, y0 + j)[k];
+            }
+        }
+
+        int it = solver.solve(&x[0], &b[0]);
+
+        #ifdef PIC_DEBUG
+            printf("Multigrid solver: %d iterations\n", it);
+        #else
+            (void) it;
+        #endif
+
+        for(int j = 0; j < height; j++) {
+            for(int i = 0; i < width; i++) {
+                (*ret)(x0 + i, y0 + j)[k] = x[j * width + i];
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief computePoissonSolver solves laplacian(ret) = f.
+ * @param f
+ * @param ret
+ * @param type is the backend; PST_CHOLESKY and PST_MULTIGRID have zero
+ * Dirichlet boundary conditions, PST_DCT has Neumann ones. Without Eigen,
+ * PST_CHOLESKY falls back to PST_MULTIGRID.
+ * @return
+ */
+PIC_INLINE Image *computePoissonSolver(Image *f, Image *ret = NULL,
+                                       POISSON_SOLVER_TYPE type = PST_CHOLESKY)
+{
+    switch(type) {
+    case PST_DCT:
+        return computePoissonSolverDCT(f, ret);
+
+#ifndef PIC_DISABLE_EIGEN
+    case PST_CHOLESKY:
+        return computePoissonSolverCholesky(f, ret);
+#endif
+
+    default:
+        if(ret != NULL) {
+            ret->setZero();
+        }
+
+        return computePoissonSolverMultigrid(f, ret);
+    }
+}
+
 /**
  * @brief computePoissonSolverIterative
  * @param img
@@ -26,6 +26,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 *
 **/
 
+#include <math.h>
+
 #include "../base.hpp"
 
 namespace pic {
@@ -121,6 +123,55 @@ PIC_INLINE void fromRGBEToFloat(unsigned char *colRGBE, float *colFloat)
     *(colFloat + 2) = (float(*(colRGBE + 2)) + 0.5f) * f;
 }
 
+/**
+ * @brief The RGBEExponentTable struct stores 2^(E - 136) for each exponent E.
+ */
+struct RGBEExponentTable
+{
+    float value[256];
+
+    RGBEExponentTable()
+    {
+        for(int i = 0; i < 256; i++) {
+            value[i] = ldexpf(1.0f, i - 128 - 8);
+        }
+    }
+};
+
+/**
+ * @brief getRGBEExponentTable
+ * @return It returns a table with 2^(E - 136) for each exponent E.
+ */
+PIC_INLINE const float *getRGBEExponentTable()
+{
+    static RGBEExponentTable table;
+    return table.value;
+}
+
+/**
+ * @brief fromRGBEToFloatLine converts n RGBE pixels into floats; it gives the
+ * same results of fromRGBEToFloat, but it is branch-free, so the compiler
+ * can vectorize it.
+ * @param colRGBE is an array of 4 * n unsigned char.
+ * @param colFloat is an array of 3 * n floats.
+ * @param n is the number of pixels.
+ */
+PIC_INLINE void fromRGBEToFloatLine(const unsigned char *colRGBE, float *colFloat, int n)
+{
+    const float *table = getRGBEExponentTable();
+
+    for(int i = 0; i < n; i++) {
+        const unsigned char *in = &colRGBE[i * 4];
+        float *out = &colFloat[i * 3];
+
+        float f = (in[0] | in[1] | in[2]) ? table[in[3]] : 0.0f;
+
+        out[0] = (float(in[0]) + 0.5f) * f;
+        out[1] = (float(in[1]) + 0.5f) * f;
+        out[2] = (float(in[2]) + 0.5f) * f;
+    }
+}
+
 } // end namespace pic
 
 #endif /* PIC_COLORS_RGBE_HPP */
@@ -24,6 +24,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "filtering/filter_up_pp.hpp"
 #include "filtering/filter_white_balance.hpp"
 #include "filtering/filter_integral_image.hpp"
+#include "filtering/filter_box_mean.hpp"
 #include "filtering/filter_reconstruct.hpp"
 #include "filtering/filter_local_extrema.hpp"
 #include "filtering/filter_warp_2d.hpp"
@@ -35,6 +36,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "filtering/filter_bilateral_2das.hpp"
 #include "filtering/filter_bilateral_2df.hpp"
 #include "filtering/filter_bilateral_2dg.hpp"
+#include "filtering/filter_bilateral_2dpl.hpp"
 #include "filtering/filter_bilateral_2ds.hpp"
 #include "filtering/filter_bilateral_2dsp.hpp"
 #include "filtering/filter_non_local_means_f.hpp"
@@ -61,6 +63,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "filtering/filter_gaussian_3d.hpp"
 #include "filtering/filter_gradient.hpp"
 #include "filtering/filter_gradient_harris_opt.hpp"
+#include "filtering/filter_graph.hpp"
 #include "filtering/filter_guided_a_b.hpp"
 #include "filtering/filter_guided.hpp"
 #include "filtering/filter_iterative.hpp"
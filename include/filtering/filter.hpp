@@ -18,21 +18,23 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_HPP
 #define PIC_FILTERING_FILTER_HPP
 
-#ifndef PIC_DISABLE_THREAD
-#include <thread>
-#endif
-
 #include <functional>
 
 #include "../image.hpp"
 #include "../image_vec.hpp"
 #include "../util/tile_list.hpp"
+#include "../util/thread_pool.hpp"
 #include "../util/string.hpp"
 
 namespace pic {
 
-//NOTE: This depends on the architecture!
+/**
+ * @brief TILE_SIZE is the minimum image size for which
+ * a filter is processed in tiles on the ThreadPool.
+ */
+#ifndef TILE_SIZE
 #define TILE_SIZE 64
+#endif
 
 struct FilterFData
 {
@@ -44,6 +46,22 @@ struct FilterFData
     int nSrc;
 };
 
+/**
+ * @brief The FilterSpanData struct describes a span [x0, x1) of interior
+ * pixels on the row y of the frame z. in[i] points to the pixel (x0, y, z)
+ * of src[i], and out points to the pixel (x0, y, z) of dst.
+ */
+struct FilterSpanData
+{
+    int x0, x1, y, z;
+    float *out;
+    std::vector< float * > in;
+
+    Image *dst;
+    ImageVec src;
+    int nSrc;
+};
+
 /**
  * @brief The Filter class
  */
@@ -71,6 +89,154 @@ protected:
 
     }
 
+    /**
+     * @brief fSpan processes a span of interior pixels; i.e. pixels
+     * whose neighborhood, as given by getSpanBorder, is inside the image.
+     * Neighbors can be accessed through strides without clamping.
+     * Pixels in the border band are processed by f.
+     * @param data
+     */
+    virtual void fSpan(FilterSpanData * /*data*/)
+    {
+
+    }
+
+    /**
+     * @brief getSpanBorder returns the radius of the neighborhood read by fSpan.
+     * @param borderX is the horizontal radius in pixels.
+     * @param borderY is the vertical radius in pixels.
+     * @return This function returns true if the filter implements fSpan,
+     * otherwise false.
+     */
+    virtual bool getSpanBorder(int & /*borderX*/, int & /*borderY*/)
+    {
+        return false;
+    }
+
+    /**
+     * @brief checkSpanChannels checks if the channels of inputs and output
+     * match the layout read and written by fSpan. By default, all images
+     * have to have the same number of channels; filters that change the
+     * number of channels override it.
+     * @param dst
+     * @param src
+     * @return
+     */
+    virtual bool checkSpanChannels(Image *dst, ImageVec &src)
+    {
+        for(unsigned int i = 0; i < src.size(); i++) {
+            if(src[i]->channels != dst->channels) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief ProcessPixels calls f for pixels in [x0, x1) on the current
+     * row of the current frame.
+     * @param f_data
+     * @param x0
+     * @param x1
+     */
+    void ProcessPixels(FilterFData *f_data, int x0, int x1)
+    {
+        for(int i = x0; i < x1; i++) {
+            f_data->x = i;
+            f_data->out = (*f_data->dst)(i, f_data->y, f_data->z);
+
+            f(f_data);
+        }
+    }
+
+    /**
+     * @brief acceptsCompactInput
+     * @return This function returns true if ProcessBBox reads compact
+     * inputs on the fly; otherwise, compact inputs are promoted to float
+     * before processing. By default, this holds for pointwise filters.
+     */
+    virtual bool acceptsCompactInput()
+    {
+        return isPointwise();
+    }
+
+    /**
+     * @brief hasCompact
+     * @param imgIn
+     * @param imgOut
+     * @return This function returns true if an input or the output is
+     * stored in a compact mode; i.e. its data is NULL.
+     */
+    static bool hasCompact(ImageVec &imgIn, Image *imgOut)
+    {
+        for(unsigned int i = 0; i < imgIn.size(); i++) {
+            if((imgIn[i] != NULL) && imgIn[i]->isCompact()) {
+                return true;
+            }
+        }
+
+        return (imgOut != NULL) && imgOut->isCompact();
+    }
+
+    /**
+     * @brief promoteCompact replaces compact inputs with float copies;
+     * copies are added to promoted, and they have to be released.
+     * @param imgIn
+     * @param promoted
+     */
+    static void promoteCompact(ImageVec &imgIn, ImageVec &promoted)
+    {
+        for(unsigned int i = 0; i < imgIn.size(); i++) {
+            if((imgIn[i] == NULL) || !imgIn[i]->isCompact()) {
+                continue;
+            }
+
+            //an image passed twice is promoted once
+            Image *original = imgIn[i];
+            imgIn[i] = original->promote();
+            promoted.push_back(imgIn[i]);
+
+            for(unsigned int j = i + 1; j < imgIn.size(); j++) {
+                if(imgIn[j] == original) {
+                    imgIn[j] = imgIn[i];
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief ProcessCompact calls Process on float copies of compact
+     * inputs, and it converts the output back to its storage. Overrides of
+     * Process that access data directly, without Filter::Process, call it
+     * when hasCompact is true.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessCompact(ImageVec imgIn, Image *imgOut)
+    {
+        ImageVec promoted;
+        promoteCompact(imgIn, promoted);
+
+        IMAGE_STORAGE storageOut = IS_FLOAT;
+
+        if(imgOut != NULL) {
+            storageOut = imgOut->getStorage();
+            imgOut->setStorage(IS_FLOAT);
+        }
+
+        imgOut = Process(imgIn, imgOut);
+
+        if(imgOut != NULL) {
+            imgOut->setStorage(storageOut);
+        }
+
+        stdVectorClear<Image>(promoted);
+
+        return imgOut;
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -84,29 +250,73 @@ protected:
         f_data.dst = dst;
         f_data.nSrc = int(src.size());
 
+        int borderX, borderY;
+        bool bSpan = getSpanBorder(borderX, borderY) && checkSpanInput(dst, src);
+
+        FilterSpanData s_data;
+        std::vector< std::vector< float > > buffers;
+        if(bSpan) {
+            s_data.src = src;
+            s_data.dst = dst;
+            s_data.nSrc = f_data.nSrc;
+            s_data.in.resize(src.size());
+            buffers.resize(src.size());
+        }
+
         for(int k = box->z0; k < box->z1; k++) {
             f_data.z = k;
 
             for(int j = box->y0; j < box->y1; j++) {
                 f_data.y = j;
 
-                for(int i = box->x0; i < box->x1; i++) {
-                    f_data.x = i;
-                    f_data.out = (*dst)(i, j);
+                //interior span [x0, x1)
+                int x0 = box->x0;
+                int x1 = box->x0;
+
+                if(bSpan && (j >= borderY) && (j < (dst->height - borderY))) {
+                    x0 = MIN(MAX(box->x0, borderX), box->x1);
+                    x1 = MAX(MIN(box->x1, dst->width - borderX), x0);
+                }
+
+                ProcessPixels(&f_data, box->x0, x0);
+
+                if(x1 > x0) {
+                    s_data.x0 = x0;
+                    s_data.x1 = x1;
+                    s_data.y = j;
+                    s_data.z = k;
+                    s_data.out = dst->data + k * dst->tstride + j * dst->ystride + x0 * dst->xstride;
 
-                    f(&f_data);
+                    for(unsigned int l = 0; l < src.size(); l++) {
+                        s_data.in[l] = getSpan(src[l], x0, x1, j, k, buffers[l]);
+                    }
+
+                    fSpan(&s_data);
                 }
+
+                ProcessPixels(&f_data, x1, box->x1);
             }
         }
     }
 
     /**
-     * @brief ProcessP
+     * @brief getTileShape returns a hint on the shape of tiles that
+     * best fits the memory access pattern of the filter.
+     * @return
+     */
+    virtual TILE_SHAPE getTileShape()
+    {
+        return TS_SQUARE;
+    }
+
+    /**
+     * @brief ProcessP processes the output in parallel tiles; filters with
+     * a different strategy (e.g., in the frequency domain) override it.
      * @param imgIn
      * @param imgOut
      * @return
      */
-    Image *ProcessP(ImageVec imgIn, Image *imgOut);
+    virtual Image *ProcessP(ImageVec imgIn, Image *imgOut);
 
     /**
      * @brief setupAux
@@ -144,6 +354,91 @@ public:
 
     }
 
+    /**
+     * @brief isPointwise
+     * @return This function returns true if an output pixel depends only on
+     * the input pixels at the same position; i.e. fSpan has no border.
+     */
+    bool isPointwise()
+    {
+        int borderX, borderY;
+        return getSpanBorder(borderX, borderY) && (borderX == 0) && (borderY == 0);
+    }
+
+    /**
+     * @brief hasPlanarPath
+     * @return This function returns true if the filter is faster on single
+     * channel images, and it processes channels independently. In a
+     * multi-pass filter whose passes all return true, a single input with
+     * many channels is split in planes once (see ImagePlanar), all passes
+     * run on each plane, and planes are interleaved once at the end.
+     */
+    virtual bool hasPlanarPath()
+    {
+        return false;
+    }
+
+    /**
+     * @brief checkSpanInput checks if inputs and output have the same
+     * size, and if their channels match fSpan; this is required for
+     * processing spans.
+     * @param dst
+     * @param src
+     * @return
+     */
+    bool checkSpanInput(Image *dst, ImageVec &src)
+    {
+        for(unsigned int i = 0; i < src.size(); i++) {
+            if((src[i]->width  != dst->width) ||
+               (src[i]->height != dst->height) ||
+               (src[i]->frames != dst->frames)) {
+                return false;
+            }
+        }
+
+        return checkSpanChannels(dst, src);
+    }
+
+    /**
+     * @brief getSpan returns a pointer to the pixel (x0, y, z) of img; if
+     * img is compact, the span [x0, x1) is promoted into buffer.
+     * @param img
+     * @param x0
+     * @param x1
+     * @param y
+     * @param z
+     * @param buffer
+     * @return
+     */
+    static float *getSpan(Image *img, int x0, int x1, int y, int z,
+                          std::vector< float > &buffer)
+    {
+        int offset = z * img->tstride + y * img->ystride + x0 * img->xstride;
+
+        if(!img->isCompact()) {
+            return img->data + offset;
+        }
+
+        int n = (x1 - x0) * img->channels;
+
+        if(int(buffer.size()) < n) {
+            buffer.resize(n);
+        }
+
+        img->promoteSpan(offset, n, &buffer[0]);
+        return &buffer[0];
+    }
+
+    /**
+     * @brief ProcessSpan processes a span of pixels with fSpan; inputs
+     * and output have to be set up as for the interior of the image.
+     * @param data
+     */
+    void ProcessSpan(FilterSpanData *data)
+    {
+        fSpan(data);
+    }
+
     /**
      * @brief changePass changes the pass direction.
      * @param pass
@@ -360,24 +655,28 @@ PIC_INLINE Image *Filter::ProcessP(ImageVec imgIn, Image *imgOut)
         return imgOut;
     }
 
-    //create threads
-    int numCores = std::thread::hardware_concurrency();
-
-    std::thread **thrd = new std::thread*[numCores];
-    TileList lst(TILE_SIZE, imgOut->width, imgOut->height);
+    ThreadPool *pool = ThreadPool::getInstance();
 
-    for(int i = 0; i < numCores; i++) {
-        thrd[i] = new std::thread(
-            std::bind(&Filter::ProcessAux, this, imgIn, imgOut, &lst));
+    //tiles are sized on the working set of inputs and output
+    int bytesPerPixel = imgOut->channels;
+    for(unsigned int i = 0; i < imgIn.size(); i++) {
+        bytesPerPixel += imgIn[i]->channels;
     }
+    bytesPerPixel *= int(sizeof(float));
 
-    //join threads
-    for(int i = 0; i < numCores; i++) {
-        thrd[i]->join();
-        delete thrd[i];
-    }
+    int tileWidth, tileHeight;
+    TileList::getTileSize(imgOut->width, imgOut->height, bytesPerPixel,
+                          getTileShape(), pool->getNumberOfThreads(),
+                          tileWidth, tileHeight);
+
+    TileList lst(tileWidth, tileHeight, imgOut->width, imgOut->height);
+
+    //each lane of the pool pulls tiles from lst
+    int nLanes = MIN(int(lst.size()), pool->getNumberOfThreads());
 
-    delete[] thrd;
+    pool->parallelFor(nLanes, [this, &imgIn, imgOut, &lst](int /*i*/) {
+        ProcessAux(imgIn, imgOut, &lst);
+    });
 
     return imgOut;
 }
@@ -393,13 +692,32 @@ PIC_INLINE Image *Filter::Process(ImageVec imgIn, Image *imgOut)
         return imgOut;
     }
 
+    //a compact output is written as float, and then converted back
+    IMAGE_STORAGE storageOut = IS_FLOAT;
+
+    if(imgOut != NULL) {
+        storageOut = imgOut->getStorage();
+        imgOut->setStorage(IS_FLOAT);
+    }
+
     imgOut = setupAux(imgIn, imgOut);
 
-    if(imgOut == NULL) {
-        return imgOut;
+    //compact inputs are promoted, unless spans read them on the fly
+    ImageVec promoted;
+
+    if((imgOut == NULL) || !acceptsCompactInput() ||
+       !checkSpanInput(imgOut, imgIn)) {
+        promoteCompact(imgIn, promoted);
     }
 
-    return ProcessP(imgIn, imgOut);
+    if(imgOut != NULL) {
+        imgOut = ProcessP(imgIn, imgOut);
+        imgOut->setStorage(storageOut);
+    }
+
+    stdVectorClear<Image>(promoted);
+
+    return imgOut;
 }
 
 } // end namespace pic
@@ -35,14 +35,42 @@ protected:
      */
     void f(FilterFData *data)
     {
-        float *dataIn0 = (*data->src[0])(data->x, data->y);
-        float *dataIn1 = (*data->src[1])(data->x, data->y);
+        float *dataIn0 = (*data->src[0])(data->x, data->y, data->z);
+        float *dataIn1 = (*data->src[1])(data->x, data->y, data->z);
 
         for(int k = 0; k < data->dst->channels; k++) {
             data->out[k] = fabsf(dataIn1[k] - dataIn0[k]);
         }
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        float *in0 = data->in[0];
+        float *in1 = data->in[1];
+        int n = (data->x1 - data->x0) * data->dst->channels;
+
+        for(int i = 0; i < n; i++) {
+            data->out[i] = fabsf(in1[i] - in0[i]);
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
 public:
 
     /**
@@ -73,11 +73,20 @@ protected:
         float *acc = new float[channels];
         float *totWeight = new float[channels];
 
+        //scanlines of the exposures; compact exposures are promoted on the fly
+        std::vector< float * > rows(n);
+        std::vector< std::vector< float > > buffers(n);
+
         for(int j = box->y0; j < box->y1; j++) {
             int ind = j * width;
 
+            for(int l = 0; l < n; l++) {
+                rows[l] = getSpan(src[l], box->x0, box->x1, j, 0, buffers[l]);
+            }
+
             for(int i = box->x0; i < box->x1; i++) {
                 int c = (ind + i) * channels;
+                int c_row = (i - box->x0) * channels;
 
                 Arrayf::assign(0.0f, acc, channels);
                 Arrayf::assign(0.0f, totWeight, channels);
@@ -88,7 +97,9 @@ protected:
                 //for each exposure...
                 for(int l = 0; l < n; l++) {
 
-                    float x = Arrayf::sum(&src[l]->data[c], channels);
+                    float *src_l = rows[l] + c_row;
+
+                    float x = Arrayf::sum(src_l, channels);
                     x /= dst->channelsf;
 
                     float t_mvs = x / t_min;
@@ -106,7 +117,7 @@ protected:
                     }
 
                     for(int k = 0; k < channels; k++) {
-                        float x_lin = crf->remove(src[l]->data[c + k], k);
+                        float x_lin = crf->remove(src_l[k], k);
 
                         //merge HDR pixels
                         switch(domain) {
@@ -151,6 +162,16 @@ protected:
         delete[] acc;
     }
 
+    /**
+     * @brief acceptsCompactInput
+     * @return exposures are read by scanlines, so compact stacks are not
+     * promoted as a whole.
+     */
+    bool acceptsCompactInput()
+    {
+        return true;
+    }
+
 public:
 
     /**
@@ -35,17 +35,63 @@ protected:
      */
     void f(FilterFData *data)
     {
-        float *in   = (*data->src[0])(data->x,     data->y);
-        float *inXm = (*data->src[0])(data->x + 1, data->y);
-        float *inYm = (*data->src[0])(data->x,     data->y + 1);
+        float *in   = (*data->src[0])(data->x,     data->y, data->z);
+        float *inXm = (*data->src[0])(data->x + 1, data->y, data->z);
+        float *inYm = (*data->src[0])(data->x,     data->y + 1, data->z);
 
-        for(int k = 0; k < data->dst->channels; k++) {
+        for(int k = 0; k < data->src[0]->channels; k++) {
             int tmp = k << 1;
             data->out[tmp  ]   = inXm[k] - in[k];
             data->out[tmp + 1] = inYm[k] - in[k];
         }
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        int channels = data->src[0]->channels;
+        int xstride = data->src[0]->xstride;
+        int ystride = data->src[0]->ystride;
+
+        for(int i = 0; i < (data->x1 - data->x0); i++) {
+            float *in = data->in[0] + i * xstride;
+            float *out = data->out + i * data->dst->xstride;
+
+            for(int k = 0; k < channels; k++) {
+                int tmp = k << 1;
+                out[tmp    ] = in[k + xstride] - in[k];
+                out[tmp + 1] = in[k + ystride] - in[k];
+            }
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 1;
+        borderY = 1;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @param src
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec &src)
+    {
+        return dst->channels == (src[0]->channels * 2);
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -44,6 +44,15 @@ protected:
      */
     void ProcessBBox(Image *dst, ImageVec src, BBox *box);
 
+    /**
+     * @brief getTileShape uses row strips for horizontal passes.
+     * @return
+     */
+    TILE_SHAPE getTileShape()
+    {
+        return (dirs[1] == 1) ? TS_ROW_STRIP : TS_SQUARE;
+    }
+
 public:
 
     float sigma_s, sigma_r;
@@ -0,0 +1,143 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FILTERING_FILTER_BILATERAL_2DPL_HPP
+#define PIC_FILTERING_FILTER_BILATERAL_2DPL_HPP
+
+#include "../util/std_util.hpp"
+
+#include "../filtering/filter.hpp"
+#include "../algorithms/permutohedral_lattice.hpp"
+
+namespace pic {
+
+/**
+ * @brief The FilterBilateral2DPL class is the (joint) bilateral filter
+ * computed with a permutohedral lattice. The edge image, imgIn[1] if
+ * present, can have any number of channels (e.g., RGB, RGB + depth); its
+ * cost grows linearly with the number of pixels, and polynomially with the
+ * number of channels of the edge.
+ */
+class FilterBilateral2DPL: public Filter
+{
+protected:
+    float sigma_s, sigma_r;
+
+    PermutohedralLattice lattice;
+
+public:
+
+    /**
+     * @brief FilterBilateral2DPL
+     * @param sigma_s
+     * @param sigma_r
+     */
+    FilterBilateral2DPL(float sigma_s, float sigma_r) : Filter()
+    {
+        update(sigma_s, sigma_r);
+    }
+
+    /**
+     * @brief update
+     * @param sigma_s
+     * @param sigma_r
+     */
+    void update(float sigma_s, float sigma_r)
+    {
+        this->sigma_s = sigma_s > 0.0f ? sigma_s : 1.0f;
+        this->sigma_r = sigma_r > 0.0f ? sigma_r : 0.01f;
+    }
+
+    /**
+     * @brief signature
+     * @return
+     */
+    std::string signature()
+    {
+        return genBilString("PL", sigma_s, sigma_r);
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(!checkInput(imgIn)) {
+            return imgOut;
+        }
+
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
+        imgOut = setupAux(imgIn, imgOut);
+
+        if(imgOut == NULL) {
+            return imgOut;
+        }
+
+        Image *base = imgIn[0];
+        Image *edge = imgIn.size() == 2 ? imgIn[1] : imgIn[0];
+
+        if((base->width != edge->width) || (base->height != edge->height)) {
+            return imgOut;
+        }
+
+        lattice.filter(imgOut, base, edge, sigma_s, sigma_r);
+
+        return imgOut;
+    }
+
+    /**
+     * @brief execute
+     * @param imgIn
+     * @param imgOut
+     * @param sigma_s
+     * @param sigma_r
+     * @return
+     */
+    static Image *execute(Image *imgIn, Image *imgOut, float sigma_s,
+                          float sigma_r)
+    {
+        FilterBilateral2DPL filter(sigma_s, sigma_r);
+        return filter.Process(Single(imgIn), imgOut);
+    }
+
+    /**
+     * @brief execute
+     * @param imgIn
+     * @param imgEdge
+     * @param imgOut
+     * @param sigma_s
+     * @param sigma_r
+     * @return
+     */
+    static Image *execute(Image *imgIn, Image *imgEdge, Image *imgOut,
+                          float sigma_s, float sigma_r)
+    {
+        FilterBilateral2DPL filter(sigma_s, sigma_r);
+        return filter.Process(Double(imgIn, imgEdge), imgOut);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FILTERING_FILTER_BILATERAL_2DPL_HPP */
+
@@ -0,0 +1,204 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FILTERING_FILTER_BOX_MEAN_HPP
+#define PIC_FILTERING_FILTER_BOX_MEAN_HPP
+
+#include <string.h>
+#include <vector>
+
+#include "../filtering/filter.hpp"
+
+namespace pic {
+
+/**
+ * @brief FILTER_BOX_MEAN_COLUMNS is the number of floats of a row
+ * processed by a task in the vertical pass of FilterBoxMean.
+ */
+#ifndef FILTER_BOX_MEAN_COLUMNS
+#define FILTER_BOX_MEAN_COLUMNS 256
+#endif
+
+/**
+ * @brief The FilterBoxMean class computes the mean of each channel in the
+ * window [x - radius0, x + radius1] x [y - radius0, y + radius1], where
+ * coordinates are clamped as in Image::operator(). The window slides: a
+ * horizontal pass runs on rows, and a vertical pass on spans of columns,
+ * and both keep running sums in double, so the cost per pixel does not
+ * depend on the size of the window. The filter can run in place.
+ */
+class FilterBoxMean: public Filter
+{
+protected:
+    int radius0, radius1;
+
+    /**
+     * @brief slidingSum computes out[x] = sum of in[CLAMP(t, n)] for t in
+     * [x - radius0, x + radius1], for n values with a given stride.
+     * @param out
+     * @param in
+     * @param n
+     * @param stride
+     */
+    void slidingSum(float *out, const float *in, int n, int stride)
+    {
+        double sum = 0.0;
+
+        for(int t = -radius0; t <= radius1; t++) {
+            sum += in[CLAMP(t, n) * stride];
+        }
+
+        out[0] = float(sum);
+
+        for(int x = 1; x < n; x++) {
+            sum += in[CLAMP(x + radius1, n) * stride] - in[CLAMP(x - radius0 - 1, n) * stride];
+            out[x * stride] = float(sum);
+        }
+    }
+
+public:
+
+    /**
+     * @brief FilterBoxMean
+     * @param radius0 is the extent of the window before a pixel.
+     * @param radius1 is the extent of the window after a pixel.
+     */
+    FilterBoxMean(int radius0, int radius1) : Filter()
+    {
+        update(radius0, radius1);
+    }
+
+    /**
+     * @brief update
+     * @param radius0
+     * @param radius1
+     */
+    void update(int radius0, int radius1)
+    {
+        this->radius0 = MAX(radius0, 0);
+        this->radius1 = MAX(radius1, -this->radius0);
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(!checkInput(imgIn)) {
+            return imgOut;
+        }
+
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
+        Image *img = imgIn[0];
+        imgOut = setupAux(imgIn, imgOut);
+
+        if(imgOut == NULL) {
+            return imgOut;
+        }
+
+        int width = img->width;
+        int height = img->height;
+        int channels = img->channels;
+        int frames = img->frames;
+
+        int size = radius0 + radius1 + 1;
+        float scale = 1.0f / float(size * size);
+
+        //horizontal pass; a row is copied, so imgIn can be imgOut
+        ThreadPool::getInstance()->parallelFor(height * frames, [&](int r) {
+            std::vector< float > row(img->data + r * img->ystride,
+                                     img->data + (r + 1) * img->ystride);
+
+            float *out = imgOut->data + r * imgOut->ystride;
+
+            for(int c = 0; c < channels; c++) {
+                slidingSum(out + c, &row[c], width, channels);
+            }
+        });
+
+        //vertical pass on spans of columns
+        int rowSize = width * channels;
+        int nSpans = (rowSize + FILTER_BOX_MEAN_COLUMNS - 1) / FILTER_BOX_MEAN_COLUMNS;
+
+        ThreadPool::getInstance()->parallelFor(nSpans * frames, [&](int k) {
+            int f = k / nSpans;
+            int x0 = (k % nSpans) * FILTER_BOX_MEAN_COLUMNS;
+            int n = MIN(rowSize - x0, FILTER_BOX_MEAN_COLUMNS);
+
+            float *data = imgOut->data + f * imgOut->tstride + x0;
+
+            std::vector< float > span(height * n);
+            for(int y = 0; y < height; y++) {
+                memcpy(&span[y * n], data + y * rowSize, sizeof(float) * n);
+            }
+
+            std::vector< double > sum(n, 0.0);
+
+            for(int t = -radius0; t <= radius1; t++) {
+                float *span_t = &span[CLAMP(t, height) * n];
+
+                for(int i = 0; i < n; i++) {
+                    sum[i] += span_t[i];
+                }
+            }
+
+            for(int y = 0; y < height; y++) {
+                if(y > 0) {
+                    float *span_in = &span[CLAMP(y + radius1, height) * n];
+                    float *span_out = &span[CLAMP(y - radius0 - 1, height) * n];
+
+                    for(int i = 0; i < n; i++) {
+                        sum[i] += span_in[i] - span_out[i];
+                    }
+                }
+
+                float *out = data + y * rowSize;
+
+                for(int i = 0; i < n; i++) {
+                    out[i] = float(sum[i]) * scale;
+                }
+            }
+        });
+
+        return imgOut;
+    }
+
+    /**
+     * @brief execute
+     * @param imgIn
+     * @param imgOut
+     * @param radius0
+     * @param radius1
+     * @return
+     */
+    static Image *execute(Image *imgIn, Image *imgOut, int radius0, int radius1)
+    {
+        FilterBoxMean filter(radius0, radius1);
+        return filter.Process(Single(imgIn), imgOut);
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_FILTERING_FILTER_BOX_MEAN_HPP */
+
@@ -58,29 +58,79 @@ class FilterChannel: public Filter
 protected:
 
     /**
-     * @brief ProcessBBox
+     * @brief f
+     * @param data
+     */
+    void f(FilterFData *data)
+    {
+        int totChannels = CLAMPi(int(channels_vec.size()), 0, data->src[0]->channels);
+
+        float *dataIn = (*data->src[0])(data->x, data->y, data->z);
+        float *dataOut = (*data->dst)(data->x, data->y, data->z);
+
+        for(int k = 0; k < totChannels; k++) {
+            dataOut[k] = dataIn[channels_vec[k]];
+        }
+    }
+
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        int channels_in = data->src[0]->channels;
+        int channels_out = data->dst->channels;
+        int totChannels = CLAMPi(int(channels_vec.size()), 0, channels_in);
+
+        float *in = data->in[0];
+        float *out = data->out;
+        int n = data->x1 - data->x0;
+
+        for(int i = 0; i < n; i++) {
+            for(int k = 0; k < totChannels; k++) {
+                out[k] = in[channels_vec[k]];
+            }
+
+            in += channels_in;
+            out += channels_out;
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
      * @param dst
      * @param src
-     * @param box
+     * @return
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    bool checkSpanChannels(Image *dst, ImageVec &src)
     {
-        int totChannels =  CLAMPi(int(channels_vec.size()), 0, src[0]->channels);
+        int totChannels = CLAMPi(int(channels_vec.size()), 0, src[0]->channels);
 
-        for(int p = box->z0; p < box->z1; p++) {
-            for(int j = box->y0; j < box->y1; j++) {
-                for(int i = box->x0; i < box->x1; i++) {
-
-                    float *dataOut = (*dst)(i, j, p);
-                    float *dataIn = (*src[0])(i, j, p);
+        if(dst->channels < totChannels) {
+            return false;
+        }
 
-                    for(int k = 0; k < totChannels; k++) {
-                        int index = channels_vec[k];
-                        dataOut[k] = dataIn[index];
-                    }
-                }
+        for(int k = 0; k < totChannels; k++) {
+            if((channels_vec[k] < 0) || (channels_vec[k] >= src[0]->channels)) {
+                return false;
             }
         }
+
+        return true;
     }
 
     std::vector<int> channels_vec;
@@ -44,54 +44,87 @@ protected:
     bool bEven;
 
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief transform applies the list of color transforms to a pixel.
+     * @param dataIn
+     * @param dataOut
+     * @param tmpCol is a temporary color with the same number of channels.
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void transform(float *dataIn, float *dataOut, float *tmpCol)
+    {
+        float *tmp[2];
+
+        if(bEven) {
+            tmp[1] = dataOut;
+            tmp[0] = tmpCol;
+        } else {
+            tmp[0] = dataOut;
+            tmp[1] = tmpCol;
+        }
+
+        if(bDirection) { //direct color transform
+            list[0].f->transform(dataIn, tmp[0], list[0].bDirection);
+            for(unsigned int k = 1; k < n; k++) {
+                list[k].f->transform(tmp[(k + 1) % 2], tmp[k % 2], list[k].bDirection);
+            }
+        } else { //inverse color transform
+            list[n - 1].f->transform(dataIn, tmp[0], !list[n - 1].bDirection);
+            for(unsigned int k = 1; k < n; k++) {
+                list[n - k - 1].f->transform(tmp[(k + 1) % 2], tmp[k % 2], !list[n - k - 1].bDirection);
+            }
+        }
+    }
+
+    /**
+     * @brief f
+     * @param data
+     */
+    void f(FilterFData *data)
     {
         if(n < 1) {
             return;
         }
 
-        int channels = src[0]->channels;
+        std::vector< float > tmpCol(data->src[0]->channels);
 
-        float *tmpCol = new float [channels];
-        float *tmp[2];
+        transform((*data->src[0])(data->x, data->y, data->z), data->out, &tmpCol[0]);
+    }
 
-        tmp[1] = tmpCol;
-
-        for(int j = box->y0; j < box->y1; j++) {
-
-            for(int i = box->x0; i < box->x1; i++) {
-
-                float *dataIn  = (*src[0])(i, j);
-                float *dataOut = (*dst) (i, j);
-
-                if(bEven) {
-                    tmp[1] = dataOut;
-                    tmp[0] = tmpCol;
-                } else {
-                    tmp[0] = dataOut;
-                    tmp[1] = tmpCol;
-                }
-
-                if(bDirection) { //direct color transform
-                    list[0].f->transform(dataIn, tmp[0], list[0].bDirection);
-                    for(unsigned int k = 1; k < n; k++) {
-                        list[k].f->transform(tmp[(k + 1) % 2], tmp[k % 2], list[k].bDirection);
-                    }
-                } else { //inverse color transform
-                    list[n - 1].f->transform(dataIn, tmp[0], !list[n - 1].bDirection);
-                    for(unsigned int k = 1; k < n; k++) {
-                        list[n - k - 1].f->transform(tmp[(k + 1) % 2], tmp[k % 2], !list[n - k - 1].bDirection);
-                    }
-                }
-            }
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        if(n < 1) {
+            return;
         }
 
-        delete[] tmpCol;
+        int channels = data->src[0]->channels;
+        std::vector< float > tmpCol(channels);
+
+        float *in = data->in[0];
+        float *out = data->out;
+        int channels_out = data->dst->channels;
+
+        for(int i = data->x0; i < data->x1; i++) {
+            transform(in, out, &tmpCol[0]);
+
+            in += channels;
+            out += channels_out;
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
     }
 
 public:
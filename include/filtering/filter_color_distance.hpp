@@ -37,13 +37,51 @@ protected:
      */
     void f(FilterFData *data)
     {
-        float *in = (*data->src[0])(data->x, data->y);
+        float *in = (*data->src[0])(data->x, data->y, data->z);
 
-        float sum = Arrayf::distanceSq(in, color, data->dst->channels);
+        float sum = Arrayf::distanceSq(in, color, data->src[0]->channels);
 
         data->out[0] = expf(- sum / sigma_sq_2);
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        int channels = data->src[0]->channels;
+        float *in = data->in[0];
+
+        for(int i = 0; i < (data->x1 - data->x0); i++) {
+            float sum = Arrayf::distanceSq(&in[i * channels], color, channels);
+            data->out[i] = expf(- sum / sigma_sq_2);
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec & /*src*/)
+    {
+        return dst->channels == 1;
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -21,6 +21,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../base.hpp"
 #include "../util/std_util.hpp"
 #include "../util/array.hpp"
+#include "../util/span_ops.hpp"
 #include "../filtering/filter.hpp"
 #include "../util/precomputed_gaussian.hpp"
 
@@ -44,6 +45,27 @@ protected:
      */
     void ProcessBBox(Image *dst, ImageVec src, BBox *box);
 
+    /**
+     * @brief ProcessBorder filters pixels in [x0, x1) on the row j of
+     * the frame m with clamped coordinates.
+     * @param dst
+     * @param source
+     * @param x0
+     * @param x1
+     * @param j
+     * @param m
+     */
+    void ProcessBorder(Image *dst, Image *source, int x0, int x1, int j, int m);
+
+    /**
+     * @brief getTileShape uses row strips for horizontal passes.
+     * @return
+     */
+    TILE_SHAPE getTileShape()
+    {
+        return (dirs[1] == 1) ? TS_ROW_STRIP : TS_SQUARE;
+    }
+
 public:
 
     /**
@@ -69,6 +91,20 @@ public:
      */
     void update(float *data, int kernelSize, int direction);
 
+    /**
+     * @brief getKernel returns the kernel of the filter.
+     * @param kernel
+     * @param kernelSize
+     * @return This function returns true if the filter is a plain
+     * convolution with kernel; otherwise false.
+     */
+    virtual bool getKernel(float *&kernel, int &kernelSize)
+    {
+        kernel = data;
+        kernelSize = this->kernelSize;
+        return (data != NULL) && (kernelSize > 0);
+    }
+
     /**
      * @brief changePass
      * @param pass
@@ -147,6 +183,14 @@ PIC_INLINE FilterConv1D::FilterConv1D()
 
 PIC_INLINE FilterConv1D::FilterConv1D(float *data, int kernelSize, int direction = 0)
 {
+    this->data = NULL;
+    this->kernelSize = 0;
+    halfKernelSize = 0;
+
+    dirs[0] = 0;
+    dirs[1] = 0;
+    dirs[2] = 0;
+
     update(data, kernelSize, direction);
 }
 
@@ -208,36 +252,76 @@ PIC_INLINE void FilterConv1D::changePass(int x, int y, int z)
     dirs[2] = z;
 }
 
+PIC_INLINE void FilterConv1D::ProcessBorder(Image *dst, Image *source,
+                                            int x0, int x1, int j, int m)
+{
+    int channels = dst->channels;
+
+    //tap direction
+    int dx = dirs[1];
+    int dy = dirs[0];
+    int dz = dirs[2];
+
+    for(int i = x0; i < x1; i++) {
+        float *dst_data = (*dst)(i, j, m);
+
+        Arrayf::assign(0.0f, dst_data, channels);
+
+        int tx = i - halfKernelSize * dx;
+        int ty = j - halfKernelSize * dy;
+        int tz = m - halfKernelSize * dz;
+
+        for(int k = 0; k < kernelSize; k++) { //1D Filtering
+            float *tmpSource = (*source)(tx, ty, tz);
+
+            for(int l = 0; l < channels; l++) {
+                dst_data[l] += tmpSource[l] * data[k];
+            }
+
+            tx += dx;
+            ty += dy;
+            tz += dz;
+        }
+    }
+}
+
 PIC_INLINE void FilterConv1D::ProcessBBox(Image *dst, ImageVec src, BBox *box)
 {
     Image *source = src[0];
 
-    for(int m = box->z0; m < box->z1; m++) {
+    //interior spans are convolved without clamping for 2D passes
+    bool bSpan = (dirs[2] == 0) &&
+                 (source->width    == dst->width) &&
+                 (source->height   == dst->height) &&
+                 (source->channels == dst->channels) &&
+                 (source->frames   == dst->frames);
 
-        for(int j = box->y0; j < box->y1; j++) {
+    int borderX = dirs[1] * halfKernelSize;
+    int borderY = dirs[0] * halfKernelSize;
+    int tapStride = dirs[1] * source->xstride + dirs[0] * source->ystride;
 
-            for(int i = box->x0; i < box->x1; i++) {
-                float *dst_data = (*dst)(i, j, m);
+    for(int m = box->z0; m < box->z1; m++) {
 
-                Arrayf::assign(0.0f, dst_data, dst->channels);
+        for(int j = box->y0; j < box->y1; j++) {
+            int x0 = box->x0;
+            int x1 = box->x0;
 
-                for(int k = 0; k < kernelSize; k++) { //1D Filtering
-                    int tmpCoord = k - halfKernelSize;
+            if(bSpan && (j >= borderY) && (j < (dst->height - borderY))) {
+                x0 = MIN(MAX(box->x0, borderX), box->x1);
+                x1 = MAX(MIN(box->x1, dst->width - borderX), x0);
+            }
 
-                    //Address cj
-                    int cj = j + tmpCoord * dirs[0];
-                    //Address ci
-                    int ci = i + tmpCoord * dirs[1];
-                    //Address cm
-                    int cm = m + tmpCoord * dirs[2];
+            ProcessBorder(dst, source, box->x0, x0, j, m);
 
-                    float *tmpSource = (*source)(ci, cj, cm);
+            if(x1 > x0) {
+                int offset = m * dst->tstride + j * dst->ystride + x0 * dst->xstride;
 
-                    for(int l = 0; l < dst->channels; l++) {
-                        dst_data[l] += tmpSource[l] * data[k];
-                    }
-                }
+                SpanOps::convolve(&dst->data[offset], &source->data[offset],
+                                  (x1 - x0) * dst->channels,
+                                  data, kernelSize, tapStride);
             }
+
+            ProcessBorder(dst, source, x1, box->x1, j, m);
         }
     }
 }
@@ -19,17 +19,93 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_CONV_2D_HPP
 
 #include "../util/array.hpp"
+#include "../util/span_ops.hpp"
 
 #include "../filtering/filter.hpp"
+#include "../algorithms/fft_convolution.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterConv2D class
+ * @brief The FilterConv2D class convolves imgIn[0] with the kernel imgIn[1];
+ * large kernels are convolved in the frequency domain when this is
+ * estimated to be faster.
  */
 class FilterConv2D: public Filter
 {
 protected:
+    FFTConvolution fftConv;
+
+    /**
+     * @brief ProcessP chooses between the spatial domain (tiles) and the
+     * frequency domain.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessP(ImageVec imgIn, Image *imgOut)
+    {
+        Image *img  = imgIn[0];
+        Image *conv = imgIn[1];
+
+        bool bFrequency = (img != imgOut) &&
+                          (img->frames == 1) && (conv->frames == 1) &&
+                          img->isSimilarType(imgOut) &&
+                          FFTConvolution::isFaster(img->width, img->height, conv);
+
+        if(!bFrequency) {
+            return Filter::ProcessP(imgIn, imgOut);
+        }
+
+        fftConv.setup(img->width, img->height, conv);
+
+        for(int c = 0; c < img->channels; c++) {
+            float *out = imgOut->data + c;
+
+            fftConv.process(img, c, [&](int x, int y, float value) {
+                out[y * imgOut->ystride + x * imgOut->xstride] = value;
+            });
+        }
+
+        return imgOut;
+    }
+
+    /**
+     * @brief ProcessBorder filters pixels in [x0, x1) on the row j
+     * with clamped coordinates.
+     * @param dst
+     * @param img
+     * @param conv
+     * @param x0
+     * @param x1
+     * @param j
+     */
+    void ProcessBorder(Image *dst, Image *img, Image *conv, int x0, int x1, int j)
+    {
+        int channels = dst->channels;
+
+        int c_w_h = (conv->width >> 1);
+        int c_h_h = (conv->height >> 1);
+
+        for(int i = x0; i < x1; i++) {
+            float *dst_data = (*dst)(i, j);
+
+            Arrayf::assign(0.0f, dst_data, channels);
+
+            for(int k = -c_h_h; k <= c_h_h; k++) {
+                for(int l = -c_w_h; l <= c_w_h; l++) {
+
+                    float *img_data  = (*img)(i + l, j + k);
+                    float *conv_data = (*conv)(l + c_w_h, k + c_h_h);
+
+                    for(int c = 0; c < channels; c++) {
+                        int c2 = c % conv->channels;
+                        dst_data[c] += img_data[c] * conv_data[c2];
+                    }
+                }
+            }
+        }
+    }
 
     /**
      * @brief ProcessBBox
@@ -42,30 +118,59 @@ protected:
         Image *img  = src[0];
         Image *conv = src[1];
 
-        int channels = dst->channels;
-
         int c_w_h = (conv->width >> 1);
         int c_h_h = (conv->height >> 1);
 
+        //interior spans are convolved without clamping for single channel kernels
+        bool bSpan = (conv->channels == 1) &&
+                     (img->width    == dst->width) &&
+                     (img->height   == dst->height) &&
+                     (img->channels == dst->channels);
+
+        std::vector< float > weights;
+        std::vector< int > offsets;
+
+        if(bSpan) {
+            for(int k = -c_h_h; k <= c_h_h; k++) {
+                for(int l = -c_w_h; l <= c_w_h; l++) {
+                    weights.push_back((*conv)(l + c_w_h, k + c_h_h)[0]);
+                    offsets.push_back(k * img->ystride + l * img->xstride);
+                }
+            }
+        }
+
+        int n = int(weights.size());
+
         for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *dst_data = (*dst)(i, j);
+            int x0 = box->x0;
+            int x1 = box->x0;
+
+            if(bSpan && (j >= c_h_h) && (j < (dst->height - c_h_h))) {
+                x0 = MIN(MAX(box->x0, c_w_h), box->x1);
+                x1 = MAX(MIN(box->x1, dst->width - c_w_h), x0);
+            }
 
-                Arrayf::assign(0.0f, dst_data, channels);
+            ProcessBorder(dst, img, conv, box->x0, x0, j);
 
-                for(int k = -c_h_h; k <= c_h_h; k++) {
-                    for(int l = -c_w_h; l <= c_w_h; l++) {
+            if(x1 > x0) {
+                int offset = j * dst->ystride + x0 * dst->xstride;
+                float *out = &dst->data[offset];
+                float *in  = &img->data[offset];
 
-                        float *img_data  = (*img)(i + l, j + k);
-                        float *conv_data = (*conv)(l + c_w_h, k + c_h_h);
+                int size = (x1 - x0) * dst->channels;
 
-                        for(int c = 0; c < channels; c++) {
-                            int c2 = c % conv->channels;
-                            dst_data[c] += img_data[c] * conv_data[c2];
-                        }
+                for(int i = 0; i < size; i += SPAN_OPS_CHUNK) {
+                    int len = MIN(SPAN_OPS_CHUNK, size - i);
+
+                    SpanOps::assign(out + i, in + i + offsets[0], weights[0], len);
+
+                    for(int k = 1; k < n; k++) {
+                        SpanOps::madd(out + i, in + i + offsets[k], weights[k], len);
                     }
                 }
             }
+
+            ProcessBorder(dst, img, conv, x1, box->x1, j);
         }
     }
 
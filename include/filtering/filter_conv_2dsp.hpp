@@ -38,8 +38,9 @@ public:
      * @param data
      * @param n
      */
-    FilterConv2DSP(float *data, int n)
+    FilterConv2DSP(float *data, int n) : FilterNPasses()
     {
+        conv1DFltY = NULL;
         conv1DFltX = new FilterConv1D(data, n);
 
         insertFilter(conv1DFltX);
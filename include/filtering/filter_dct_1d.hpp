@@ -18,20 +18,25 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_DCT_1D_HPP
 #define PIC_FILTERING_FILTER_DCT_1D_HPP
 
+#include <vector>
+
 #include "../filtering/filter.hpp"
+#include "../util/dct.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterDCT1D class
+ * @brief The FilterDCT1D class computes the DCT of blocks of nCoeff pixels
+ * along a direction. Each block is transformed once with a DCTPlan, and
+ * the blocks of a bounding box are transformed together.
  */
 class FilterDCT1D: public Filter
 {
 protected:
     int     dirs[3];
-    float   *coeff, sqr[2];
     int     nCoeff;
     bool    bForward;
+    DCTPlan *plan;
 
     /**
      * @brief ProcessBBox
@@ -58,13 +63,6 @@ public:
     void setForward()
     {
         this->bForward = true;
-
-        if(coeff != NULL) {
-            delete[] coeff;
-            coeff = NULL;
-        }
-
-        coeff = createCoefficientsTransform(nCoeff);
     }
 
     /**
@@ -73,13 +71,6 @@ public:
     void setInverse()
     {
         this->bForward = false;
-
-        if(coeff != NULL) {
-            delete[] coeff;
-            coeff = NULL;
-        }
-
-        coeff = createCoefficientsInverse(nCoeff);
     }
 
     /**
@@ -167,17 +158,9 @@ public:
 
 PIC_INLINE FilterDCT1D::FilterDCT1D(int nCoeff, bool bForward)
 {
-    this->coeff = NULL;
     this->nCoeff = nCoeff;
-
-    if(bForward) {
-        setForward();
-    } else {
-        setInverse();
-    }
-
-    sqr[0] = sqrtf(1.0f / float(nCoeff));
-    sqr[1] = sqrtf(2.0f / float(nCoeff));
+    this->bForward = bForward;
+    this->plan = DCTPlan::get(nCoeff);
 
     dirs[0] = 1;
     dirs[1] = 0;
@@ -186,9 +169,6 @@ PIC_INLINE FilterDCT1D::FilterDCT1D(int nCoeff, bool bForward)
 
 PIC_INLINE FilterDCT1D::~FilterDCT1D()
 {
-    if(coeff != NULL) {
-        delete[] coeff;
-    }
 }
 
 PIC_INLINE void FilterDCT1D::changePass(int pass, int tPass)
@@ -223,46 +203,72 @@ PIC_INLINE void FilterDCT1D::changePass(int x, int y, int z)
 
 PIC_INLINE void FilterDCT1D::ProcessBBox(Image *dst, ImageVec src, BBox *box)
 {
+    if(plan == NULL) {
+        return;
+    }
+
     int channels = dst->channels;
 
     Image *source = src[0];
 
-    for(int m = box->z0; m < box->z1; m++) {
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-                float *tmpDst = (*dst)(i, j, m);
-
-                for(int l = 0; l < channels; l++) {
-                    tmpDst[l] = 0.0f;
-                }
-
-                int ind = (j * dirs[0] + i * dirs[1] + m * dirs[2]) % nCoeff;
-                int ind2 = ind * nCoeff;
-
-                for(int k = 0; k < nCoeff; k++) { //1D Filtering
-                    int k2 = k - ind;
-                    //Address cj
-                    int cj = j + k2 * dirs[0];
-                    //Address ci
-                    int ci = i + k2 * dirs[1];
-                    //Address cm
-                    int cm = m + k2 * dirs[2];
-
-                    float *tmpSource = (*source)(ci, cj, cm);
-
-                    float tmpCoeff = coeff[ind2];
-
-                    for(int l = 0; l < channels; l++) {
-                        tmpDst[l] += tmpSource[l] * tmpCoeff;
+    //lines of the box along the direction, and the range of the direction
+    int x0 = dirs[1] ? 0 : box->x0;
+    int x1 = dirs[1] ? 1 : box->x1;
+    int y0 = dirs[0] ? 0 : box->y0;
+    int y1 = dirs[0] ? 1 : box->y1;
+    int z0 = dirs[2] ? 0 : box->z0;
+    int z1 = dirs[2] ? 1 : box->z1;
+
+    int p0 = box->y0 * dirs[0] + box->x0 * dirs[1] + box->z0 * dirs[2];
+    int p1 = box->y1 * dirs[0] + box->x1 * dirs[1] + box->z1 * dirs[2];
+
+    //when x is not the direction, the pixels of a row are contiguous
+    int width = dirs[1] ? 1 : (x1 - x0);
+
+    int len = (x1 - x0) * (y1 - y0) * (z1 - z0) * channels;
+    std::vector< float > buffer(nCoeff * len);
+
+    //blocks are aligned to multiples of nCoeff; pixels outside the image
+    //are clamped as in the direct transform
+    for(int s = p0 - (p0 % nCoeff); s < p1; s += nCoeff) {
+        for(int k = 0; k < nCoeff; k++) {
+            int p = s + k;
+            float *line = &buffer[k * len];
+
+            for(int m = z0; m < z1; m++) {
+                for(int j = y0; j < y1; j++) {
+                    for(int i = x0; i < x1; i += width) {
+                        float *tmpSource = (*source)(i + p * dirs[1],
+                                                     j + p * dirs[0],
+                                                     m + p * dirs[2]);
+                        memcpy(line, tmpSource, sizeof(float) * width * channels);
+                        line += width * channels;
                     }
-
-                    ind2++;
                 }
+            }
+        }
+
+        if(bForward) {
+            plan->forward(&buffer[0], len, len);
+        } else {
+            plan->inverse(&buffer[0], len, len);
+        }
 
-                if(bForward) {
-                    int select = (ind == 0) ? 0 : 1;
-                    for(int l = 0; l < channels; l++) {
-                        tmpDst[l] *= sqr[select];
+        int k0 = MAX(p0 - s, 0);
+        int k1 = MIN(p1 - s, nCoeff);
+
+        for(int k = k0; k < k1; k++) {
+            int p = s + k;
+            float *line = &buffer[k * len];
+
+            for(int m = z0; m < z1; m++) {
+                for(int j = y0; j < y1; j++) {
+                    for(int i = x0; i < x1; i += width) {
+                        float *tmpDst = (*dst)(i + p * dirs[1],
+                                               j + p * dirs[0],
+                                               m + p * dirs[2]);
+                        memcpy(tmpDst, line, sizeof(float) * width * channels);
+                        line += width * channels;
                     }
                 }
             }
@@ -22,11 +22,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "../image.hpp"
 #include "../filtering/filter_conv_2d.hpp"
+#include "../algorithms/fft_convolution.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterDeconvolution class
+ * @brief The FilterDeconvolution class computes the Richardson-Lucy
+ * deconvolution of imgIn[0] with the PSF imgIn[1].
  */
 class FilterDeconvolution: public Filter
 {
@@ -36,9 +38,47 @@ protected:
     Image *img_err;
     Image *img_rel_blur;
     FilterConv2D *flt_conv;
+    FFTConvolution fft_psf, fft_psf_hat;
 
     int nIterations;
 
+    /**
+     * @brief ProcessFFT runs the iterations in the frequency domain; the
+     * spectra of psf and psf_hat are computed once, and the division and
+     * the multiplication of an iteration are fused into the inverse
+     * transforms.
+     * @param img
+     * @param psf
+     * @param imgOut
+     */
+    void ProcessFFT(Image *img, Image *psf, Image *imgOut)
+    {
+        fft_psf.setup(img->width, img->height, psf);
+        fft_psf_hat.setup(img->width, img->height, psf_hat);
+
+        float *in = img->data;
+        float *rel = img_rel_blur->data;
+        float *out = imgOut->data;
+
+        for(int i = 0; i < nIterations; i++) {
+
+            #ifdef PIC_DEBUG
+                printf("%d\n", i);
+            #endif
+
+            for(int c = 0; c < img->channels; c++) {
+                fft_psf.process(imgOut, c, [&](int x, int y, float value) {
+                    int ind = y * img->ystride + x * img->xstride + c;
+                    rel[ind] = in[ind] / value;
+                });
+
+                fft_psf_hat.process(img_rel_blur, c, [&](int x, int y, float value) {
+                    out[y * img->ystride + x * img->xstride + c] *= value;
+                });
+            }
+        }
+    }
+
 public:
 
     /**
@@ -79,6 +119,10 @@ public:
             return imgOut;
         }
 
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
         imgOut = setupAux(imgIn, imgOut);
 
         if (imgOut == NULL) {
@@ -102,6 +146,14 @@ public:
         *imgOut = 0.5f;
 
         img_rel_blur = allocateOutputMemory(imgIn, img_rel_blur, true);
+
+        if((imgIn[0]->frames == 1) && (psf->frames == 1) &&
+           imgIn[0]->isSimilarType(imgOut) &&
+           FFTConvolution::isFaster(imgIn[0]->width, imgIn[0]->height, psf)) {
+            ProcessFFT(imgIn[0], psf, imgOut);
+            return imgOut;
+        }
+
         img_est_conv = allocateOutputMemory(imgIn, img_est_conv, true);
         img_err = allocateOutputMemory(imgIn, img_err, true);
 
@@ -277,6 +277,10 @@ public:
             return NULL;
         }
 
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
         if((!imgIn[0]->isValid()) && (imgIn[0]->channels != 1)) {
             return imgOut;
         }
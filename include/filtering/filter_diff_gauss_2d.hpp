@@ -68,6 +68,10 @@ public:
      */
     Image *Process(ImageVec imgIn, Image *imgOut)
     {
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
         imgOut = filter_1->Process(imgIn, imgOut);
 
         //MEMORY-LEAK: to check
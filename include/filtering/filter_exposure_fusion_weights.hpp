@@ -34,48 +34,104 @@ protected:
     float mu, sigma_sq_2;
 
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief computeWeight
+     * @param pCon is the contrast.
+     * @param pCur1 is the color of the pixel.
+     * @param channels is the number of color channels.
+     * @return
+     */
+    inline float computeWeight(float pCon, float *pCur1, int channels)
+    {
+        //saturation
+        float pSat = computeSaturation(pCur1, channels);
+
+        //well-exposedness
+        float pExp = 0.0f;
+        for(int c = 0; c < channels; c++) {
+            float delta = pCur1[c] - mu;
+            pExp += delta * delta;
+        }
+        pExp = expf(-pExp / sigma_sq_2);
+
+        //final weights
+        float out = powf(pCon, wC) * powf(pExp, wE) * powf(pSat, wS) + 1e-12f;
+        return CLAMPi(out, 0.0f, 1.0f);
+    }
+
+    /**
+     * @brief f
+     * @param data
+     */
+    void f(FilterFData *data)
+    {
+        int i = data->x;
+        int j = data->y;
+
+        Image *src0 = data->src[0];
+        Image *src1 = data->src[1];
+
+        //contrast
+        float *pCur0  = (*src0)(i, j, data->z);
+        float *pCurN0 = (*src0)(i, j + 1, data->z);
+        float *pCurS0 = (*src0)(i, j - 1, data->z);
+        float *pCurE0 = (*src0)(i + 1, j, data->z);
+        float *pCurW0 = (*src0)(i - 1, j, data->z);
+
+        float pCon = fabsf(-4.0f * pCur0[0] +
+                pCurN0[0] + pCurS0[0] + pCurE0[0] + pCurW0[0]);
+
+        data->out[0] = computeWeight(pCon, (*src1)(i, j, data->z), src1->channels);
+    }
+
+    /**
+     * @brief fSpan
+     * @param data
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void fSpan(FilterSpanData *data)
     {
-        for(int j = box->y0; j < box->y1; j++) {
-
-            for(int i = box->x0; i < box->x1; i++) {
-
-                float *pCur0 = (*src[0])(i, j);
-                float *pCur1 = (*src[1])(i, j);
-
-                //saturation
-                float pSat = computeSaturation(pCur1, src[1]->channels);
-
-                //contrast
-                float *pCurN0 = (*src[0])(i, j + 1);
-                float *pCurS0 = (*src[0])(i, j - 1);
-                float *pCurE0 = (*src[0])(i + 1, j);
-                float *pCurW0 = (*src[0])(i - 1, j);
-
-                float pCon = fabsf(-4.0f * pCur0[0] +
-                        pCurN0[0] + pCurS0[0] + pCurE0[0] + pCurW0[0]);
-
-                //well-exposedness
-                float pExp = 0.0f;
-                for(int c = 0; c < src[1]->channels; c++) {
-                    float delta = pCur1[c] - mu;
-                    pExp += delta * delta;
-                }
-                pExp = expf(-pExp / sigma_sq_2);
-
-                //final weights
-                float *out = (*dst)(i, j);
-                out[0] = powf(pCon, wC) * powf(pExp, wE) * powf(pSat, wS) + 1e-12f;
-                out[0] = CLAMPi(out[0], 0.0f, 1.0f);
-            }
+        float *in0 = data->in[0];
+        float *in1 = data->in[1];
+
+        int xstride0 = data->src[0]->xstride;
+        int ystride0 = data->src[0]->ystride;
+        int channels1 = data->src[1]->channels;
+        int n = data->x1 - data->x0;
+
+        for(int i = 0; i < n; i++) {
+            float *pCur0 = &in0[i * xstride0];
+
+            //contrast
+            float pCon = fabsf(-4.0f * pCur0[0] +
+                    pCur0[ystride0] + pCur0[-ystride0] +
+                    pCur0[xstride0] + pCur0[-xstride0]);
+
+            data->out[i] = computeWeight(pCon, &in1[i * channels1], channels1);
         }
     }
 
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 1;
+        borderY = 1;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec & /*src*/)
+    {
+        return dst->channels == 1;
+    }
+
 public:
 
     /**
@@ -20,6 +20,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "../filtering/filter_conv_1d.hpp"
 #include "../util/precomputed_gaussian.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace pic {
 
@@ -32,6 +33,211 @@ protected:
     float               sigma;
     PrecomputedGaussian *pg;
     bool                bPgOwned;
+    bool                bRecursive;
+
+    /**
+     * @brief getRecursiveCoefficients computes the coefficients of the
+     * Young and van Vliet recursive Gaussian filter ("Recursive implementation
+     * of the Gaussian filter", Signal Processing, 1995).
+     * @param sigma is the standard deviation of the Gaussian; it has to be >= 0.5.
+     * @param B is the gain.
+     * @param c is an array of three feedback coefficients (b1, b2, b3 divided by b0).
+     * @param M is a 3x3 matrix (row-major) mapping the last three causal
+     * outputs to the three anti-causal outputs after the end of a line, when
+     * the line is extended by replicating its last sample. This is computed by
+     * running the filter on the extension (Triggs and Sdika, 2006).
+     */
+    static void getRecursiveCoefficients(float sigma, float &B, float *c, float *M)
+    {
+        double q;
+
+        if(sigma >= 2.5f) {
+            q = 0.98711 * double(sigma) - 0.96330;
+        } else {
+            q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * double(sigma));
+        }
+
+        double q2 = q * q;
+        double q3 = q2 * q;
+
+        double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        double b[3];
+        b[0] = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+        b[1] = -(1.4281 * q2 + 1.26661 * q3) / b0;
+        b[2] = (0.422205 * q3) / b0;
+        double Bd = 1.0 - (b[0] + b[1] + b[2]);
+
+        B = float(Bd);
+        for(int i = 0; i < 3; i++) {
+            c[i] = float(b[i]);
+        }
+
+        //the response of the extension, in deviation from the last sample,
+        //for each of the last three causal outputs
+        int n = MAX(int(sigma * 20.0f), 100);
+        std::vector< double > e(n + 3), f(n + 3);
+
+        for(int j = 0; j < 3; j++) {
+            std::fill(e.begin(), e.end(), 0.0);
+            e[2 - j] = 1.0;
+
+            for(int i = 3; i < (n + 3); i++) {
+                e[i] = b[0] * e[i - 1] + b[1] * e[i - 2] + b[2] * e[i - 3];
+            }
+
+            std::fill(f.begin(), f.end(), 0.0);
+
+            for(int i = n - 1; i >= 0; i--) {
+                f[i] = Bd * e[i + 3] + b[0] * f[i + 1] + b[1] * f[i + 2] + b[2] * f[i + 3];
+            }
+
+            for(int i = 0; i < 3; i++) {
+                M[i * 3 + j] = float(f[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief ProcessRecursiveLines filters m lines of length nSamples. Lines
+     * are contiguous in memory, and samples are stride floats apart.
+     * Borders are handled by replicating the first and the last sample.
+     * @param out is the output buffer; it can be in.
+     * @param in is the input buffer.
+     * @param nSamples is the number of samples of a line; it has to be >= 3.
+     * @param stride is the distance in floats between two samples.
+     * @param m is the number of contiguous lines.
+     * @param B is the gain.
+     * @param c are the feedback coefficients.
+     * @param M is the boundary matrix.
+     */
+    static void ProcessRecursiveLines(float *out, float *in, int nSamples,
+                                      int stride, int m, float B,
+                                      const float *c, const float *M)
+    {
+        std::vector< float > first(in, in + m);
+
+        float *in_last = in + (nSamples - 1) * stride;
+        std::vector< float > last(in_last, in_last + m);
+
+        //causal pass; the first sample is replicated before the line
+        for(int i = 0; i < nSamples; i++) {
+            float *o = out + i * stride;
+            float *x = in  + i * stride;
+
+            if(i > 2) {
+                float *o1 = o - stride;
+                float *o2 = o1 - stride;
+                float *o3 = o2 - stride;
+
+                for(int l = 0; l < m; l++) {
+                    o[l] = B * x[l] + c[0] * o1[l] + c[1] * o2[l] + c[2] * o3[l];
+                }
+            } else {
+                for(int l = 0; l < m; l++) {
+                    float w1 = (i > 0) ? o[l - stride]     : first[l];
+                    float w2 = (i > 1) ? o[l - 2 * stride] : first[l];
+                    o[l] = B * x[l] + c[0] * w1 + c[1] * w2 + c[2] * first[l];
+                }
+            }
+        }
+
+        //anti-causal outputs after the end of the line
+        std::vector< float > ext(3 * m);
+        float *o_last = out + (nSamples - 1) * stride;
+
+        for(int l = 0; l < m; l++) {
+            float d0 = o_last[l] - last[l];
+            float d1 = o_last[l - stride] - last[l];
+            float d2 = o_last[l - 2 * stride] - last[l];
+
+            for(int k = 0; k < 3; k++) {
+                ext[k * m + l] = last[l] + M[k * 3] * d0 + M[k * 3 + 1] * d1 + M[k * 3 + 2] * d2;
+            }
+        }
+
+        //anti-causal pass in-place
+        for(int i = nSamples - 1; i >= 0; i--) {
+            float *o = out + i * stride;
+
+            if(i < (nSamples - 3)) {
+                float *o1 = o + stride;
+                float *o2 = o1 + stride;
+                float *o3 = o2 + stride;
+
+                for(int l = 0; l < m; l++) {
+                    o[l] = B * o[l] + c[0] * o1[l] + c[1] * o2[l] + c[2] * o3[l];
+                }
+            } else {
+                int d = nSamples - 1 - i;
+
+                float *y[3];
+                for(int k = 0; k < 3; k++) {
+                    int t = k + 1 - d;
+                    y[k] = (t > 0) ? &ext[(t - 1) * m] : (o + (k + 1) * stride);
+                }
+
+                for(int l = 0; l < m; l++) {
+                    o[l] = B * o[l] + c[0] * y[0][l] + c[1] * y[1][l] + c[2] * y[2][l];
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief ProcessRecursive applies the recursive Gaussian filter
+     * along the current direction.
+     * @param imgIn
+     * @param imgOut
+     */
+    void ProcessRecursive(Image *imgIn, Image *imgOut)
+    {
+        float B, c[3], M[9];
+        getRecursiveCoefficients(sigma, B, c, M);
+
+        int nSamples = getRecursiveSamples(imgIn);
+        int stride;
+
+        if(dirs[1] == 1) {
+            stride = imgIn->xstride;
+        } else {
+            stride = (dirs[0] == 1) ? imgIn->ystride : imgIn->tstride;
+        }
+
+        //a group is a set of stride lines; groups are split
+        //in blocks of contiguous lines for the pool
+        int groupSize = nSamples * stride;
+        int nGroups = imgIn->size() / groupSize;
+
+        const int blockSize = 64;
+        int nBlocks = (stride + blockSize - 1) / blockSize;
+
+        float *in = imgIn->data;
+        float *out = imgOut->data;
+
+        ThreadPool::getInstance()->parallelFor(nGroups * nBlocks, [=](int index) {
+            int group = index / nBlocks;
+            int block = (index % nBlocks) * blockSize;
+
+            int m = MIN(blockSize, stride - block);
+            int offset = group * groupSize + block;
+
+            ProcessRecursiveLines(out + offset, in + offset, nSamples, stride, m, B, c, M);
+        });
+    }
+
+    /**
+     * @brief getRecursiveSamples
+     * @param img
+     * @return It returns the number of samples along the current direction.
+     */
+    int getRecursiveSamples(Image *img)
+    {
+        if(dirs[1] == 1) {
+            return img->width;
+        } else {
+            return (dirs[0] == 1) ? img->height : img->frames;
+        }
+    }
 
 public:
     /**
@@ -43,8 +249,10 @@ public:
      * @brief FilterGaussian1D
      * @param sigma
      * @param direction
+     * @param bRecursive enables the recursive (IIR) approximation of the
+     * Gaussian filter, whose cost per pixel does not depend on sigma.
      */
-    FilterGaussian1D(float sigma, int direction);
+    FilterGaussian1D(float sigma, int direction, bool bRecursive);
 
     /**
      * @brief FilterGaussian1D
@@ -65,7 +273,7 @@ public:
         if(this->sigma != sigma) {
             this->sigma = sigma;
 
-            if(pg != NULL) {
+            if(pg != NULL && bPgOwned) {
                 delete pg;
             }
 
@@ -76,24 +284,82 @@ public:
         FilterConv1D::update(pg->coeff, pg->kernelSize, direction);
     }
 
+    /**
+     * @brief setRecursive enables or disables the recursive (IIR) approximation
+     * of the Gaussian filter. This is used for sigma >= 0.5 only.
+     * @param bRecursive
+     */
+    void setRecursive(bool bRecursive)
+    {
+        this->bRecursive = bRecursive;
+    }
+
+    /**
+     * @brief getKernel
+     * @param kernel
+     * @param kernelSize
+     * @return This function returns false when the recursive filter is used.
+     */
+    bool getKernel(float *&kernel, int &kernelSize)
+    {
+        if(bRecursive && (sigma >= 0.5f)) {
+            return false;
+        }
+
+        return FilterConv1D::getKernel(kernel, kernelSize);
+    }
+
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut)
+    {
+        if(!checkInput(imgIn)) {
+            return imgOut;
+        }
+
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
+        if(!bRecursive || (sigma < 0.5f) || (getRecursiveSamples(imgIn[0]) < 3)) {
+            return FilterConv1D::Process(imgIn, imgOut);
+        }
+
+        imgOut = setupAux(imgIn, imgOut);
+
+        if(imgOut == NULL) {
+            return imgOut;
+        }
+
+        ProcessRecursive(imgIn[0], imgOut);
+
+        return imgOut;
+    }
+
     /**
      * @brief execute
      * @param imgIn
      * @param imgOut
      * @param sigma
      * @param direction
+     * @param bRecursive
      * @return
      */
     static Image *execute(Image *imgIn, Image *imgOut, float sigma,
-                             int direction)
+                             int direction, bool bRecursive = false)
     {
-        FilterGaussian1D filter(sigma, direction);
+        FilterGaussian1D filter(sigma, direction, bRecursive);
         return filter.Process(Single(imgIn), imgOut);
     }
 };
 
 PIC_INLINE FilterGaussian1D::FilterGaussian1D()
 {
+    bRecursive = false;
     sigma = 1.0f;
     pg = new PrecomputedGaussian(sigma);
 
@@ -101,8 +367,10 @@ PIC_INLINE FilterGaussian1D::FilterGaussian1D()
     FilterConv1D::update(pg->coeff, pg->kernelSize, 0);
 }
 
-PIC_INLINE FilterGaussian1D::FilterGaussian1D(float sigma, int direction = 0)
+PIC_INLINE FilterGaussian1D::FilterGaussian1D(float sigma, int direction = 0,
+                                              bool bRecursive = false)
 {
+    this->bRecursive = bRecursive;
     this->sigma = sigma;
     pg = new PrecomputedGaussian(sigma);
 
@@ -112,6 +380,10 @@ PIC_INLINE FilterGaussian1D::FilterGaussian1D(float sigma, int direction = 0)
 
 PIC_INLINE FilterGaussian1D::FilterGaussian1D(PrecomputedGaussian *pg, int direction = 0)
 {
+    bRecursive = false;
+    bPgOwned = false;
+    this->pg = pg;
+
     if(pg == NULL) {
         #ifdef PICE_DEBUG
             printf("Error no precomputed gaussian values.\n");
@@ -119,7 +391,7 @@ PIC_INLINE FilterGaussian1D::FilterGaussian1D(PrecomputedGaussian *pg, int direc
         return;
     }
 
-    bPgOwned = false;
+    sigma = pg->sigma;
 
     FilterConv1D::update(pg->coeff, pg->kernelSize, direction);
 }
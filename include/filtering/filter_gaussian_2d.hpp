@@ -49,10 +49,12 @@ public:
     /**
      * @brief FilterGaussian2D
      * @param sigma
+     * @param bRecursive enables the recursive (IIR) approximation of
+     * the Gaussian filter; its cost does not depend on sigma.
      */
-    FilterGaussian2D(float sigma) : FilterNPasses()
+    FilterGaussian2D(float sigma, bool bRecursive = false) : FilterNPasses()
     {
-        filter = new FilterGaussian1D(sigma);
+        filter = new FilterGaussian1D(sigma, 0, bRecursive);
 
         insertFilter(filter);
         insertFilter(filter);
@@ -74,16 +76,26 @@ public:
         filter->update(sigma, 0);
     }
 
+    /**
+     * @brief setRecursive
+     * @param bRecursive
+     */
+    void setRecursive(bool bRecursive)
+    {
+        filter->setRecursive(bRecursive);
+    }
+
     /**
      * @brief execute
      * @param imgIn
      * @param imgOut
      * @param sigma
+     * @param bRecursive
      * @return
      */
-    static Image *execute(Image *imgIn, Image *imgOut, float sigma)
+    static Image *execute(Image *imgIn, Image *imgOut, float sigma, bool bRecursive = false)
     {
-        FilterGaussian2D filter(sigma);
+        FilterGaussian2D filter(sigma, bRecursive);
         return filter.Process(Single(imgIn), imgOut);
     }
 };
@@ -42,11 +42,13 @@ public:
     /**
      * @brief FilterGaussian3D
      * @param sigma
+     * @param bRecursive enables the recursive (IIR) approximation of
+     * the Gaussian filter; its cost does not depend on sigma.
      */
-    FilterGaussian3D(float sigma)
+    FilterGaussian3D(float sigma, bool bRecursive = false)
     {
         //Gaussian filter
-        gaussianFilter = new FilterGaussian1D(sigma);
+        gaussianFilter = new FilterGaussian1D(sigma, 0, bRecursive);
 
         insertFilter((Filter *)gaussianFilter);
         insertFilter((Filter *)gaussianFilter);
@@ -65,11 +67,12 @@ public:
      * @param imgIn
      * @param imgOut
      * @param sigma
+     * @param bRecursive
      * @return
      */
-    static Image *execute(Image *imgIn, Image *imgOut, float sigma)
+    static Image *execute(Image *imgIn, Image *imgOut, float sigma, bool bRecursive = false)
     {
-        FilterGaussian3D filter(sigma);
+        FilterGaussian3D filter(sigma, bRecursive);
         Image *ret = filter.Process(Single(imgIn), imgOut);
         return ret;
     }
@@ -0,0 +1,570 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_FILTERING_FILTER_GRAPH_HPP
+#define PIC_FILTERING_FILTER_GRAPH_HPP
+
+#include <atomic>
+#include <vector>
+
+#include "../util/std_util.hpp"
+#include "../util/thread_pool.hpp"
+
+#include "../filtering/filter.hpp"
+
+namespace pic {
+
+/**
+ * @brief FILTER_GRAPH_SPAN is the number of pixels of a row processed
+ * at once by a fused group of pointwise filters.
+ */
+#ifndef FILTER_GRAPH_SPAN
+#define FILTER_GRAPH_SPAN 256
+#endif
+
+/**
+ * @brief The FilterGraph class records a DAG of filters and evaluates it
+ * lazily. Consecutive pointwise filters (see Filter::isPointwise) are fused
+ * into a single sweep over the image, where intermediate results live in
+ * small per-thread row buffers; images are materialized only at the output
+ * of non-pointwise filters, at requested outputs, and when a result is used
+ * by more than one filter. Materialized intermediates are recycled as soon
+ * as their last consumer has been processed.
+ * The graph does not own filters and inputs; outputs belong to the caller.
+ */
+class FilterGraph
+{
+protected:
+
+    /**
+     * @brief The Node struct is a node of the graph.
+     */
+    struct Node
+    {
+        Filter *flt;
+        std::vector<int> in;
+        Image *img, *header;
+        bool bOutput;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Image *> pool;
+
+    /**
+     * @brief allocateHeader allocates an image without data; it describes
+     * the size of a fused intermediate result.
+     * @param frames
+     * @param width
+     * @param height
+     * @param channels
+     * @return
+     */
+    static Image *allocateHeader(int frames, int width, int height, int channels)
+    {
+        Image *header = new Image();
+        header->frames = frames;
+        header->width = width;
+        header->height = height;
+        header->channels = channels;
+        header->allocateAux();
+        return header;
+    }
+
+    /**
+     * @brief isSameSize
+     * @param a
+     * @param b
+     * @return
+     */
+    static bool isSameSize(Image *a, Image *b)
+    {
+        return (a->width == b->width) && (a->height == b->height) &&
+               (a->frames == b->frames);
+    }
+
+    /**
+     * @brief acquire returns an image from the recycled ones, or a new one.
+     * @param header
+     * @return
+     */
+    Image *acquire(Image *header);
+
+    /**
+     * @brief isPointwise checks if a node can be computed in spans.
+     * @param i
+     * @return
+     */
+    bool isPointwise(int i);
+
+    /**
+     * @brief ProcessGroup evaluates a group of fused pointwise nodes.
+     * @param members are the nodes of the group in topological order;
+     * the last one is the root, which is materialized.
+     * @param slot maps nodes to their position in members (-1 if outside).
+     */
+    void ProcessGroup(std::vector<int> &members, std::vector<int> &slot);
+
+public:
+
+    /**
+     * @brief FilterGraph
+     */
+    FilterGraph()
+    {
+    }
+
+    ~FilterGraph()
+    {
+        release();
+    }
+
+    /**
+     * @brief release removes all nodes; outputs are not deallocated.
+     */
+    void release()
+    {
+        for(unsigned int i = 0; i < nodes.size(); i++) {
+            if(nodes[i].flt != NULL) {
+                nodes[i].header = delete_s(nodes[i].header);
+            }
+        }
+
+        nodes.clear();
+    }
+
+    /**
+     * @brief insertInput adds an input image to the graph.
+     * @param img
+     * @return It returns the index of the node.
+     */
+    int insertInput(Image *img);
+
+    /**
+     * @brief insertFilter adds a filter to the graph.
+     * @param flt
+     * @param in are the indices of the input nodes.
+     * @return It returns the index of the node.
+     */
+    int insertFilter(Filter *flt, std::vector<int> in);
+
+    /**
+     * @brief insertFilter adds a filter to the graph.
+     * @param flt
+     * @param in0 is the index of the first input node.
+     * @param in1 is the index of the second input node; -1 if there is none.
+     * @return It returns the index of the node.
+     */
+    int insertFilter(Filter *flt, int in0, int in1 = -1)
+    {
+        std::vector<int> in;
+        in.push_back(in0);
+
+        if(in1 >= 0) {
+            in.push_back(in1);
+        }
+
+        return insertFilter(flt, in);
+    }
+
+    /**
+     * @brief setOutput marks a node as an output of the graph.
+     * @param i is the index of the node.
+     * @param imgOut is the image where to store the result; if it is NULL
+     * or it has a different size, an image is allocated.
+     */
+    void setOutput(int i, Image *imgOut = NULL)
+    {
+        if((i >= 0) && (i < int(nodes.size())) && (nodes[i].flt != NULL)) {
+            nodes[i].bOutput = true;
+            nodes[i].img = imgOut;
+        }
+    }
+
+    /**
+     * @brief getOutput
+     * @param i is the index of an output node.
+     * @return It returns the result of the node after Process.
+     */
+    Image *getOutput(int i)
+    {
+        if((i >= 0) && (i < int(nodes.size())) && nodes[i].bOutput) {
+            return nodes[i].img;
+        } else {
+            return NULL;
+        }
+    }
+
+    /**
+     * @brief Process evaluates the nodes needed by the outputs.
+     * @return It returns true if the graph was evaluated.
+     */
+    bool Process();
+
+    /**
+     * @brief execute runs a chain of single input filters.
+     * @param imgIn
+     * @param imgOut
+     * @param chain
+     * @return
+     */
+    static Image *execute(Image *imgIn, Image *imgOut, std::vector<Filter *> chain)
+    {
+        FilterGraph graph;
+        int node = graph.insertInput(imgIn);
+
+        for(unsigned int i = 0; i < chain.size(); i++) {
+            node = graph.insertFilter(chain[i], node);
+        }
+
+        graph.setOutput(node, imgOut);
+
+        if(graph.Process()) {
+            return graph.getOutput(node);
+        } else {
+            return imgOut;
+        }
+    }
+};
+
+PIC_INLINE int FilterGraph::insertInput(Image *img)
+{
+    if(img == NULL) {
+        return -1;
+    }
+
+    Node node;
+    node.flt = NULL;
+    node.img = img;
+    node.header = img;
+    node.bOutput = false;
+
+    nodes.push_back(node);
+    return int(nodes.size()) - 1;
+}
+
+PIC_INLINE int FilterGraph::insertFilter(Filter *flt, std::vector<int> in)
+{
+    if((flt == NULL) || in.empty()) {
+        return -1;
+    }
+
+    for(unsigned int i = 0; i < in.size(); i++) {
+        if((in[i] < 0) || (in[i] >= int(nodes.size()))) {
+            return -1;
+        }
+    }
+
+    Node node;
+    node.flt = flt;
+    node.in = in;
+    node.img = NULL;
+    node.header = NULL;
+    node.bOutput = false;
+
+    nodes.push_back(node);
+    return int(nodes.size()) - 1;
+}
+
+PIC_INLINE Image *FilterGraph::acquire(Image *header)
+{
+    for(unsigned int i = 0; i < pool.size(); i++) {
+        Image *img = pool[i];
+
+        if(isSameSize(img, header) && (img->channels == header->channels)) {
+            pool.erase(pool.begin() + i);
+            return img;
+        }
+    }
+
+    return new Image(header->frames, header->width, header->height,
+                     header->channels);
+}
+
+PIC_INLINE bool FilterGraph::isPointwise(int i)
+{
+    Node &node = nodes[i];
+
+    if((node.flt == NULL) || !node.flt->isPointwise()) {
+        return false;
+    }
+
+    //inputs have to match the size and the channels read by the spans
+    ImageVec headers;
+    for(unsigned int j = 0; j < node.in.size(); j++) {
+        headers.push_back(nodes[node.in[j]].header);
+    }
+
+    return node.flt->checkSpanInput(node.header, headers);
+}
+
+PIC_INLINE void FilterGraph::ProcessGroup(std::vector<int> &members,
+        std::vector<int> &slot)
+{
+    int root = members.back();
+    Image *dst = nodes[root].img;
+    int nMembers = int(members.size());
+    int nRows = dst->height * dst->frames;
+
+    ThreadPool *pool_t = ThreadPool::getInstance();
+    int nLanes = MIN(nRows, pool_t->getNumberOfThreads());
+
+    std::atomic<int> next(0);
+
+    //a compact root is written in a float row buffer, and then demoted
+    bool bCompact = dst->isCompact();
+
+    pool_t->parallelFor(nLanes, [&](int /*lane*/) {
+        //row buffers of intermediate results
+        std::vector< std::vector< float > > buf(nMembers);
+        std::vector< float > bufOut;
+
+        if(bCompact) {
+            bufOut.resize(FILTER_GRAPH_SPAN * dst->channels);
+        }
+        std::vector< FilterSpanData > s_data(nMembers);
+
+        //spans of compact inputs promoted to float
+        std::vector< std::vector< float > > bufIn(nodes.size());
+
+        for(int m = 0; m < nMembers; m++) {
+            Node &node = nodes[members[m]];
+
+            if(m < (nMembers - 1)) {
+                buf[m].resize(FILTER_GRAPH_SPAN * node.header->channels);
+            }
+
+            s_data[m].dst = (m < (nMembers - 1)) ? node.header : dst;
+            s_data[m].nSrc = int(node.in.size());
+            s_data[m].in.resize(node.in.size());
+
+            for(unsigned int l = 0; l < node.in.size(); l++) {
+                int k = node.in[l];
+                s_data[m].src.push_back(slot[k] >= 0 ? nodes[k].header : nodes[k].img);
+            }
+        }
+
+        while(true) {
+            int row = next++;
+
+            if(row >= nRows) {
+                break;
+            }
+
+            int z = row / dst->height;
+            int j = row % dst->height;
+
+            for(int x0 = 0; x0 < dst->width; x0 += FILTER_GRAPH_SPAN) {
+                int x1 = MIN(x0 + FILTER_GRAPH_SPAN, dst->width);
+
+                for(int m = 0; m < nMembers; m++) {
+                    Node &node = nodes[members[m]];
+                    FilterSpanData *data = &s_data[m];
+
+                    data->x0 = x0;
+                    data->x1 = x1;
+                    data->y = j;
+                    data->z = z;
+
+                    for(unsigned int l = 0; l < node.in.size(); l++) {
+                        int k = node.in[l];
+
+                        if(slot[k] >= 0) {
+                            data->in[l] = &buf[slot[k]][0];
+                        } else {
+                            data->in[l] = Filter::getSpan(nodes[k].img, x0, x1, j, z, bufIn[k]);
+                        }
+                    }
+
+                    if(m < (nMembers - 1)) {
+                        data->out = &buf[m][0];
+                    } else if(bCompact) {
+                        data->out = &bufOut[0];
+                    } else {
+                        data->out = dst->data + z * dst->tstride +
+                                    j * dst->ystride + x0 * dst->xstride;
+                    }
+
+                    node.flt->ProcessSpan(data);
+                }
+
+                if(bCompact) {
+                    dst->demoteSpan(z * dst->tstride + j * dst->ystride + x0 * dst->xstride,
+                                    (x1 - x0) * dst->channels, &bufOut[0]);
+                }
+            }
+        }
+    });
+}
+
+PIC_INLINE bool FilterGraph::Process()
+{
+    int n = int(nodes.size());
+
+    //nodes needed by the outputs; inputs of a node have lower indices
+    std::vector<bool> needed(n, false);
+    bool bOutput = false;
+
+    for(int i = (n - 1); i >= 0; i--) {
+        if(nodes[i].bOutput) {
+            needed[i] = true;
+            bOutput = true;
+        }
+
+        if(needed[i]) {
+            for(unsigned int j = 0; j < nodes[i].in.size(); j++) {
+                needed[nodes[i].in[j]] = true;
+            }
+        }
+    }
+
+    if(!bOutput) {
+        return false;
+    }
+
+    //output sizes
+    for(int i = 0; i < n; i++) {
+        Node &node = nodes[i];
+
+        if(!needed[i] || (node.flt == NULL)) {
+            continue;
+        }
+
+        ImageVec headers;
+        for(unsigned int j = 0; j < node.in.size(); j++) {
+            headers.push_back(nodes[node.in[j]].header);
+        }
+
+        int width, height, channels, frames;
+        node.flt->OutputSize(headers, width, height, channels, frames);
+
+        node.header = delete_s(node.header);
+        node.header = allocateHeader(frames, width, height, channels);
+    }
+
+    //consumers
+    std::vector<int> nConsumers(n, 0), consumer(n, -1);
+    for(int i = 0; i < n; i++) {
+        if(needed[i]) {
+            for(unsigned int j = 0; j < nodes[i].in.size(); j++) {
+                int k = nodes[i].in[j];
+                nConsumers[k]++;
+                consumer[k] = i;
+            }
+        }
+    }
+
+    //a pointwise node is fused into its consumer when it is its only
+    //consumer and it is pointwise as well
+    std::vector<bool> bFused(n, false);
+    std::vector<bool> bPointwise(n, false);
+    for(int i = 0; i < n; i++) {
+        bPointwise[i] = needed[i] && isPointwise(i);
+    }
+
+    for(int i = 0; i < n; i++) {
+        bFused[i] = bPointwise[i] && !nodes[i].bOutput &&
+                    (nConsumers[i] == 1) && bPointwise[consumer[i]] &&
+                    isSameSize(nodes[i].header, nodes[consumer[i]].header);
+    }
+
+    std::vector<int> root(n, -1);
+    for(int i = (n - 1); i >= 0; i--) {
+        root[i] = bFused[i] ? root[consumer[i]] : i;
+    }
+
+    //liveness of materialized results
+    std::vector<int> lastUse(n, -1);
+    for(int i = 0; i < n; i++) {
+        if(!needed[i] || bFused[i]) {
+            continue;
+        }
+
+        for(int k = 0; k < n; k++) {
+            if(needed[k] && (root[k] == i)) {
+                for(unsigned int j = 0; j < nodes[k].in.size(); j++) {
+                    int l = nodes[k].in[j];
+
+                    if(!bFused[l]) {
+                        lastUse[l] = MAX(lastUse[l], i);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<int> slot(n, -1);
+
+    for(int i = 0; i < n; i++) {
+        Node &node = nodes[i];
+
+        if(!needed[i] || (node.flt == NULL) || bFused[i]) {
+            continue;
+        }
+
+        if(node.img != NULL) {
+            if(!isSameSize(node.img, node.header) ||
+               (node.img->channels != node.header->channels)) {
+                node.img = NULL;
+            }
+        }
+
+        if(node.img == NULL) {
+            node.img = acquire(node.header);
+        }
+
+        if(bPointwise[i]) {
+            std::vector<int> members;
+            for(int k = 0; k <= i; k++) {
+                if(needed[k] && (root[k] == i)) {
+                    slot[k] = (k < i) ? int(members.size()) : -1;
+                    members.push_back(k);
+                }
+            }
+
+            ProcessGroup(members, slot);
+
+            for(unsigned int k = 0; k < members.size(); k++) {
+                slot[members[k]] = -1;
+            }
+        } else {
+            ImageVec imgIn;
+            for(unsigned int j = 0; j < node.in.size(); j++) {
+                imgIn.push_back(nodes[node.in[j]].img);
+            }
+
+            node.img = node.flt->Process(imgIn, node.img);
+        }
+
+        //recycling results which are not needed anymore
+        for(int k = 0; k < i; k++) {
+            if((lastUse[k] == i) && (nodes[k].flt != NULL) &&
+               !nodes[k].bOutput && (nodes[k].img != NULL)) {
+                pool.push_back(nodes[k].img);
+                nodes[k].img = NULL;
+            }
+        }
+    }
+
+    stdVectorClear<Image>(pool);
+
+    return true;
+}
+
+} // end namespace pic
+
+#endif /* PIC_FILTERING_FILTER_GRAPH_HPP */
+
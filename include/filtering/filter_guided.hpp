@@ -18,6 +18,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_GUIDED_HPP
 #define PIC_FILTERING_FILTER_GUIDED_HPP
 
+#include <vector>
+
 #include "../filtering/filter.hpp"
 
 #include "../util/array.hpp"
@@ -25,24 +27,69 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../util/matrix_3_x_3.hpp"
 
 #include "../filtering/filter_guided_a_b.hpp"
+#include "../filtering/filter_box_mean.hpp"
+#include "../filtering/filter_downsampler_2d.hpp"
 
 #include "../util/math.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterGuided class
+ * @brief The FilterGuided class. The coefficients a and b are computed
+ * by FilterGuidedAB, and they are averaged with FilterBoxMean. In the fast
+ * mode (He and Sun), a and b are computed on I and p subsampled by a
+ * factor, and they are interpolated bilinearly at each pixel.
  */
 class FilterGuided: public Filter
 {
 protected:
 
-    int radius;
-    float e_regularization, nPixels;
+    int radius, subsample;
+    float e_regularization, nPixels, scaleX, scaleY;
     Image *img_a_b;
 
     FilterGuidedAB flt;
 
+    /**
+     * @brief getMeanAB
+     * @param i
+     * @param j
+     * @param buffer
+     * @return It returns the mean of a and b at pixel (i, j); in the fast
+     * mode, the coarse grid is interpolated in buffer.
+     */
+    inline float *getMeanAB(int i, int j, float *buffer)
+    {
+        if(subsample == 1) {
+            return (*img_a_b)(i, j);
+        }
+
+        //pixel centers of the image and of the coarse grid are aligned
+        float x = (float(i) + 0.5f) * scaleX - 0.5f;
+        float y = (float(j) + 0.5f) * scaleY - 0.5f;
+
+        x = CLAMPi(x, 0.0f, img_a_b->width1f);
+        y = CLAMPi(y, 0.0f, img_a_b->height1f);
+
+        int x0 = int(x);
+        int y0 = int(y);
+        float dx = x - float(x0);
+        float dy = y - float(y0);
+
+        float *v00 = (*img_a_b)(x0, y0);
+        float *v10 = (*img_a_b)(x0 + 1, y0);
+        float *v01 = (*img_a_b)(x0, y0 + 1);
+        float *v11 = (*img_a_b)(x0 + 1, y0 + 1);
+
+        for(int c = 0; c < img_a_b->channels; c++) {
+            float v0 = v00[c] + (v10[c] - v00[c]) * dx;
+            float v1 = v01[c] + (v11[c] - v01[c]) * dx;
+            buffer[c] = v0 + (v1 - v0) * dy;
+        }
+
+        return buffer;
+    }
+
     /**
      * @brief Process1Channel
      * @param I
@@ -61,6 +108,12 @@ protected:
      */
     void Process3Channel(Image *I, Image *p, Image *q, BBox *box);
 
+    /**
+     * @brief getAB computes the mean of a and b for each pixel.
+     * @param imgIn
+     */
+    void getAB(ImageVec imgIn);
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -76,6 +129,7 @@ public:
      */
     FilterGuided() : Filter()
     {
+        img_a_b = NULL;
         update(5, 0.01f);
     }
 
@@ -83,18 +137,27 @@ public:
      * @brief FilterGuided
      * @param radius
      * @param e_regularization
+     * @param subsample is the subsampling factor of the fast mode; the
+     * fast mode is disabled if it is 1.
      */
-    FilterGuided(int radius, float e_regularization) : Filter()
+    FilterGuided(int radius, float e_regularization, int subsample = 1) : Filter()
+    {
+        img_a_b = NULL;
+        update(radius, e_regularization, subsample);
+    }
+
+    ~FilterGuided()
     {
-        update(radius, e_regularization);
+        img_a_b = delete_s(img_a_b);
     }
 
     /**
      * @brief update
      * @param radius
      * @param e_regularization
+     * @param subsample
      */
-    void update(int radius, float e_regularization);
+    void update(int radius, float e_regularization, int subsample = 1);
 
     /**
      * @brief FilterGuided::Process
@@ -111,39 +174,37 @@ public:
      * @param imgOut
      * @param radius
      * @param e_regularization
+     * @param subsample
      * @return
      */
     static Image *execute(Image *imgIn, Image *guide, Image *imgOut,
-                             int radius, float e_regularization)
+                             int radius, float e_regularization,
+                             int subsample = 1)
     {
-        FilterGuided filter(radius, e_regularization);
+        FilterGuided filter(radius, e_regularization, subsample);
         return filter.Process(Double(imgIn, guide), imgOut);
     }
 };
 
-PIC_INLINE void FilterGuided::update(int radius, float e_regularization)
+PIC_INLINE void FilterGuided::update(int radius, float e_regularization, int subsample)
 {
-    img_a_b = NULL;
-
-    this->radius = radius;
+    this->radius = MAX(radius, 1);
     this->e_regularization = e_regularization;
-    nPixels = float(radius * radius * 4);
-
-    flt.update(radius, e_regularization);
+    this->subsample = MAX(subsample, 1);
+    nPixels = float(this->radius * this->radius * 4);
 }
 
 PIC_INLINE void FilterGuided::Process1Channel(Image *I, Image *p, Image *q,
                                    BBox *box)
 {
-    float *a_b_mean = new float[img_a_b->channels];
+    std::vector< float > bufferVec(img_a_b->channels);
+    float *buffer = &bufferVec[0];
 
     for(int j = box->y0; j < box->y1; j++) {
         for(int i = box->x0; i < box->x1; i++) {
             float *tmpQ = (*q)(i, j);
             float *tmpI = (*I)(i, j);
-
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
-            img_a_b->getMeanVal(&tmpBox, a_b_mean);
+            float *a_b_mean = getMeanAB(i, j, buffer);
 
             for(int c = 0; c < p->channels; c++) {
                 int index = c << 1;
@@ -153,14 +214,13 @@ PIC_INLINE void FilterGuided::Process1Channel(Image *I, Image *p, Image *q,
             }
         }
     }
-
-    delete[] a_b_mean;
 }
 
 PIC_INLINE void FilterGuided::Process3Channel(Image *I, Image *p,
         Image *q, BBox *box)
 {
-    float *a_b_mean = new float[img_a_b->channels];
+    std::vector< float > bufferVec(img_a_b->channels);
+    float *buffer = &bufferVec[0];
 
     int shift = I->channels + 1;
 
@@ -168,9 +228,7 @@ PIC_INLINE void FilterGuided::Process3Channel(Image *I, Image *p,
         for(int i = box->x0; i < box->x1; i++) {
             float *tmpQ = (*q)(i, j);
             float *tmpI = (*I)(i, j);
-
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
-            img_a_b->getMeanVal(&tmpBox, a_b_mean);
+            float *a_b_mean = getMeanAB(i, j, buffer);
 
             for(int c = 0; c < p->channels; c++) {
 
@@ -185,7 +243,6 @@ PIC_INLINE void FilterGuided::Process3Channel(Image *I, Image *p,
 
         }
     }
-    delete[] a_b_mean;
 }
 
 PIC_INLINE void FilterGuided::ProcessBBox(Image *dst, ImageVec src,
@@ -219,17 +276,59 @@ PIC_INLINE Image *FilterGuided::Process(ImageVec imgIn, Image *imgOut)
         return imgOut;
     }
 
+    if(hasCompact(imgIn, imgOut)) {
+        return ProcessCompact(imgIn, imgOut);
+    }
+
     imgOut = setupAux(imgIn, imgOut);
 
     if(imgOut == NULL) {
         return imgOut;
     }
 
-    img_a_b = flt.Process(imgIn, img_a_b);
+    getAB(imgIn);
 
     return ProcessP(imgIn, imgOut);
 }
 
+PIC_INLINE void FilterGuided::getAB(ImageVec imgIn)
+{
+    if(subsample == 1) {
+        flt.update(radius, e_regularization);
+        img_a_b = flt.Process(imgIn, img_a_b);
+        FilterBoxMean::execute(img_a_b, img_a_b, radius, radius - 1);
+        return;
+    }
+
+    //fast mode: a and b are computed on a coarse grid, and they are
+    //interpolated by getMeanAB
+    int width = imgIn[0]->width;
+    int height = imgIn[0]->height;
+    int width_s = MAX(width / subsample, 1);
+    int height_s = MAX(height / subsample, 1);
+    int radius_s = MAX(radius / subsample, 1);
+
+    scaleX = float(width_s) / float(width);
+    scaleY = float(height_s) / float(height);
+
+    ImageVec imgIn_s;
+    for(unsigned int i = 0; i < imgIn.size(); i++) {
+        Image *tmp = NULL;
+
+        if(imgIn[i] != NULL) {
+            tmp = FilterDownSampler2D::execute(imgIn[i], NULL, width_s, height_s);
+        }
+
+        imgIn_s.push_back(tmp);
+    }
+
+    flt.update(radius_s, e_regularization);
+    img_a_b = flt.Process(imgIn_s, img_a_b);
+    FilterBoxMean::execute(img_a_b, img_a_b, radius_s, radius_s - 1);
+
+    stdVectorClear<Image>(imgIn_s);
+}
+
 } // end namespace pic
 
 #endif /* PIC_FILTERING_FILTER_GUIDED_HPP */
@@ -18,18 +18,29 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_GUIDED_A_B_HPP
 #define PIC_FILTERING_FILTER_GUIDED_A_B_HPP
 
-#include "../filtering/filter.hpp"
-
-#include "../util/array.hpp"
+#include <vector>
 
-#include "../util/matrix_3_x_3.hpp"
+#include "../filtering/filter.hpp"
 
 #include "../util/math.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterGuidedAB class
+ * @brief FILTER_GUIDED_A_B_ROWS is the number of rows processed by a task
+ * in FilterGuidedAB.
+ */
+#ifndef FILTER_GUIDED_A_B_ROWS
+#define FILTER_GUIDED_A_B_ROWS 64
+#endif
+
+/**
+ * @brief The FilterGuidedAB class computes the coefficients a and b of
+ * the guided filter in windows of 2 * radius x 2 * radius pixels. Means,
+ * variances, and covariances are computed from sliding box means of I, p,
+ * and of their products, so the cost per pixel does not depend on the
+ * radius. Products and sums are kept in double: with HDR values, the
+ * variance E[I * I] - E[I]^2 cancels catastrophically in float.
  */
 class FilterGuidedAB: public Filter
 {
@@ -39,30 +50,46 @@ protected:
     float e_regularization, nPixels;
 
     /**
-     * @brief Process1Channel
+     * @brief getStatistics computes a row of the statistics whose box means
+     * are needed: I, the products I_n * I_m with n <= m, p, and the products
+     * I_n * p_c.
      * @param I
      * @param p
-     * @param q
-     * @param box
+     * @param y is the row; it is clamped.
+     * @param f is the frame.
+     * @param out
      */
-    void Process1Channel(Image *I, Image *p, Image *q, BBox *box);
+    void getStatistics(Image *I, Image *p, int y, int f, double *out);
 
     /**
-     * @brief Process3Channel
+     * @brief getRowSum computes the sums of the statistics of a row in the
+     * window [x - radius, x + radius - 1], where x is clamped.
      * @param I
      * @param p
-     * @param q
-     * @param box
+     * @param y
+     * @param f
+     * @param stats is a buffer of a row of statistics.
+     * @param out
      */
-    void Process3Channel(Image *I, Image *p, Image *q, BBox *box);
+    void getRowSum(Image *I, Image *p, int y, int f, double *stats, double *out);
 
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief Process1Channel computes a and b for a row.
+     * @param s are the box means of the statistics of the row.
+     * @param nP is the number of channels of p.
+     * @param q is the output row.
+     * @param width
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box);
+    void Process1Channel(double *s, int nP, float *q, int width);
+
+    /**
+     * @brief Process3Channel computes a and b for a row.
+     * @param s are the box means of the statistics of the row.
+     * @param nP is the number of channels of p.
+     * @param q is the output row.
+     * @param width
+     */
+    void Process3Channel(double *s, int nP, float *q, int width);
 
 public:
 
@@ -145,6 +172,14 @@ public:
      */
     void update(int radius, float e_regularization);
 
+    /**
+     * @brief Process
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *Process(ImageVec imgIn, Image *imgOut);
+
     /**
      * @brief execute
      * @param imgIn
@@ -164,130 +199,254 @@ public:
 
 PIC_INLINE void FilterGuidedAB::update(int radius, float e_regularization)
 {
-    this->radius = radius;
+    this->radius = MAX(radius, 1);
     this->e_regularization = e_regularization;
-    nPixels = float(radius * radius * 4);
+    nPixels = float(this->radius * this->radius * 4);
 }
 
-PIC_INLINE void FilterGuidedAB::Process1Channel(Image *I, Image *p, Image *q,
-                                   BBox *box)
+PIC_INLINE void FilterGuidedAB::getStatistics(Image *I, Image *p, int y, int f, double *out)
 {
-    float I_mean, I_var;
-    float *p_mean = new float [p->channels];
+    int nI = I->channels;
+    int nP = p->channels;
 
-    for(int j = box->y0; j < box->y1; j++) {
-        for(int i = box->x0; i < box->x1; i++) {
-            float *tmpQ = (*q)(i, j);
+    y = CLAMP(y, I->height);
 
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
+    float *I_r = &I->data[f * I->tstride + y * I->ystride];
+    float *p_r = &p->data[f * p->tstride + y * p->ystride];
 
-            I->getMeanVal(&tmpBox, &I_mean);
-            I->getVarianceVal(&I_mean, &tmpBox, &I_var);
+    for(int i = 0; i < I->width; i++) {
+        float *I_i = &I_r[i * nI];
+        float *p_i = &p_r[i * nP];
 
-            p->getMeanVal(&tmpBox, p_mean);
-
-            for(int c = 0; c < p->channels; c++) {
-                float I_mean_p_mean = I_mean * p_mean[c];
-                float a = 0.0f;
+        for(int n = 0; n < nI; n++) {
+            *(out++) = I_i[n];
+        }
 
-                for(int k = -radius; k < radius; k++) {
-                    for(int l = -radius; l < radius; l++) {
-                        float *I_i = (*I)(i + l, j + k);
-                        float *p_i = (*p)(i + l, j + k);
-                        a += I_i[0] * p_i[c] - I_mean_p_mean;
-                    }
-                }
+        for(int n = 0; n < nI; n++) {
+            for(int m = n; m < nI; m++) {
+                *(out++) = double(I_i[n]) * double(I_i[m]);
+            }
+        }
 
-                a /= (nPixels * (I_var + e_regularization));
-                float b = p_mean[c] - a * I_mean;
+        for(int c = 0; c < nP; c++) {
+            *(out++) = p_i[c];
 
-                int index = c << 1;
-                tmpQ[index] = a;
-                tmpQ[index + 1] = b;
+            for(int n = 0; n < nI; n++) {
+                *(out++) = double(I_i[n]) * double(p_i[c]);
             }
         }
     }
-
-    delete[] p_mean;
 }
 
-PIC_INLINE void FilterGuidedAB::Process3Channel(Image *I, Image *p,
-        Image *q, BBox *box)
+PIC_INLINE void FilterGuidedAB::getRowSum(Image *I, Image *p, int y, int f, double *stats, double *out)
 {
-    float *I_mean = new float[I->channels];
-    float *p_mean = new float[p->channels];
+    int nI = I->channels;
+    int channels = nI + ((nI * (nI + 1)) >> 1) + p->channels * (nI + 1);
+    int width = I->width;
 
-    float *a = new float[I->channels];
-    float *tmp_A = new float[I->channels];
+    getStatistics(I, p, y, f, stats);
 
-    Matrix3x3 cov, inv;
+    for(int c = 0; c < channels; c++) {
+        double sum = 0.0;
 
-    for(int j = box->y0; j < box->y1; j++) {
-        for(int i = box->x0; i < box->x1; i++) {
-            float *tmpQ = (*q)(i, j);
+        for(int t = -radius; t < radius; t++) {
+            sum += stats[CLAMP(t, width) * channels + c];
+        }
 
-            BBox tmpBox(i - radius, i + radius, j - radius, j + radius);
+        out[c] = sum;
+
+        for(int x = 1; x < width; x++) {
+            sum += stats[CLAMP(x + radius - 1, width) * channels + c] -
+                   stats[CLAMP(x - radius - 1, width) * channels + c];
+            out[x * channels + c] = sum;
+        }
+    }
+}
 
-            I->getMeanVal(&tmpBox, I_mean);
-            I->getCovMtxVal(I_mean, &tmpBox, cov.data);
+PIC_INLINE void FilterGuidedAB::Process1Channel(double *s_r, int nP, float *q_r, int width)
+{
+    //unbiased variance as in Image::getVarianceVal
+    double varScale = double(nPixels) / (double(nPixels) - 1.0);
+    int channels = 2 + nP * 2;
 
-            //regularization
-            cov.add(e_regularization);
-            //invert matrix
-            cov.inverse(&inv);
+    for(int i = 0; i < width; i++) {
+        double *s = &s_r[i * channels];
+        float *tmpQ = &q_r[i * nP * 2];
 
-            p->getMeanVal(&tmpBox, p_mean);
+        double I_mean = s[0];
+        double I_var = (s[1] - I_mean * I_mean) * varScale;
 
-            int index = 0;
-            for(int c = 0; c < p->channels; c++) {
+        for(int c = 0; c < nP; c++) {
+            double p_mean = s[2 + c * 2];
+            double Ip_mean = s[3 + c * 2];
 
-                Array<float>::assign(0.0f, tmp_A, I->channels);
+            double a = (Ip_mean - I_mean * p_mean) / (I_var + double(e_regularization));
+            double b = p_mean - a * I_mean;
 
-                for(int k = -radius; k < radius; k++) {
-                    for(int l = -radius; l < radius; l++) {
-                        float *I_i = (*I)(i + l, j + k);
-                        float *p_i = (*p)(i + l, j + k);
+            int index = c << 1;
+            tmpQ[index] = float(a);
+            tmpQ[index + 1] = float(b);
+        }
+    }
+}
 
-                        for(int n = 0; n < I->channels; n++) {
-                            tmp_A[n] += I_i[n] * p_i[c] - I_mean[n] * p_mean[c];
-                        }
-                    }
-                }
+PIC_INLINE void FilterGuidedAB::Process3Channel(double *s_r, int nP, float *q_r, int width)
+{
+    //unbiased covariance as in Image::getCovMtxVal
+    double varScale = double(nPixels) / (double(nPixels) - 1.0);
+    int channels = 9 + nP * 4;
 
-                Array<float>::div(tmp_A, I->channels, nPixels);
+    double cov[9], inv[9];
 
-                //multiply for inverted matrix
-                a = inv.mul(tmp_A, a);
+    for(int i = 0; i < width; i++) {
+        double *s = &s_r[i * channels];
+        float *tmpQ = &q_r[i * nP * 4];
 
-                float a_dot_I_mean = Array<float>::dot(a, I_mean, I->channels);
-                //float a_dot_I = Array<float>::dot(a, tmpI, channels);
+        double *I_mean = s;
+        double *II_mean = &s[3];
 
-                for(int n = 0; n < I->channels; n++) {
-                    tmpQ[index] = a[n];
-                    index++;
-                }
+        int index = 0;
+        for(int n = 0; n < 3; n++) {
+            for(int m = n; m < 3; m++) {
+                double c_nm = (II_mean[index] - I_mean[n] * I_mean[m]) * varScale;
+                cov[n * 3 + m] = c_nm;
+                cov[m * 3 + n] = c_nm;
+                index++;
+            }
+        }
+
+        //regularization
+        for(int n = 0; n < 3; n++) {
+            cov[n * 4] += double(e_regularization);
+        }
+
+        //invert matrix; it is done in double as Matrix3x3 is in float
+        inv[0] = cov[4] * cov[8] - cov[5] * cov[7];
+        inv[1] = cov[2] * cov[7] - cov[1] * cov[8];
+        inv[2] = cov[1] * cov[5] - cov[2] * cov[4];
+        inv[3] = cov[5] * cov[6] - cov[3] * cov[8];
+        inv[4] = cov[0] * cov[8] - cov[2] * cov[6];
+        inv[5] = cov[2] * cov[3] - cov[0] * cov[5];
+        inv[6] = cov[3] * cov[7] - cov[4] * cov[6];
+        inv[7] = cov[1] * cov[6] - cov[0] * cov[7];
+        inv[8] = cov[0] * cov[4] - cov[1] * cov[3];
+
+        double det = cov[0] * inv[0] + cov[1] * inv[3] + cov[2] * inv[6];
+        det = (det != 0.0) ? (1.0 / det) : 0.0;
+
+        index = 0;
+        for(int c = 0; c < nP; c++) {
+            double *s_c = &s[9 + c * 4];
+            double p_mean = s_c[0];
+
+            double tmp_A[3];
+            for(int n = 0; n < 3; n++) {
+                tmp_A[n] = s_c[1 + n] - I_mean[n] * p_mean;
+            }
 
-                //b
-                tmpQ[index] = p_mean[c] - a_dot_I_mean;
+            //multiply for inverted matrix
+            double b = p_mean;
+            for(int n = 0; n < 3; n++) {
+                double a = (inv[n * 3] * tmp_A[0] + inv[n * 3 + 1] * tmp_A[1] +
+                            inv[n * 3 + 2] * tmp_A[2]) * det;
+                b -= a * I_mean[n];
+
+                tmpQ[index] = float(a);
                 index++;
             }
+
+            //b
+            tmpQ[index] = float(b);
+            index++;
         }
     }
 }
 
-PIC_INLINE void FilterGuidedAB::ProcessBBox(Image *dst, ImageVec src,
-        BBox *box)
+PIC_INLINE Image *FilterGuidedAB::Process(ImageVec imgIn, Image *imgOut)
 {
-    Image *I = getI(src);
-    Image *p = getp(src);
+    if(!checkInput(imgIn)) {
+        return imgOut;
+    }
 
-    if(I->channels == 1) {
-        Process1Channel(I, p, dst, box);
+    if(hasCompact(imgIn, imgOut)) {
+        return ProcessCompact(imgIn, imgOut);
     }
 
-    if(I->channels == 3) {
-        Process3Channel(I, p, dst, box);
+    Image *I = getI(imgIn);
+    Image *p = getp(imgIn);
+
+    if((I->channels != 1) && (I->channels != 3)) {
+        return imgOut;
     }
+
+    //I and p have to be sampled on the same grid
+    if((I->width != p->width) || (I->height != p->height) ||
+       (I->frames != p->frames)) {
+        return imgOut;
+    }
+
+    imgOut = setupAux(imgIn, imgOut);
+
+    if(imgOut == NULL) {
+        return imgOut;
+    }
+
+    int nI = I->channels;
+    int nP = p->channels;
+    int width = I->width;
+    int height = I->height;
+    int rowSize = width * (nI + ((nI * (nI + 1)) >> 1) + nP * (nI + 1));
+    double scale = 1.0 / double(nPixels);
+
+    //box means of the statistics in the window [i - radius, i + radius);
+    //the vertical sums slide on bands of rows
+    int nBands = (height + FILTER_GUIDED_A_B_ROWS - 1) / FILTER_GUIDED_A_B_ROWS;
+
+    ThreadPool::getInstance()->parallelFor(nBands * I->frames, [&](int k) {
+        int f = k / nBands;
+        int y0 = (k % nBands) * FILTER_GUIDED_A_B_ROWS;
+        int y1 = MIN(y0 + FILTER_GUIDED_A_B_ROWS, height);
+
+        std::vector< double > stats(rowSize), row(rowSize), sum(rowSize, 0.0), mean(rowSize);
+
+        for(int t = y0 - radius; t < y0 + radius; t++) {
+            getRowSum(I, p, t, f, &stats[0], &row[0]);
+
+            for(int i = 0; i < rowSize; i++) {
+                sum[i] += row[i];
+            }
+        }
+
+        for(int y = y0; y < y1; y++) {
+            if(y > y0) {
+                getRowSum(I, p, y + radius - 1, f, &stats[0], &row[0]);
+
+                for(int i = 0; i < rowSize; i++) {
+                    sum[i] += row[i];
+                }
+
+                getRowSum(I, p, y - radius - 1, f, &stats[0], &row[0]);
+
+                for(int i = 0; i < rowSize; i++) {
+                    sum[i] -= row[i];
+                }
+            }
+
+            for(int i = 0; i < rowSize; i++) {
+                mean[i] = sum[i] * scale;
+            }
+
+            float *q = &imgOut->data[f * imgOut->tstride + y * imgOut->ystride];
+
+            if(nI == 1) {
+                Process1Channel(&mean[0], nP, q, width);
+            } else {
+                Process3Channel(&mean[0], nP, q, width);
+            }
+        }
+    });
+
+    return imgOut;
 }
 
 } // end namespace pic
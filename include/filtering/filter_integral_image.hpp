@@ -18,15 +18,72 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_INTEGRAL_IMAGE
 #define PIC_FILTERING_FILTER_INTEGRAL_IMAGE
 
+#include <vector>
+
 #include "../filtering/filter.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterIntegralImage class
+ * @brief The FilterIntegralImage class computes the integral image; i.e.,
+ * out(x, y) = sum of in(i, j) for i <= x and j <= y. Rows are integrated
+ * in parallel, and then spans of columns are integrated in parallel; sums
+ * are accumulated in double. getIntegralImage stores the integral image in
+ * double, which is needed when many values are summed.
  */
 class FilterIntegralImage: public Filter
 {
+protected:
+
+    /**
+     * @brief integrate
+     * @param img
+     * @param out has the size of img.
+     */
+    template<class T>
+    static void integrate(Image *img, T *out)
+    {
+        int width = img->width;
+        int height = img->height;
+        int channels = img->channels;
+        int rowSize = width * channels;
+
+        //rows
+        ThreadPool::getInstance()->parallelFor(height, [&](int i) {
+            float *in_i = img->data + i * rowSize;
+            T *out_i = out + i * rowSize;
+
+            for(int k = 0; k < channels; k++) {
+                double sum = 0.0;
+
+                for(int j = 0; j < width; j++) {
+                    sum += in_i[j * channels + k];
+                    out_i[j * channels + k] = T(sum);
+                }
+            }
+        });
+
+        //spans of columns
+        int spanSize = 256;
+        int nSpans = (rowSize + spanSize - 1) / spanSize;
+
+        ThreadPool::getInstance()->parallelFor(nSpans, [&](int s) {
+            int x0 = s * spanSize;
+            int n = MIN(rowSize - x0, spanSize);
+
+            std::vector< double > sum(n, 0.0);
+
+            for(int i = 0; i < height; i++) {
+                T *out_i = out + i * rowSize + x0;
+
+                for(int j = 0; j < n; j++) {
+                    sum[j] += double(out_i[j]);
+                    out_i[j] = T(sum[j]);
+                }
+            }
+        });
+    }
+
 public:
 
     /**
@@ -52,55 +109,13 @@ public:
             return imgOut;
         }
 
-        imgOut = setupAux(imgIn, imgOut);
-
-        int width = imgIn[0]->width;
-        int height = imgIn[0]->height;
-        int channels = imgIn[0]->channels;
-
-        //set up the first pixel (0,0)
-        for(int k = 0; k < channels; k++) {
-            imgOut->data[k] = imgIn[0]->data[k];
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
         }
 
-        //set up the first row
-        for(int j=1; j<width; j++) {
-            int ind1 = j * channels;
-            int ind2 = ind1 - channels;
-
-            for(int k=0; k<channels; k++) {
-                imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] + imgOut->data[ind2 + k];
-            }
-        }
+        imgOut = setupAux(imgIn, imgOut);
 
-        //set up the first column
-        int c1 = width * channels;
-        for(int i=1; i<height; i++){
-            int ind1 = i * c1;
-            int ind2 = ind1 - c1;
-            for(int k=0; k<channels; k++) {
-                imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] + imgOut->data[ind2 + k];
-            }
-        }
-
-        int c2 = (width + 1) * channels;
-
-        for(int i=1; i<height; i++) {
-            int ind = i * width;
-            for(int j=1; j<width; j++) {
-                int ind1 = (ind + j) * channels;
-                int ind2 = ind1 - channels;
-                int ind3 = ind1 - c1;
-                int ind4 = ind1 - c2;
-
-                for(int k=0; k<channels; k++) {
-                    imgOut->data[ind1 + k] = imgIn[0]->data[ind1 + k] +
-                                             imgOut->data[ind2 + k] +
-                                             imgOut->data[ind3 + k] -
-                                             imgOut->data[ind4 + k];
-                }
-            }
-        }
+        integrate<float>(imgIn[0], imgOut->data);
 
         return imgOut;
     }
@@ -115,6 +130,73 @@ public:
     {
         return Process(imgIn, imgOut);
     }
+
+    /**
+     * @brief getIntegralImage computes the integral image of the first
+     * frame of img in double.
+     * @param img
+     * @param out is an array of width * height * channels values; it is
+     * allocated if it is NULL.
+     * @return
+     */
+    static double *getIntegralImage(Image *img, double *out = NULL)
+    {
+        if(img == NULL) {
+            return out;
+        }
+
+        if(out == NULL) {
+            out = new double[img->width * img->height * img->channels];
+        }
+
+        integrate<double>(img, out);
+
+        return out;
+    }
+
+    /**
+     * @brief getSum
+     * @param integral is an integral image.
+     * @param width
+     * @param channels
+     * @param x0
+     * @param y0
+     * @param x1
+     * @param y1
+     * @param c
+     * @return It returns the sum of the channel c in [x0, x1) x [y0, y1);
+     * the box has to be inside the image.
+     */
+    template<class T>
+    static double getSum(const T *integral, int width, int channels,
+                         int x0, int y0, int x1, int y1, int c)
+    {
+        if((x1 <= x0) || (y1 <= y0)) {
+            return 0.0;
+        }
+
+        int rowSize = width * channels;
+        x0--;
+        y0--;
+        x1--;
+        y1--;
+
+        double ret = double(integral[y1 * rowSize + x1 * channels + c]);
+
+        if(x0 >= 0) {
+            ret -= double(integral[y1 * rowSize + x0 * channels + c]);
+        }
+
+        if(y0 >= 0) {
+            ret -= double(integral[y0 * rowSize + x1 * channels + c]);
+        }
+
+        if((x0 >= 0) && (y0 >= 0)) {
+            ret += double(integral[y0 * rowSize + x0 * channels + c]);
+        }
+
+        return ret;
+    }
 };
 
 } // end namespace pic
@@ -38,27 +38,54 @@ protected:
     float *weights;
 
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief f
+     * @param data
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void f(FilterFData *data)
     {
-        for(int j = box->y0; j < box->y1; j++) {
-
-            for(int i = box->x0; i < box->x1; i++) {
+        float *data_src = (*data->src[0])(data->x, data->y, data->z);
 
-                float *data_src = (*src[0])(i, j);
-                float *data_dst = (*dst)(i, j);
+        data->out[0] = Arrayf::dot(data_src, weights, data->src[0]->channels);
+    }
 
-                data_dst[0] = data_src[0] * weights[0];
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        float *in = data->in[0];
+        int channels = data->src[0]->channels;
+        int n = data->x1 - data->x0;
 
-                data_dst[0] = Arrayf::dot(data_src, weights, src[0]->channels);
-            }
+        for(int i = 0; i < n; i++) {
+            data->out[i] = Arrayf::dot(&in[i * channels], weights, channels);
         }
     }
 
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec & /*src*/)
+    {
+        return dst->channels == 1;
+    }
+
 public:
 
     /**
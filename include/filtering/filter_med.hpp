@@ -18,27 +18,39 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_MED_HPP
 #define PIC_FILTERING_FILTER_MED_HPP
 
+#include <algorithm>
+#include <vector>
+
 #include "../filtering/filter.hpp"
+#include "../util/span_ops.hpp"
+#include "../util/sorting_network.hpp"
 
 namespace pic {
 
 /**
- * @brief The FilterMed class
+ * @brief The FilterMed class computes the median of each channel in a
+ * square window. 3x3 and 5x5 windows are computed with sorting networks
+ * on rows of pixels. When nLevels > 1, values are quantized in nLevels
+ * levels in [rangeMin, rangeMax], and the median is computed in constant
+ * time per pixel with sliding histograms (Perreault and Hebert); this is
+ * exact for data that is already quantized, e.g., 8-bit images with
+ * nLevels = 256 in [0, 1].
  */
 class FilterMed: public Filter
 {
 protected:
     int halfSize, areaKernel, midValue;
+    int nLevels;
+    float rangeMin, rangeMax;
 
     /**
-     * @brief ProcessBBox
+     * @brief ProcessBBoxSelect computes the median with a selection.
      * @param dst
-     * @param src
+     * @param in
      * @param box
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void ProcessBBoxSelect(Image *dst, Image *in, BBox *box)
     {
-        Image *in = src[0];
         float *values = new float[areaKernel * in->channels];
 
         for(int j = box->y0; j < box->y1; j++) {
@@ -62,7 +74,7 @@ protected:
 
                 for(int ch = 0; ch < in->channels; ch++) {
                     float *tmp_v_ch = &values[areaKernel * ch];
-                    std::sort(tmp_v_ch, tmp_v_ch + areaKernel);
+                    std::nth_element(tmp_v_ch, tmp_v_ch + midValue, tmp_v_ch + areaKernel);
 
                     out[ch] = tmp_v_ch[midValue];
                 }
@@ -72,26 +84,234 @@ protected:
         delete[] values;
     }
 
+    /**
+     * @brief ProcessBBoxNetwork computes the median of a row of pixels
+     * at once with a sorting network.
+     * @param dst
+     * @param in
+     * @param box
+     * @param pairs
+     * @param nPairs
+     */
+    void ProcessBBoxNetwork(Image *dst, Image *in, BBox *box,
+                            const unsigned char *pairs, int nPairs)
+    {
+        int width = box->x1 - box->x0;
+        float *values = new float[areaKernel * width];
+        float *median = &values[midValue * width];
+
+        //clamped offsets of the columns of the box and its borders
+        std::vector< int > cols(width + halfSize * 2);
+        for(unsigned int t = 0; t < cols.size(); t++) {
+            cols[t] = CLAMP(box->x0 - halfSize + int(t), in->width) * in->xstride;
+        }
+
+        for(int j = box->y0; j < box->y1; j++) {
+            for(int ch = 0; ch < in->channels; ch++) {
+
+                int c = 0;
+                for(int k = -halfSize; k <= halfSize; k++) {
+                    float *row = (*in)(0, j + k) + ch;
+
+                    for(int l = 0; l <= (halfSize * 2); l++) {
+                        float *values_c = &values[c * width];
+                        int *cols_l = &cols[l];
+
+                        for(int i = 0; i < width; i++) {
+                            values_c[i] = row[cols_l[i]];
+                        }
+
+                        c++;
+                    }
+                }
+
+                MedianNetwork::apply(values, width, width, pairs, nPairs);
+
+                for(int i = 0; i < width; i++) {
+                    (*dst)(box->x0 + i, j)[ch] = median[i];
+                }
+            }
+        }
+
+        delete[] values;
+    }
+
+    /**
+     * @brief ProcessBBoxHistogram computes the median with a histogram
+     * for each column of the box, and a histogram of the window; when
+     * the window moves, a column histogram is added to the window
+     * histogram, and another one is subtracted.
+     * @param dst
+     * @param in
+     * @param box
+     */
+    void ProcessBBoxHistogram(Image *dst, Image *in, BBox *box)
+    {
+        int width = box->x1 - box->x0;
+        int height = box->y1 - box->y0;
+        int size = halfSize * 2;
+
+        int nCols = width + size;
+        int nRows = height + size;
+
+        //coarse levels of 16 fine levels speed up the search of the median
+        int nCoarse = (nLevels + 15) >> 4;
+
+        int *colHist = new int[nCols * nLevels];
+        int *colCoarse = new int[nCols * nCoarse];
+        int *hist = new int[nLevels];
+        int *coarse = new int[nCoarse];
+        unsigned short *bins = new unsigned short[nRows * nCols];
+
+        float scale = float(nLevels - 1) / (rangeMax - rangeMin);
+        float maxLevel = float(nLevels - 1);
+
+        std::vector< float > levels(nLevels);
+        for(int b = 0; b < nLevels; b++) {
+            levels[b] = rangeMin + (rangeMax - rangeMin) * float(b) / maxLevel;
+        }
+
+        for(int ch = 0; ch < in->channels; ch++) {
+            //quantization of the box and its borders
+            for(int r = 0; r < nRows; r++) {
+                unsigned short *bins_r = &bins[r * nCols];
+
+                for(int c = 0; c < nCols; c++) {
+                    float t = ((*in)(box->x0 - halfSize + c, box->y0 - halfSize + r)[ch] - rangeMin) * scale;
+                    t = CLAMPi(t, 0.0f, maxLevel);
+                    bins_r[c] = (unsigned short) (t + 0.5f);
+                }
+            }
+
+            //column histograms of the first window
+            memset(colHist, 0, sizeof(int) * nCols * nLevels);
+            memset(colCoarse, 0, sizeof(int) * nCols * nCoarse);
+
+            for(int r = 0; r <= size; r++) {
+                for(int c = 0; c < nCols; c++) {
+                    int b = bins[r * nCols + c];
+                    colHist[c * nLevels + b]++;
+                    colCoarse[c * nCoarse + (b >> 4)]++;
+                }
+            }
+
+            for(int j = 0; j < height; j++) {
+                if(j > 0) {
+                    unsigned short *bins_out = &bins[(j - 1) * nCols];
+                    unsigned short *bins_in = &bins[(j + size) * nCols];
+
+                    for(int c = 0; c < nCols; c++) {
+                        colHist[c * nLevels + bins_out[c]]--;
+                        colCoarse[c * nCoarse + (bins_out[c] >> 4)]--;
+                        colHist[c * nLevels + bins_in[c]]++;
+                        colCoarse[c * nCoarse + (bins_in[c] >> 4)]++;
+                    }
+                }
+
+                memset(hist, 0, sizeof(int) * nLevels);
+                memset(coarse, 0, sizeof(int) * nCoarse);
+
+                for(int c = 0; c < size; c++) {
+                    SpanOps::add(hist, &colHist[c * nLevels], nLevels);
+                    SpanOps::add(coarse, &colCoarse[c * nCoarse], nCoarse);
+                }
+
+                for(int i = 0; i < width; i++) {
+                    SpanOps::add(hist, &colHist[(i + size) * nLevels], nLevels);
+                    SpanOps::add(coarse, &colCoarse[(i + size) * nCoarse], nCoarse);
+
+                    //search of the median
+                    int count = 0;
+                    int cb = 0;
+                    while((count + coarse[cb]) <= midValue) {
+                        count += coarse[cb];
+                        cb++;
+                    }
+
+                    int b = cb << 4;
+                    while((count + hist[b]) <= midValue) {
+                        count += hist[b];
+                        b++;
+                    }
+
+                    (*dst)(box->x0 + i, box->y0 + j)[ch] = levels[b];
+
+                    SpanOps::sub(hist, &colHist[i * nLevels], nLevels);
+                    SpanOps::sub(coarse, &colCoarse[i * nCoarse], nCoarse);
+                }
+            }
+        }
+
+        delete[] colHist;
+        delete[] colCoarse;
+        delete[] hist;
+        delete[] coarse;
+        delete[] bins;
+    }
+
+    /**
+     * @brief ProcessBBox
+     * @param dst
+     * @param src
+     * @param box
+     */
+    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    {
+        Image *in = src[0];
+
+        if(nLevels > 1) {
+            ProcessBBoxHistogram(dst, in, box);
+            return;
+        }
+
+        int nPairs;
+        const unsigned char *pairs = MedianNetwork::get(areaKernel, nPairs);
+
+        if(pairs != NULL) {
+            ProcessBBoxNetwork(dst, in, box, pairs, nPairs);
+        } else {
+            ProcessBBoxSelect(dst, in, box);
+        }
+    }
+
 public:
     /**
      * @brief FilterMed
      * @param size
+     * @param nLevels is the number of quantization levels; if it is
+     * greater than 1, the median is computed with histograms.
+     * @param rangeMin is the value of the first level.
+     * @param rangeMax is the value of the last level.
      */
-    FilterMed(int size) : Filter()
+    FilterMed(int size, int nLevels = 0, float rangeMin = 0.0f,
+              float rangeMax = 1.0f) : Filter()
     {
-        update(size);
+        update(size, nLevels, rangeMin, rangeMax);
     }
 
     /**
      * @brief update
      * @param size
+     * @param nLevels
+     * @param rangeMin
+     * @param rangeMax
      */
-    void update(int size)
+    void update(int size, int nLevels = 0, float rangeMin = 0.0f,
+                float rangeMax = 1.0f)
     {
         this->halfSize = checkHalfSize(size);
         size = (halfSize << 1) + 1;
         this->areaKernel = size * size;
         this->midValue = areaKernel >> 1;
+
+        this->nLevels = CLAMPi(nLevels, 0, 65536);
+        this->rangeMin = rangeMin;
+        this->rangeMax = rangeMax;
+
+        //histograms need at least two levels and a valid range
+        if((this->nLevels < 2) || (rangeMax <= rangeMin)) {
+            this->nLevels = 0;
+        }
     }
 
     /**
@@ -99,11 +319,16 @@ public:
      * @param imgIn
      * @param imgOut
      * @param size
+     * @param nLevels
+     * @param rangeMin
+     * @param rangeMax
      * @return
      */
-    static Image *execute(Image *imgIn, Image *imgOut, int size)
+    static Image *execute(Image *imgIn, Image *imgOut, int size,
+                          int nLevels = 0, float rangeMin = 0.0f,
+                          float rangeMax = 1.0f)
     {
-        FilterMed filter(size);
+        FilterMed filter(size, nLevels, rangeMin, rangeMax);
         return filter.Process(Single(imgIn), imgOut);
     }
 };
@@ -18,6 +18,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_MED_VEC_HPP
 #define PIC_FILTERING_FILTER_MED_VEC_HPP
 
+#include <float.h>
+
 #include "../filtering/filter.hpp"
 #include "../util/array.hpp"
 
@@ -29,10 +31,34 @@ namespace pic {
 class FilterMedVec: public Filter
 {
 protected:
-    int halfSize, areaKernel, midValue;
+    int halfSize, kernelSize, areaKernel, midValue;
 
     /**
-     * @brief ProcessBBox
+     * @brief distanceSum
+     * @param color
+     * @param values are the colors of a column of the window.
+     * @param channels
+     * @return It returns the sum of the distances between color and the
+     * colors of a column.
+     */
+    double distanceSum(float *color, float *values, int channels)
+    {
+        double dist = 0.0;
+
+        for(int r = 0; r < kernelSize; r++) {
+            float d_sq = Arrayf::distanceSq(color, &values[r * channels], channels);
+            dist += sqrtf(d_sq);
+        }
+
+        return dist;
+    }
+
+    /**
+     * @brief ProcessBBox computes the vector median; for each color of the
+     * window, the sum of its distances to the other colors is stored. When
+     * the window moves by a pixel, only distances to the removed and the
+     * added columns are computed, so the cost per pixel is O(size^3)
+     * instead of O(size^4).
      * @param dst
      * @param src
      * @param box
@@ -40,56 +66,93 @@ protected:
     void ProcessBBox(Image *dst, ImageVec src, BBox *box)
     {
         Image *in = src[0];
-        float *values = new float[areaKernel * in->channels];
+        int channels = in->channels;
 
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
+        int width = box->x1 - box->x0;
+        int nCols = width + halfSize * 2;
+        int colSize = kernelSize * channels;
 
-                int c = 0;
-                for(int k = -halfSize; k <= halfSize; k++) {
-                    for(int l = -halfSize; l <= halfSize; l++) {
+        //colors and distance sums for the columns of the box and its borders
+        float *values = new float[nCols * colSize];
+        double *dist = new double[nCols * kernelSize];
 
-                        float *color = (*in)(i + l, j + k);
+        for(int j = box->y0; j < box->y1; j++) {
+            for(int t = 0; t < nCols; t++) {
+                for(int r = 0; r < kernelSize; r++) {
+                    float *color = (*in)(box->x0 - halfSize + t, j - halfSize + r);
 
-                        for(int ch = 0; ch < in->channels; ch++) {
-                            values[c * in->channels + ch] = color[ch];
-                        }
+                    for(int ch = 0; ch < channels; ch++) {
+                        values[t * colSize + r * channels + ch] = color[ch];
+                    }
+                }
+            }
 
-                        c++;
+            //first window
+            for(int t = 0; t < kernelSize; t++) {
+                for(int r = 0; r < kernelSize; r++) {
+                    float *color = &values[t * colSize + r * channels];
+                    double d = 0.0;
+
+                    for(int l = 0; l < kernelSize; l++) {
+                        d += distanceSum(color, &values[l * colSize], channels);
                     }
+
+                    dist[t * kernelSize + r] = d;
                 }
+            }
 
-                //compute distances
-                int best = -1;
-                float distBest = FLT_MAX;
+            for(int i = 0; i < width; i++) {
+                if(i > 0) {
+                    int tOut = i - 1;
+                    int tIn = i + halfSize * 2;
 
-                for(int k = 0; k < areaKernel; k++) {
-                    int index_k = k * in->channels;
-                    float dist = 0.0f;
+                    for(int t = i; t < tIn; t++) {
+                        for(int r = 0; r < kernelSize; r++) {
+                            float *color = &values[t * colSize + r * channels];
 
-                    for(int l = 0; l < areaKernel; l++) {
-                        int index_l = l * in->channels;
-                        float d_sq = Arrayf::distanceSq(&values[index_k], &values[index_l], in->channels);
-                        dist += sqrtf(d_sq);
+                            dist[t * kernelSize + r] +=
+                                distanceSum(color, &values[tIn * colSize], channels) -
+                                distanceSum(color, &values[tOut * colSize], channels);
+                        }
                     }
 
-                    if(dist < distBest) {
-                        distBest = dist;
-                        best = k;
+                    for(int r = 0; r < kernelSize; r++) {
+                        float *color = &values[tIn * colSize + r * channels];
+                        double d = 0.0;
+
+                        for(int t = i; t <= tIn; t++) {
+                            d += distanceSum(color, &values[t * colSize], channels);
+                        }
+
+                        dist[tIn * kernelSize + r] = d;
                     }
                 }
 
-                float *out = (*dst) (i, j);
+                //the best color is the first one in scanline order
+                int best = -1;
+                double distBest = DBL_MAX;
+
+                for(int r = 0; r < kernelSize; r++) {
+                    for(int t = i; t < (i + kernelSize); t++) {
+                        double d = dist[t * kernelSize + r];
+
+                        if(d < distBest) {
+                            distBest = d;
+                            best = t * colSize + r * channels;
+                        }
+                    }
+                }
 
-                int index = best * in->channels;
+                float *out = (*dst) (box->x0 + i, j);
 
-                for(int ch = 0; ch < in->channels; ch++) {
-                    out[ch] = values[index + ch];
+                for(int ch = 0; ch < channels; ch++) {
+                    out[ch] = values[best + ch];
                 }
             }
         }
 
         delete[] values;
+        delete[] dist;
     }
 
 public:
@@ -110,7 +173,7 @@ public:
     {
         this->halfSize = checkHalfSize(size);
 
-        int kernelSize = (halfSize << 1) + 1;
+        this->kernelSize = (halfSize << 1) + 1;
         this->areaKernel = kernelSize * kernelSize;
 
         this->midValue = areaKernel >> 1;
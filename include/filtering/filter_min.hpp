@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_MIN_HPP
 
 #include "../filtering/filter.hpp"
+#include "../util/running_extrema.hpp"
 
 namespace pic {
 
@@ -31,45 +32,56 @@ protected:
     int halfSize;
 
     /**
-     * @brief ProcessBBox
+     * @brief ProcessBBox processes the box with a separable square window:
+     * a horizontal pass on the rows of the box (plus borders) is followed
+     * by a vertical pass. Both passes use the van Herk/Gil-Werman
+     * algorithm; the horizontal one runs on each channel with a stride,
+     * and the vertical one works on contiguous spans of interleaved rows.
      * @param dst
      * @param src
      * @param box
      */
     void ProcessBBox(Image *dst, ImageVec src, BBox *box)
     {
+        int width = box->x1 - box->x0;
+        int height = box->y1 - box->y0;
         int channels = dst->channels;
-        float *minVal = new float[channels];
-
-        for(int j = box->y0; j < box->y1; j++) {
-            for(int i = box->x0; i < box->x1; i++) {
-
-                float *dst_data = (*dst)(i, j);
-                float *src_data = (*src[0])(i, j);
-
-                for(int k = 0; k < channels; k++) {
-                    minVal[k] = src_data[k];
-                }
-
-                for(int k = -halfSize; k <= halfSize; k++) {
-                    for(int l = -halfSize; l <= halfSize; l++) {
-
-                        src_data = (*src[0])(i + l, j + k);
-
-                        for(int ch = 0; ch < channels; ch++) {
-                            minVal[ch] = minVal[ch] < src_data[ch] ?
-                                         minVal[ch] : src_data[ch];
-                        }
+        int kernelSize = (halfSize << 1) + 1;
+
+        int nRows = height + kernelSize - 1;
+        int lineSize = width + kernelSize - 1;
+        int rowSize = width * channels;
+
+        float *line = new float[lineSize * 3];
+        float *rows = new float[nRows * rowSize * 2];
+        float *buffer = &rows[nRows * rowSize];
+
+        for(int k = box->z0; k < box->z1; k++) {
+            //horizontal pass
+            for(int r = 0; r < nRows; r++) {
+                float *src_data = (*src[0])(0, box->y0 - halfSize + r, k);
+                float *rows_r = &rows[r * rowSize];
+
+                for(int c = 0; c < channels; c++) {
+                    for(int i = 0; i < lineSize; i++) {
+                        int x = CLAMP(box->x0 - halfSize + i, src[0]->width);
+                        line[i] = src_data[x * src[0]->channels + c];
                     }
-                }
 
-                for(int k = 0; k < channels; k++) {
-                    dst_data[k] = minVal[k];
+                    RunningExtrema<ExtremaMin>::line(&rows_r[c], line, width,
+                                                     kernelSize, &line[lineSize],
+                                                     channels);
                 }
             }
+
+            //vertical pass
+            RunningExtrema<ExtremaMin>::rows((*dst)(box->x0, box->y0, k), dst->ystride,
+                                             rows, rowSize, height, kernelSize,
+                                             buffer);
         }
 
-        delete[] minVal;
+        delete[] line;
+        delete[] rows;
     }
 
 public:
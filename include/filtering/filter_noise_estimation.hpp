@@ -84,6 +84,10 @@ public:
             return imgOut;
         }
 
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
         imgOut = flt.Process(Double(imgIn[0], img_conv), imgOut);
 
         if(imgOut == NULL) {
@@ -19,6 +19,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_FILTERING_FILTER_NON_LOCAL_MEANS_F_HPP
 
 #include <random>
+#include <vector>
 
 #include "../filtering/filter.hpp"
 #include "../features_matching/patch_comp.hpp"
@@ -29,7 +30,11 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 namespace pic {
 
 /**
- * @brief The FilterNonLocalMeansF class
+ * @brief The FilterNonLocalMeansF class. By default, patch distances are
+ * computed as in Darbon et al.: for each offset of the search window, the
+ * squared differences between the image and its shifted copy are summed
+ * in an integral image, so the distance of a patch costs O(1) instead of
+ * O(kernelSize^2), and weights are read from a table of exponentials.
  */
 class FilterNonLocalMeansF: public Filter
 {
@@ -41,6 +46,73 @@ protected:
     MRSamplers<2> *ms;
     int seed;
 
+    bool bIntegral;
+    std::vector< float > expTable;
+    float expTableScale;
+
+    /**
+     * @brief setupExpTable samples expf(-x) in [0, 16] with 256 samples
+     * per unit; beyond 16, weights are below 1e-7 and they are set to zero.
+     */
+    void setupExpTable()
+    {
+        expTableScale = 256.0f;
+        expTable.resize(16 * 256 + 1);
+
+        for(unsigned int i = 0; i < expTable.size(); i++) {
+            expTable[i] = expf(-float(i) / expTableScale);
+        }
+    }
+
+    /**
+     * @brief getWeight
+     * @param x
+     * @return It returns expf(-x) for x >= 0 from a table.
+     */
+    inline float getWeight(float x)
+    {
+        float t = x * expTableScale;
+
+        if(t >= float(expTable.size() - 1)) {
+            return 0.0f;
+        }
+
+        int i = int(t);
+        float a = t - float(i);
+        return expTable[i] + (expTable[i + 1] - expTable[i]) * a;
+    }
+
+    /**
+     * @brief getMultiplicity
+     * @param i
+     * @param m
+     * @param size
+     * @return It returns how many offsets of the search window move i into
+     * the pixel i + m when coordinates are clamped.
+     */
+    inline int getMultiplicity(int i, int m, int size)
+    {
+        int n = 1;
+
+        if((i + m) == 0) {
+            n += MAX(halfSearchWindow - i, 0);
+        }
+
+        if((i + m) == (size - 1)) {
+            n += MAX(i + halfSearchWindow - size + 1, 0);
+        }
+
+        return n;
+    }
+
+    /**
+     * @brief ProcessBBoxIntegral
+     * @param dst
+     * @param src
+     * @param box
+     */
+    void ProcessBBoxIntegral(Image *dst, ImageVec src, BBox *box);
+
     /**
      * @brief ProcessBBox
      * @param dst
@@ -58,29 +130,57 @@ public:
     {
         seed = 1;
         ms = NULL;
+        bIntegral = true;
+        setupExpTable();
     }
 
     /**
      * @brief FilterNonLocalMeansF
-     * @param sigma_s
+     * @param searchWindow
+     * @param kernelSize
      * @param sigma_r
+     * @param bIntegral enables integral images of patch distances;
+     * otherwise each patch distance is computed pixel by pixel.
      */
-    FilterNonLocalMeansF(int searchWindow, int kernelSize, float sigma_r);
+    FilterNonLocalMeansF(int searchWindow, int kernelSize, float sigma_r,
+                         bool bIntegral = true);
 
     /**
      * @brief update
+     * @param searchWindow
+     * @param kernelSize
+     * @param sigma_r
+     * @param bIntegral
+     */
+    void update(int searchWindow, int kernelSize, float sigma_r,
+                bool bIntegral = true);
+
+    /**
+     * @brief execute
+     * @param imgIn
+     * @param imgOut
+     * @param searchWindow
+     * @param kernelSize
      * @param sigma_r
+     * @return
      */
-    void update(int searchWindow, int kernelSize, float sigma_r);
+    static Image *execute(Image *imgIn, Image *imgOut, int searchWindow,
+                          int kernelSize, float sigma_r)
+    {
+        FilterNonLocalMeansF filter(searchWindow, kernelSize, sigma_r);
+        return filter.Process(Single(imgIn), imgOut);
+    }
 
 };
 
-PIC_INLINE FilterNonLocalMeansF::FilterNonLocalMeansF(int searchWindow, int kernelSize, float sigma_r) : Filter()
+PIC_INLINE FilterNonLocalMeansF::FilterNonLocalMeansF(int searchWindow, int kernelSize, float sigma_r, bool bIntegral) : Filter()
 {
-    update(searchWindow, kernelSize, sigma_r);
+    ms = NULL;
+    setupExpTable();
+    update(searchWindow, kernelSize, sigma_r, bIntegral);
 }
 
-PIC_INLINE void FilterNonLocalMeansF::update(int searchWindow, int kernelSize, float sigma_r)
+PIC_INLINE void FilterNonLocalMeansF::update(int searchWindow, int kernelSize, float sigma_r, bool bIntegral)
 {
     //protected values are assigned/computed
     this->sigma_r = sigma_r;
@@ -97,11 +197,125 @@ PIC_INLINE void FilterNonLocalMeansF::update(int searchWindow, int kernelSize, f
     this->searchWindow = halfSearchWindow << 1;
 
     seed = 1;
+
+    this->bIntegral = bIntegral;
+}
+
+PIC_INLINE void FilterNonLocalMeansF::ProcessBBoxIntegral(Image *dst, ImageVec src,
+        BBox *box)
+{
+    Image *img = src[0];
+
+    int width = img->width;
+    int height = img->height;
+    int channels = img->channels;
+
+    int halfKernelSize = kernelSize >> 1;
+    float area = kernelSize_sq * dst->channelsf;
+
+    int bWidth = box->x1 - box->x0;
+    int bHeight = box->y1 - box->y0;
+
+    //integral image of the box and its borders; first row and column are zero
+    int iWidth = bWidth + kernelSize;
+    int iHeight = bHeight + kernelSize;
+    std::vector< double > integral(iWidth * iHeight, 0.0);
+
+    std::vector< float > acc(bWidth * bHeight * channels, 0.0f);
+    std::vector< float > tot(bWidth * bHeight, 0.0f);
+
+    for(int l = -halfSearchWindow; l <= halfSearchWindow; l++) {
+        for(int m = -halfSearchWindow; m <= halfSearchWindow; m++) {
+
+            //squared differences between the image and its shifted copy
+            for(int r = 1; r < iHeight; r++) {
+                int y = box->y0 - halfKernelSize + r - 1;
+                float *row0 = (*img)(0, y);
+                float *row1 = (*img)(0, y + l);
+
+                double *S = &integral[r * iWidth];
+                double *S_up = &integral[(r - 1) * iWidth];
+
+                double rowSum = 0.0;
+                for(int c = 1; c < iWidth; c++) {
+                    int x = box->x0 - halfKernelSize + c - 1;
+
+                    rowSum += Arrayf::distanceSq(&row0[CLAMP(x, width) * channels],
+                                                 &row1[CLAMP(x + m, width) * channels],
+                                                 channels);
+                    S[c] = S_up[c] + rowSum;
+                }
+            }
+
+            //weights of the shifted pixels
+            for(int j = box->y0; j < box->y1; j++) {
+                int jl = j + l;
+
+                if(jl < 0 || jl >= height) {
+                    continue;
+                }
+
+                int mult_y = getMultiplicity(j, l, height);
+
+                int r = j - box->y0;
+                double *S0 = &integral[r * iWidth];
+                double *S1 = &integral[(r + kernelSize) * iWidth];
+
+                float *row = (*img)(0, jl);
+
+                for(int i = box->x0; i < box->x1; i++) {
+                    int im = i + m;
+
+                    if(im < 0 || im >= width) {
+                        continue;
+                    }
+
+                    int c = i - box->x0;
+                    double ssd = S1[c + kernelSize] - S1[c] - S0[c + kernelSize] + S0[c];
+
+                    float d_sq = float(ssd) / area;
+                    float w = getWeight(MAX(d_sq - sigma_r_sq_2, 0.0f) / h_sq);
+                    w *= float(mult_y * getMultiplicity(i, m, width));
+
+                    int index = r * bWidth + c;
+                    tot[index] += w;
+
+                    float *tmp_src = &row[im * channels];
+                    float *tmp_acc = &acc[index * channels];
+
+                    for(int ch = 0; ch < channels; ch++) {
+                        tmp_acc[ch] += tmp_src[ch] * w;
+                    }
+                }
+            }
+        }
+    }
+
+    for(int j = box->y0; j < box->y1; j++) {
+        for(int i = box->x0; i < box->x1; i++) {
+            int index = (j - box->y0) * bWidth + (i - box->x0);
+
+            float *tmp_dst = (*dst)(i, j);
+            float *tmp_src = (*img)(i, j);
+            float *tmp_acc = &acc[index * channels];
+
+            bool sumTest = tot[index] > 0.0f;
+
+            for(int c = 0; c < channels; c++) {
+                tmp_dst[c] = sumTest ? tmp_acc[c] / tot[index] : tmp_src[c];
+            }
+        }
+    }
 }
 
 PIC_INLINE void FilterNonLocalMeansF::ProcessBBox(Image *dst, ImageVec src,
         BBox *box)
 {
+    if(bIntegral) {
+        ProcessBBoxIntegral(dst, src, box);
+        return;
+    }
+
     int width = dst->width;
     int height = dst->height;
     int channels = dst->channels;
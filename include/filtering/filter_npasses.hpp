@@ -18,9 +18,17 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_NPASSES_HPP
 #define PIC_FILTERING_FILTER_NPASSES_HPP
 
+#include <atomic>
+#include <vector>
+
 #include "../util/std_util.hpp"
 
+#include "../image_planar.hpp"
+
 #include "../filtering/filter.hpp"
+#include "../filtering/filter_conv_1d.hpp"
+#include "../util/span_ops.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace pic {
 
@@ -33,6 +41,7 @@ protected:
     Image *imgAllocated;
     Image *imgTmpSame[2];
     ImageVec imgTmp;
+    bool bFused;
 
     /**
      * @brief PreProcess
@@ -93,6 +102,68 @@ protected:
      */
     Image *ProcessSame(ImageVec imgIn, Image *imgOut, bool parallel);
 
+    /**
+     * @brief hasPlanarPasses checks if all passes have a planar path.
+     * @param imgIn
+     * @param imgOut
+     * @return This function returns true if imgIn can be processed in
+     * planes by ProcessPlanar.
+     */
+    bool hasPlanarPasses(ImageVec imgIn, Image *imgOut);
+
+    /**
+     * @brief ProcessPlanar splits imgIn in planes, it runs all passes on
+     * each plane, and it interleaves the planes into imgOut. This costs two
+     * extra copies of the image per Process call, so it is used only when
+     * the passes are faster on single channel images.
+     * @param imgIn
+     * @param imgOut
+     * @return
+     */
+    Image *ProcessPlanar(Image *imgIn, Image *imgOut);
+
+    /**
+     * @brief getFusedKernels checks if passes are a vertical and a horizontal
+     * convolution, with odd kernels, that can be fused.
+     * @param imgIn
+     * @param imgOut
+     * @param kernelY
+     * @param sizeY
+     * @param kernelX
+     * @param sizeX
+     * @return This function returns true if passes can be fused.
+     */
+    bool getFusedKernels(ImageVec imgIn, Image *imgOut, float *&kernelY, int &sizeY,
+                         float *&kernelX, int &sizeX);
+
+    /**
+     * @brief convolveRow convolves a row horizontally with replicated borders.
+     * @param out
+     * @param in
+     * @param width
+     * @param channels
+     * @param kernel
+     * @param size
+     */
+    static void convolveRow(float *out, float *in, int width, int channels,
+                            float *kernel, int size);
+
+    /**
+     * @brief ProcessFused runs a vertical and a horizontal convolution in a single
+     * sweep over bands of rows. Each thread keeps the horizontally filtered rows
+     * in a ring buffer as tall as the vertical kernel; so no full-size
+     * intermediate image is allocated.
+     * @param imgIn
+     * @param imgOut
+     * @param kernelY
+     * @param sizeY
+     * @param kernelX
+     * @param sizeX
+     * @return
+     */
+    Image *ProcessFused(Image *imgIn, Image *imgOut, float *kernelY, int sizeY,
+                        float *kernelX, int sizeX);
+
 public:
 
     /**
@@ -112,6 +183,16 @@ public:
      */
     void OutputSize(ImageVec imgIn, int &width, int &height, int &channels, int &frames);
 
+    /**
+     * @brief setFused enables or disables the fused executor for
+     * separable convolutions; it is enabled by default.
+     * @param bFused
+     */
+    void setFused(bool bFused)
+    {
+        this->bFused = bFused;
+    }
+
     /**
      * @brief Process
      * @param imgIn
@@ -124,6 +205,7 @@ public:
 PIC_INLINE FilterNPasses::FilterNPasses() : Filter()
 {
     imgAllocated = NULL;
+    bFused = true;
 
     for(int i = 0; i < 2; i++) {
         imgTmpSame[i] = NULL;
@@ -307,6 +389,187 @@ PIC_INLINE Image *FilterNPasses::ProcessSame(ImageVec imgIn, Image *imgOut,
     return imgOut;
 }
 
+PIC_INLINE bool FilterNPasses::hasPlanarPasses(ImageVec imgIn, Image *imgOut)
+{
+    if((imgIn.size() != 1) || (imgIn[0]->channels < 2) ||
+       ((imgOut != NULL) && !imgOut->isSimilarType(imgIn[0]))) {
+        return false;
+    }
+
+    int n = getIterations();
+
+    for(int i = 0; i < n; i++) {
+        if(!getFilter(i)->hasPlanarPath()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+PIC_INLINE Image *FilterNPasses::ProcessPlanar(Image *imgIn, Image *imgOut)
+{
+    if(imgOut == NULL) {
+        imgOut = imgIn->allocateSimilarOne();
+    }
+
+    ImagePlanar planesIn(imgIn);
+    ImagePlanar planesOut(imgIn->frames, imgIn->width, imgIn->height,
+                          imgIn->channels);
+
+    for(int c = 0; c < imgIn->channels; c++) {
+        ProcessSame(Single(planesIn.getPlane(c)), planesOut.getPlane(c));
+    }
+
+    return planesOut.toInterleaved(imgOut);
+}
+
+PIC_INLINE bool FilterNPasses::getFusedKernels(ImageVec imgIn,
+        Image *imgOut, float *&kernelY, int &sizeY, float *&kernelX, int &sizeX)
+{
+    if(!bFused || (imgIn.size() != 1) || (getIterations() != 2) ||
+       (imgOut == imgIn[0]) || imgIn[0]->isCompact() ||
+       ((imgOut != NULL) && imgOut->isCompact())) {
+        return false;
+    }
+
+    //the first pass is vertical, and the second one is horizontal
+    FilterConv1D *flt_y = dynamic_cast<FilterConv1D *>(getFilter(0));
+    FilterConv1D *flt_x = dynamic_cast<FilterConv1D *>(getFilter(1));
+
+    if((flt_y == NULL) || (flt_x == NULL)) {
+        return false;
+    }
+
+    if(!flt_y->getKernel(kernelY, sizeY) || !flt_x->getKernel(kernelX, sizeX)) {
+        return false;
+    }
+
+    //the ring buffer holds sizeY rows, which is enough only for odd kernels
+    return ((sizeY & 1) == 1) && ((sizeX & 1) == 1);
+}
+
+PIC_INLINE void FilterNPasses::convolveRow(float *out, float *in, int width,
+        int channels, float *kernel, int size)
+{
+    int half = size >> 1;
+    int x0 = MIN(half, width);
+    int x1 = MAX(width - half, x0);
+
+    //border
+    for(int i = 0; i < width; i++) {
+        if(i == x0) {
+            i = x1;
+
+            if(i >= width) {
+                break;
+            }
+        }
+
+        float *out_i = &out[i * channels];
+
+        for(int c = 0; c < channels; c++) {
+            out_i[c] = 0.0f;
+        }
+
+        for(int k = 0; k < size; k++) {
+            int ci = CLAMP(i + k - half, width) * channels;
+
+            for(int c = 0; c < channels; c++) {
+                out_i[c] += in[ci + c] * kernel[k];
+            }
+        }
+    }
+
+    //interior
+    if(x1 > x0) {
+        SpanOps::convolve(&out[x0 * channels], &in[x0 * channels],
+                          (x1 - x0) * channels, kernel, size, channels);
+    }
+}
+
+PIC_INLINE Image *FilterNPasses::ProcessFused(Image *imgIn, Image *imgOut,
+        float *kernelY, int sizeY, float *kernelX, int sizeX)
+{
+    if(imgOut == NULL) {
+        imgOut = imgIn->allocateSimilarOne();
+    } else {
+        if(!imgOut->isSimilarType(imgIn)) {
+            imgOut = imgIn->allocateSimilarOne();
+        }
+    }
+
+    int width = imgIn->width;
+    int height = imgIn->height;
+    int channels = imgIn->channels;
+    int rowSize = imgIn->ystride;
+    int halfY = sizeY >> 1;
+
+    ThreadPool *pool = ThreadPool::getInstance();
+    int nThreads = pool->getNumberOfThreads();
+
+    //bands are tall enough to amortize the rows of the vertical halo
+    int bandHeight = MAX(sizeY << 1, (height + (nThreads << 2) - 1) / (nThreads << 2));
+    bandHeight = MIN(bandHeight, height);
+    int nBands = (height + bandHeight - 1) / bandHeight;
+
+    std::atomic<int> next(0);
+    int nTasks = nBands * imgIn->frames;
+    int nLanes = MIN(nTasks, nThreads);
+
+    pool->parallelFor(nLanes, [&](int /*lane*/) {
+        std::vector< float > ring(sizeY * rowSize);
+        std::vector< float * > taps(sizeY);
+
+        while(true) {
+            int task = next++;
+
+            if(task >= nTasks) {
+                break;
+            }
+
+            int frame = task / nBands;
+            int y0 = (task % nBands) * bandHeight;
+            int y1 = MIN(y0 + bandHeight, height);
+
+            float *in  = imgIn->data  + frame * imgIn->tstride;
+            float *out = imgOut->data + frame * imgOut->tstride;
+
+            //rows filtered horizontally so far are in [r0, r1)
+            int r0 = MAX(y0 - halfY, 0);
+            int r1 = r0;
+
+            for(int j = y0; j < y1; j++) {
+                int r_end = MIN(j + halfY + 1, height);
+
+                for(; r1 < r_end; r1++) {
+                    convolveRow(&ring[(r1 % sizeY) * rowSize], in + r1 * rowSize,
+                                width, channels, kernelX, sizeX);
+                }
+
+                for(int k = 0; k < sizeY; k++) {
+                    int r = CLAMP(j + k - halfY, height);
+                    taps[k] = &ring[(r % sizeY) * rowSize];
+                }
+
+                float *out_j = out + j * rowSize;
+
+                for(int i = 0; i < rowSize; i += SPAN_OPS_CHUNK) {
+                    int len = MIN(SPAN_OPS_CHUNK, rowSize - i);
+
+                    SpanOps::assign(out_j + i, taps[0] + i, kernelY[0], len);
+
+                    for(int k = 1; k < sizeY; k++) {
+                        SpanOps::madd(out_j + i, taps[k] + i, kernelY[k], len);
+                    }
+                }
+            }
+        }
+    });
+
+    return imgOut;
+}
+
 PIC_INLINE Image *FilterNPasses::Process(ImageVec imgIn, 
         Image *imgOut)
 {
@@ -314,6 +577,10 @@ PIC_INLINE Image *FilterNPasses::Process(ImageVec imgIn,
         return imgOut;
     }
 
+    if(hasCompact(imgIn, imgOut)) {
+        return ProcessCompact(imgIn, imgOut);
+    }
+
     PreProcess(imgIn, imgOut);
 
     int width, height, frames, channels;
@@ -324,8 +591,17 @@ PIC_INLINE Image *FilterNPasses::Process(ImageVec imgIn,
                  (imgIn[0]->frames == frames) &&
                  (imgIn[0]->channels == channels);
 
+    float *kernelX, *kernelY;
+    int sizeX, sizeY;
+
     if(bSame) {
-        imgOut = ProcessSame(imgIn, imgOut);
+        if(getFusedKernels(imgIn, imgOut, kernelY, sizeY, kernelX, sizeX)) {
+            imgOut = ProcessFused(imgIn[0], imgOut, kernelY, sizeY, kernelX, sizeX);
+        } else if(hasPlanarPasses(imgIn, imgOut)) {
+            imgOut = ProcessPlanar(imgIn[0], imgOut);
+        } else {
+            imgOut = ProcessSame(imgIn, imgOut);
+        }
     } else {
         imgOut = ProcessGen(imgIn, imgOut);
     }
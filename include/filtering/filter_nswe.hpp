@@ -34,11 +34,11 @@ protected:
      */
     void f(FilterFData *data)
     {
-        float *img_data  = (*data->src[0])(data->x    , data->y);
-        float *img_dataN = (*data->src[0])(data->x + 1, data->y);
-        float *img_dataS = (*data->src[0])(data->x - 1, data->y);
-        float *img_dataW = (*data->src[0])(data->x    , data->y - 1);
-        float *img_dataE = (*data->src[0])(data->x    , data->y + 1);
+        float *img_data  = (*data->src[0])(data->x    , data->y, data->z);
+        float *img_dataN = (*data->src[0])(data->x + 1, data->y, data->z);
+        float *img_dataS = (*data->src[0])(data->x - 1, data->y, data->z);
+        float *img_dataW = (*data->src[0])(data->x    , data->y - 1, data->z);
+        float *img_dataE = (*data->src[0])(data->x    , data->y + 1, data->z);
 
         for(int k = 0; k < data->src[0]->channels; k++) {
             int tmp = k << 2;
@@ -49,6 +49,55 @@ protected:
         }
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        int channels = data->src[0]->channels;
+        int xstride = data->src[0]->xstride;
+        int ystride = data->src[0]->ystride;
+
+        for(int i = 0; i < (data->x1 - data->x0); i++) {
+            float *img_data = data->in[0] + i * xstride;
+            float *out = data->out + i * data->dst->xstride;
+
+            for(int k = 0; k < channels; k++) {
+                int tmp = k << 2;
+                float val = img_data[k];
+                out[tmp    ] = img_data[k + xstride] - val;
+                out[tmp + 1] = img_data[k - xstride] - val;
+                out[tmp + 2] = img_data[k - ystride] - val;
+                out[tmp + 3] = img_data[k + ystride] - val;
+            }
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 1;
+        borderY = 1;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @param src
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec &src)
+    {
+        return dst->channels == (src[0]->channels << 2);
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
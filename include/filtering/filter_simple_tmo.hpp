@@ -36,13 +36,40 @@ protected:
      */
     void f(FilterFData *data)
     {
-        float *dataIn = (*data->src[0])(data->x, data->y);
+        float *dataIn = (*data->src[0])(data->x, data->y, data->z);
 
         for(int k = 0; k < data->dst->channels; k++) {
             data->out[k] = powf((dataIn[k] * exposure), gamma);
         }
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        float *in = data->in[0];
+        int n = (data->x1 - data->x0) * data->dst->channels;
+
+        for(int i = 0; i < n; i++) {
+            data->out[i] = powf((in[i] * exposure), gamma);
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
 public:
     /**
      * @brief FilterSimpleTMO
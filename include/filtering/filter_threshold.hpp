@@ -32,45 +32,77 @@ protected:
     bool bAdaptive;
 
     /**
-     * @brief ProcessBBox
-     * @param dst
-     * @param src
-     * @param box
+     * @brief f
+     * @param data
      */
-    void ProcessBBox(Image *dst, ImageVec src, BBox *box)
+    void f(FilterFData *data)
     {
-        Image* img = src[0];
+        float *img_val = (*data->src[0])(data->x, data->y, data->z);
 
         if(bAdaptive) {
-            if(src.size() < 2) {
+            if(data->nSrc < 2) {
                 return;
             }
 
-            Image* img_ada = src[1];
+            float *img_ada_val = (*data->src[1])(data->x, data->y, data->z);
 
-            for(int j = box->y0; j < box->y1; j++) {
+            data->out[0] = img_val[0] > img_ada_val[0] ? 1.0f : 0.0f;
+        } else {
+            data->out[0] = img_val[0] > threshold ? 1.0f : 0.0f;
+        }
+    }
 
-                for(int i = box->x0; i < box->x1; i++) {
-                    float *dst_val = (*dst)(i, j);
-                    float *img_val = (*img)(i, j);
-                    float *img_ada_val = (*img_ada)(i, j);
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        float *in = data->in[0];
+        int channels = data->src[0]->channels;
+        int n = data->x1 - data->x0;
 
-                    dst_val[0] = img_val[0] > img_ada_val[0] ? 1.0f : 0.0f;
-                }
+        if(bAdaptive) {
+            if(data->nSrc < 2) {
+                return;
             }
-        } else {
-            for(int j = box->y0; j < box->y1; j++) {
 
-                for(int i = box->x0; i < box->x1; i++) {
-                    float *dst_val = (*dst)(i, j);
-                    float *img_val = (*img)(i, j);
+            float *in_ada = data->in[1];
+            int channels_ada = data->src[1]->channels;
 
-                    dst_val[0] = img_val[0] > threshold ? 1.0f : 0.0f;
-                }
+            for(int i = 0; i < n; i++) {
+                data->out[i] = in[i * channels] > in_ada[i * channels_ada] ? 1.0f : 0.0f;
+            }
+        } else {
+            for(int i = 0; i < n; i++) {
+                data->out[i] = in[i * channels] > threshold ? 1.0f : 0.0f;
             }
         }
     }
 
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 0;
+        borderY = 0;
+        return true;
+    }
+
+    /**
+     * @brief checkSpanChannels
+     * @param dst
+     * @return
+     */
+    bool checkSpanChannels(Image *dst, ImageVec & /*src*/)
+    {
+        return dst->channels == 1;
+    }
+
 public:
 
     /**
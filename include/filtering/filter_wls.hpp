@@ -18,7 +18,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_FILTERING_FILTER_WLS_HPP
 #define PIC_FILTERING_FILTER_WLS_HPP
 
+#include <math.h>
+#include <vector>
+
 #include "../filtering/filter.hpp"
+#include "../util/thread_pool.hpp"
+#include "../algorithms/multigrid_solver.hpp"
 
 #ifndef PIC_DISABLE_EIGEN
 
@@ -34,11 +39,80 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 namespace pic {
 
-#ifndef PIC_DISABLE_EIGEN
-
+/**
+ * @brief The FilterWLS class is the weighted least squares smoothing of
+ * Farbman et al. (2008). The sparse system is factored with Cholesky, or,
+ * in the matrix-free mode, it is solved by a MultigridSolver whose
+ * couplings are computed from the input image.
+ */
 class FilterWLS: public Filter
 {
 protected:
+    bool bMatrixFree, bWarmStart;
+    MultigridSolver solver;
+    std::vector< float > wx, wy, c;
+
+    /**
+     * @brief matrixFree applies WLS smoothing with a MultigridSolver.
+     * @param imgIn
+     * @param imgOut
+     * @param bPrevious uses imgOut as the initial guess.
+     * @return
+     */
+    Image *matrixFree(ImageVec imgIn, Image *imgOut, bool bPrevious)
+    {
+        Image *img = imgIn[0];
+
+        int width  = img->width;
+        int height = img->height;
+        int channels = img->channels;
+        int tot    = height * width;
+
+        wx.resize(tot);
+        wy.resize(tot);
+        c.assign(tot, 1.0f);
+
+        //|L_i - L_j|^alpha for gray-scale, ||I_i - I_j||^alpha for color
+        float alpha_2 = alpha * 0.5f;
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int j) {
+            for(int i = 0; i < width; i++) {
+                float *data = (*img)(i, j);
+                float *data_x = (*img)(i + 1, j);
+                float *data_y = (*img)(i, j + 1);
+
+                float diff_x = 0.0f;
+                float diff_y = 0.0f;
+
+                for(int p = 0; p < channels; p++) {
+                    float tmp_x = data_x[p] - data[p];
+                    float tmp_y = data_y[p] - data[p];
+                    diff_x += tmp_x * tmp_x;
+                    diff_y += tmp_y * tmp_y;
+                }
+
+                int ind = j * width + i;
+
+                wx[ind] = (i < (width - 1)) ? lambda / (powf(diff_x, alpha_2) + epsilon) : 0.0f;
+                wy[ind] = (j < (height - 1)) ? lambda / (powf(diff_y, alpha_2) + epsilon) : 0.0f;
+            }
+        });
+
+        solver.setup(width, height, &wx[0], &wy[0], &c[0]);
+
+        //A = I + L, so the input is a good initial guess
+        if(!bPrevious) {
+            imgOut->assign(img);
+        }
+
+        for(int p = 0; p < imgOut->channels; p++) {
+            solver.solve(&imgOut->data[p], &img->data[p], channels);
+        }
+
+        return imgOut;
+    }
+
+#ifndef PIC_DISABLE_EIGEN
     /**
      * @brief singleChannel applies WLS smoothing filter for gray-scale images.
      * @param imgIn
@@ -156,7 +230,7 @@ protected:
         int height = img->height;
         int tot    = height * width;
 
-        alpha /= 2.0f;
+        float alpha = this->alpha / 2.0f;
 
         int stridex = width * img->channels;
 
@@ -283,6 +357,7 @@ protected:
 
         return imgOut;
     }
+#endif
 
     float alpha, lambda, epsilon;
 
@@ -294,6 +369,8 @@ public:
     FilterWLS() : Filter()
     {
         update(1.2f, 1.0f);
+        setMatrixFree(false);
+        setTolerance(1e-7f);
     }
 
     /**
@@ -304,6 +381,8 @@ public:
     FilterWLS(float alpha, float lambda) : Filter()
     {
         update(alpha, lambda);
+        setMatrixFree(false);
+        setTolerance(1e-7f);
     }
 
     /**
@@ -327,6 +406,35 @@ public:
         this->lambda = lambda;
     }
 
+    /**
+     * @brief setMatrixFree selects the solver; without Eigen, the filter is
+     * always matrix-free.
+     * @param bMatrixFree
+     * @param bWarmStart uses the output image passed to Process as the
+     * initial guess; e.g., the previous frame of a video.
+     * @param preconditioner
+     */
+    void setMatrixFree(bool bMatrixFree, bool bWarmStart = false,
+                       MULTIGRID_PRECONDITIONER preconditioner = MGP_VCYCLE)
+    {
+#ifdef PIC_DISABLE_EIGEN
+        bMatrixFree = true;
+#endif
+        this->bMatrixFree = bMatrixFree;
+        this->bWarmStart = bWarmStart;
+        solver.preconditioner = preconditioner;
+    }
+
+    /**
+     * @brief setTolerance sets the relative residual at convergence of the
+     * matrix-free mode.
+     * @param tolerance
+     */
+    void setTolerance(float tolerance)
+    {
+        solver.tolerance = tolerance > 0.0f ? tolerance : 1e-7f;
+    }
+
     /**
      * @brief Process
      * @param imgIn
@@ -343,18 +451,32 @@ public:
             return imgOut;
         }
 
+        if(hasCompact(imgIn, imgOut)) {
+            return ProcessCompact(imgIn, imgOut);
+        }
+
+        bool bPrevious = bWarmStart && (imgOut != NULL) &&
+                         imgOut->isSimilarType(imgIn[0]);
+
         imgOut = setupAux(imgIn, imgOut);
 
         if(imgOut == NULL) {
             return imgOut;
         }
 
-        //convolution
+        if(bMatrixFree) {
+            return matrixFree(imgIn, imgOut, bPrevious);
+        }
+
+#ifndef PIC_DISABLE_EIGEN
         if(imgIn[0]->channels == 1) {
             return singleChannel(imgIn, imgOut);
         } else {
             return multiChannel(imgIn, imgOut);
         }
+#else
+        return imgOut;
+#endif
     }
 
     /**
@@ -388,7 +510,6 @@ public:
         return 0;
     }
 };
-#endif
 
 } // end namespace pic
 
@@ -38,9 +38,9 @@ protected:
 
         float value;
 
-        float *data_src  = (*data->src[0])(data->x, data->y);
-        float *data_src0 = (*data->src[0])(data->x, data->y + 1);
-        float *data_src1 = (*data->src[0])(data->x + 1, data->y);
+        float *data_src  = (*data->src[0])(data->x, data->y, data->z);
+        float *data_src0 = (*data->src[0])(data->x, data->y + 1, data->z);
+        float *data_src1 = (*data->src[0])(data->x + 1, data->y, data->z);
 
         for(int k = 0; k < data->src[0]->channels; k++) {
             value = (data_src[k] == 0.0f) ? 1.0f : 0.0f;
@@ -52,6 +52,47 @@ protected:
         }
     }
 
+    /**
+     * @brief fSpan
+     * @param data
+     */
+    void fSpan(FilterSpanData *data)
+    {
+        int channels = data->src[0]->channels;
+        int xstride = data->src[0]->xstride;
+        int ystride = data->src[0]->ystride;
+
+        for(int i = 0; i < (data->x1 - data->x0); i++) {
+            float *data_src = data->in[0] + i * xstride;
+            float *data_src0 = data_src + ystride;
+            float *data_src1 = data_src + xstride;
+            float *out = data->out + i * data->dst->xstride;
+
+            for(int k = 0; k < channels; k++) {
+                float value;
+                value = (data_src[k] == 0.0f) ? 1.0f : 0.0f;
+                value = (data_src[k] > 0.0f && data_src0[k] < 0.0f) ? 1.0f : value;
+                value = (data_src[k] < 0.0f && data_src0[k] > 0.0f) ? 1.0f : value;
+                value = (data_src[k] > 0.0f && data_src1[k] < 0.0f) ? 1.0f : value;
+                value = (data_src[k] < 0.0f && data_src1[k] > 0.0f) ? 1.0f : value;
+                out[k] = value;
+            }
+        }
+    }
+
+    /**
+     * @brief getSpanBorder
+     * @param borderX
+     * @param borderY
+     * @return
+     */
+    bool getSpanBorder(int &borderX, int &borderY)
+    {
+        borderX = 1;
+        borderY = 1;
+        return true;
+    }
+
     /**
      * @brief ProcessBBox
      * @param dst
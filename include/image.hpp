@@ -36,6 +36,10 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "util/array.hpp"
 #include "util/indexed_array.hpp"
 #include "util/std_util.hpp"
+#include "util/buffer_pool.hpp"
+#include "util/half.hpp"
+#include "util/thread_pool.hpp"
+#include "image_expr.hpp"
 
 //IO formats
 #include "io/bmp.hpp"
@@ -69,6 +73,31 @@ PIC_INLINE float estimateAverageLuminance(float shutter_speed, float aperture_va
     return (iso_value * shutter_speed) / (K_value * aperture_value * aperture_value);
 }
 
+/**
+ * @brief The IMAGE_STORAGE enum
+ * IS_FLOAT: pixels are stored as float in data
+ *
+ * IS_HALF: pixels are stored as half float (IEEE 754 binary16) in dataCompact
+ *
+ * IS_UINT16: pixels in [0, 1] are stored as 16-bit integers in dataCompact
+ *
+ * IS_UINT8: pixels in [0, 1] are stored as 8-bit integers in dataCompact
+ *
+ * Statistics and operators work on compact images in chunks of floats, and
+ * values are quantized again after each operator; e.g. a = (a + b) * c is
+ * quantized once, while a += b; a *= c is quantized twice. Pixel pointers,
+ * e.g. operator (), require IS_FLOAT (see isValid and setStorage).
+ */
+enum IMAGE_STORAGE {IS_FLOAT, IS_HALF, IS_UINT16, IS_UINT8};
+
+/**
+ * @brief IMAGE_STORAGE_CHUNK is the number of values converted by a task
+ * when the storage of an image is changed.
+ */
+#ifndef IMAGE_STORAGE_CHUNK
+#define IMAGE_STORAGE_CHUNK 65536
+#endif
+
 /**
  * @brief The Image class stores an image as buffer of float.
  */
@@ -86,6 +115,11 @@ protected:
     int  readerCounter;
     bool notOwned;
 
+    //data was allocated from the BufferPool
+    bool bPool;
+
+    IMAGE_STORAGE storage;
+
     BBox fullBox;
 
     LDR_type typeLoad;
@@ -110,6 +144,12 @@ public:
      */
     float *dataTMP;
 
+    /**
+     * @brief dataCompact is the buffer where pixel values are stored when
+     * the storage is not IS_FLOAT; in this case, data is NULL.
+     */
+    unsigned char *dataCompact;
+
     /**
      * @brief dataUC is a buffer for rendering 8-bit images.
      */
@@ -290,14 +330,101 @@ public:
      */
     void setRand(unsigned int seed);
 
+    /**
+     * @brief getStorage
+     * @return This function returns how pixels are stored.
+     */
+    IMAGE_STORAGE getStorage() const
+    {
+        return storage;
+    }
+
+    /**
+     * @brief isCompact
+     * @return This function returns true if pixels are not stored as float;
+     * in this case, data is NULL, and the image has to be promoted to float
+     * before accessing data. Filters promote their inputs automatically.
+     */
+    bool isCompact() const
+    {
+        return storage != IS_FLOAT;
+    }
+
+    /**
+     * @brief setStorage converts the pixels of the image into a storage.
+     * IS_UINT16 and IS_UINT8 clamp values in [0, 1].
+     * @param storage
+     * @return This function returns true if the image was converted; images
+     * that do not own their data cannot be converted.
+     */
+    bool setStorage(IMAGE_STORAGE storage);
+
+    /**
+     * @brief promoteSpan converts n values starting at the offset-th one
+     * into floats.
+     * @param offset
+     * @param n
+     * @param out
+     */
+    void promoteSpan(int offset, int n, float *out) const;
+
+    /**
+     * @brief demoteSpan converts n floats into the compact storage
+     * starting at the offset-th value.
+     * @param offset
+     * @param n
+     * @param in
+     */
+    void demoteSpan(int offset, int n, const float *in);
+
+    /**
+     * @brief getValues returns n values starting at the offset-th one as
+     * floats.
+     * @param offset
+     * @param n
+     * @param buffer stores the promoted values of a compact image.
+     * @return This function returns a pointer into data for a float image,
+     * otherwise a pointer to buffer.
+     */
+    float *getValues(int offset, int n, std::vector< float > &buffer) const;
+
+    /**
+     * @brief processValues calls func(values, offset, n) on all values of
+     * the image, where values points to the n floats starting at the
+     * offset-th one. A float image is passed in a single call. A compact
+     * image is processed in parallel chunks of whole pixels: each chunk is
+     * promoted to a float buffer, processed, and demoted back, so the image
+     * is never converted as a whole.
+     * @param func
+     * @param bRead has to be false when func overwrites all values without
+     * reading them; in this case, chunks are not promoted.
+     */
+    void processValues(std::function<void(float *, int, int)> func, bool bRead = true);
+
+    /**
+     * @brief promote returns a copy of the image stored as float.
+     * @param imgOut is the output image; it is allocated if NULL or if
+     * it does not have the same size.
+     * @return
+     */
+    Image *promote(Image *imgOut = NULL) const;
+
     /**
      * @brief isValid checks if the current image is valid, which means if they
-     * have an allocated buffer or not.
-     * @return This function return true if the current Image is allocated,
-     * otherwise false.
+     * have an allocated float buffer or not; a compact image is not valid
+     * until it is promoted to float (see isAllocated).
+     * @return This function return true if the current Image is allocated
+     * as float, otherwise false.
      */
     bool isValid();
 
+    /**
+     * @brief isAllocated checks if the current image has pixels, which are
+     * stored as float or in a compact mode.
+     * @return
+     */
+    bool isAllocated() const;
+
     /**
      * @brief isSimilarType checks if the current image is similar to img;
      * i.e. if they have the same width, height, frames, and channels.
@@ -764,30 +891,76 @@ public:
     void operator =(const float &a);
 
     /**
-     * @brief operator +=
-     * @param a
+     * @brief Image evaluates an expression of images into a new image;
+     * e.g. Image c = (a * w + b) / d.
+     * @param e
      */
-    void operator +=(const float &a);
+    template<class E>
+    Image(const ImageExpr<E> &e)
+    {
+        setNULL();
+
+        const Image *img;
+        int width, height, channels, frames;
+
+        if(e.self().getShape(img, width, height, channels, frames)) {
+            allocate(width, height, channels, frames);
+
+            flippedEXR = img->flippedEXR;
+            exposure = img->exposure;
+            alpha = img->alpha;
+
+            evaluateImageExpr(data, e.self(), nPixels(), channels);
+        }
+    }
 
     /**
-     * @brief operator +
-     * @param a
-     * @return it returns (this + a)
+     * @brief operator = evaluates an expression of images in a single pass.
+     * The expression may contain this image.
+     * @param e
      */
-    Image operator +(const float &a) const;
+    template<class E>
+    void operator =(const ImageExpr<E> &e)
+    {
+        const Image *img;
+        int width, height, channels, frames;
+
+        if(!e.self().getShape(img, width, height, channels, frames)) {
+            return;
+        }
+
+        bool bSame = (this->width == width) && (this->height == height) &&
+                     (this->channels == channels) && (this->frames == frames) &&
+                     isAllocated();
+
+        if(bSame) {
+            if(isCompact()) {
+                //a compact image is evaluated in chunks of floats
+                const E &expr = e.self();
+
+                processValues([&expr, channels](float *values, int offset, int n) {
+                    evaluateImageExprRange(values, expr, offset, offset + n, channels);
+                }, false);
+            } else {
+                evaluateImageExpr(data, e.self(), nPixels(), channels);
+            }
+        } else {
+            Image tmp(e);
+            assign(&tmp);
+        }
+    }
 
     /**
      * @brief operator +=
      * @param a
      */
-    void operator +=(const Image &a);
+    void operator +=(const float &a);
 
     /**
-     * @brief operator +
+     * @brief operator +=
      * @param a
-     * @return it returns (this + a)
      */
-    Image operator +(const Image &a) const;
+    void operator +=(const Image &a);
 
     /**
      * @brief operator *=
@@ -795,83 +968,42 @@ public:
      */
     void operator *=(const float &a);
 
-    /**
-     * @brief operator *
-     * @param a
-     * @return it returns (this * a)
-     */
-    Image operator *(const float &a) const;
-
     /**
      * @brief operator *=
      * @param a
      */
     void operator *=(const Image &a);
 
-    /**
-     * @brief operator *
-     * @param a
-     * @return it returns (this * a)
-     */
-    Image operator *(const Image &a) const;
-
     /**
      * @brief operator -=
      * @param a
      */
     void operator -=(const float &a);
 
-    /**
-     * @brief operator -
-     * @param a
-     * @return it returns (this - a)
-     */
-    Image operator -(const float &a) const;
-
     /**
      * @brief operator -=
      * @param a
      */
     void operator -=(const Image &a);
 
-    /**
-     * @brief operator -
-     * @param a
-     * @return it returns (this - a)
-     */
-    Image operator -(const Image &a) const;
-
     /**
      * @brief operator /=
      * @param a
      */
     void operator /=(const float &a);
 
-    /**
-     * @brief operator /
-     * @param a
-     * @return it returns (this / a)
-     */
-    Image operator /(const float &a) const;
-
     /**
      * @brief operator /=
      * @param a
      */
     void operator /=(const Image &a);
-
-    /**
-     * @brief operator /
-     * @param a
-     * @return it returns (this / a)
-     */
-    Image operator /(const Image &a) const;
 };
 
 PIC_INLINE void Image::setNULL()
 {
     nameFile = "";
     notOwned = false;
+    bPool = false;
 
     alpha = -1;
     tstride = -1;
@@ -893,6 +1025,8 @@ PIC_INLINE void Image::setNULL()
 
     dataTMP = NULL;
     data = NULL;
+    dataCompact = NULL;
+    storage = IS_FLOAT;
     dataUC = NULL;
     dataRGBE = NULL;
     typeLoad = LT_NONE;
@@ -997,9 +1131,19 @@ PIC_INLINE void Image::release()
 {
     //release all allocated resources
     if(!notOwned) {
-        data = delete_vec_s(data);
+        if(bPool) {
+            BufferPool::getInstance()->release(data);
+            data = NULL;
+        } else {
+            data = delete_vec_s(data);
+        }
     }
 
+    bPool = false;
+
+    dataCompact = delete_vec_s(dataCompact);
+    storage = IS_FLOAT;
+
     dataTMP = delete_vec_s(dataTMP);
     dataUC = delete_vec_s(dataUC);
     dataRGBE = delete_vec_s(dataRGBE);
@@ -1032,7 +1176,16 @@ PIC_INLINE void Image::allocate(int width, int height, int channels, int frames)
     this->height = height;
     this->notOwned = false;
 
-    data = new float [height * width * channels * frames];
+    size_t n = size_t(height) * size_t(width) * size_t(channels) * size_t(frames);
+
+    BufferPool *pool = BufferPool::getInstance();
+    bPool = pool->isEnabled();
+
+    if(bPool) {
+        data = pool->allocate(n);
+    } else {
+        data = new float [n];
+    }
 
     allocateAux();
 }
@@ -1068,7 +1221,12 @@ PIC_INLINE void Image::assign(const Image *imgIn)
         return;
     }
 
-    if(!isSimilarType(imgIn)) {
+    if(imgIn == this) {
+        return;
+    }
+
+    //a similar image keeps its storage
+    if(!isSimilarType(imgIn) || !isAllocated()) {
         release();
         allocate(imgIn->width, imgIn->height, imgIn->channels, imgIn->frames);
     }
@@ -1078,32 +1236,35 @@ PIC_INLINE void Image::assign(const Image *imgIn)
     typeLoad = imgIn->typeLoad;
     flippedEXR = imgIn->flippedEXR;
 
-    memcpy(data, imgIn->data, frames * width * height * channels * sizeof(float));
+    processValues([imgIn](float *values, int offset, int n) {
+        imgIn->promoteSpan(offset, n, values);
+    }, false);
 }
 
 PIC_INLINE void Image::clamp(float a = 0.0f, float b = 1.0f)
 {
-    int n = size();
-
-    #pragma omp parallel for
+    processValues([a, b](float *values, int, int n) {
+        #pragma omp parallel for
 
-    for(int i = 0; i < n; i++) {
-        data[i] = CLAMPi(data[i], a, b);
-    }
+        for(int i = 0; i < n; i++) {
+            values[i] = CLAMPi(values[i], a, b);
+        }
+    });
 }
 
 PIC_INLINE void Image::removeSpecials()
 {
-    int n = size();
-    #pragma omp parallel for
+    processValues([](float *values, int, int n) {
+        #pragma omp parallel for
 
-    for(int i = 0; i < n; i++) {
-        float val = data[i];
+        for(int i = 0; i < n; i++) {
+            float val = values[i];
 
-        if(isnan(val) || isinf(val)) {
-            data[i] = 0.0f;
+            if(isnan(val) || isinf(val)) {
+                values[i] = 0.0f;
+            }
         }
-    }
+    });
 }
 
 PIC_INLINE bool Image::isSimilarType(const Image *img)
@@ -1135,6 +1296,196 @@ PIC_INLINE bool Image::isValid()
            (data != NULL);
 }
 
+PIC_INLINE bool Image::isAllocated() const
+{
+    return (width > 0) && (height > 0) && (channels > 0) && (frames > 0) &&
+           ((data != NULL) || (dataCompact != NULL));
+}
+
+PIC_INLINE void Image::promoteSpan(int offset, int n, float *out) const
+{
+    switch(storage) {
+    case IS_HALF: {
+        halfToFloatBuffer(((unsigned short *) dataCompact) + offset, out, n);
+    } break;
+
+    case IS_UINT16: {
+        const unsigned short *in = ((unsigned short *) dataCompact) + offset;
+
+        for(int i = 0; i < n; i++) {
+            out[i] = float(in[i]) / 65535.0f;
+        }
+    } break;
+
+    case IS_UINT8: {
+        const unsigned char *in = dataCompact + offset;
+
+        for(int i = 0; i < n; i++) {
+            out[i] = float(in[i]) / 255.0f;
+        }
+    } break;
+
+    default: {
+        memcpy(out, data + offset, n * sizeof(float));
+    } break;
+    }
+}
+
+PIC_INLINE void Image::demoteSpan(int offset, int n, const float *in)
+{
+    switch(storage) {
+    case IS_HALF: {
+        floatToHalfBuffer(in, ((unsigned short *) dataCompact) + offset, n);
+    } break;
+
+    case IS_UINT16: {
+        unsigned short *out = ((unsigned short *) dataCompact) + offset;
+
+        for(int i = 0; i < n; i++) {
+            out[i] = (unsigned short) (CLAMPi(in[i], 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+    } break;
+
+    case IS_UINT8: {
+        unsigned char *out = dataCompact + offset;
+
+        for(int i = 0; i < n; i++) {
+            out[i] = (unsigned char) (CLAMPi(in[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    } break;
+
+    default: {
+        memcpy(data + offset, in, n * sizeof(float));
+    } break;
+    }
+}
+
+PIC_INLINE float *Image::getValues(int offset, int n,
+                                   std::vector< float > &buffer) const
+{
+    if(!isCompact()) {
+        return data + offset;
+    }
+
+    if(int(buffer.size()) < n) {
+        buffer.resize(n);
+    }
+
+    promoteSpan(offset, n, &buffer[0]);
+    return &buffer[0];
+}
+
+PIC_INLINE void Image::processValues(std::function<void(float *, int, int)> func,
+                                     bool bRead)
+{
+    if(!isAllocated()) {
+        return;
+    }
+
+    int n = size();
+
+    if(!isCompact()) {
+        func(data, 0, n);
+        return;
+    }
+
+    int chunk = MAX((IMAGE_STORAGE_CHUNK / channels) * channels, channels);
+    int nChunks = (n + chunk - 1) / chunk;
+
+    ThreadPool::getInstance()->parallelFor(nChunks, [&](int k) {
+        int i0 = k * chunk;
+        int len = MIN(chunk, n - i0);
+
+        std::vector< float > buffer(len);
+
+        if(bRead) {
+            promoteSpan(i0, len, &buffer[0]);
+        }
+
+        func(&buffer[0], i0, len);
+
+        demoteSpan(i0, len, &buffer[0]);
+    });
+}
+
+PIC_INLINE bool Image::setStorage(IMAGE_STORAGE storage)
+{
+    if(this->storage == storage) {
+        return true;
+    }
+
+    if(!isAllocated() || notOwned) {
+        return false;
+    }
+
+    int n = size();
+    int nChunks = (n + IMAGE_STORAGE_CHUNK - 1) / IMAGE_STORAGE_CHUNK;
+
+    //the new buffer
+    Image tmp;
+    tmp.storage = storage;
+
+    if(storage == IS_FLOAT) {
+        BufferPool *pool = BufferPool::getInstance();
+        tmp.bPool = pool->isEnabled();
+        tmp.data = tmp.bPool ? pool->allocate(n) : new float[n];
+    } else {
+        int bytes = (storage == IS_UINT8) ? 1 : 2;
+        tmp.dataCompact = new unsigned char[size_t(n) * size_t(bytes)];
+    }
+
+    ThreadPool::getInstance()->parallelFor(nChunks, [&](int k) {
+        int i0 = k * IMAGE_STORAGE_CHUNK;
+        int len = MIN(IMAGE_STORAGE_CHUNK, n - i0);
+
+        if(this->storage == IS_FLOAT) {
+            tmp.demoteSpan(i0, len, data + i0);
+        } else {
+            if(storage == IS_FLOAT) {
+                promoteSpan(i0, len, tmp.data + i0);
+            } else {
+                std::vector< float > buffer(len);
+                promoteSpan(i0, len, &buffer[0]);
+                tmp.demoteSpan(i0, len, &buffer[0]);
+            }
+        }
+    });
+
+    //swap buffers; tmp releases the old ones
+    std::swap(data, tmp.data);
+    std::swap(dataCompact, tmp.dataCompact);
+    std::swap(bPool, tmp.bPool);
+    std::swap(this->storage, tmp.storage);
+
+    return true;
+}
+
+PIC_INLINE Image *Image::promote(Image *imgOut) const
+{
+    if((imgOut == NULL) || (imgOut->width != width) || (imgOut->height != height) ||
+       (imgOut->channels != channels) || (imgOut->frames != frames) ||
+       (imgOut->data == NULL)) {
+        delete_s(imgOut);
+        imgOut = new Image(frames, width, height, channels);
+    }
+
+    imgOut->exposure = exposure;
+    imgOut->nameFile = nameFile;
+    imgOut->alpha = alpha;
+    imgOut->typeLoad = typeLoad;
+    imgOut->flippedEXR = flippedEXR;
+
+    int n = size();
+    int nChunks = (n + IMAGE_STORAGE_CHUNK - 1) / IMAGE_STORAGE_CHUNK;
+
+    ThreadPool::getInstance()->parallelFor(nChunks, [&](int k) {
+        int i0 = k * IMAGE_STORAGE_CHUNK;
+        promoteSpan(i0, MIN(IMAGE_STORAGE_CHUNK, n - i0), imgOut->data + i0);
+    });
+
+    return imgOut;
+}
+
 PIC_INLINE void Image::copySubImage(Image *imgIn, int startX, int startY)
 {
     if(imgIn == NULL) {
@@ -1215,35 +1566,27 @@ PIC_INLINE void Image::scaleCosine()
 
 PIC_INLINE void Image::applyFunction(float(*func)(float))
 {
-    if(!isValid()) {
-        return;
-    }
-
-    int size = frames * width * height * channels;
-
-    #pragma omp parallel for
-    for(int i = 0; i < size; i++) {
-        data[i] = (*func)(data[i]);
-    }
+    processValues([func](float *values, int, int size) {
+        #pragma omp parallel for
+        for(int i = 0; i < size; i++) {
+            values[i] = (*func)(values[i]);
+        }
+    });
 }
 
 PIC_INLINE void Image::applyFunctionParam(float(*func)(float, std::vector<float>&), std::vector<float> &param)
 {
-    if(!isValid()) {
-        return;
-    }
-
-    int size = frames * width * height * channels;
-
-    #pragma omp parallel for
-    for(int i = 0; i < size; i++) {
-        data[i] = (*func)(data[i], param);
-    }
+    processValues([func, &param](float *values, int, int size) {
+        #pragma omp parallel for
+        for(int i = 0; i < size; i++) {
+            values[i] = (*func)(values[i], param);
+        }
+    });
 }
 
 PIC_INLINE void Image::sort()
 {
-    if(!isValid()) {
+    if(!isAllocated()) {
         return;
     }
 
@@ -1251,7 +1594,7 @@ PIC_INLINE void Image::sort()
 
     if(dataTMP == NULL) {
         dataTMP = new float[size];
-        memcpy(dataTMP, data, sizeof(float) * size);
+        promoteSpan(0, size, dataTMP);
     }
 
     std::sort(dataTMP, dataTMP + size);
@@ -1259,7 +1602,7 @@ PIC_INLINE void Image::sort()
 
 PIC_INLINE float Image::getPercentileVal(float perCent = 0.5f)
 {
-    if(!isValid()) {
+    if(!isAllocated()) {
         return -1.0f;
     }
 
@@ -1281,6 +1624,13 @@ PIC_INLINE float Image::getMedVal()
 
 PIC_INLINE float Image::getDynamicRange(bool bRobust = false, float percentile = 0.99f)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        float ret = tmp->getDynamicRange(bRobust, percentile);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return -1.0f;
     }
@@ -1399,17 +1749,13 @@ PIC_INLINE void Image::maximum(Image *img)
 
 PIC_INLINE void Image::setZero()
 {
-    if(!isValid()) {
-        return;
-    }
-
-    int n = size();
+    processValues([](float *values, int, int n) {
+        #pragma omp parallel for
 
-    #pragma omp parallel for
-
-    for(int i = 0; i < n; i++) {
-        data[i] = 0.0f;
-    }
+        for(int i = 0; i < n; i++) {
+            values[i] = 0.0f;
+        }
+    }, false);
 }
 
 PIC_INLINE void Image::setRand(unsigned int seed = 1)
@@ -1428,6 +1774,13 @@ PIC_INLINE void Image::setRand(unsigned int seed = 1)
 
 PIC_INLINE float *Image::getMaxVal(BBox *box = NULL, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getMaxVal(box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1461,6 +1814,13 @@ PIC_INLINE float *Image::getMaxVal(BBox *box = NULL, float *ret = NULL)
 
 PIC_INLINE float *Image::getMinVal(BBox *box = NULL, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getMinVal(box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1494,6 +1854,13 @@ PIC_INLINE float *Image::getMinVal(BBox *box = NULL, float *ret = NULL)
 
 PIC_INLINE float *Image::getSumVal(BBox *box = NULL, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getSumVal(box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1523,6 +1890,13 @@ PIC_INLINE float *Image::getSumVal(BBox *box = NULL, float *ret = NULL)
 
 PIC_INLINE float *Image::getMeanVal(BBox *box = NULL, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getMeanVal(box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1542,6 +1916,13 @@ PIC_INLINE float *Image::getMeanVal(BBox *box = NULL, float *ret = NULL)
 
 PIC_INLINE float *Image::getMomentsVal(int x0, int y0, int radius, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getMomentsVal(x0, y0, radius, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1575,6 +1956,13 @@ PIC_INLINE float *Image::getMomentsVal(int x0, int y0, int radius, float *ret =
 PIC_INLINE float *Image::getVarianceVal(float *meanVal = NULL, BBox *box = NULL,
                                         float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getVarianceVal(meanVal, box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1623,6 +2011,13 @@ PIC_INLINE float *Image::getVarianceVal(float *meanVal = NULL, BBox *box = NULL,
 
 PIC_INLINE float *Image::getCovMtxVal(float *meanVal, BBox *box, float *ret)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getCovMtxVal(meanVal, box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1677,6 +2072,13 @@ PIC_INLINE float *Image::getCovMtxVal(float *meanVal, BBox *box, float *ret)
 
 PIC_INLINE float *Image::getLogMeanVal(BBox *box = NULL, float *ret = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        ret = tmp->getLogMeanVal(box, ret);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return ret;
     }
@@ -1734,6 +2136,13 @@ PIC_INLINE void Image::convertFromMask(bool *mask, int width, int height)
 PIC_INLINE bool *Image::convertToMask(float *color = NULL, float threshold = 0.25f,
                                       bool cmp = true,  bool *mask = NULL)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        mask = tmp->convertToMask(color, threshold, cmp, mask);
+        delete tmp;
+        return mask;
+    }
+
     if(!isValid()) {
         return NULL;
     }
@@ -1948,6 +2357,13 @@ PIC_INLINE bool Image::Read(std::string nameFile,
 PIC_INLINE bool Image::Write(std::string nameFile, LDR_type typeWrite = LT_NOR_GAMMA,
                                 int writerCounter = 0)
 {
+    if(isCompact()) {
+        Image *tmp = promote();
+        bool ret = tmp->Write(nameFile, typeWrite, writerCounter);
+        delete tmp;
+        return ret;
+    }
+
     if(!isValid()) {
         return false;
     }
@@ -2068,7 +2484,7 @@ PIC_INLINE Image *Image::allocateSimilarOne()
 PIC_INLINE void Image::allocateSimilarTo(Image *img)
 {
     if(img != NULL) {
-        if(img->isValid()) {
+        if(img->isAllocated()) {
             allocate(img->width, img->height, img->channels, img->frames);
         }
     }
@@ -2085,7 +2501,16 @@ PIC_INLINE Image *Image::clone() const
     ret->alpha = alpha;
     ret->typeLoad = typeLoad;
 
-    memcpy(ret->data, data, width * height * channels * sizeof(float));
+    if(isCompact()) {
+        size_t bytes = size_t(size()) * ((storage == IS_UINT8) ? 1 : 2);
+
+        ret->release();
+        ret->storage = storage;
+        ret->dataCompact = new unsigned char[bytes];
+        memcpy(ret->dataCompact, dataCompact, bytes);
+    } else {
+        memcpy(ret->data, data, width * height * channels * sizeof(float));
+    }
 
     return ret;
 }
@@ -2128,129 +2553,142 @@ PIC_INLINE void Image::operator =(const Image &a)
 
 PIC_INLINE void Image::operator =(const float &a)
 {
-    Buffer<float>::assign(data, size(), a);
+    processValues([a](float *values, int, int n) {
+        Buffer<float>::assign(values, n, a);
+    }, false);
 }
 
 PIC_INLINE void Image::operator +=(const float &a)
 {
-    Buffer<float>::add(data, size(), a);
-}
-
-PIC_INLINE Image Image::operator +(const float &a) const
-{
-    Image *out = this->clone();
-    *out += a;
-    return Image(out, false);
+    processValues([a](float *values, int, int n) {
+        Buffer<float>::add(values, n, a);
+    });
 }
 
 PIC_INLINE void Image::operator +=(const Image &a)
 {
+    //compact operands are read and written in chunks
     if(isSimilarType(&a)) {
-        Buffer<float>::add(data, a.data, size());
+        processValues([&a](float *values, int offset, int n) {
+            std::vector< float > buffer;
+            Buffer<float>::add(values, a.getValues(offset, n, buffer), n);
+        });
     } else {
         if((nPixels() == a.nPixels()) && (a.channels == 1)) {
-            Buffer<float>::addS(data, a.data, nPixels(), channels);
+            int channels = this->channels;
+
+            processValues([&a, channels](float *values, int offset, int n) {
+                std::vector< float > buffer;
+                int nPixels = n / channels;
+                Buffer<float>::addS(values, a.getValues(offset / channels, nPixels, buffer),
+                                  nPixels, channels);
+            });
         }
     }
-
-}
-
-PIC_INLINE Image Image::operator +(const Image &a) const
-{
-    Image *out = this->clone();
-    *out += a;
-    return Image(out, false);
 }
 
 PIC_INLINE void Image::operator *=(const float &a)
 {
-    Buffer<float>::mul(data, size(), a);
-}
-
-PIC_INLINE Image Image::operator *(const float &a) const
-{
-    Image *out = this->clone();
-    *out *= a;
-    return Image(out, false);
+    processValues([a](float *values, int, int n) {
+        Buffer<float>::mul(values, n, a);
+    });
 }
 
 PIC_INLINE void Image::operator *=(const Image &a)
 {
+    //compact operands are read and written in chunks
     if(isSimilarType(&a)) {
-        Buffer<float>::mul(data, a.data, size());
+        processValues([&a](float *values, int offset, int n) {
+            std::vector< float > buffer;
+            Buffer<float>::mul(values, a.getValues(offset, n, buffer), n);
+        });
     } else {
         if((nPixels() == a.nPixels()) && (a.channels == 1)) {
-            Buffer<float>::mulS(data, a.data, nPixels(), channels);
+            int channels = this->channels;
+
+            processValues([&a, channels](float *values, int offset, int n) {
+                std::vector< float > buffer;
+                int nPixels = n / channels;
+                Buffer<float>::mulS(values, a.getValues(offset / channels, nPixels, buffer),
+                                  nPixels, channels);
+            });
         }
     }
 }
 
-PIC_INLINE Image Image::operator *(const Image &a) const
-{
-    Image *out = this->clone();
-    *out *= a;
-    return Image(out, false);
-}
-
 PIC_INLINE void Image::operator -=(const float &a)
 {
-    Buffer<float>::sub(data, size(), a);
-}
-
-PIC_INLINE Image Image::operator -(const float &a) const
-{
-    Image *out = this->clone();
-    *out -= a;
-    return Image(out, false);
+    processValues([a](float *values, int, int n) {
+        Buffer<float>::sub(values, n, a);
+    });
 }
 
 PIC_INLINE void Image::operator -=(const Image &a)
 {
+    //compact operands are read and written in chunks
     if(isSimilarType(&a)) {
-        Buffer<float>::sub(data, a.data, size());
+        processValues([&a](float *values, int offset, int n) {
+            std::vector< float > buffer;
+            Buffer<float>::sub(values, a.getValues(offset, n, buffer), n);
+        });
     } else {
         if((nPixels() == a.nPixels()) && (a.channels == 1)) {
-            Buffer<float>::subS(data, a.data, nPixels(), channels);
+            int channels = this->channels;
+
+            processValues([&a, channels](float *values, int offset, int n) {
+                std::vector< float > buffer;
+                int nPixels = n / channels;
+                Buffer<float>::subS(values, a.getValues(offset / channels, nPixels, buffer),
+                                  nPixels, channels);
+            });
         }
     }
 }
 
-PIC_INLINE Image Image::operator -(const Image &a) const
-{
-    Image *out = this->clone();
-    *out -= a;
-    return Image(out, false);
-}
-
 PIC_INLINE void Image::operator /=(const float &a)
 {
-    Buffer<float>::div(data, size(), a);
-}
-
-PIC_INLINE Image Image::operator /(const float &a) const
-{
-    Image *out = this->clone();
-    *out /= a;
-    return Image(out, false);
+    processValues([a](float *values, int, int n) {
+        Buffer<float>::div(values, n, a);
+    });
 }
 
 PIC_INLINE void Image::operator /=(const Image &a)
 {
+    //compact operands are read and written in chunks
     if(isSimilarType(&a)) {
-        Buffer<float>::div(data, a.data, size());
+        processValues([&a](float *values, int offset, int n) {
+            std::vector< float > buffer;
+            Buffer<float>::div(values, a.getValues(offset, n, buffer), n);
+        });
     } else {
         if((nPixels() == a.nPixels()) && (a.channels == 1)) {
-            Buffer<float>::divS(data, a.data, nPixels(), channels);
+            int channels = this->channels;
+
+            processValues([&a, channels](float *values, int offset, int n) {
+                std::vector< float > buffer;
+                int nPixels = n / channels;
+                Buffer<float>::divS(values, a.getValues(offset / channels, nPixels, buffer),
+                                  nPixels, channels);
+            });
         }
     }
 }
 
-PIC_INLINE Image Image::operator /(const Image &a) const
+PIC_INLINE ImageExprLeaf toImageExpr(const Image &img)
 {
-    Image *out = this->clone();
-    *out /= a;
-    return Image(out, false);
+    if(!img.isCompact()) {
+        return ImageExprLeaf(&img, img.data, img.width, img.height,
+                             img.channels, img.frames);
+    }
+
+    std::shared_ptr<Image> promoted(img.promote());
+
+    ImageExprLeaf leaf(&img, promoted->data, img.width, img.height,
+                       img.channels, img.frames);
+    leaf.promoted = promoted;
+    return leaf;
 }
+
 } // end namespace pic
 
 #endif /* PIC_IMAGE_HPP */
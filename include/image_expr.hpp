@@ -0,0 +1,450 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_IMAGE_EXPR_HPP
+#define PIC_IMAGE_EXPR_HPP
+
+#include <memory>
+
+#include "base.hpp"
+#include "util/math.hpp"
+#include "util/thread_pool.hpp"
+
+namespace pic {
+
+class Image;
+
+/**
+ * @brief IMAGE_EXPR_CHUNK is the number of floats evaluated by a task
+ * when an expression is evaluated on the ThreadPool.
+ */
+#ifndef IMAGE_EXPR_CHUNK
+#define IMAGE_EXPR_CHUNK 16384
+#endif
+
+/**
+ * @brief The ImageExpr struct is the base of expression templates on images.
+ * An expression such as (a * w + b) / c, where a, b and c are images, is not
+ * evaluated until it is assigned to an Image; then, it is evaluated in a
+ * single pass without temporary images.
+ * Each node implements:
+ * flat<bCheck>(i), the value at the i-th float when all images have the same
+ * number of channels; pixel<bCheck>(p, c), the value of channel c of the
+ * p-th pixel; isFlat(channels); isValid(); isCompatible(width, height,
+ * frames, channels); and getShape(...). When bCheck is false, operands are
+ * assumed to be compatible; i.e. isValid() is true.
+ */
+template<class E>
+struct ImageExpr
+{
+    /**
+     * @brief self
+     * @return It returns the derived expression.
+     */
+    const E &self() const
+    {
+        return *static_cast<const E *>(this);
+    }
+};
+
+/**
+ * @brief The ImageExprLeaf struct is an image in an expression; a compact
+ * image is read from a float copy, which is shared by the copies of the leaf.
+ */
+struct ImageExprLeaf: public ImageExpr<ImageExprLeaf>
+{
+    const Image *img;
+    const float *data;
+    int width, height, channels, frames;
+    std::shared_ptr<Image> promoted;
+
+    ImageExprLeaf(const Image *img, const float *data, int width, int height,
+                  int channels, int frames)
+    {
+        this->img = img;
+        this->data = data;
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+        this->frames = frames;
+    }
+
+    template<bool bCheck>
+    inline float flat(int i) const
+    {
+        return data[i];
+    }
+
+    template<bool bCheck>
+    inline float pixel(int p, int c) const
+    {
+        return channels == 1 ? data[p] : data[p * channels + c];
+    }
+
+    bool isFlat(int channels) const
+    {
+        return this->channels == channels;
+    }
+
+    bool isValid() const
+    {
+        return true;
+    }
+
+    /**
+     * @brief isCompatible checks if the image can be combined with an
+     * image of the given size; they must have the same width, height, and
+     * frames, and single channel images are broadcast over channels.
+     * @param width
+     * @param height
+     * @param frames
+     * @param channels
+     * @return
+     */
+    bool isCompatible(int width, int height, int frames, int channels) const
+    {
+        return (this->width == width) && (this->height == height) &&
+               (this->frames == frames) &&
+               ((this->channels == channels) || (this->channels == 1));
+    }
+
+    bool getShape(const Image *&img, int &width, int &height, int &channels,
+                  int &frames) const
+    {
+        img = this->img;
+        width = this->width;
+        height = this->height;
+        channels = this->channels;
+        frames = this->frames;
+        return data != NULL;
+    }
+};
+
+/**
+ * @brief The ImageExprScalar struct is a constant in an expression.
+ */
+struct ImageExprScalar: public ImageExpr<ImageExprScalar>
+{
+    float value;
+
+    ImageExprScalar(float value)
+    {
+        this->value = value;
+    }
+
+    template<bool bCheck>
+    inline float flat(int) const
+    {
+        return value;
+    }
+
+    template<bool bCheck>
+    inline float pixel(int, int) const
+    {
+        return value;
+    }
+
+    bool isFlat(int) const
+    {
+        return true;
+    }
+
+    bool isValid() const
+    {
+        return true;
+    }
+
+    bool isCompatible(int, int, int, int) const
+    {
+        return true;
+    }
+
+    bool getShape(const Image *&, int &, int &, int &, int &) const
+    {
+        return false;
+    }
+};
+
+struct ImageExprAdd
+{
+    static inline float apply(float a, float b)
+    {
+        return a + b;
+    }
+};
+
+struct ImageExprSub
+{
+    static inline float apply(float a, float b)
+    {
+        return a - b;
+    }
+};
+
+struct ImageExprMul
+{
+    static inline float apply(float a, float b)
+    {
+        return a * b;
+    }
+};
+
+struct ImageExprDiv
+{
+    static inline float apply(float a, float b)
+    {
+        return a / b;
+    }
+};
+
+/**
+ * @brief The ImageExprBinary struct applies OP to two expressions. As for
+ * the compound assignment operators of Image, if the right operand does not
+ * fit the shape of the left one, the result is the left operand.
+ */
+template<class OP, class L, class R>
+struct ImageExprBinary: public ImageExpr< ImageExprBinary<OP, L, R> >
+{
+    L l;
+    R r;
+    bool bValid;
+
+    ImageExprBinary(const L &l, const R &r) : l(l), r(r)
+    {
+        const Image *img;
+        int width, height, channels, frames;
+
+        if(l.getShape(img, width, height, channels, frames)) {
+            bValid = r.isCompatible(width, height, frames, channels);
+        } else {
+            bValid = true;
+        }
+    }
+
+    template<bool bCheck>
+    inline float flat(int i) const
+    {
+        if(bCheck && !bValid) {
+            return l.template flat<bCheck>(i);
+        }
+
+        return OP::apply(l.template flat<bCheck>(i), r.template flat<bCheck>(i));
+    }
+
+    template<bool bCheck>
+    inline float pixel(int p, int c) const
+    {
+        if(bCheck && !bValid) {
+            return l.template pixel<bCheck>(p, c);
+        }
+
+        return OP::apply(l.template pixel<bCheck>(p, c), r.template pixel<bCheck>(p, c));
+    }
+
+    bool isFlat(int channels) const
+    {
+        return l.isFlat(channels) && (!bValid || r.isFlat(channels));
+    }
+
+    bool isValid() const
+    {
+        return bValid && l.isValid() && r.isValid();
+    }
+
+    bool isCompatible(int width, int height, int frames, int channels) const
+    {
+        return l.isCompatible(width, height, frames, channels) &&
+               (!bValid || r.isCompatible(width, height, frames, channels));
+    }
+
+    bool getShape(const Image *&img, int &width, int &height, int &channels,
+                  int &frames) const
+    {
+        if(l.getShape(img, width, height, channels, frames)) {
+            return true;
+        }
+
+        return r.getShape(img, width, height, channels, frames);
+    }
+};
+
+/**
+ * @brief evaluateImageExprChunk evaluates the floats [i0, i1) of an
+ * expression into out, which points to the i0-th float; i0 and i1 are
+ * multiples of channels.
+ * @param out
+ * @param e
+ * @param i0
+ * @param i1
+ * @param channels
+ * @param bFlat
+ */
+template<bool bCheck, class E>
+void evaluateImageExprChunk(float *out, const E &e, int i0, int i1,
+                            int channels, bool bFlat)
+{
+    if(bFlat) {
+        int n = i1 - i0;
+
+        for(int i = 0; i < n; i++) {
+            out[i] = e.template flat<bCheck>(i0 + i);
+        }
+    } else {
+        int p0 = i0 / channels;
+        int p1 = i1 / channels;
+
+        for(int p = p0; p < p1; p++) {
+            float *out_p = &out[(p - p0) * channels];
+
+            for(int c = 0; c < channels; c++) {
+                out_p[c] = e.template pixel<bCheck>(p, c);
+            }
+        }
+    }
+}
+
+/**
+ * @brief evaluateImageExprRange evaluates the floats [i0, i1) of an
+ * expression into out, which points to the i0-th float; i0 and i1 are
+ * multiples of channels. Operands are checked once, so loops of valid
+ * expressions have no branches.
+ * @param out
+ * @param e
+ * @param i0
+ * @param i1
+ * @param channels
+ */
+template<class E>
+void evaluateImageExprRange(float *out, const E &e, int i0, int i1, int channels)
+{
+    bool bFlat = e.isFlat(channels);
+
+    if(e.isValid()) {
+        evaluateImageExprChunk<false>(out, e, i0, i1, channels, bFlat);
+    } else {
+        evaluateImageExprChunk<true>(out, e, i0, i1, channels, bFlat);
+    }
+}
+
+/**
+ * @brief evaluateImageExpr evaluates an expression into a buffer; chunks
+ * of the buffer are evaluated in parallel on the ThreadPool.
+ * @param out is the output buffer; it may alias the images of the
+ * expression with the same shape.
+ * @param e is the expression.
+ * @param nPixels is the number of pixels of out.
+ * @param channels is the number of channels of out.
+ */
+template<class E>
+void evaluateImageExpr(float *out, const E &e, int nPixels, int channels)
+{
+    int n = nPixels * channels;
+
+    if(n <= 0) {
+        return;
+    }
+
+    int chunk = MAX((IMAGE_EXPR_CHUNK / channels) * channels, channels);
+    int nChunks = (n + chunk - 1) / chunk;
+
+    ThreadPool::getInstance()->parallelFor(nChunks, [&](int k) {
+        int i0 = k * chunk;
+        int i1 = MIN(i0 + chunk, n);
+
+        evaluateImageExprRange(out + i0, e, i0, i1, channels);
+    });
+}
+
+/**
+ * @brief toImageExpr
+ * @param img
+ * @return It returns the leaf of an image.
+ */
+PIC_INLINE ImageExprLeaf toImageExpr(const Image &img);
+
+template<class E>
+inline const E &toImageExpr(const ImageExpr<E> &e)
+{
+    return e.self();
+}
+
+inline ImageExprScalar toImageExpr(const float &value)
+{
+    return ImageExprScalar(value);
+}
+
+/**
+ * @brief PIC_IMAGE_EXPR_OPERATOR declares an operator between images,
+ * expressions, and scalars.
+ */
+#define PIC_IMAGE_EXPR_OPERATOR(op, OP)                                                              \
+inline ImageExprBinary<OP, ImageExprLeaf, ImageExprLeaf> operator op(const Image &a, const Image &b) \
+{                                                                                                    \
+    return ImageExprBinary<OP, ImageExprLeaf, ImageExprLeaf>(toImageExpr(a), toImageExpr(b));        \
+}                                                                                                    \
+                                                                                                     \
+inline ImageExprBinary<OP, ImageExprLeaf, ImageExprScalar> operator op(const Image &a, const float &b) \
+{                                                                                                    \
+    return ImageExprBinary<OP, ImageExprLeaf, ImageExprScalar>(toImageExpr(a), toImageExpr(b));      \
+}                                                                                                    \
+                                                                                                     \
+inline ImageExprBinary<OP, ImageExprScalar, ImageExprLeaf> operator op(const float &a, const Image &b) \
+{                                                                                                    \
+    return ImageExprBinary<OP, ImageExprScalar, ImageExprLeaf>(toImageExpr(a), toImageExpr(b));      \
+}                                                                                                    \
+                                                                                                     \
+template<class L>                                                                                    \
+inline ImageExprBinary<OP, L, ImageExprLeaf> operator op(const ImageExpr<L> &a, const Image &b)      \
+{                                                                                                    \
+    return ImageExprBinary<OP, L, ImageExprLeaf>(a.self(), toImageExpr(b));                          \
+}                                                                                                    \
+                                                                                                     \
+template<class R>                                                                                    \
+inline ImageExprBinary<OP, ImageExprLeaf, R> operator op(const Image &a, const ImageExpr<R> &b)      \
+{                                                                                                    \
+    return ImageExprBinary<OP, ImageExprLeaf, R>(toImageExpr(a), b.self());                          \
+}                                                                                                    \
+                                                                                                     \
+template<class L, class R>                                                                           \
+inline ImageExprBinary<OP, L, R> operator op(const ImageExpr<L> &a, const ImageExpr<R> &b)           \
+{                                                                                                    \
+    return ImageExprBinary<OP, L, R>(a.self(), b.self());                                            \
+}                                                                                                    \
+                                                                                                     \
+template<class L>                                                                                    \
+inline ImageExprBinary<OP, L, ImageExprScalar> operator op(const ImageExpr<L> &a, const float &b)    \
+{                                                                                                    \
+    return ImageExprBinary<OP, L, ImageExprScalar>(a.self(), ImageExprScalar(b));                    \
+}                                                                                                    \
+                                                                                                     \
+template<class R>                                                                                    \
+inline ImageExprBinary<OP, ImageExprScalar, R> operator op(const float &a, const ImageExpr<R> &b)    \
+{                                                                                                    \
+    return ImageExprBinary<OP, ImageExprScalar, R>(ImageExprScalar(a), b.self());                    \
+}
+
+PIC_IMAGE_EXPR_OPERATOR(+, ImageExprAdd)
+PIC_IMAGE_EXPR_OPERATOR(-, ImageExprSub)
+PIC_IMAGE_EXPR_OPERATOR(*, ImageExprMul)
+PIC_IMAGE_EXPR_OPERATOR(/, ImageExprDiv)
+
+#undef PIC_IMAGE_EXPR_OPERATOR
+
+} // end namespace pic
+
+#endif /* PIC_IMAGE_EXPR_HPP */
+
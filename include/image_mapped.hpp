@@ -0,0 +1,217 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_IMAGE_MAPPED_HPP
+#define PIC_IMAGE_MAPPED_HPP
+
+#include <string>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "util/io.hpp"
+#include "io/mapped_file.hpp"
+#include "io/pfm.hpp"
+#include "io/tmp.hpp"
+
+namespace pic {
+
+/**
+ * @brief The MappedImage class loads an image by mapping its file in memory.
+ * Little-endian PFM and TMP files are exposed as an Image that does not own
+ * its data and points directly into the mapping; the mapping is private, so
+ * filters can write the image without modifying the file. Other files are
+ * loaded in a regular Image.
+ * Note that PFM scanlines are stored bottom-up: a zero-copy PFM image is
+ * vertically flipped (see isBottomUp). The operator () and getScanline
+ * access pixels top-down, as in Image::Read, and setTopDown flips the
+ * mapped rows in place.
+ */
+class MappedImage
+{
+protected:
+    MappedFile file;
+    Image *img;
+    bool bZeroCopy, bBottomUp;
+
+    //a mapping cannot be shared
+    MappedImage(const MappedImage &);
+    MappedImage &operator =(const MappedImage &);
+
+public:
+
+    MappedImage()
+    {
+        img = NULL;
+        bZeroCopy = false;
+        bBottomUp = false;
+    }
+
+    MappedImage(std::string nameFile)
+    {
+        img = NULL;
+        bZeroCopy = false;
+        bBottomUp = false;
+        open(nameFile);
+    }
+
+    ~MappedImage()
+    {
+        close();
+    }
+
+    /**
+     * @brief open loads an image; PFM and TMP files are mapped without
+     * copies when possible.
+     * @param nameFile
+     * @return It returns true if the image was loaded.
+     */
+    bool open(std::string nameFile)
+    {
+        close();
+
+        LABEL_IO_EXTENSION label = getLabelHDRExtension(nameFile);
+
+        if((label == IO_PFM) || (label == IO_TMP)) {
+            //the image is a writable, copy-on-write view of the file
+            if(file.open(nameFile, true)) {
+                int width, height, channels, frames = 1;
+                float *ptr;
+
+                if(label == IO_PFM) {
+                    ptr = MapPFM(file, width, height, channels);
+                } else {
+                    ptr = MapTMP(file, width, height, channels, frames);
+                }
+
+                if(ptr != NULL) {
+                    img = new Image(frames, width, height, channels, ptr);
+                    bZeroCopy = true;
+                    bBottomUp = (label == IO_PFM) && (height > 1);
+                    return true;
+                }
+
+                file.close();
+            }
+        }
+
+        img = new Image(nameFile);
+
+        if(!img->isValid()) {
+            delete img;
+            img = NULL;
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief close releases the image and unmaps its file.
+     */
+    void close()
+    {
+        if(img != NULL) {
+            delete img;
+            img = NULL;
+        }
+
+        file.close();
+        bZeroCopy = false;
+        bBottomUp = false;
+    }
+
+    /**
+     * @brief getImage
+     * @return It returns the loaded image; it is valid until close is called.
+     */
+    Image *getImage()
+    {
+        return img;
+    }
+
+    /**
+     * @brief isZeroCopy
+     * @return It returns true if the image points into the mapped file.
+     */
+    bool isZeroCopy()
+    {
+        return bZeroCopy;
+    }
+
+    /**
+     * @brief isBottomUp
+     * @return It returns true if the first row of the image is the bottom
+     * scanline.
+     */
+    bool isBottomUp()
+    {
+        return bBottomUp;
+    }
+
+    /**
+     * @brief getScanline returns a scanline in top-down order, regardless
+     * of how the image is stored.
+     * @param y
+     * @param frame
+     * @return
+     */
+    float *getScanline(int y, int frame = 0)
+    {
+        if(img == NULL) {
+            return NULL;
+        }
+
+        int row = bBottomUp ? (img->height - 1 - y) : y;
+        return &img->data[frame * img->tstride + row * img->ystride];
+    }
+
+    /**
+     * @brief operator () returns a pointer to a pixel at (x, y, t) in
+     * top-down order, regardless of how the image is stored.
+     * @param x is the horizontal coordinate in pixels
+     * @param y is the vertical coordinate in pixels
+     * @param t is the temporal coordinate in pixels
+     * @return This function returns a pointer to data at location (x, y, t).
+     */
+    float *operator()(int x, int y, int t = 0)
+    {
+        if(img == NULL) {
+            return NULL;
+        }
+
+        y = CLAMP(y, img->height);
+        return (*img)(x, bBottomUp ? (img->height - 1 - y) : y, t);
+    }
+
+    /**
+     * @brief setTopDown flips the rows of a bottom-up image in place, so
+     * that getImage matches Image::Read. The mapping is private, so the file
+     * is not modified, but the flipped pages are copied by the system.
+     */
+    void setTopDown()
+    {
+        if(bBottomUp && (img != NULL)) {
+            img->flipV();
+            bBottomUp = false;
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_IMAGE_MAPPED_HPP */
+
@@ -0,0 +1,232 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_IMAGE_PLANAR_HPP
+#define PIC_IMAGE_PLANAR_HPP
+
+#include <vector>
+
+#include "base.hpp"
+#include "image.hpp"
+#include "image_vec.hpp"
+#include "util/thread_pool.hpp"
+
+namespace pic {
+
+/**
+ * @brief The ImagePlanar class stores the channels of an image in separate
+ * planes (SoA layout), whereas Image interleaves them. Each plane is exposed
+ * as a single channel Image that does not own its data, so any filter can
+ * process a plane, and the pixels of a plane are contiguous in memory.
+ */
+class ImagePlanar
+{
+protected:
+    float *data;
+    int width, height, channels, frames;
+    ImageVec planes;
+
+    //a planar image cannot be shared
+    ImagePlanar(const ImagePlanar &);
+    ImagePlanar &operator =(const ImagePlanar &);
+
+public:
+
+    ImagePlanar()
+    {
+        data = NULL;
+        width = height = channels = frames = 0;
+    }
+
+    /**
+     * @brief ImagePlanar converts an interleaved image into planes.
+     * @param img
+     */
+    ImagePlanar(const Image *img)
+    {
+        data = NULL;
+        width = height = channels = frames = 0;
+        fromInterleaved(img);
+    }
+
+    ImagePlanar(int frames, int width, int height, int channels)
+    {
+        data = NULL;
+        this->width = this->height = this->channels = this->frames = 0;
+        allocate(frames, width, height, channels);
+    }
+
+    ~ImagePlanar()
+    {
+        release();
+    }
+
+    /**
+     * @brief allocate allocates planes; it does nothing if planes with
+     * the same size are already allocated.
+     * @param frames
+     * @param width
+     * @param height
+     * @param channels
+     */
+    void allocate(int frames, int width, int height, int channels)
+    {
+        if((data != NULL) && (this->width == width) && (this->height == height) &&
+           (this->channels == channels) && (this->frames == frames)) {
+            return;
+        }
+
+        release();
+
+        if(width < 1 || height < 1 || channels < 1 || frames < 1) {
+            return;
+        }
+
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+        this->frames = frames;
+
+        int planeSize = width * height * frames;
+        data = new float[planeSize * channels];
+
+        for(int c = 0; c < channels; c++) {
+            planes.push_back(new Image(frames, width, height, 1, data + c * planeSize));
+        }
+    }
+
+    /**
+     * @brief release
+     */
+    void release()
+    {
+        stdVectorClear<Image>(planes);
+        data = delete_vec_s(data);
+        width = height = channels = frames = 0;
+    }
+
+    /**
+     * @brief fromInterleaved copies an interleaved image into the planes;
+     * scanlines are converted in parallel.
+     * @param img
+     */
+    void fromInterleaved(const Image *img)
+    {
+        if(img == NULL || img->data == NULL) {
+            return;
+        }
+
+        allocate(img->frames, img->width, img->height, img->channels);
+
+        int planeSize = width * height * frames;
+        int nRows = height * frames;
+
+        ThreadPool::getInstance()->parallelFor(nRows, [&](int r) {
+            const float *in = img->data + r * img->ystride;
+
+            for(int c = 0; c < channels; c++) {
+                float *out = data + c * planeSize + r * width;
+
+                for(int x = 0; x < width; x++) {
+                    out[x] = in[x * channels + c];
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief toInterleaved copies the planes into an interleaved image.
+     * @param imgOut is the output image; it is allocated if NULL, and
+     * it is not modified if its size is different.
+     * @return
+     */
+    Image *toInterleaved(Image *imgOut = NULL) const
+    {
+        if(data == NULL) {
+            return imgOut;
+        }
+
+        if(imgOut == NULL) {
+            imgOut = new Image(frames, width, height, channels);
+        }
+
+        if((imgOut->width != width) || (imgOut->height != height) ||
+           (imgOut->channels != channels) || (imgOut->frames != frames) ||
+           (imgOut->data == NULL)) {
+            return imgOut;
+        }
+
+        int planeSize = width * height * frames;
+        int nRows = height * frames;
+
+        ThreadPool::getInstance()->parallelFor(nRows, [&](int r) {
+            float *out = imgOut->data + r * imgOut->ystride;
+
+            for(int c = 0; c < channels; c++) {
+                const float *in = data + c * planeSize + r * width;
+
+                for(int x = 0; x < width; x++) {
+                    out[x * channels + c] = in[x];
+                }
+            }
+        });
+
+        return imgOut;
+    }
+
+    /**
+     * @brief getPlane
+     * @param c
+     * @return It returns the c-th plane as a single channel image.
+     */
+    Image *getPlane(int c)
+    {
+        return planes[c];
+    }
+
+    /**
+     * @brief getPlanes
+     * @return It returns all planes.
+     */
+    ImageVec &getPlanes()
+    {
+        return planes;
+    }
+
+    /**
+     * @brief getChannels
+     * @return
+     */
+    int getChannels() const
+    {
+        return channels;
+    }
+
+    /**
+     * @brief isValid
+     * @return
+     */
+    bool isValid() const
+    {
+        return data != NULL;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_IMAGE_PLANAR_HPP */
+
@@ -161,7 +161,7 @@ PIC_INLINE bool ImageVecCheck(ImageVec &imgIn, int minInputImages)
         if(imgIn[i] == NULL) {
             return false;
         } else {
-            if(!imgIn[i]->isValid()) {
+            if(!imgIn[i]->isAllocated()) {
                 return false;
             }
         }
@@ -22,6 +22,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "io/exr.hpp"
 #include "io/exr_tiny.hpp"
 #include "io/hdr.hpp"
+#include "io/mapped_file.hpp"
 #include "io/pfm.hpp"
 #include "io/ppm.hpp"
 #include "io/pgm.hpp"
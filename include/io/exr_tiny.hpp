@@ -24,67 +24,622 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #define TINYEXR_IMPLEMENTATION
 
+#include <atomic>
+#include <string>
+#include <vector>
+
 #include "../util/std_util.hpp"
+#include "../util/math.hpp"
+#include "../util/half.hpp"
+#include "../util/thread_pool.hpp"
+#include "../io/mapped_file.hpp"
 
 #include "../externals/tinyexr/tinyexr.h"
 
 namespace pic {
 
-PIC_INLINE float *ReadEXR(std::string nameFile, float *data, int &width, int &height, int &channels)
+/**
+ * @brief The EXRLayout struct describes the scanline blocks of an EXR file.
+ */
+struct EXRLayout
 {
-    EXRImage image;
-    InitEXRImage(&image);
+    int width, height, y0;
+    int compression, linesPerBlock, nBlocks;
 
-    const char* err;
-    int ret = ParseMultiChannelEXRHeaderFromFile(&image, nameFile.c_str(), &err);
-    if (ret != 0) {
+    //bytes of a scanline with all channels
+    int lineSize;
+
+    std::vector<std::string> names;
+    std::vector<int> types, offsets;
+    std::vector<long long> blockOffsets;
+};
+
+/**
+ * @brief ParseLayoutEXR parses the header and the offset table of a
+ * scanline EXR file in memory. Subsampled channels (x or y sampling
+ * different from 1) are not supported, and they are read errors.
+ * @param buffer
+ * @param size
+ * @param layout
+ * @return It returns true if the file can be decoded.
+ */
+PIC_INLINE bool ParseLayoutEXR(const unsigned char *buffer, size_t size,
+                               EXRLayout &layout)
+{
+    const unsigned char magic[] = {0x76, 0x2f, 0x31, 0x01};
+
+    //only single-part scanline files
+    if((size < 8) || (memcmp(buffer, magic, 4) != 0) || (buffer[4] != 2) ||
+       (buffer[5] != 0) || (buffer[6] != 0) || (buffer[7] != 0)) {
+        return false;
+    }
+
+    const char *marker = (const char *) &buffer[8];
+
+    int box[4] = {0, 0, -1, -1};
+    bool bSampled = false;
+    layout.compression = -1;
+    layout.names.clear();
+    layout.types.clear();
+    layout.offsets.clear();
+
+    for(;;) {
+        std::string attrName, attrType;
+        std::vector<unsigned char> attrData;
+        const char *marker_next = ReadAttribute(attrName, attrType, attrData, marker);
+
+        if(marker_next == NULL) {
+            marker++;
+            break;
+        }
+
+        if(attrName.compare("compression") == 0) {
+            layout.compression = attrData[0];
+        } else {
+            if(attrName.compare("channels") == 0) {
+                std::vector<ChannelInfo> channels;
+                ReadChannelInfo(channels, attrData);
+
+                for(unsigned int i = 0; i < channels.size(); i++) {
+                    layout.names.push_back(channels[i].name);
+                    layout.types.push_back(channels[i].pixelType);
+                    bSampled = bSampled || (channels[i].xSampling != 1) ||
+                               (channels[i].ySampling != 1);
+                }
+            } else {
+                if(attrName.compare("dataWindow") == 0) {
+                    memcpy(box, &attrData[0], sizeof(int) * 4);
+                }
+            }
+        }
+
+        marker = marker_next;
+    }
+
+    //no compression, ZIPS, ZIP, and PIZ
+    switch(layout.compression) {
+    case 0:
+    case 2:
+        layout.linesPerBlock = 1;
+        break;
+
+    case 3:
+        layout.linesPerBlock = 16;
+        break;
+
+    case 4:
+        layout.linesPerBlock = 32;
+        break;
+
+    default:
+        return false;
+    }
+
+    //the data window may have a negative origin
+    if(layout.names.empty() || bSampled ||
+       (box[2] < box[0]) || (box[3] < box[1]) ||
+       ((long long) box[2] - box[0] >= 0x7fffffffLL) ||
+       ((long long) box[3] - box[1] >= 0x7fffffffLL)) {
+        return false;
+    }
+
+    layout.width = box[2] - box[0] + 1;
+    layout.height = box[3] - box[1] + 1;
+    layout.y0 = box[1];
+
+    long long lineSize = 0;
+
+    for(unsigned int i = 0; i < layout.types.size(); i++) {
+        layout.offsets.push_back(int(lineSize));
+        lineSize += (layout.types[i] == TINYEXR_PIXELTYPE_HALF ? 2 : 4) * (long long) layout.width;
+
+        if(lineSize > 0x7fffffffLL) {
+            return false;
+        }
+    }
+
+    layout.lineSize = int(lineSize);
+
+    layout.nBlocks = (layout.height + layout.linesPerBlock - 1) / layout.linesPerBlock;
+
+    size_t tableEnd = size_t(marker - (const char *) buffer) +
+                      size_t(layout.nBlocks) * sizeof(long long);
+
+    if(tableEnd > size) {
+        return false;
+    }
+
+    layout.blockOffsets.resize(layout.nBlocks);
+    memcpy(&layout.blockOffsets[0], marker, layout.nBlocks * sizeof(long long));
+
+    for(int i = 0; i < layout.nBlocks; i++) {
+        if((layout.blockOffsets[i] < (long long) tableEnd) ||
+           ((layout.blockOffsets[i] + 8) > (long long) size)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief getChannelMapEXR maps the channels of an EXR file into interleaved
+ * channels: R, G, B, and A when the file has RGB channels, otherwise all
+ * channels in the order of the file.
+ * @param layout
+ * @param map is the output channel of each channel of the file; -1 if
+ * the channel is skipped.
+ * @return It returns the number of interleaved channels.
+ */
+PIC_INLINE int getChannelMapEXR(EXRLayout &layout, std::vector<int> &map)
+{
+    int n = int(layout.names.size());
+    map.assign(n, -1);
+
+    const char *rgba = "RGBA";
+    int indices[4] = {-1, -1, -1, -1};
+
+    for(int i = 0; i < n; i++) {
+        //layers are named as "layer.R"
+        std::string name = layout.names[i];
+        size_t pos = name.find_last_of('.');
+
+        if(pos != std::string::npos) {
+            name = name.substr(pos + 1);
+        }
+
+        for(int j = 0; j < 4; j++) {
+            if((name.size() == 1) && (name[0] == rgba[j]) && (indices[j] < 0)) {
+                indices[j] = i;
+            }
+        }
+    }
+
+    if((indices[0] >= 0) && (indices[1] >= 0) && (indices[2] >= 0)) {
+        int channels = indices[3] >= 0 ? 4 : 3;
+
+        for(int j = 0; j < channels; j++) {
+            map[indices[j]] = j;
+        }
+
+        return channels;
+    }
+
+    for(int i = 0; i < n; i++) {
+        map[i] = i;
+    }
+
+    return n;
+}
+
+inline void convertSampleEXR(unsigned short in, float &out)
+{
+    out = halfToFloat(in);
+}
+
+inline void convertSampleEXR(float in, float &out)
+{
+    out = in;
+}
+
+inline void convertSampleEXR(unsigned int in, float &out)
+{
+    out = float(in);
+}
+
+inline void convertSampleEXR(unsigned short in, unsigned short &out)
+{
+    out = in;
+}
+
+inline void convertSampleEXR(float in, unsigned short &out)
+{
+    out = floatToHalf(in);
+}
+
+inline void convertSampleEXR(unsigned int in, unsigned short &out)
+{
+    out = floatToHalf(float(in));
+}
+
+/**
+ * @brief convertLineEXR converts a scanline of a channel into an
+ * interleaved scanline.
+ * @param in
+ * @param out
+ * @param n
+ * @param stride
+ */
+template<class S, class T>
+inline void convertLineEXR(const unsigned char *in, T *out, int n, int stride)
+{
+    for(int i = 0; i < n; i++) {
+        S sample;
+        memcpy(&sample, in + i * sizeof(S), sizeof(S));
+        convertSampleEXR(sample, out[i * stride]);
+    }
+}
+
+/**
+ * @brief DecompressZipEXR decompresses a ZIP block and undoes the EXR
+ * predictor and byte interleaving.
+ * @param dst
+ * @param dstSize is the expected size of the block.
+ * @param src
+ * @param srcSize
+ * @param tmp is a temporary buffer.
+ * @return It returns true if the block was decompressed to dstSize bytes.
+ */
+PIC_INLINE bool DecompressZipEXR(unsigned char *dst, size_t dstSize,
+                                 const unsigned char *src, size_t srcSize,
+                                 std::vector<unsigned char> &tmp)
+{
+    tmp.resize(dstSize);
+
+    miniz::mz_ulong outSize = (miniz::mz_ulong) dstSize;
+    int ret = miniz::mz_uncompress(&tmp[0], &outSize, src, (miniz::mz_ulong) srcSize);
+
+    if((ret != miniz::MZ_OK) || (size_t(outSize) != dstSize)) {
+        return false;
+    }
+
+    //predictor
+    for(size_t i = 1; i < dstSize; i++) {
+        tmp[i] = (unsigned char) (int(tmp[i - 1]) + int(tmp[i]) - 128);
+    }
+
+    //bytes are split into two halves
+    const unsigned char *t1 = &tmp[0];
+    const unsigned char *t2 = &tmp[0] + (dstSize + 1) / 2;
+
+    for(size_t i = 0; i < dstSize; i++) {
+        dst[i] = (i & 1) ? *(t2++) : *(t1++);
+    }
+
+    return true;
+}
+
+/**
+ * @brief DecodeBlockEXR decodes a block of scanlines into an interleaved
+ * buffer.
+ * @param buffer is the EXR file in memory.
+ * @param size is the size of the file in bytes.
+ * @param layout
+ * @param map
+ * @param channels
+ * @param block
+ * @param data is the output buffer.
+ * @param tmp is a temporary buffer.
+ * @return It returns true if the block was decoded.
+ */
+template<class T>
+PIC_INLINE bool DecodeBlockEXR(const unsigned char *buffer, size_t size,
+                               EXRLayout &layout, std::vector<int> &map,
+                               int channels, int block, T *data,
+                               std::vector<unsigned char> &tmp,
+                               std::vector<unsigned char> &tmpZip)
+{
+    const unsigned char *ptr = buffer + layout.blockOffsets[block];
+
+    int lineNo, dataLen;
+    memcpy(&lineNo, ptr, sizeof(int));
+    memcpy(&dataLen, ptr + 4, sizeof(int));
+
+    lineNo -= layout.y0;
+
+    if((lineNo < 0) || (lineNo >= layout.height) || (dataLen < 0)) {
+        return false;
+    }
+
+    //the block has to be inside the file
+    size_t blockOffset = size_t(layout.blockOffsets[block]) + 8;
+
+    if(size_t(dataLen) > (size - blockOffset)) {
+        return false;
+    }
+
+    int nLines = MIN(layout.linesPerBlock, layout.height - lineNo);
+    size_t blockSize = size_t(layout.lineSize) * size_t(nLines);
+
+    const unsigned char *src = ptr + 8;
+
+    //a block is stored uncompressed when compression does not pay off
+    if((layout.compression != 0) && (size_t(dataLen) < blockSize)) {
+        tmp.resize(blockSize);
+
+        if(layout.compression == 4) {
+            std::vector<ChannelInfo> channelInfo(layout.types.size());
+
+            for(unsigned int i = 0; i < layout.types.size(); i++) {
+                channelInfo[i].name = layout.names[i];
+                channelInfo[i].pixelType = layout.types[i];
+                channelInfo[i].pLinear = 0;
+                channelInfo[i].xSampling = 1;
+                channelInfo[i].ySampling = 1;
+            }
+
+            unsigned int dstLen;
+            if(!DecompressPiz(&tmp[0], dstLen, src, blockSize, channelInfo,
+                              layout.width, nLines)) {
+                return false;
+            }
+        } else {
+            if(!DecompressZipEXR(&tmp[0], blockSize, src, size_t(dataLen), tmpZip)) {
+                return false;
+            }
+        }
+
+        src = &tmp[0];
+    } else {
+        if(size_t(dataLen) < blockSize) {
+            return false;
+        }
+    }
+
+    int nChannels = int(layout.types.size());
+
+    for(int v = 0; v < nLines; v++) {
+        const unsigned char *line = src + v * layout.lineSize;
+        T *out = &data[(lineNo + v) * layout.width * channels];
+
+        for(int c = 0; c < nChannels; c++) {
+            if(map[c] < 0) {
+                continue;
+            }
+
+            const unsigned char *line_c = line + layout.offsets[c];
+
+            switch(layout.types[c]) {
+            case TINYEXR_PIXELTYPE_HALF:
+                convertLineEXR<unsigned short, T>(line_c, out + map[c], layout.width, channels);
+                break;
+
+            case TINYEXR_PIXELTYPE_FLOAT:
+                convertLineEXR<float, T>(line_c, out + map[c], layout.width, channels);
+                break;
+
+            default:
+                convertLineEXR<unsigned int, T>(line_c, out + map[c], layout.width, channels);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief DecodeEXR decodes an EXR file into an interleaved buffer; blocks
+ * of scanlines are decompressed in parallel on the ThreadPool.
+ * @param nameFile
+ * @param data is the output buffer; if it is NULL, it is allocated.
+ * @param width
+ * @param height
+ * @param channels
+ * @return It returns the output buffer, or NULL if a block could not be
+ * decoded; in this case, a buffer allocated by this function is released.
+ */
+template<class T>
+PIC_INLINE T *DecodeEXR(std::string nameFile, T *data, int &width, int &height,
+                        int &channels)
+{
+    MappedFile file;
+
+    if(!file.open(nameFile)) {
+        return NULL;
+    }
+
+    EXRLayout layout;
+
+    if(!ParseLayoutEXR(file.getData(), file.getSize(), layout)) {
         #ifdef PIC_DEBUG
-            printf("Parse EXR error: %s\n", err);
+            printf("Parse EXR error: %s\n", nameFile.c_str());
         #endif
 
         return NULL;
     }
 
-    width = image.width;
-    height = image.height;
-    channels = image.num_channels;
+    std::vector<int> map;
+    channels = getChannelMapEXR(layout, map);
+    width = layout.width;
+    height = layout.height;
 
     //Allocate into memory
-    if(data == NULL) {
-        data = new float[width * height * channels];
+    bool bAllocated = (data == NULL);
+
+    if(bAllocated) {
+        data = new T[width * height * channels];
     }
 
-    for (int i = 0; i < image.num_channels; i++) {
-        if (image.pixel_types[i] == TINYEXR_PIXELTYPE_HALF) {
-            image.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+    const unsigned char *buffer = file.getData();
+    size_t size = file.getSize();
+
+    std::atomic<bool> bFailed(false);
+
+    ThreadPool::getInstance()->parallelFor(layout.nBlocks, [&](int i) {
+        if(bFailed) {
+            return;
         }
+
+        std::vector<unsigned char> tmp, tmpZip;
+
+        if(!DecodeBlockEXR(buffer, size, layout, map, channels, i, data, tmp, tmpZip)) {
+            bFailed = true;
+
+            #ifdef PIC_DEBUG
+                printf("Load EXR error: block %d\n", i);
+            #endif
+        }
+    });
+
+    if(bFailed) {
+        if(bAllocated) {
+            delete[] data;
+        }
+
+        return NULL;
     }
 
-    ret = LoadMultiChannelEXRFromFile(&image, nameFile.c_str(), &err);
+    return data;
+}
+
+/**
+ * @brief ReadEXR reads an EXR file into an interleaved float buffer.
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @param channels
+ * @return
+ */
+PIC_INLINE float *ReadEXR(std::string nameFile, float *data, int &width, int &height, int &channels)
+{
+    return DecodeEXR<float>(nameFile, data, width, height, channels);
+}
+
+/**
+ * @brief ReadEXRHalf reads an EXR file into an interleaved half float
+ * buffer; half channels are copied without conversions.
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @param channels
+ * @return
+ */
+PIC_INLINE unsigned short *ReadEXRHalf(std::string nameFile, unsigned short *data,
+                                       int &width, int &height, int &channels)
+{
+    return DecodeEXR<unsigned short>(nameFile, data, width, height, channels);
+}
+
+/**
+ * @brief WriteEXRPlanes writes planar channels as half floats into an EXR file.
+ * @param nameFile
+ * @param planes
+ * @param pixelType is the type of planes.
+ * @param width
+ * @param height
+ * @param channels
+ * @return
+ */
+PIC_INLINE bool WriteEXRPlanes(std::string nameFile, std::vector<unsigned char *> &planes,
+                               int pixelType, int width, int height, int channels)
+{
+    //channels have to be sorted by name
+    const char *names1[] = {"Y"};
+    const char *names3[] = {"B", "G", "R"};
+    const char *names4[] = {"A", "B", "G", "R"};
+    const int order3[] = {2, 1, 0};
+    const int order4[] = {3, 2, 1, 0};
+
+    const char **channel_names;
+    const int *order;
+
+    switch(channels) {
+    case 1:
+        channel_names = names1;
+        order = order3 + 2;
+        break;
+
+    case 3:
+        channel_names = names3;
+        order = order3;
+        break;
+
+    case 4:
+        channel_names = names4;
+        order = order4;
+        break;
+
+    default:
+        return false;
+    }
+
+    std::vector<unsigned char *> image_ptr(channels);
+    std::vector<int> pixel_types(channels, pixelType);
+    std::vector<int> requested_pixel_types(channels, TINYEXR_PIXELTYPE_HALF);
+
+    for(int i = 0; i < channels; i++) {
+        image_ptr[i] = planes[order[i]];
+    }
+
+    EXRImage image;
+    InitEXRImage(&image);
+
+    image.num_channels = channels;
+    image.channel_names = channel_names;
+    image.images = &image_ptr[0];
+    image.width = width;
+    image.height = height;
+    image.pixel_types = &pixel_types[0];
+    image.requested_pixel_types = &requested_pixel_types[0];
+
+    const char* err;
+    int ret = SaveMultiChannelEXRToFile(&image, nameFile.c_str(), &err);
+
     if (ret != 0) {
         #ifdef PIC_DEBUG
-            printf("Load EXR error: %s\n", err);
+            printf("Save EXR err: %s\n", err);
         #endif
-        return data;
+        return false;
     }
 
-    float **images = (float**) image.images;
+    return true;
+}
 
+/**
+ * @brief WriteEXR
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @param channels
+ * @return
+ */
+PIC_INLINE bool WriteEXR(std::string nameFile, float *data, int width,
+                         int height, int channels = 3)
+{
     int nPixels = width * height;
-    for (int i = 0; i < nPixels; i++){
-        int index = i * channels;
 
-        data[index    ] = images[2][i];
-        data[index + 1] = images[1][i];
-        data[index + 2] = images[0][i];
+    std::vector< float > tmp(nPixels * channels);
+    std::vector< unsigned char * > planes;
+
+    for(int j = 0; j < channels; j++) {
+        float *plane = &tmp[j * nPixels];
+        planes.push_back((unsigned char *) plane);
+
+        for(int i = 0; i < nPixels; i++) {
+            plane[i] = data[i * channels + j];
+        }
     }
 
-    FreeEXRImage(&image);
-    return data;
+    return WriteEXRPlanes(nameFile, planes, TINYEXR_PIXELTYPE_FLOAT, width, height, channels);
 }
 
 /**
- * @brief WriteEXR
+ * @brief WriteEXRHalf writes an interleaved half float buffer into an EXR
+ * file without conversions.
  * @param nameFile
  * @param data
  * @param width
@@ -92,64 +647,24 @@ PIC_INLINE float *ReadEXR(std::string nameFile, float *data, int &width, int &he
  * @param channels
  * @return
  */
-PIC_INLINE bool WriteEXR(std::string nameFile, float *data, int width,
-                         int height, int channels = 3)
+PIC_INLINE bool WriteEXRHalf(std::string nameFile, unsigned short *data, int width,
+                             int height, int channels = 3)
 {
-    EXRImage image;
-    InitEXRImage(&image);
+    int nPixels = width * height;
+
+    std::vector< unsigned short > tmp(nPixels * channels);
+    std::vector< unsigned char * > planes;
+
+    for(int j = 0; j < channels; j++) {
+        unsigned short *plane = &tmp[j * nPixels];
+        planes.push_back((unsigned char *) plane);
+
+        for(int i = 0; i < nPixels; i++) {
+            plane[i] = data[i * channels + j];
+        }
+    }
 
-     image.num_channels = channels;
-
-     const char* channel_names[] = {"B", "G", "R"}; // "B", "G", "R", "A" for RGBA image
-
-     std::vector< float* > images;
-     for(int i = 0; i < channels; i++) {
-         float *tmp = new float[width * height];
-         images.push_back(tmp);
-     }
-
-     int nPixels = width * height;
-     for (int i = 0; i < nPixels; i++){
-         int index = i * channels;
-
-         for(int j = 0; j < channels; j++) {
-             images[j][i] = data[index + j];
-         }
-     }
-
-     float *image_ptr[3];
-     image_ptr[0] = &(images[2][0]); // B
-     image_ptr[1] = &(images[1][0]); // G
-     image_ptr[2] = &(images[0][0]); // R
-
-     image.channel_names = channel_names;
-     image.images = (unsigned char**)image_ptr;
-     image.width = width;
-     image.height = height;
-
-     image.pixel_types = (int *)malloc(sizeof(int) * image.num_channels);
-     image.requested_pixel_types = (int *)malloc(sizeof(int) * image.num_channels);
-     for (int i = 0; i < image.num_channels; i++) {
-       image.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT; // pixel type of input image
-       image.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF; // pixel type of output image to be stored in .EXR
-     }
-
-     const char* err;
-     int ret = SaveMultiChannelEXRToFile(&image, nameFile.c_str(), &err);
-     if (ret != 0) {
-         printf("Save EXR err: %s\n", err);
-         return false;
-     }
-
-     for(int i = 0; i < channels; i++) {
-         delete_vec_s(images[i]);
-     }
-     images.clear();
-
-     delete_vec_s(image.pixel_types);
-     delete_vec_s(image.requested_pixel_types);
-
-     return true;
+    return WriteEXRPlanes(nameFile, planes, TINYEXR_PIXELTYPE_HALF, width, height, channels);
 }
 
 }
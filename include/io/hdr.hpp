@@ -20,37 +20,36 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <stdio.h>
 #include <string.h>
+#include <string>
+#include <vector>
+#include <atomic>
 
 #include "../colors/rgbe.hpp"
 #include "../base.hpp"
+#include "../util/math.hpp"
+#include "../util/thread_pool.hpp"
 //SYSTEM: X NEG Y POS
 
 namespace pic {
 
 /**
- * @brief ReadHDR reads a .hdr/.pic file.
- * @param nameFile
- * @param data
+ * @brief ReadHeaderHDR reads the header of a .hdr/.pic file.
+ * @param file
  * @param width
  * @param height
- * @return
+ * @return It returns true if the header is valid, otherwise false.
  */
-PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
-                          int &height)
+PIC_INLINE bool ReadHeaderHDR(FILE *file, int &width, int &height)
 {
-    FILE *file = fopen(nameFile.c_str(), "rb");
-
-    if(file == NULL) {
-        return NULL;
-    }
-
     char tmp[512];
 
     //Is it a Radiance file?
-    fscanf(file, "%s\n", tmp);
+    if(fscanf(file, "%511s\n", tmp) != 1) {
+        return false;
+    }
 
     if(strcmp(tmp, "#?RADIANCE") != 0) {
-        return NULL;
+        return false;
     }
 
     while(true) { //Reading Radiance Header
@@ -60,7 +59,7 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
             char *tmp2 = fgets(tmp, 512, file);
 
             if(tmp2 == NULL) {
-                return NULL;
+                return false;
             }
 
             line += tmp2;
@@ -78,7 +77,7 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
         //Properties:
         if(line.find("FORMAT") != std::string::npos) { //Format
             if(line.find("32-bit_rle_rgbe") == std::string::npos) {
-                return NULL;
+                return false;
             }
         }
 
@@ -88,11 +87,177 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
     }
 
     //width and height
-    fscanf(file, "-Y %d +X %d", &height, &width);
+    if(fscanf(file, "-Y %d +X %d", &height, &width) != 2) {
+        return false;
+    }
+
     fgetc(file);
 
-    if(data == NULL) {
-        data = new float[width * height * 3];
+    return (width > 0) && (height > 0);
+}
+
+/**
+ * @brief getMaxLineSizeHDR
+ * @param width
+ * @return It returns the maximum size in bytes of an encoded scanline.
+ */
+PIC_INLINE int getMaxLineSizeHDR(int width)
+{
+    //a literal run of 128 bytes costs 129 bytes
+    return MAX(width * 4, 4 + 4 * (width + (width + 127) / 128));
+}
+
+/**
+ * @brief isLineRLEHDR checks if a scanline is RLE encoded.
+ * @param buffer is the start of the scanline.
+ * @param end is the end of the encoded data.
+ * @param width
+ * @return
+ */
+PIC_INLINE bool isLineRLEHDR(const unsigned char *buffer, const unsigned char *end,
+                             int width)
+{
+    if(((end - buffer) < 4) || (width < 8) || (width > 32767)) {
+        return false;
+    }
+
+    return (buffer[0] == 2) && (buffer[1] == 2) &&
+           (buffer[2] == (width >> 8)) && (buffer[3] == (width & 0xFF));
+}
+
+/**
+ * @brief SkipLineHDR finds the end of a scanline without decoding it.
+ * @param buffer is the start of the scanline.
+ * @param end is the end of the encoded data.
+ * @param width
+ * @return It returns the start of the next scanline, or NULL if the
+ * scanline is not valid.
+ */
+PIC_INLINE const unsigned char *SkipLineHDR(const unsigned char *buffer,
+        const unsigned char *end, int width)
+{
+    if(!isLineRLEHDR(buffer, end, width)) { //flat RGBE scanline
+        return (end - buffer) >= (width * 4) ? (buffer + width * 4) : NULL;
+    }
+
+    buffer += 4;
+
+    for(int j = 0; j < 4; j++) {
+        int k = 0;
+
+        while(k < width) {
+            if(buffer >= end) {
+                return NULL;
+            }
+
+            int num = buffer[0];
+
+            if(num > 128) {
+                num -= 128;
+                buffer += 2;
+            } else {
+                buffer += num + 1;
+            }
+
+            k += num;
+
+            if((num == 0) || (k > width)) {
+                return NULL;
+            }
+        }
+    }
+
+    return buffer <= end ? buffer : NULL;
+}
+
+/**
+ * @brief DecodeLineHDR decodes a scanline into RGBE pixels.
+ * @param buffer is the start of the scanline.
+ * @param end is the end of the encoded data.
+ * @param buffer_line is an array of width * 4 unsigned char.
+ * @param width
+ * @return It returns the start of the next scanline, or NULL if the
+ * scanline is not valid.
+ */
+PIC_INLINE const unsigned char *DecodeLineHDR(const unsigned char *buffer,
+        const unsigned char *end, unsigned char *buffer_line, int width)
+{
+    if(!isLineRLEHDR(buffer, end, width)) { //flat RGBE scanline
+        if((end - buffer) < (width * 4)) {
+            return NULL;
+        }
+
+        memcpy(buffer_line, buffer, width * 4);
+        return buffer + width * 4;
+    }
+
+    buffer += 4;
+
+    for(int j = 0; j < 4; j++) {
+        int k = 0;
+
+        //decompression of a single channel line
+        while(k < width) {
+            if(buffer >= end) {
+                return NULL;
+            }
+
+            int num = buffer[0];
+
+            if(num > 128) {
+                num -= 128;
+
+                if(((k + num) > width) || ((end - buffer) < 2)) {
+                    return NULL;
+                }
+
+                unsigned char value = buffer[1];
+                for(int l = k; l < (k + num); l++) {
+                    buffer_line[l * 4 + j] = value;
+                }
+
+                buffer += 2;
+            } else {
+                if((num == 0) || ((k + num) > width) || ((end - buffer) <= num)) {
+                    return NULL;
+                }
+
+                for(int l = 0; l < num; l++) {
+                    buffer_line[(l + k) * 4 + j] = buffer[1 + l];
+                }
+
+                buffer += num + 1;
+            }
+
+            k += num;
+        }
+    }
+
+    return buffer;
+}
+
+/**
+ * @brief ReadHDR reads a .hdr/.pic file. The file is read at once; then,
+ * a fast pass finds where each scanline starts, and scanlines are decoded
+ * in parallel on the ThreadPool.
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @return
+ */
+PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
+                          int &height)
+{
+    FILE *file = fopen(nameFile.c_str(), "rb");
+
+    if(file == NULL) {
+        return NULL;
+    }
+
+    if(!ReadHeaderHDR(file, width, height)) {
+        fclose(file);
+        return NULL;
     }
 
     //File size
@@ -106,97 +271,251 @@ PIC_INLINE float *ReadHDR(std::string nameFile, float *data, int &width,
     printf("%d %d\n", total, width * height * 4);
 #endif
 
-    //Compressed?
-    if(total == (width * height * 4)) { //uncompressed
-        unsigned char colRGBE[4];
+    std::vector< unsigned char > buffer(MAX(total, 1));
 
-        int c = 0;
+    if(fread(&buffer[0], 1, total, file) != size_t(total)) {
+        fclose(file);
+        return NULL;
+    }
 
-        for(int i = 0; i < width; i++) {
-            for(int j = 0; j < height; j++) {
-                fread(colRGBE, 1, 4, file);
-                fromRGBEToFloat(colRGBE, &data[c]);
-                c += 3;
-            }
-        }
-    } else { //RLE compressed
-        unsigned char *buffer = new unsigned char[total];
-        fread(buffer, sizeof(unsigned char)*total, 1, file);
+    fclose(file);
 
-        int line_width3 = width * 3;
-        int line_width4 = width * 4;
+    const unsigned char *start = &buffer[0];
+    const unsigned char *end = start + total;
 
-        unsigned char *buffer_line_start;
-        unsigned char *buffer_line = new unsigned char[line_width4];
-        int c = 4;
-        int c_buffer_line = 0;
+    //scanline offsets
+    std::vector< const unsigned char * > lines(height);
 
-        //for each line
-        for(int i = 0; i < height; i++) {
-            buffer_line_start = &buffer[c - 4];
+    bool bFlat = (total == (width * height * 4));
 
-            int width_check  = buffer_line_start[2];
-            int width_check2 = buffer_line_start[3];
+    if(bFlat) { //uncompressed
+        for(int i = 0; i < height; i++) {
+            lines[i] = start + i * width * 4;
+        }
+    } else { //RLE compressed
+        const unsigned char *cur = start;
 
-            bool b1 = buffer_line_start[0] != 2;
-            bool b2 = buffer_line_start[1] != 2;
-            bool b3 = width_check  != (width >> 8); 
-            bool b4 = width_check2 != (width & 0xFF);
+        for(int i = 0; i < height; i++) {
+            lines[i] = cur;
+            cur = SkipLineHDR(cur, end, width);
 
-            if(b1 || b2 || b3 || b4) {
+            if(cur == NULL) {
                 #ifdef PIC_DEBUG
-                    printf("ReadHDR ERROR: the file is not a RLE encoded .hdr file.\n");
+                    printf("ReadHDR ERROR: the file is not a valid RLE encoded .hdr file.\n");
                 #endif
 
-                fclose(file);
-
                 return NULL;
             }
+        }
+    }
+
+    bool bAllocated = (data == NULL);
 
-            for(int j = 0; j < 4; j++) {
-                int k = 0;
+    if(bAllocated) {
+        data = new float[width * height * 3];
+    }
 
-                //decompression of a single channel line
-                while(k < width) {
-                    int num = buffer[c];
+    //decoding scanlines in blocks
+    int linesPerTask = MAX(1, (1 << 16) / (width * 4));
+    int nTasks = (height + linesPerTask - 1) / linesPerTask;
 
-                    if(num > 128) {
-                        num -= 128;
+    std::atomic<bool> bError(false);
 
-                        for(int l = k; l < (k + num); l++) {
-                            buffer_line[l * 4 + j] = buffer[c + 1];
-                        }
+    ThreadPool::getInstance()->parallelFor(nTasks, [&](int t) {
+        std::vector< unsigned char > buffer_line(bFlat ? 0 : width * 4);
 
-                        c += 2;
-                        k += num;
-                    } else {
-                        for(int l = 0; l < num; l++) {
-                            buffer_line[(l + k) * 4 + j] = buffer[c + 1 + l];
-                        }
+        int i0 = t * linesPerTask;
+        int i1 = MIN(i0 + linesPerTask, height);
 
-                        c += num + 1;
-                        k += num;
-                    }
-                }
+        for(int i = i0; i < i1; i++) {
+            float *data_line = &data[i * width * 3];
+
+            if(bFlat) {
+                fromRGBEToFloatLine(lines[i], data_line, width);
+                continue;
             }
 
-            //From RGBE to Float
-            for(int j = 0; j < width; j++) {
-                fromRGBEToFloat(&buffer_line[j * 4], &data[c_buffer_line + j * 3]);
+            if(DecodeLineHDR(lines[i], end, &buffer_line[0], width) == NULL) {
+                bError = true;
+                return;
             }
 
-            c += 4;
-            c_buffer_line += line_width3;
+            fromRGBEToFloatLine(&buffer_line[0], data_line, width);
+        }
+    });
+
+    if(bError) {
+        if(bAllocated) {
+            delete[] data;
         }
 
-        delete[] buffer_line;
-        delete[] buffer;
+        return NULL;
     }
 
-    fclose(file);
     return data;
 }
 
+/**
+ * @brief The ScanlineReaderHDR class reads a .hdr/.pic file in bands of
+ * scanlines; only a small window of the file is kept in memory, so large
+ * images can be decoded into caller-provided buffers.
+ */
+class ScanlineReaderHDR
+{
+protected:
+    FILE *file;
+    int width, height, currentLine;
+
+    std::vector< unsigned char > buffer, buffer_line;
+    size_t pos, len;
+
+    /**
+     * @brief fill makes sure that at least n bytes are buffered, unless
+     * the end of the file is reached.
+     * @param n
+     */
+    void fill(size_t n)
+    {
+        if((len - pos) >= n) {
+            return;
+        }
+
+        //moving unread bytes at the beginning
+        if(pos > 0) {
+            memmove(&buffer[0], &buffer[pos], len - pos);
+            len -= pos;
+            pos = 0;
+        }
+
+        while(len < buffer.size()) {
+            size_t r = fread(&buffer[len], 1, buffer.size() - len, file);
+
+            if(r == 0) {
+                break;
+            }
+
+            len += r;
+        }
+    }
+
+public:
+
+    ScanlineReaderHDR()
+    {
+        file = NULL;
+        width = height = currentLine = 0;
+        pos = len = 0;
+    }
+
+    ~ScanlineReaderHDR()
+    {
+        close();
+    }
+
+    /**
+     * @brief open opens a file and reads its header.
+     * @param nameFile
+     * @return It returns true if the file is a valid .hdr/.pic file.
+     */
+    bool open(std::string nameFile)
+    {
+        close();
+
+        file = fopen(nameFile.c_str(), "rb");
+
+        if(file == NULL) {
+            return false;
+        }
+
+        if(!ReadHeaderHDR(file, width, height)) {
+            close();
+            return false;
+        }
+
+        int maxLine = getMaxLineSizeHDR(width);
+        buffer.resize(MAX(1 << 16, maxLine * 2));
+        buffer_line.resize(width * 4);
+        pos = len = 0;
+        currentLine = 0;
+
+        return true;
+    }
+
+    /**
+     * @brief close
+     */
+    void close()
+    {
+        if(file != NULL) {
+            fclose(file);
+            file = NULL;
+        }
+    }
+
+    /**
+     * @brief getWidth
+     * @return
+     */
+    int getWidth()
+    {
+        return width;
+    }
+
+    /**
+     * @brief getHeight
+     * @return
+     */
+    int getHeight()
+    {
+        return height;
+    }
+
+    /**
+     * @brief getCurrentLine
+     * @return It returns the index of the next scanline to be read.
+     */
+    int getCurrentLine()
+    {
+        return currentLine;
+    }
+
+    /**
+     * @brief read decodes the next nLines scanlines.
+     * @param band is an array of nLines * width * 3 floats.
+     * @param nLines
+     * @return It returns the number of decoded scanlines.
+     */
+    int read(float *band, int nLines)
+    {
+        if((file == NULL) || (band == NULL)) {
+            return 0;
+        }
+
+        size_t maxLine = getMaxLineSizeHDR(width);
+
+        int n = 0;
+        while((n < nLines) && (currentLine < height)) {
+            fill(maxLine);
+
+            const unsigned char *start = &buffer[pos];
+            const unsigned char *next = DecodeLineHDR(start, &buffer[0] + len,
+                                                      &buffer_line[0], width);
+
+            if(next == NULL) {
+                break;
+            }
+
+            fromRGBEToFloatLine(&buffer_line[0], &band[n * width * 3], width);
+
+            pos += next - start;
+            currentLine++;
+            n++;
+        }
+
+        return n;
+    }
+};
+
 /**
  * @brief WriteLineHDR writes a scanline of an image using RLE and RGBE encoding.
  * @param file
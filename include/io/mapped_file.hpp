@@ -0,0 +1,246 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_IO_MAPPED_FILE_HPP
+#define PIC_IO_MAPPED_FILE_HPP
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define PIC_MAPPED_FILE_POSIX
+#endif
+
+#include "../base.hpp"
+
+namespace pic {
+
+/**
+ * @brief The MappedFile class maps a file in memory. By default, the mapping
+ * is read-only, and writing it faults. A writable mapping is private: changes
+ * are copy-on-write and they never reach the file. When memory mapping is not
+ * available, the file is read in memory.
+ */
+class MappedFile
+{
+protected:
+    unsigned char *data;
+    size_t size;
+    bool bMapped;
+
+    std::vector< unsigned char > buffer;
+
+#if defined(_WIN32)
+    HANDLE hFile, hMapping;
+#endif
+
+    //a mapping cannot be shared
+    MappedFile(const MappedFile &);
+    MappedFile &operator =(const MappedFile &);
+
+    /**
+     * @brief readFile reads the whole file in memory.
+     * @param nameFile
+     * @return
+     */
+    bool readFile(std::string nameFile)
+    {
+        FILE *file = fopen(nameFile.c_str(), "rb");
+
+        if(file == NULL) {
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long int s_end = ftell(file);
+        rewind(file);
+
+        if(s_end <= 0) {
+            fclose(file);
+            return false;
+        }
+
+        buffer.resize(s_end);
+        size_t r = fread(&buffer[0], 1, s_end, file);
+        fclose(file);
+
+        if(r != size_t(s_end)) {
+            buffer.clear();
+            return false;
+        }
+
+        data = &buffer[0];
+        size = buffer.size();
+        bMapped = false;
+        return true;
+    }
+
+public:
+
+    MappedFile()
+    {
+        data = NULL;
+        size = 0;
+        bMapped = false;
+
+#if defined(_WIN32)
+        hFile = INVALID_HANDLE_VALUE;
+        hMapping = NULL;
+#endif
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    /**
+     * @brief open maps a file in memory.
+     * @param nameFile
+     * @param bWritable enables writing the mapping (copy-on-write);
+     * otherwise, pages are mapped read-only.
+     * @return It returns true if the file was mapped or read.
+     */
+    bool open(std::string nameFile, bool bWritable = false)
+    {
+        close();
+
+#if defined(PIC_MAPPED_FILE_POSIX)
+        int fd = ::open(nameFile.c_str(), O_RDONLY);
+
+        if(fd >= 0) {
+            off_t fileSize = lseek(fd, 0, SEEK_END);
+
+            if(fileSize > 0) {
+                int prot = bWritable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+                void *ptr = mmap(NULL, fileSize, prot, MAP_PRIVATE, fd, 0);
+
+                if(ptr != MAP_FAILED) {
+                    data = (unsigned char *) ptr;
+                    size = size_t(fileSize);
+                    bMapped = true;
+                }
+            }
+
+            ::close(fd);
+        }
+#elif defined(_WIN32)
+        hFile = CreateFileA(nameFile.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if(hFile != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER fileSize;
+
+            if(GetFileSizeEx(hFile, &fileSize) && (fileSize.QuadPart > 0)) {
+                hMapping = CreateFileMappingA(hFile, NULL,
+                                              bWritable ? PAGE_WRITECOPY : PAGE_READONLY,
+                                              0, 0, NULL);
+
+                if(hMapping != NULL) {
+                    void *ptr = MapViewOfFile(hMapping,
+                                              bWritable ? FILE_MAP_COPY : FILE_MAP_READ,
+                                              0, 0, 0);
+
+                    if(ptr != NULL) {
+                        data = (unsigned char *) ptr;
+                        size = size_t(fileSize.QuadPart);
+                        bMapped = true;
+                    }
+                }
+            }
+        }
+#endif
+
+        if(!bMapped) {
+            close();
+            return readFile(nameFile);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief close unmaps the file.
+     */
+    void close()
+    {
+        if(bMapped) {
+#if defined(PIC_MAPPED_FILE_POSIX)
+            munmap(data, size);
+#elif defined(_WIN32)
+            UnmapViewOfFile(data);
+#endif
+        }
+
+#if defined(_WIN32)
+        if(hMapping != NULL) {
+            CloseHandle(hMapping);
+            hMapping = NULL;
+        }
+
+        if(hFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+#endif
+
+        buffer.clear();
+        data = NULL;
+        size = 0;
+        bMapped = false;
+    }
+
+    /**
+     * @brief getData
+     * @return It returns the content of the file; it can be written only
+     * if the file was opened as writable.
+     */
+    unsigned char *getData()
+    {
+        return data;
+    }
+
+    /**
+     * @brief getSize
+     * @return It returns the size of the file in bytes.
+     */
+    size_t getSize()
+    {
+        return size;
+    }
+
+    /**
+     * @brief isMapped
+     * @return It returns true if the file is memory mapped, false if it was
+     * read in memory.
+     */
+    bool isMapped()
+    {
+        return bMapped;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_IO_MAPPED_FILE_HPP */
+
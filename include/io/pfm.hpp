@@ -19,9 +19,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_IO_PFM_HPP
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 #include "../base.hpp"
+#include "../util/math.hpp"
+#include "../io/mapped_file.hpp"
 
 namespace pic {
 
@@ -48,91 +51,150 @@ PIC_INLINE float convertFloatEndianess(float value)
 }
 
 /**
- * @brief ReadPFM loads a portable float map from a file.
- * @param nameFile
+ * @brief convertFloatEndianessBuffer converts n floats from little-endian
+ * to big-endian or viceversa; it works on 32-bit words, so the compiler can
+ * vectorize it.
  * @param data
+ * @param n
+ */
+PIC_INLINE void convertFloatEndianessBuffer(float *data, size_t n)
+{
+    unsigned int *data_u = (unsigned int *) data;
+
+    for(size_t i = 0; i < n; i++) {
+        unsigned int v = data_u[i];
+        data_u[i] = (v >> 24) | ((v >> 8) & 0x0000FF00) |
+                    ((v << 8) & 0x00FF0000) | (v << 24);
+    }
+}
+
+/**
+ * @brief ParseHeaderPFM parses the header of a portable float map in memory.
+ * @param buffer
+ * @param size
  * @param width
  * @param height
  * @param channel
- * @return
+ * @param bLittleEndian
+ * @return It returns the size of the header in bytes; 0 if it is not valid.
  */
-PIC_INLINE float *ReadPFM(std::string nameFile, float *data, int &width,
-                          int &height, int &channel)
+PIC_INLINE size_t ParseHeaderPFM(const unsigned char *buffer, size_t size,
+                                 int &width, int &height, int &channel,
+                                 bool &bLittleEndian)
 {
-    FILE *file = fopen(nameFile.c_str(), "rb");
+    if((buffer == NULL) || (size < 3) || (buffer[0] != 'P')) {
+        return 0;
+    }
 
-    if(file == NULL) {
-        return NULL;
+    if(buffer[1] == 'f') {
+        channel = 1;
+    } else {
+        if(buffer[1] == 'F') {
+            channel = 3;
+        } else {
+            return 0;
+        }
     }
 
-    char  flagc;
+    char header[256];
+    size_t n = MIN(size - 3, size_t(255));
+    memcpy(header, &buffer[3], n);
+    header[n] = 0;
+
+    char flagc;
     float flag;
-    char P = fgetc(file);
+    int nRead = 0;
 
-    if(P != 'P') {
-        fclose(file);
-        return NULL;
+    if(sscanf(header, "%d %d%c%f%c%n", &width, &height, &flagc, &flag,
+              &flagc, &nRead) < 5) {
+        return 0;
     }
 
-    char F = fgetc(file);
+    if((width < 1) || (height < 1) || (nRead <= 0)) {
+        return 0;
+    }
 
-    bool fCheck = false;
+    bLittleEndian = flag < 0.0f;
 
-    if(F == 'f') {
-        fCheck = true;
-        channel = 1;
-    }
+    size_t offset = 3 + size_t(nRead);
+    size_t dataSize = size_t(width) * size_t(height) * size_t(channel) * sizeof(float);
 
-    if(F == 'F') {
-        fCheck = true;
-        channel = 3;
-    }
+    return (offset + dataSize) <= size ? offset : 0;
+}
 
-    if(!fCheck) {
-        fclose(file);
+/**
+ * @brief MapPFM returns the pixels of a memory mapped portable float map
+ * without copying them. This is possible only for little-endian files whose
+ * data is aligned to floats. Note that scanlines are stored bottom-up.
+ * @param file
+ * @param width
+ * @param height
+ * @param channel
+ * @return It returns a pointer to the pixels of the file; NULL if the file
+ * cannot be mapped without conversions.
+ */
+PIC_INLINE float *MapPFM(MappedFile &file, int &width, int &height, int &channel)
+{
+    bool bLittleEndian;
+    size_t offset = ParseHeaderPFM(file.getData(), file.getSize(), width, height,
+                                   channel, bLittleEndian);
+
+    if((offset == 0) || !bLittleEndian || ((offset % sizeof(float)) != 0)) {
         return NULL;
     }
 
+    unsigned char *ptr = file.getData() + offset;
 
-    fgetc(file);
-    fscanf(file, "%d %d%c", &width, &height, &flagc);
-    fscanf(file, "%f%c", &flag, &flagc);
-
-    if(data == NULL) {
-        data = new float[width * height * channel];
+    if((size_t(ptr) % sizeof(float)) != 0) {
+        return NULL;
     }
 
-    if(flag < 0.0f) {
-        //little-endian encoding
+    return (float *) ptr;
+}
 
-        for(int i = height - 1; i > -1; i--) {
-            int ind = i * width;
+/**
+ * @brief ReadPFM loads a portable float map from a file.
+ * @param nameFile
+ * @param data
+ * @param width
+ * @param height
+ * @param channel
+ * @return
+ */
+PIC_INLINE float *ReadPFM(std::string nameFile, float *data, int &width,
+                          int &height, int &channel)
+{
+    MappedFile file;
 
-            for(int j = 0; j < width; j++) {
-                int tmpInd = (ind + j) * channel;
+    if(!file.open(nameFile)) {
+        return NULL;
+    }
 
-                fread(&data[tmpInd], sizeof(float), channel, file);
-            }
-        }
-    } else {
-        //big-endian encoding
+    bool bLittleEndian;
+    size_t offset = ParseHeaderPFM(file.getData(), file.getSize(), width, height,
+                                   channel, bLittleEndian);
 
-        for(int i = height - 1; i > -1; i--) {
-            int ind = i * width;
+    if(offset == 0) {
+        return NULL;
+    }
 
-            for(int j = 0; j < width; j++) {
-                int tmpInd = (ind + j) * channel;
+    if(data == NULL) {
+        data = new float[width * height * channel];
+    }
 
-                fread(&data[tmpInd], sizeof(float), channel, file);
+    //scanlines are stored bottom-up
+    size_t lineSize = size_t(width) * size_t(channel);
+    const unsigned char *src = file.getData() + offset;
 
-                for(int k = 0; k < channel; k++) {
-                    data[tmpInd + k] = convertFloatEndianess(data[tmpInd + k]);
-                }
-            }
-        }
+    for(int i = 0; i < height; i++) {
+        memcpy(&data[(height - 1 - i) * lineSize], src + i * lineSize * sizeof(float),
+               lineSize * sizeof(float));
+    }
+
+    if(!bLittleEndian) {
+        convertFloatEndianessBuffer(data, lineSize * height);
     }
 
-    fclose(file);
     return data;
 }
 
@@ -170,11 +232,18 @@ PIC_INLINE bool WritePFM(std::string nameFile, float *data, int width,
     fputc(0x0a, file);
 
     //width and height
-    fprintf(file, "%d %d", width, height);
+    int nWH = fprintf(file, "%d %d", width, height);
     fputc(0x0a, file);
 
-    //flag: writing little-endian only
+    //flag: writing little-endian only; the flag is padded with zeros
+    //so that data is aligned to floats, and the file can be mapped
+    int nPad = (4 - ((3 + nWH + 1 + 9 + 1) % 4)) % 4;
     fprintf(file, "%f", -1.0f);
+
+    for(int i = 0; i < nPad; i++) {
+        fputc('0', file);
+    }
+
     fputc(0x0a, file);
 
     //data
@@ -186,21 +255,29 @@ PIC_INLINE bool WritePFM(std::string nameFile, float *data, int width,
         ind2 = 1;
     }
 
+    int channelsOut = channels > 1 ? 3 : 1;
+    float *line = new float[width * channelsOut];
+
     for(int i = height - 1; i > -1; i--) {
         int ind = i * width;
 
         for(int j = 0; j < width; j++) {
             int tmpInd = (ind + j) * channels;
+            float *line_j = &line[j * channelsOut];
 
-            fwrite(&data[tmpInd], sizeof(float), 1, file);
+            line_j[0] = data[tmpInd];
 
             if(channels > 1) {
-                fwrite(&data[tmpInd + ind1], sizeof(float), 1, file);
-                fwrite(&data[tmpInd + ind2], sizeof(float), 1, file);
+                line_j[1] = data[tmpInd + ind1];
+                line_j[2] = data[tmpInd + ind2];
             }
         }
+
+        fwrite(line, sizeof(float), width * channelsOut, file);
     }
 
+    delete[] line;
+
     fclose(file);
     return true;
 }
@@ -19,9 +19,11 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #define PIC_IO_TMP_HPP
 
 #include <stdio.h>
+#include <string.h>
 #include <string>
 
 #include "../base.hpp"
+#include "../io/mapped_file.hpp"
 
 namespace pic {
 
@@ -33,6 +35,47 @@ struct TMP_IMG_HEADER {
 };
 
 
+/**
+ * @brief MapTMP returns the pixels of a memory mapped dump temp file
+ * without copying them.
+ * @param file
+ * @param width
+ * @param height
+ * @param channels
+ * @param frames
+ * @return It returns a pointer to the pixels of the file; NULL if the
+ * header is not valid.
+ */
+PIC_INLINE float *MapTMP(MappedFile &file, int &width, int &height,
+                         int &channels, int &frames)
+{
+    if(file.getSize() < sizeof(TMP_IMG_HEADER)) {
+        return NULL;
+    }
+
+    TMP_IMG_HEADER header;
+    memcpy(&header, file.getData(), sizeof(TMP_IMG_HEADER));
+
+    if(header.channels < 1 || header.frames < 1 || header.height < 1 ||
+       header.width < 1) { //invalid image!
+        return NULL;
+    }
+
+    size_t n = size_t(header.frames) * size_t(header.width) *
+               size_t(header.height) * size_t(header.channels);
+
+    if((sizeof(TMP_IMG_HEADER) + n * sizeof(float)) > file.getSize()) {
+        return NULL;
+    }
+
+    width    = header.width;
+    height   = header.height;
+    channels = header.channels;
+    frames   = header.frames;
+
+    return (float *) (file.getData() + sizeof(TMP_IMG_HEADER));
+}
+
 /**
  * @brief ReadTMP reads a dump temp file.
  * @param nameFile
@@ -47,42 +90,32 @@ struct TMP_IMG_HEADER {
 PIC_INLINE float *ReadTMP(std::string nameFile, float *data, int &width,
                           int &height, int &channels, int &frames, bool bHeader = true)
 {
-    FILE *file = fopen(nameFile.c_str(), "rb");
+    MappedFile file;
 
-    if(file == NULL) {
+    if(!file.open(nameFile)) {
         return NULL;
     }
 
-    //read the header
-    TMP_IMG_HEADER header;
-    header.channels = -1;
-    header.frames = -1;
-    header.width = -1;
-    header.height = -1;
+    float *src;
 
     if(bHeader) {
-        fread(&header, sizeof(TMP_IMG_HEADER), 1, file);
-
-        if(header.channels < 1 && header.frames < 1 && header.height < 1 &&
-           header.width < 1) { //invalid image!
-            return NULL;
-        }
+        src = MapTMP(file, width, height, channels, frames);
+    } else {
+        size_t n = size_t(frames) * size_t(width) * size_t(height) * size_t(channels);
+        src = (n * sizeof(float)) <= file.getSize() ? (float *) file.getData() : NULL;
     }
 
-    if(data == NULL) {
-        data = new float[width * height * channels * frames];
+    if(src == NULL) {
+        return NULL;
     }
 
-    if(bHeader) {
-        width    = header.width;
-        height   = header.height;
-        channels = header.channels;
-        frames   = header.frames;
-    }
+    size_t n = size_t(frames) * size_t(width) * size_t(height) * size_t(channels);
 
-    fread(data, sizeof(float), frames * width * height * channels, file);
+    if(data == NULL) {
+        data = new float[n];
+    }
 
-    fclose(file);
+    memcpy(data, src, n * sizeof(float));
 
     return data;
 }
@@ -24,6 +24,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "../base.hpp"
 
 #include "../util/math.hpp"
+#include "../io/mapped_file.hpp"
 
 namespace pic {
 
@@ -40,16 +41,14 @@ namespace pic {
 PIC_INLINE float *ReadVOL(std::string nameFile, float *data, int &width,
                           int &height, int &depth, int &channels)
 {
-    FILE *file = fopen(nameFile.c_str(), "rb");
+    MappedFile file;
 
-    if(file == NULL) {
+    if(!file.open(nameFile)) {
         return NULL;
     }
 
     //File size
-    fseek(file, 0, SEEK_END);
-    int fileSize = ftell(file) / 3;
-    rewind(file);
+    int fileSize = int(file.getSize() / 3);
 
     //Check size
     int c64  = 64 * 64 * 64;
@@ -68,14 +67,13 @@ PIC_INLINE float *ReadVOL(std::string nameFile, float *data, int &width,
     width	= len;
     height	= len;
     depth	= len;
+    channels = 4;
 
     if(data == NULL) {
         data = new float[len * len * len * 4];
     }
 
-    unsigned char *tmpData = new unsigned char[fileSize * 3];
-
-    fread(tmpData, sizeof(unsigned char), fileSize * 3, file);
+    const unsigned char *tmpData = file.getData();
 
     int ind0, ind1;
 
@@ -99,10 +97,6 @@ PIC_INLINE float *ReadVOL(std::string nameFile, float *data, int &width,
         }
     };
 
-    delete[] tmpData;
-
-    fclose(file);
-
     return data;
 }
 
@@ -32,6 +32,12 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
  * \li \c PIC_DEBUG used for debugging; it mostly enables some printf messages;
  * i.e. for warning when a computation succeeds or fails.
  * \li \c PIC_DISABLE_OPENGL disables the OpenGL support.
+ * \li \c PIC_DISABLE_THREAD disables multi-threading; filters run on the calling thread only.
+ * Otherwise, filters share a persistent pool of worker threads, pic::ThreadPool, which can be
+ * configured with pic::ThreadPool::setup.
+ * \li \c PIC_ENABLE_BUFFER_POOL makes images draw their buffers from pic::BufferPool, a pool of
+ * aligned buffers that are recycled when images are released. The pool can also be enabled at
+ * run-time with pic::BufferPool::setEnabled.
  * \li \c PIC_ENABLE_OPEN_EXR enables the support for the OpenEXR library. This may be useful to have
  * in the case .exr images are used. Note that you need to manually install OpenEXR on your developing maching in order
  * to enable this flag.
@@ -216,6 +222,8 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "base.hpp"
 #include "image.hpp"
 #include "image_vec.hpp"
+#include "image_mapped.hpp"
+#include "image_planar.hpp"
 #include "histogram.hpp"
 
 // sub dirs
@@ -120,20 +120,32 @@ protected:
 
         pOut->setValue(0.0f);
 
+        //compact exposures are promoted one at a time
+        Image *promoted = NULL;
+
         for(auto j = 0; j < n; j++) {
-            images[0] = flt_lum.Process(Single(imgIn[j]), images[0]);
-            images[1] = flt_weights.Process(Double(images[0], imgIn[j]), images[1]);
+            Image *img_j = imgIn[j];
+
+            if(img_j->isCompact()) {
+                promoted = img_j->promote(promoted);
+                img_j = promoted;
+            }
+
+            images[0] = flt_lum.Process(Single(img_j), images[0]);
+            images[1] = flt_weights.Process(Double(images[0], img_j), images[1]);
 
             //normalization
             *images[1] /= *images[2];
 
             pW->update(images[1]);
-            pI->update(imgIn[j]);
+            pI->update(img_j);
 
             pI->mul(pW);
             pOut->add(pI);
         }
 
+        promoted = delete_s(promoted);
+
         //final result
         imgOut = pOut->reconstruct(imgOut);
 
@@ -36,6 +36,7 @@ class RamanTMO: public ToneMappingOperator
 {
 protected:
     FilterLuminance flt_lum;
+    FilterBilateral2DG flt_bil;
 
     /**
      * @brief ProcessAux
@@ -124,7 +125,8 @@ protected:
             images[0]->getMaxVal(NULL, &max);
             float sigma_r = K2 * (max - min);
 
-            images[1] = FilterBilateral2DG::execute(images[0], images[1], sigma_s, sigma_r);
+            flt_bil.update(sigma_s, sigma_r);
+            images[1] = flt_bil.Process(Single(images[0]), images[1]);
             *images[1] -= *images[0];
             images[1]->applyFunctionParam(ramanFunction, param);
 
@@ -151,7 +153,7 @@ public:
     /**
      * @brief RamanTMO
      */
-    RamanTMO()
+    RamanTMO() : flt_bil(1.0f, 0.01f)
     {
         setToANullVector<Image>(images, 3);
     }
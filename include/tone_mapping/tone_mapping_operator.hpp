@@ -124,7 +124,7 @@ public:
         }
 
         if(imgOut == NULL) {
-            imgOut = imgIn[0]->clone();
+            imgOut = imgIn[0]->isCompact() ? imgIn[0]->promote() : imgIn[0]->clone();
         } else {
             if(!imgOut->isSimilarType(imgIn[0])) {
                 imgOut = imgIn[0]->allocateSimilarOne();
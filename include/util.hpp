@@ -27,6 +27,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "util/compability.hpp"
 //#include "util/convert_raw_to_images.hpp"
 #include "util/file_lister.hpp"
+#include "util/half.hpp"
 
 #ifndef PIC_DISABLE_OPENGL
 #include "util/gl/program.hpp"
@@ -58,6 +59,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include "util/string.hpp"
 #include "util/tile.hpp"
 #include "util/tile_list.hpp"
+#include "util/thread_pool.hpp"
+#include "util/span_ops.hpp"
+#include "util/sorting_network.hpp"
+#include "util/running_extrema.hpp"
+#include "util/fft.hpp"
+#include "util/dct.hpp"
+#include "util/buffer_pool.hpp"
 #include "util/vec.hpp"
 #include "util/warp_samples.hpp"
 #include "util/rasterizer.hpp"
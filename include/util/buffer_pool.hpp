@@ -0,0 +1,389 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_BUFFER_POOL_HPP
+#define PIC_UTIL_BUFFER_POOL_HPP
+
+#include <map>
+#include <vector>
+#include <stdlib.h>
+
+#ifndef PIC_DISABLE_THREAD
+#include <mutex>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "../base.hpp"
+#include "../util/math.hpp"
+
+namespace pic {
+
+/**
+ * @brief BUFFER_POOL_ALIGNMENT is the alignment in bytes of pooled buffers.
+ */
+#ifndef BUFFER_POOL_ALIGNMENT
+#define BUFFER_POOL_ALIGNMENT 64
+#endif
+
+/**
+ * @brief BUFFER_POOL_HUGE_PAGE is the size in bytes of a huge page; buffers
+ * of at least this size are aligned to it and backed by huge pages when
+ * the OS supports it.
+ */
+#ifndef BUFFER_POOL_HUGE_PAGE
+#define BUFFER_POOL_HUGE_PAGE (2 << 20)
+#endif
+
+/**
+ * @brief BUFFER_POOL_MAX_CACHED is the default maximum number of bytes
+ * kept in the pool by released buffers.
+ */
+#ifndef BUFFER_POOL_MAX_CACHED
+#define BUFFER_POOL_MAX_CACHED (size_t(512) << 20)
+#endif
+
+/**
+ * @brief The BufferPoolStats struct stores statistics of a BufferPool.
+ */
+struct BufferPoolStats
+{
+    size_t hits, misses, releases;
+    size_t bytesInUse, bytesCached, peakBytes;
+
+    /**
+     * @brief getHitRate
+     * @return It returns the ratio of allocations served by cached buffers.
+     */
+    float getHitRate() const
+    {
+        size_t n = hits + misses;
+        return n > 0 ? float(hits) / float(n) : 0.0f;
+    }
+};
+
+/**
+ * @brief The BufferPool class is a process-wide, thread-safe pool of float
+ * buffers. Sizes are rounded up to size classes (at most 25% larger than
+ * the request), and released buffers are kept in per-class free lists, so
+ * iterative algorithms that allocate and free images of the same size reuse
+ * memory instead of hitting the allocator.
+ * Image draws from the pool when it is enabled; it is disabled by default
+ * unless PIC_ENABLE_BUFFER_POOL is defined.
+ */
+class BufferPool
+{
+protected:
+
+    //size class of each block owned by the pool, in use or cached
+    std::map<char *, size_t> blocks;
+
+    std::map<size_t, std::vector<char *> > freeLists;
+    BufferPoolStats stats;
+    size_t maxCachedBytes;
+    bool bEnabled;
+
+#ifndef PIC_DISABLE_THREAD
+    std::mutex mutex;
+#endif
+
+    /**
+     * @brief BufferPool
+     */
+    BufferPool()
+    {
+        stats.hits = 0;
+        stats.misses = 0;
+        stats.releases = 0;
+        stats.bytesInUse = 0;
+        stats.bytesCached = 0;
+        stats.peakBytes = 0;
+
+        maxCachedBytes = BUFFER_POOL_MAX_CACHED;
+
+#ifdef PIC_ENABLE_BUFFER_POOL
+        bEnabled = true;
+#else
+        bEnabled = false;
+#endif
+    }
+
+    /**
+     * @brief getSizeClass rounds bytes up to its size class.
+     * @param bytes
+     * @return
+     */
+    static size_t getSizeClass(size_t bytes)
+    {
+        size_t p = BUFFER_POOL_ALIGNMENT;
+
+        while(p < bytes && (p << 1) <= bytes) {
+            p <<= 1;
+        }
+
+        if(p >= bytes) {
+            return p;
+        }
+
+        //four classes between two powers of two
+        size_t step = MAX(p >> 2, size_t(BUFFER_POOL_ALIGNMENT));
+        return ((bytes + step - 1) / step) * step;
+    }
+
+    /**
+     * @brief allocateBlock allocates an aligned block from the OS.
+     * @param bytes
+     * @return
+     */
+    static char *allocateBlock(size_t bytes)
+    {
+        size_t alignment = bytes >= BUFFER_POOL_HUGE_PAGE ?
+                           BUFFER_POOL_HUGE_PAGE : BUFFER_POOL_ALIGNMENT;
+
+        void *block = NULL;
+
+#ifdef _WIN32
+        block = _aligned_malloc(bytes, alignment);
+#else
+        if(posix_memalign(&block, alignment, bytes) != 0) {
+            block = NULL;
+        }
+#endif
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if((block != NULL) && (alignment == BUFFER_POOL_HUGE_PAGE)) {
+            madvise(block, bytes, MADV_HUGEPAGE);
+        }
+#endif
+
+        return (char *) block;
+    }
+
+    /**
+     * @brief freeBlock
+     * @param block
+     */
+    static void freeBlock(char *block)
+    {
+#ifdef _WIN32
+        _aligned_free(block);
+#else
+        free(block);
+#endif
+    }
+
+public:
+
+    /**
+     * @brief getInstance returns the process-wide pool. It is never
+     * destroyed, so images with static storage can be released safely.
+     * @return
+     */
+    static BufferPool *getInstance()
+    {
+        static BufferPool *pool = new BufferPool();
+        return pool;
+    }
+
+    /**
+     * @brief setEnabled enables or disables the pool for new allocations;
+     * buffers already allocated from the pool are still returned to it.
+     * @param bEnabled
+     */
+    void setEnabled(bool bEnabled)
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        this->bEnabled = bEnabled;
+    }
+
+    /**
+     * @brief isEnabled
+     * @return
+     */
+    bool isEnabled()
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        return bEnabled;
+    }
+
+    /**
+     * @brief setMaxCachedBytes sets the maximum number of bytes kept by
+     * released buffers; buffers beyond this limit are freed.
+     * @param maxCachedBytes
+     */
+    void setMaxCachedBytes(size_t maxCachedBytes)
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        this->maxCachedBytes = maxCachedBytes;
+    }
+
+    /**
+     * @brief allocate returns an uninitialized buffer of n floats aligned
+     * to BUFFER_POOL_ALIGNMENT bytes; buffers of at least
+     * BUFFER_POOL_HUGE_PAGE bytes are aligned to it.
+     * @param n
+     * @return
+     */
+    float *allocate(size_t n)
+    {
+        size_t bytes = getSizeClass(n * sizeof(float));
+
+        char *block = NULL;
+
+        {
+#ifndef PIC_DISABLE_THREAD
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            std::map<size_t, std::vector<char *> >::iterator it = freeLists.find(bytes);
+
+            if((it != freeLists.end()) && !it->second.empty()) {
+                block = it->second.back();
+                it->second.pop_back();
+
+                stats.hits++;
+                stats.bytesCached -= bytes;
+            } else {
+                stats.misses++;
+            }
+
+            stats.bytesInUse += bytes;
+            stats.peakBytes = MAX(stats.peakBytes, stats.bytesInUse);
+        }
+
+        if(block == NULL) {
+            block = allocateBlock(bytes);
+
+#ifndef PIC_DISABLE_THREAD
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            if(block == NULL) {
+                stats.bytesInUse -= bytes;
+                return NULL;
+            }
+
+            blocks[block] = bytes;
+        }
+
+        return (float *) block;
+    }
+
+    /**
+     * @brief release returns a buffer allocated by allocate to the pool.
+     * @param data
+     */
+    void release(float *data)
+    {
+        if(data == NULL) {
+            return;
+        }
+
+        char *block = (char *) data;
+
+        {
+#ifndef PIC_DISABLE_THREAD
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            std::map<char *, size_t>::iterator it = blocks.find(block);
+
+            if(it == blocks.end()) {
+                return;
+            }
+
+            size_t bytes = it->second;
+
+            stats.releases++;
+            stats.bytesInUse -= bytes;
+
+            if((stats.bytesCached + bytes) <= maxCachedBytes) {
+                freeLists[bytes].push_back(block);
+                stats.bytesCached += bytes;
+                block = NULL;
+            } else {
+                blocks.erase(it);
+            }
+        }
+
+        if(block != NULL) {
+            freeBlock(block);
+        }
+    }
+
+    /**
+     * @brief trim frees all cached buffers.
+     */
+    void trim()
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        std::map<size_t, std::vector<char *> >::iterator it;
+
+        for(it = freeLists.begin(); it != freeLists.end(); it++) {
+            for(unsigned int i = 0; i < it->second.size(); i++) {
+                blocks.erase(it->second[i]);
+                freeBlock(it->second[i]);
+            }
+        }
+
+        freeLists.clear();
+        stats.bytesCached = 0;
+    }
+
+    /**
+     * @brief getStats
+     * @return It returns a snapshot of the statistics of the pool.
+     */
+    BufferPoolStats getStats()
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        return stats;
+    }
+
+    /**
+     * @brief resetStats resets counters; bytes in use and cached are kept,
+     * and the peak is set to the bytes in use.
+     */
+    void resetStats()
+    {
+#ifndef PIC_DISABLE_THREAD
+        std::lock_guard<std::mutex> lock(mutex);
+#endif
+        stats.hits = 0;
+        stats.misses = 0;
+        stats.releases = 0;
+        stats.peakBytes = stats.bytesInUse;
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_BUFFER_POOL_HPP */
+
@@ -0,0 +1,342 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_DCT_HPP
+#define PIC_UTIL_DCT_HPP
+
+#include <math.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "../base.hpp"
+#include "../util/fft.hpp"
+
+namespace pic {
+
+/**
+ * @brief The DCTPlan class computes the orthonormal DCT-II (forward) and
+ * DCT-III (inverse) of size n in O(n log n). The size 8 uses the
+ * Arai-Agui-Nakajima (AAN) butterflies with the scaling folded into the
+ * coefficients; the other sizes use Makhoul's reordering and an FFTPlan
+ * of size n. Plans are cached by size, and they are read-only, so they can
+ * be shared by threads.
+ */
+class DCTPlan
+{
+protected:
+    int n;
+    FFTPlan *fft;
+    std::vector< float > twRe, twIm, scale;
+
+    /**
+     * @brief DCTPlan
+     * @param n
+     */
+    DCTPlan(int n)
+    {
+        this->n = n;
+        fft = NULL;
+
+        scale.resize(n);
+
+        if(n == 8) {
+            //AAN outputs scaled by 1 / (cos(k pi / 16) * sqrt(2) * sqrt(8))
+            for(int k = 0; k < 8; k++) {
+                double aan = (k == 0) ? 1.0 : cos(double(k) * C_PI / 16.0) * sqrt(2.0);
+                scale[k] = float(1.0 / (aan * sqrt(8.0)));
+            }
+        } else {
+            fft = FFTPlan::get(n);
+
+            //twiddles: exp(-i pi k / (2 n))
+            twRe.resize(n);
+            twIm.resize(n);
+            for(int k = 0; k < n; k++) {
+                double angle = -C_PI * double(k) / double(2 * n);
+                twRe[k] = float(cos(angle));
+                twIm[k] = float(sin(angle));
+                scale[k] = float(sqrt((k == 0 ? 1.0 : 2.0) / double(n)));
+            }
+        }
+    }
+
+    /**
+     * @brief forward8 computes the AAN DCT-II of size 8 of len sequences.
+     * @param data
+     * @param stride
+     * @param len
+     */
+    void forward8(float *data, int stride, int len) const
+    {
+        float *d[8];
+        for(int t = 0; t < 8; t++) {
+            d[t] = data + t * stride;
+        }
+
+        const float *s = &scale[0];
+
+        for(int b = 0; b < len; b++) {
+            float tmp0 = d[0][b] + d[7][b];
+            float tmp7 = d[0][b] - d[7][b];
+            float tmp1 = d[1][b] + d[6][b];
+            float tmp6 = d[1][b] - d[6][b];
+            float tmp2 = d[2][b] + d[5][b];
+            float tmp5 = d[2][b] - d[5][b];
+            float tmp3 = d[3][b] + d[4][b];
+            float tmp4 = d[3][b] - d[4][b];
+
+            //even part
+            float tmp10 = tmp0 + tmp3;
+            float tmp13 = tmp0 - tmp3;
+            float tmp11 = tmp1 + tmp2;
+            float tmp12 = tmp1 - tmp2;
+
+            d[0][b] = (tmp10 + tmp11) * s[0];
+            d[4][b] = (tmp10 - tmp11) * s[4];
+
+            float z1 = (tmp12 + tmp13) * 0.707106781f;
+            d[2][b] = (tmp13 + z1) * s[2];
+            d[6][b] = (tmp13 - z1) * s[6];
+
+            //odd part
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+
+            float z5 = (tmp10 - tmp12) * 0.382683433f;
+            float z2 = 0.541196100f * tmp10 + z5;
+            float z4 = 1.306562965f * tmp12 + z5;
+            float z3 = tmp11 * 0.707106781f;
+
+            float z11 = tmp7 + z3;
+            float z13 = tmp7 - z3;
+
+            d[5][b] = (z13 + z2) * s[5];
+            d[3][b] = (z13 - z2) * s[3];
+            d[1][b] = (z11 + z4) * s[1];
+            d[7][b] = (z11 - z4) * s[7];
+        }
+    }
+
+    /**
+     * @brief inverse8 computes the AAN DCT-III of size 8 of len sequences.
+     * @param data
+     * @param stride
+     * @param len
+     */
+    void inverse8(float *data, int stride, int len) const
+    {
+        float *d[8];
+        for(int t = 0; t < 8; t++) {
+            d[t] = data + t * stride;
+        }
+
+        //inputs are scaled by cos(k pi / 16) * sqrt(2) / sqrt(8)
+        float s[8];
+        for(int k = 0; k < 8; k++) {
+            s[k] = 1.0f / (8.0f * scale[k]);
+        }
+
+        for(int b = 0; b < len; b++) {
+            //even part
+            float tmp0 = d[0][b] * s[0];
+            float tmp1 = d[2][b] * s[2];
+            float tmp2 = d[4][b] * s[4];
+            float tmp3 = d[6][b] * s[6];
+
+            float tmp10 = tmp0 + tmp2;
+            float tmp11 = tmp0 - tmp2;
+            float tmp13 = tmp1 + tmp3;
+            float tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+
+            tmp0 = tmp10 + tmp13;
+            tmp3 = tmp10 - tmp13;
+            tmp1 = tmp11 + tmp12;
+            tmp2 = tmp11 - tmp12;
+
+            //odd part
+            float tmp4 = d[1][b] * s[1];
+            float tmp5 = d[3][b] * s[3];
+            float tmp6 = d[5][b] * s[5];
+            float tmp7 = d[7][b] * s[7];
+
+            float z13 = tmp6 + tmp5;
+            float z10 = tmp6 - tmp5;
+            float z11 = tmp4 + tmp7;
+            float z12 = tmp4 - tmp7;
+
+            tmp7 = z11 + z13;
+            tmp11 = (z11 - z13) * 1.414213562f;
+
+            float z5 = (z10 + z12) * 1.847759065f;
+            tmp10 = 1.082392200f * z12 - z5;
+            tmp12 = -2.613125930f * z10 + z5;
+
+            tmp6 = tmp12 - tmp7;
+            tmp5 = tmp11 - tmp6;
+            tmp4 = tmp10 + tmp5;
+
+            d[0][b] = tmp0 + tmp7;
+            d[7][b] = tmp0 - tmp7;
+            d[1][b] = tmp1 + tmp6;
+            d[6][b] = tmp1 - tmp6;
+            d[2][b] = tmp2 + tmp5;
+            d[5][b] = tmp2 - tmp5;
+            d[4][b] = tmp3 + tmp4;
+            d[3][b] = tmp3 - tmp4;
+        }
+    }
+
+public:
+
+    /**
+     * @brief get returns the plan of size n; plans are created once.
+     * @param n
+     * @return
+     */
+    static DCTPlan *get(int n)
+    {
+        static std::mutex mutex;
+        static std::map<int, DCTPlan *> plans;
+
+        //plans are never released, so a static holder frees them at exit
+        struct Holder
+        {
+            std::map<int, DCTPlan *> &plans;
+            Holder(std::map<int, DCTPlan *> &plans) : plans(plans) {}
+            ~Holder()
+            {
+                for(auto &p : plans) {
+                    delete p.second;
+                }
+            }
+        };
+        static Holder holder(plans);
+
+        if(n < 1) {
+            return NULL;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = plans.find(n);
+        if(it != plans.end()) {
+            return it->second;
+        }
+
+        DCTPlan *plan = new DCTPlan(n);
+        plans[n] = plan;
+        return plan;
+    }
+
+    /**
+     * @brief size
+     * @return
+     */
+    int size() const
+    {
+        return n;
+    }
+
+    /**
+     * @brief forward computes in place the DCT-II of len sequences; the
+     * t-th value of the b-th sequence is at t * stride + b.
+     * @param data
+     * @param stride
+     * @param len
+     */
+    void forward(float *data, int stride, int len) const
+    {
+        if(n == 8) {
+            forward8(data, stride, len);
+            return;
+        }
+
+        //Makhoul: v[t] = x[2t], v[n - 1 - t] = x[2t + 1]
+        std::vector< float > buffer(2 * n * len, 0.0f);
+        float *re = &buffer[0];
+        float *im = re + n * len;
+
+        for(int t = 0; t < n; t++) {
+            int src = (t & 1) ? (n - 1 - (t >> 1)) : (t >> 1);
+            memcpy(re + src * len, data + t * stride, sizeof(float) * len);
+        }
+
+        fft->transform(re, im, len, len);
+
+        //X[k] = Re(exp(-i pi k / (2 n)) V[k])
+        for(int k = 0; k < n; k++) {
+            float *out = data + k * stride;
+            float *vRe = re + k * len;
+            float *vIm = im + k * len;
+            float cRe = twRe[k] * scale[k];
+            float cIm = twIm[k] * scale[k];
+
+            for(int b = 0; b < len; b++) {
+                out[b] = vRe[b] * cRe - vIm[b] * cIm;
+            }
+        }
+    }
+
+    /**
+     * @brief inverse computes in place the DCT-III of len sequences; the
+     * t-th value of the b-th sequence is at t * stride + b.
+     * @param data
+     * @param stride
+     * @param len
+     */
+    void inverse(float *data, int stride, int len) const
+    {
+        if(n == 8) {
+            inverse8(data, stride, len);
+            return;
+        }
+
+        //V[k] = exp(i pi k / (2 n)) X[k]
+        std::vector< float > buffer(2 * n * len);
+        float *re = &buffer[0];
+        float *im = re + n * len;
+
+        for(int k = 0; k < n; k++) {
+            const float *in = data + k * stride;
+            float *vRe = re + k * len;
+            float *vIm = im + k * len;
+            float cRe = twRe[k] * scale[k];
+            float cIm = -twIm[k] * scale[k];
+
+            for(int b = 0; b < len; b++) {
+                vRe[b] = in[b] * cRe;
+                vIm[b] = in[b] * cIm;
+            }
+        }
+
+        fft->transform(re, im, len, len, true);
+
+        //x[2t] = Re(v[t]), x[2t + 1] = Re(v[n - 1 - t])
+        for(int t = 0; t < n; t++) {
+            int src = (t & 1) ? (n - 1 - (t >> 1)) : (t >> 1);
+            memcpy(data + t * stride, re + src * len, sizeof(float) * len);
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_DCT_HPP */
+
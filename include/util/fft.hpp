@@ -18,14 +18,29 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_UTIL_FFT_HPP
 #define PIC_UTIL_FFT_HPP
 
+#include <math.h>
 #include <string.h>
 #include <complex>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "../base.hpp"
+#include "../image.hpp"
 #include "../util/math.hpp"
+#include "../util/span_ops.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace pic {
 
+/**
+ * @brief FFT_BATCH is the number of transforms computed at once by a task
+ * in 2D passes; each butterfly works on spans of FFT_BATCH floats.
+ */
+#ifndef FFT_BATCH
+#define FFT_BATCH 64
+#endif
+
 /**
  * @brief RE
  * @param x
@@ -55,110 +70,1018 @@ typedef std::complex<float> complexf;
 typedef std::complex<double> complexd;
 
 /**
- * @brief DFT1D
- * @param in
- * @param n
- * @param out
- * @return
+ * @brief The FFTPlan class computes the DFT of size n with a mixed-radix
+ * (4, 2, 3, 5, and any other prime) Stockham algorithm, which does not
+ * need bit reversal. Roots of unity are computed once per plan; plans are
+ * cached by size, and they are read-only, so they can be shared by threads.
+ * Each thread keeps its own table of plan pointers, so only the first
+ * request of a size in a thread takes a lock.
+ * Complex numbers are stored as separate real and imaginary parts, and
+ * transforms are not scaled.
  */
-PIC_INLINE float *DFT1D(float *in, unsigned int n, float *out = NULL)
+class FFTPlan
 {
-    if(out == NULL) {
-        out = new float[n * 2];
+protected:
+    int n;
+    std::vector< int > factors;
+    std::vector< float > rootRe, rootIm;
+    std::vector< float > realRootRe, realRootIm;
+
+    /**
+     * @brief FFTPlan
+     * @param n
+     */
+    FFTPlan(int n)
+    {
+        this->n = n;
+
+        //radices; 4 first, since it has the cheapest butterfly
+        int m = n;
+        while((m % 4) == 0) {
+            factors.push_back(4);
+            m /= 4;
+        }
+
+        for(int p = 2; m > 1; p++) {
+            while((m % p) == 0) {
+                factors.push_back(p);
+                m /= p;
+            }
+        }
+
+        //roots of unity: exp(-2 pi i t / n)
+        rootRe.resize(n);
+        rootIm.resize(n);
+        for(int t = 0; t < n; t++) {
+            double angle = -C_PI_2 * double(t) / double(n);
+            rootRe[t] = float(cos(angle));
+            rootIm[t] = float(sin(angle));
+        }
+
+        //roots of order 2 n, exp(-pi i k / n), for real transforms of 2 n values
+        realRootRe.resize(n + 1);
+        realRootIm.resize(n + 1);
+        for(int k = 0; k <= n; k++) {
+            double angle = -C_PI_2 * double(k) / double(2 * n);
+            realRootRe[k] = float(cos(angle));
+            realRootIm[k] = float(sin(angle));
+        }
     }
 
-    float n_f = float(n);
+    /**
+     * @brief butterfly computes in place the DFT of size p of (xr, xi).
+     * @param p
+     * @param xr
+     * @param xi
+     * @param yr is working memory of p values.
+     * @param yi is working memory of p values.
+     */
+    void butterfly(int p, float *xr, float *xi, float *yr, float *yi) const
+    {
+        switch(p) {
+        case 2: {
+            float tr = xr[1];
+            float ti = xi[1];
+            xr[1] = xr[0] - tr;
+            xi[1] = xi[0] - ti;
+            xr[0] += tr;
+            xi[0] += ti;
+        } break;
 
-    for(unsigned int i = 0; i < n ; i++) {
-        unsigned int re = RE(i);
-        unsigned int im = IM(i);
+        case 3: {
+            const float s = -0.86602540378f;
+            float t1r = xr[1] + xr[2];
+            float t1i = xi[1] + xi[2];
+            float t2r = xr[0] - 0.5f * t1r;
+            float t2i = xi[0] - 0.5f * t1i;
+            float t3r = s * (xr[1] - xr[2]);
+            float t3i = s * (xi[1] - xi[2]);
+            xr[0] += t1r;
+            xi[0] += t1i;
+            xr[1] = t2r - t3i;
+            xi[1] = t2i + t3r;
+            xr[2] = t2r + t3i;
+            xi[2] = t2i - t3r;
+        } break;
 
-        out[re] = 0.0f;
-        out[im] = 0.0f;
+        case 4: {
+            float s0r = xr[0] + xr[2], s0i = xi[0] + xi[2];
+            float d0r = xr[0] - xr[2], d0i = xi[0] - xi[2];
+            float s1r = xr[1] + xr[3], s1i = xi[1] + xi[3];
+            float d1r = xr[1] - xr[3], d1i = xi[1] - xi[3];
+            xr[0] = s0r + s1r;
+            xi[0] = s0i + s1i;
+            xr[2] = s0r - s1r;
+            xi[2] = s0i - s1i;
+            xr[1] = d0r + d1i;
+            xi[1] = d0i - d1r;
+            xr[3] = d0r - d1i;
+            xi[3] = d0i + d1r;
+        } break;
 
-        float i_f = float(i);
-        for(unsigned int j = 0; j < n ; j++) {
+        case 5: {
+            const float c1 = 0.30901699437f, c2 = -0.80901699437f;
+            const float s1 = 0.95105651629f, s2 = 0.58778525229f;
+            float a1r = xr[1] + xr[4], a1i = xi[1] + xi[4];
+            float a2r = xr[2] + xr[3], a2i = xi[2] + xi[3];
+            float b1r = xr[1] - xr[4], b1i = xi[1] - xi[4];
+            float b2r = xr[2] - xr[3], b2i = xi[2] - xi[3];
+            float u1r = xr[0] + c1 * a1r + c2 * a2r;
+            float u1i = xi[0] + c1 * a1i + c2 * a2i;
+            float u2r = xr[0] + c2 * a1r + c1 * a2r;
+            float u2i = xi[0] + c2 * a1i + c1 * a2i;
+            float v1r = s1 * b1r + s2 * b2r, v1i = s1 * b1i + s2 * b2i;
+            float v2r = s2 * b1r - s1 * b2r, v2i = s2 * b1i - s1 * b2i;
+            xr[0] += a1r + a2r;
+            xi[0] += a1i + a2i;
+            xr[1] = u1r + v1i;
+            xi[1] = u1i - v1r;
+            xr[4] = u1r - v1i;
+            xi[4] = u1i + v1r;
+            xr[2] = u2r + v2i;
+            xi[2] = u2i - v2r;
+            xr[3] = u2r - v2i;
+            xi[3] = u2i + v2r;
+        } break;
+
+        default: {
+            int step = n / p;
+
+            for(int s = 0; s < p; s++) {
+                yr[s] = 0.0f;
+                yi[s] = 0.0f;
+
+                for(int r = 0; r < p; r++) {
+                    int t = ((r * s) % p) * step;
+                    yr[s] += xr[r] * rootRe[t] - xi[r] * rootIm[t];
+                    yi[s] += xr[r] * rootIm[t] + xi[r] * rootRe[t];
+                }
+            }
 
-            float angle = -C_PI_2 * i_f * float(j) / n_f;
-            out[re] += in[j] * cosf(angle);
-            out[im] += in[j] * sinf(angle);
+            memcpy(xr, yr, sizeof(float) * p);
+            memcpy(xi, yi, sizeof(float) * p);
+        } break;
         }
     }
 
-    return out;
-}
+    /**
+     * @brief stage computes a radix-p pass of the Stockham algorithm for a
+     * single transform.
+     * @param inRe
+     * @param inIm
+     * @param outRe
+     * @param outIm
+     * @param p
+     * @param Ns is the product of the radices of the previous passes.
+     * @param work is working memory of 4 * p values.
+     */
+    void stage(const float *inRe, const float *inIm, float *outRe, float *outIm,
+               int p, int Ns, float *work) const
+    {
+        int m = n / p;
+        int tw = m / Ns;
+
+        float *xr = work;
+        float *xi = work + p;
+
+        for(int j = 0; j < m; j++) {
+            int k = j % Ns;
+            int o = (j - k) * p + k;
+
+            xr[0] = inRe[j];
+            xi[0] = inIm[j];
+
+            for(int r = 1; r < p; r++) {
+                int t = r * k * tw;
+                float ar = inRe[j + r * m];
+                float ai = inIm[j + r * m];
+                xr[r] = ar * rootRe[t] - ai * rootIm[t];
+                xi[r] = ar * rootIm[t] + ai * rootRe[t];
+            }
+
+            butterfly(p, xr, xi, work + 2 * p, work + 3 * p);
+
+            for(int s = 0; s < p; s++) {
+                outRe[o + s * Ns] = xr[s];
+                outIm[o + s * Ns] = xi[s];
+            }
+        }
+    }
+
+    /**
+     * @brief butterflyBatch computes the radix-p butterflies of len
+     * transforms at once for p = 2, 3, 4, and 5. For p = 2, 4, and 5, they
+     * are computed on spans with SpanOps: twiddled inputs are written in
+     * the output spans (and in work for p = 5), which are then combined in
+     * place, and inputs are placed so that products by -i need no extra
+     * pass.
+     * @param p
+     * @param xr are the p input spans.
+     * @param xi
+     * @param wr are the p - 1 twiddles of the inputs 1, ..., p - 1.
+     * @param wi
+     * @param yr are the p output spans.
+     * @param yi
+     * @param len
+     * @param work is working memory of 8 * len values.
+     * @return It returns false if p has no butterfly.
+     */
+    bool butterflyBatch(int p, const float **xr, const float **xi,
+                        const float *wr, const float *wi,
+                        float **yr, float **yi, int len, float *work) const
+    {
+        switch(p) {
+        case 2: {
+            memcpy(yr[0], xr[0], sizeof(float) * len);
+            memcpy(yi[0], xi[0], sizeof(float) * len);
+            SpanOps::cmul(yr[1], yi[1], xr[1], xi[1], wr[0], wi[0], len);
+
+            SpanOps::sumDiff(yr[0], yr[1], len);
+            SpanOps::sumDiff(yi[0], yi[1], len);
+        } return true;
+
+        case 3: {
+            //a fused loop; as a sequence of spans, radix 3 is slower
+            const float s = -0.86602540378f;
+
+            for(int i = 0; i < len; i++) {
+                float x1r = xr[1][i] * wr[0] - xi[1][i] * wi[0];
+                float x1i = xr[1][i] * wi[0] + xi[1][i] * wr[0];
+                float x2r = xr[2][i] * wr[1] - xi[2][i] * wi[1];
+                float x2i = xr[2][i] * wi[1] + xi[2][i] * wr[1];
+
+                float t1r = x1r + x2r;
+                float t1i = x1i + x2i;
+                float t2r = xr[0][i] - 0.5f * t1r;
+                float t2i = xi[0][i] - 0.5f * t1i;
+                float t3r = s * (x1r - x2r);
+                float t3i = s * (x1i - x2i);
+                yr[0][i] = xr[0][i] + t1r;
+                yi[0][i] = xi[0][i] + t1i;
+                yr[1][i] = t2r - t3i;
+                yi[1][i] = t2i + t3r;
+                yr[2][i] = t2r + t3i;
+                yi[2][i] = t2i - t3r;
+            }
+        } return true;
+
+        case 4: {
+            //x1 -> (yr2, yi2), x2 -> (yr1, yi3), x3 -> (yi1, yr3)
+            memcpy(yr[0], xr[0], sizeof(float) * len);
+            memcpy(yi[0], xi[0], sizeof(float) * len);
+            SpanOps::cmul(yr[2], yi[2], xr[1], xi[1], wr[0], wi[0], len);
+            SpanOps::cmul(yr[1], yi[3], xr[2], xi[2], wr[1], wi[1], len);
+            SpanOps::cmul(yi[1], yr[3], xr[3], xi[3], wr[2], wi[2], len);
+
+            //s0 = x0 + x2 -> y0, d0 = x0 - x2 -> (yr1, yi3)
+            SpanOps::sumDiff(yr[0], yr[1], len);
+            SpanOps::sumDiff(yi[0], yi[3], len);
+
+            //s1 = x1 + x3 -> y2, d1 = x1 - x3 -> (yi1, yr3)
+            SpanOps::sumDiff(yr[2], yi[1], len);
+            SpanOps::sumDiff(yi[2], yr[3], len);
+
+            //y0 = s0 + s1, y2 = s0 - s1, y1 = d0 - i d1, y3 = d0 + i d1
+            SpanOps::sumDiff(yr[0], yr[2], len);
+            SpanOps::sumDiff(yi[0], yi[2], len);
+            SpanOps::sumDiff(yr[1], yr[3], len);
+            SpanOps::sumDiff(yi[3], yi[1], len);
+        } return true;
+
+        case 5: {
+            const float c1 = 0.30901699437f, c2 = -0.80901699437f;
+            const float s1 = 0.95105651629f, s2 = 0.58778525229f;
+
+            float *a1r = work,           *a1i = work + len;
+            float *b1r = work + 2 * len, *b1i = work + 3 * len;
+            float *a2r = work + 4 * len, *a2i = work + 5 * len;
+            float *b2r = work + 6 * len, *b2i = work + 7 * len;
+
+            //a1 = x1 + x4, b1 = x1 - x4, a2 = x2 + x3, b2 = x2 - x3
+            SpanOps::cmul(a1r, a1i, xr[1], xi[1], wr[0], wi[0], len);
+            SpanOps::cmul(b1r, b1i, xr[4], xi[4], wr[3], wi[3], len);
+            SpanOps::cmul(a2r, a2i, xr[2], xi[2], wr[1], wi[1], len);
+            SpanOps::cmul(b2r, b2i, xr[3], xi[3], wr[2], wi[2], len);
+            SpanOps::sumDiff(a1r, b1r, len);
+            SpanOps::sumDiff(a1i, b1i, len);
+            SpanOps::sumDiff(a2r, b2r, len);
+            SpanOps::sumDiff(a2i, b2i, len);
+
+            //u1 -> (yr1, yi4), u2 -> (yr2, yi3)
+            memcpy(yr[1], xr[0], sizeof(float) * len);
+            memcpy(yi[4], xi[0], sizeof(float) * len);
+            memcpy(yr[2], xr[0], sizeof(float) * len);
+            memcpy(yi[3], xi[0], sizeof(float) * len);
+            SpanOps::madd(yr[1], a1r, c1, len);
+            SpanOps::madd(yr[1], a2r, c2, len);
+            SpanOps::madd(yi[4], a1i, c1, len);
+            SpanOps::madd(yi[4], a2i, c2, len);
+            SpanOps::madd(yr[2], a1r, c2, len);
+            SpanOps::madd(yr[2], a2r, c1, len);
+            SpanOps::madd(yi[3], a1i, c2, len);
+            SpanOps::madd(yi[3], a2i, c1, len);
+
+            //v1 -> (yi1, yr4), v2 -> (yi2, yr3)
+            SpanOps::assign(yi[1], b1r, s1, len);
+            SpanOps::madd(yi[1], b2r, s2, len);
+            SpanOps::assign(yr[4], b1i, s1, len);
+            SpanOps::madd(yr[4], b2i, s2, len);
+            SpanOps::assign(yi[2], b1r, s2, len);
+            SpanOps::madd(yi[2], b2r, -s1, len);
+            SpanOps::assign(yr[3], b1i, s2, len);
+            SpanOps::madd(yr[3], b2i, -s1, len);
+
+            //y0 = x0 + a1 + a2
+            memcpy(yr[0], xr[0], sizeof(float) * len);
+            memcpy(yi[0], xi[0], sizeof(float) * len);
+            SpanOps::madd(yr[0], a1r, 1.0f, len);
+            SpanOps::madd(yr[0], a2r, 1.0f, len);
+            SpanOps::madd(yi[0], a1i, 1.0f, len);
+            SpanOps::madd(yi[0], a2i, 1.0f, len);
+
+            //y1 = u1 - i v1, y4 = u1 + i v1, y2 = u2 - i v2, y3 = u2 + i v2
+            SpanOps::sumDiff(yr[1], yr[4], len);
+            SpanOps::sumDiff(yi[4], yi[1], len);
+            SpanOps::sumDiff(yr[2], yr[3], len);
+            SpanOps::sumDiff(yi[3], yi[2], len);
+        } return true;
+
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief stageBatch computes a radix-p pass for len transforms at
+     * once; the t-th value of all transforms is the span [t * len,
+     * (t + 1) * len), so butterflies are computed on spans. Radices without
+     * a butterfly are computed as a direct DFT of p * (p - 1)
+     * SpanOps::cmadd.
+     * @param inRe
+     * @param inIm
+     * @param outRe
+     * @param outIm
+     * @param p
+     * @param Ns
+     * @param len
+     * @param work is working memory of 8 * len values.
+     */
+    void stageBatch(const float *inRe, const float *inIm, float *outRe, float *outIm,
+                    int p, int Ns, int len, float *work) const
+    {
+        int m = n / p;
+        int tw = m / Ns;
+
+        const float *xr[5], *xi[5];
+        float *yr[5], *yi[5], wr[4], wi[4];
+
+        for(int j = 0; j < m; j++) {
+            int k = j % Ns;
+            int o = (j - k) * p + k;
+
+            if(p <= 5) {
+                for(int r = 0; r < p; r++) {
+                    xr[r] = inRe + (j + r * m) * len;
+                    xi[r] = inIm + (j + r * m) * len;
+                    yr[r] = outRe + (o + r * Ns) * len;
+                    yi[r] = outIm + (o + r * Ns) * len;
+                }
+
+                for(int r = 1; r < p; r++) {
+                    wr[r - 1] = rootRe[r * k * tw];
+                    wi[r - 1] = rootIm[r * k * tw];
+                }
+
+                if(butterflyBatch(p, xr, xi, wr, wi, yr, yi, len, work)) {
+                    continue;
+                }
+            }
+
+            for(int s = 0; s < p; s++) {
+                float *ysr = outRe + (o + s * Ns) * len;
+                float *ysi = outIm + (o + s * Ns) * len;
+
+                memcpy(ysr, inRe + j * len, sizeof(float) * len);
+                memcpy(ysi, inIm + j * len, sizeof(float) * len);
+
+                //twiddle and root of unity are a single root of order n
+                for(int r = 1; r < p; r++) {
+                    int t = (r * (k * tw + s * m)) % n;
+                    SpanOps::cmadd(ysr, ysi, inRe + (j + r * m) * len,
+                                   inIm + (j + r * m) * len,
+                                   rootRe[t], rootIm[t], len);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief getScratch returns working memory of at least size floats;
+     * it is kept by each thread between transforms.
+     * @param size
+     * @return
+     */
+    static float *getScratch(size_t size)
+    {
+        static thread_local std::vector< float > scratch;
+
+        if(scratch.size() < size) {
+            scratch.resize(size);
+        }
+
+        return &scratch[0];
+    }
+
+    /**
+     * @brief untangle computes the output k of a real transform from
+     * z[k] = (ar, ai) and z[n - k] = (br, bi).
+     * @param ar
+     * @param ai
+     * @param br
+     * @param bi
+     * @param k
+     * @param yr
+     * @param yi
+     */
+    void untangle(float ar, float ai, float br, float bi, int k,
+                  float &yr, float &yi) const
+    {
+        //even and odd parts
+        float er = 0.5f * (ar + br);
+        float ei = 0.5f * (ai - bi);
+        float or_ = 0.5f * (ai + bi);
+        float oi = -0.5f * (ar - br);
+
+        float wr = realRootRe[k];
+        float wi = realRootIm[k];
+
+        yr = er + or_ * wr - oi * wi;
+        yi = ei + or_ * wi + oi * wr;
+    }
+
+    /**
+     * @brief create returns the shared plan of size n, and it creates it
+     * if needed; the shared table is locked.
+     * @param n
+     * @return
+     */
+    static FFTPlan *create(int n)
+    {
+        static std::mutex mutex;
+        static std::map<int, FFTPlan *> plans;
+
+        //plans are never released, so a static holder frees them at exit
+        struct Holder
+        {
+            std::map<int, FFTPlan *> &plans;
+            Holder(std::map<int, FFTPlan *> &plans) : plans(plans) {}
+            ~Holder()
+            {
+                for(auto &p : plans) {
+                    delete p.second;
+                }
+            }
+        };
+        static Holder holder(plans);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = plans.find(n);
+        if(it != plans.end()) {
+            return it->second;
+        }
+
+        FFTPlan *plan = new FFTPlan(n);
+        plans[n] = plan;
+        return plan;
+    }
+
+public:
+
+    /**
+     * @brief get returns the plan of size n; plans are created once, and
+     * cache hits do not lock.
+     * @param n
+     * @return
+     */
+    static FFTPlan *get(int n)
+    {
+        if(n < 1) {
+            return NULL;
+        }
+
+        //plans are never released, so their pointers can be kept by threads
+        static thread_local std::map<int, FFTPlan *> local;
+
+        auto it = local.find(n);
+        if(it != local.end()) {
+            return it->second;
+        }
+
+        FFTPlan *plan = create(n);
+        local[n] = plan;
+        return plan;
+    }
+
+    /**
+     * @brief getGoodSize
+     * @param n
+     * @return It returns the smallest size >= n whose factors are 2, 3, 5.
+     */
+    static int getGoodSize(int n)
+    {
+        for(int m = MAX(n, 1); ; m++) {
+            int t = m;
+
+            while((t % 2) == 0) {
+                t /= 2;
+            }
+
+            while((t % 3) == 0) {
+                t /= 3;
+            }
+
+            while((t % 5) == 0) {
+                t /= 5;
+            }
+
+            if(t == 1) {
+                return m;
+            }
+        }
+    }
+
+    /**
+     * @brief size
+     * @return
+     */
+    int size() const
+    {
+        return n;
+    }
+
+    /**
+     * @brief transform computes in place the DFT of a single sequence.
+     * @param re
+     * @param im
+     * @param bInverse computes the inverse DFT (without scaling).
+     */
+    void transform(float *re, float *im, bool bInverse = false) const
+    {
+        //the inverse is the DFT with real and imaginary parts swapped
+        if(bInverse) {
+            std::swap(re, im);
+        }
+
+        int maxP = factors.empty() ? 1 : factors.back();
+        float *bufRe = getScratch(2 * n + 4 * maxP);
+        float *bufIm = bufRe + n;
+        float *work = bufIm + n;
+
+        float *inRe = re, *inIm = im;
+        float *outRe = bufRe, *outIm = bufIm;
+
+        int Ns = 1;
+        for(unsigned int i = 0; i < factors.size(); i++) {
+            stage(inRe, inIm, outRe, outIm, factors[i], Ns, work);
+            Ns *= factors[i];
+            std::swap(inRe, outRe);
+            std::swap(inIm, outIm);
+        }
+
+        if(inRe != re) {
+            memcpy(re, inRe, sizeof(float) * n);
+            memcpy(im, inIm, sizeof(float) * n);
+        }
+    }
+
+    /**
+     * @brief transform computes in place the DFT of len sequences; the t-th
+     * value of the b-th sequence is at t * stride + b.
+     * @param re
+     * @param im
+     * @param stride
+     * @param len
+     * @param bInverse computes the inverse DFT (without scaling).
+     */
+    void transform(float *re, float *im, int stride, int len, bool bInverse = false) const
+    {
+        if(bInverse) {
+            std::swap(re, im);
+        }
+
+        float *inRe = getScratch(size_t(4 * n + 8) * size_t(len));
+        float *inIm = inRe + n * len;
+        float *outRe = inIm + n * len;
+        float *outIm = outRe + n * len;
+        float *work = outIm + n * len;
+
+        for(int t = 0; t < n; t++) {
+            memcpy(inRe + t * len, re + t * stride, sizeof(float) * len);
+            memcpy(inIm + t * len, im + t * stride, sizeof(float) * len);
+        }
+
+        int Ns = 1;
+        for(unsigned int i = 0; i < factors.size(); i++) {
+            stageBatch(inRe, inIm, outRe, outIm, factors[i], Ns, len, work);
+            Ns *= factors[i];
+            std::swap(inRe, outRe);
+            std::swap(inIm, outIm);
+        }
+
+        for(int t = 0; t < n; t++) {
+            memcpy(re + t * stride, inRe + t * len, sizeof(float) * len);
+            memcpy(im + t * stride, inIm + t * len, sizeof(float) * len);
+        }
+    }
+
+    /**
+     * @brief transformReal computes the DFT of 2 * n real values; even and
+     * odd values are packed in a complex sequence of size n, which is
+     * transformed in the output, and then untangled in place.
+     * @param in has 2 * n values.
+     * @param outRe has n + 1 values; the others are their conjugates.
+     * @param outIm has n + 1 values.
+     */
+    void transformReal(const float *in, float *outRe, float *outIm) const
+    {
+        for(int i = 0; i < n; i++) {
+            outRe[i] = in[i << 1];
+            outIm[i] = in[(i << 1) + 1];
+        }
+
+        transform(outRe, outIm);
+
+        //the outputs k and n - k depend only on z[k] and z[n - k]
+        for(int k = 0; k <= (n >> 1); k++) {
+            int k0 = k % n;
+            int k1 = (n - k) % n;
+
+            float ar = outRe[k0], ai = outIm[k0];
+            float br = outRe[k1], bi = outIm[k1];
+
+            float yr, yi;
+            untangle(ar, ai, br, bi, k, yr, yi);
+
+            if((n - k) != k) {
+                untangle(br, bi, ar, ai, n - k, outRe[n - k], outIm[n - k]);
+            }
+
+            outRe[k] = yr;
+            outIm[k] = yi;
+        }
+    }
+};
 
 /**
- * @brief bitReversal
+ * @brief FFTReal1D computes the DFT of a real sequence of size n; the
+ * output has n / 2 + 1 values, the others are their conjugates. For an even
+ * n, the even and odd values are packed in a complex sequence of size n / 2.
+ * @param in
  * @param n
- * @param nbit
- * @return
+ * @param outRe
+ * @param outIm
  */
-PIC_INLINE unsigned int bitReversal(unsigned int n, unsigned int nbit)
+PIC_INLINE void FFTReal1D(const float *in, int n, float *outRe, float *outIm)
 {
-    unsigned int out = 0;
-    for(int i = nbit; i>0; i--) {
-        unsigned int bit = (n >> (i - 1)) & 0x00000001;
-        out += bit << (nbit - i);
+    if(n < 1) {
+        return;
     }
 
-    return out;
+    if((n & 1) || (n < 4)) {
+        //working memory is kept by each thread between calls
+        static thread_local std::vector< float > buffer;
+
+        if(buffer.size() < size_t(2 * n)) {
+            buffer.resize(2 * n);
+        }
+
+        float *re = &buffer[0];
+        float *im = re + n;
+
+        memcpy(re, in, sizeof(float) * n);
+        memset(im, 0, sizeof(float) * n);
+
+        FFTPlan::get(n)->transform(re, im);
+        memcpy(outRe, re, sizeof(float) * (n / 2 + 1));
+        memcpy(outIm, im, sizeof(float) * (n / 2 + 1));
+        return;
+    }
+
+    FFTPlan::get(n >> 1)->transformReal(in, outRe, outIm);
 }
 
 /**
- * @brief FFTIterative1D
- * @param in
- * @param n
- * @param out
- * @return
+ * @brief The FFT2D class computes 2D DFTs of width x height values with
+ * parallel passes on columns and on rows; rows are transposed in tiles, so
+ * both passes transform batches of contiguous spans. Real inputs are
+ * transformed two columns at once. Working memory is kept between calls.
  */
-PIC_INLINE float *FFTIterative1D(float *in, unsigned int n, float *out = NULL)
+class FFT2D
 {
-    if(out == NULL) {
-        out = new float[n * 2];
+protected:
+    int width, height;
+    std::vector< float > tRe, tIm;
+
+    /**
+     * @brief columns transforms the columns of a w x h complex array.
+     * @param re
+     * @param im
+     * @param w
+     * @param h
+     * @param bInverse
+     */
+    static void columns(float *re, float *im, int w, int h, bool bInverse)
+    {
+        FFTPlan *plan = FFTPlan::get(h);
+        int nChunks = (w + FFT_BATCH - 1) / FFT_BATCH;
+
+        ThreadPool::getInstance()->parallelFor(nChunks, [&](int c) {
+            int x0 = c * FFT_BATCH;
+            plan->transform(re + x0, im + x0, w, MIN(w - x0, FFT_BATCH), bInverse);
+        });
+    }
+
+    /**
+     * @brief transpose transposes a w x h array in tiles.
+     * @param in
+     * @param out
+     * @param w
+     * @param h
+     */
+    static void transpose(const float *in, float *out, int w, int h)
+    {
+        const int tile = 32;
+        int nTiles = (h + tile - 1) / tile;
+
+        ThreadPool::getInstance()->parallelFor(nTiles, [&](int ty) {
+            int y0 = ty * tile;
+            int y1 = MIN(y0 + tile, h);
+
+            for(int x0 = 0; x0 < w; x0 += tile) {
+                int x1 = MIN(x0 + tile, w);
+
+                for(int y = y0; y < y1; y++) {
+                    for(int x = x0; x < x1; x++) {
+                        out[x * h + y] = in[y * w + x];
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief rows transforms the rows of the width x height array.
+     * @param re
+     * @param im
+     * @param bInverse
+     */
+    void rows(float *re, float *im, bool bInverse)
+    {
+        transpose(re, &tRe[0], width, height);
+        transpose(im, &tIm[0], width, height);
+        columns(&tRe[0], &tIm[0], height, width, bInverse);
+        transpose(&tRe[0], re, height, width);
+        transpose(&tIm[0], im, height, width);
     }
 
-    unsigned int logn = std::log2(n);
+public:
 
-    for(unsigned int i = 0; i< n; i++) {
-        //bit reversal
-        unsigned int i_rev = bitReversal(i, logn);
-        out[RE(i_rev)] = in[i];
-        out[IM(i_rev)] = 0.0f;
+    FFT2D()
+    {
+        width = height = 0;
     }
 
-    for(unsigned int s = 1; s <= logn; s++) {
-        int m = 1 << s;
-        float angle = -C_PI_2 / float(m);
+    /**
+     * @brief FFT2D
+     * @param width
+     * @param height
+     */
+    FFT2D(int width, int height)
+    {
+        this->width = this->height = 0;
+        setup(width, height);
+    }
 
-        complexf omega_m = complexf(cosf(angle), sinf(angle));
-        complexf omega = complexf(1.0f, 0.0f);
+    /**
+     * @brief setup
+     * @param width
+     * @param height
+     */
+    void setup(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
 
-        for(unsigned int j = 0; j < (m / 2); j++) {
-            for(unsigned int k = j; k < n; k += m) {
-                unsigned int ind = k + m / 2;
+        tRe.resize(width * height);
+        tIm.resize(width * height);
+    }
 
-                complexf t = omega * complexf(out[RE(ind)], out[IM(ind)]);
-                complexf u = complexf(out[RE(k)], out[IM(k)]);
+    /**
+     * @brief forward computes in place the DFT of a complex array.
+     * @param re
+     * @param im
+     */
+    void forward(float *re, float *im)
+    {
+        columns(re, im, width, height, false);
+        rows(re, im, false);
+    }
 
-                complexf tmp0 = u + t;
+    /**
+     * @brief inverse computes in place the inverse DFT of a complex array;
+     * it is scaled by 1 / (width * height).
+     * @param re
+     * @param im
+     */
+    void inverse(float *re, float *im)
+    {
+        rows(re, im, true);
+        columns(re, im, width, height, true);
 
-                out[RE(k)] = tmp0.real();
-                out[IM(k)] = tmp0.imag();
+        int n = width * height;
+        float scale = 1.0f / float(n);
+        SpanOps::assign(re, re, scale, n);
+        SpanOps::assign(im, im, scale, n);
+    }
 
-                complexf tmp1 = u - t;
+    /**
+     * @brief forwardReal computes the DFT of a real array; columns x and
+     * x + (width + 1) / 2 are packed into a complex column, so the column
+     * pass transforms half of the columns.
+     * @param data is the real array.
+     * @param stride is the distance in floats between two values of data;
+     * e.g., the number of channels of an Image.
+     * @param re is the output; it has width * height values.
+     * @param im is the output; it has width * height values.
+     */
+    void forwardReal(const float *data, int stride, float *re, float *im)
+    {
+        int half = (width + 1) >> 1;
+        float *zr = &tRe[0];
+        float *zi = &tIm[0];
 
-                out[RE(ind)] = tmp1.real();
-                out[IM(ind)] = tmp1.imag();
+        ThreadPool::getInstance()->parallelFor(height, [&](int y) {
+            const float *row = data + y * width * stride;
+
+            for(int x = 0; x < half; x++) {
+                zr[y * half + x] = row[x * stride];
+                zi[y * half + x] = (x + half) < width ? row[(x + half) * stride] : 0.0f;
             }
+        });
 
-            omega *= omega_m;
-        }
+        columns(zr, zi, half, height, false);
+
+        //unpacking: A = (Z_k + conj(Z_-k)) / 2, B = (Z_k - conj(Z_-k)) / 2i
+        ThreadPool::getInstance()->parallelFor(height, [&](int y) {
+            int yc = (height - y) % height;
+
+            for(int x = 0; x < half; x++) {
+                float ar = zr[y * half + x], ai = zi[y * half + x];
+                float br = zr[yc * half + x], bi = -zi[yc * half + x];
+
+                re[y * width + x] = 0.5f * (ar + br);
+                im[y * width + x] = 0.5f * (ai + bi);
+
+                if((x + half) < width) {
+                    re[y * width + x + half] = 0.5f * (ai - bi);
+                    im[y * width + x + half] = -0.5f * (ar - br);
+                }
+            }
+        });
+
+        rows(re, im, false);
+    }
+
+    /**
+     * @brief inverseReal computes the inverse DFT of the DFT of a real
+     * array, e.g., the product of two such DFTs; re and im are overwritten.
+     * @param re
+     * @param im
+     * @param data is the output real array.
+     * @param stride is the distance in floats between two values of data.
+     */
+    void inverseReal(float *re, float *im, float *data, int stride)
+    {
+        rows(re, im, true);
+
+        int half = (width + 1) >> 1;
+        float *zr = &tRe[0];
+        float *zi = &tIm[0];
+
+        //packing: Z = A + iB, whose inverse is a + ib
+        ThreadPool::getInstance()->parallelFor(height, [&](int y) {
+            for(int x = 0; x < half; x++) {
+                float ar = re[y * width + x], ai = im[y * width + x];
+                float br = 0.0f, bi = 0.0f;
+
+                if((x + half) < width) {
+                    br = re[y * width + x + half];
+                    bi = im[y * width + x + half];
+                }
+
+                zr[y * half + x] = ar - bi;
+                zi[y * half + x] = ai + br;
+            }
+        });
+
+        columns(zr, zi, half, height, true);
+
+        float scale = 1.0f / float(width * height);
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int y) {
+            float *row = data + y * width * stride;
+
+            for(int x = 0; x < half; x++) {
+                row[x * stride] = zr[y * half + x] * scale;
+
+                if((x + half) < width) {
+                    row[(x + half) * stride] = zi[y * half + x] * scale;
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief forward computes the DFT of a channel of an Image.
+     * @param img
+     * @param channel
+     * @param re
+     * @param im
+     */
+    void forward(Image *img, int channel, float *re, float *im)
+    {
+        setup(img->width, img->height);
+        forwardReal(img->data + channel, img->channels, re, im);
+    }
+
+    /**
+     * @brief inverse computes the inverse DFT into a channel of an Image.
+     * @param re
+     * @param im
+     * @param img
+     * @param channel
+     */
+    void inverse(float *re, float *im, Image *img, int channel)
+    {
+        inverseReal(re, im, img->data + channel, img->channels);
+    }
+};
+
+/**
+ * @brief DFT1D computes the DFT of a real sequence.
+ * @param in
+ * @param n
+ * @param out is the output, interleaved (RE/IM); it has n complex values.
+ * @return
+ */
+PIC_INLINE float *DFT1D(float *in, unsigned int n, float *out = NULL)
+{
+    if(out == NULL) {
+        out = new float[n * 2];
+    }
+
+    std::vector< float > re(in, in + n), im(n, 0.0f);
+    FFTPlan::get(int(n))->transform(&re[0], &im[0]);
+
+    for(unsigned int i = 0; i < n; i++) {
+        out[RE(i)] = re[i];
+        out[IM(i)] = im[i];
     }
 
     return out;
 }
 
+/**
+ * @brief bitReversal
+ * @param n
+ * @param nbit
+ * @return
+ */
+PIC_INLINE unsigned int bitReversal(unsigned int n, unsigned int nbit)
+{
+    unsigned int out = 0;
+    for(int i = nbit; i>0; i--) {
+        unsigned int bit = (n >> (i - 1)) & 0x00000001;
+        out += bit << (nbit - i);
+    }
+
+    return out;
+}
+
+/**
+ * @brief FFTIterative1D computes the DFT of a real sequence; n does not
+ * have to be a power of two.
+ * @param in
+ * @param n
+ * @param out is the output, interleaved (RE/IM); it has n complex values.
+ * @return
+ */
+PIC_INLINE float *FFTIterative1D(float *in, unsigned int n, float *out = NULL)
+{
+    return DFT1D(in, n, out);
+}
+
 /**
  * @brief fftTest
  */
@@ -188,6 +1111,10 @@ PIC_INLINE void fftTest()
     for(int i=0;i<n;i++) {
         printf("%3.3f %3.3f\n", values_dft[RE(i)], values_dft[IM(i)]);
     }
+
+    delete[] values;
+    delete[] values_fft;
+    delete[] values_dft;
 }
 
 } // end namespace pic
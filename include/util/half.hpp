@@ -0,0 +1,180 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_HALF_HPP
+#define PIC_UTIL_HALF_HPP
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "../base.hpp"
+
+namespace pic {
+
+/**
+ * @brief The HalfTable class stores the float value of every half float
+ * (IEEE 754 binary16).
+ */
+class HalfTable
+{
+public:
+    float table[65536];
+
+    HalfTable()
+    {
+        for(unsigned int i = 0; i < 65536; i++) {
+            unsigned int sign = (i & 0x8000) << 16;
+            unsigned int exponent = (i >> 10) & 0x1f;
+            unsigned int mantissa = i & 0x3ff;
+            unsigned int bits;
+
+            if(exponent == 0) {
+                //zero or denormal
+                float value = ldexpf(float(mantissa), -24);
+                memcpy(&bits, &value, sizeof(float));
+                bits |= sign;
+            } else {
+                if(exponent == 31) {
+                    //infinity or NaN
+                    bits = sign | 0x7f800000 | (mantissa << 13);
+                } else {
+                    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+                }
+            }
+
+            memcpy(&table[i], &bits, sizeof(float));
+        }
+    }
+};
+
+/**
+ * @brief getHalfTable
+ * @return It returns the table of HalfTable; it is initialized once.
+ */
+PIC_INLINE const float *getHalfTable()
+{
+    static HalfTable halfTable;
+    return halfTable.table;
+}
+
+/**
+ * @brief floatToHalf converts a float into a half float rounding to
+ * the nearest even; values out of range become infinity.
+ * @param value
+ * @return
+ */
+inline unsigned short floatToHalf(float value)
+{
+    unsigned int x;
+    memcpy(&x, &value, sizeof(float));
+
+    unsigned int sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+
+    //infinity or NaN
+    if(x >= 0x7f800000) {
+        return (unsigned short)(sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00));
+    }
+
+    //overflow: 65520 and above are rounded to infinity
+    if(x >= 0x477ff000) {
+        return (unsigned short)(sign | 0x7c00);
+    }
+
+    //zero or denormal: the float unit does the rounding
+    if(x < 0x38800000) {
+        float tmp;
+        memcpy(&tmp, &x, sizeof(float));
+        tmp += 0.5f;
+
+        unsigned int bits;
+        memcpy(&bits, &tmp, sizeof(float));
+        return (unsigned short)(sign | (bits - 0x3f000000));
+    }
+
+    //normal: rebias the exponent and round the mantissa
+    unsigned int mantissaOdd = (x >> 13) & 1;
+    x += 0xc8000fff + mantissaOdd;
+    return (unsigned short)(sign | (x >> 13));
+}
+
+/**
+ * @brief halfToFloat converts a half float into a float.
+ * @param value
+ * @return
+ */
+inline float halfToFloat(unsigned short value)
+{
+    return getHalfTable()[value];
+}
+
+/**
+ * @brief floatToHalfBuffer converts n floats into half floats; F16C is
+ * used when it is enabled by the compiler.
+ * @param in
+ * @param out
+ * @param n
+ */
+PIC_INLINE void floatToHalfBuffer(const float *in, unsigned short *out, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__F16C__)
+    for(; (i + 8) <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *) (out + i), h);
+    }
+#endif
+
+    for(; i < n; i++) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+/**
+ * @brief halfToFloatBuffer converts n half floats into floats; F16C is
+ * used when it is enabled by the compiler.
+ * @param in
+ * @param out
+ * @param n
+ */
+PIC_INLINE void halfToFloatBuffer(const unsigned short *in, float *out, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__F16C__)
+    for(; (i + 8) <= n; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *) (in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+#endif
+
+    const float *table = getHalfTable();
+
+    for(; i < n; i++) {
+        out[i] = table[in[i]];
+    }
+}
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_HALF_HPP */
+
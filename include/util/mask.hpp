@@ -18,9 +18,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #ifndef PIC_UTIL_MASK_HPP
 #define PIC_UTIL_MASK_HPP
 
+#include <stdint.h>
+#include <vector>
+
 #include "../base.hpp"
 #include "../util/math.hpp"
 #include "../util/buffer.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace pic {
 
@@ -78,55 +82,207 @@ public:
     }
 
     /**
-     * @brief erode erodes a mask.
-     * @param dataOut
+     * @brief getWordsPerRow
+     * @param width
+     * @return It returns the number of 64-bit words of a packed row.
+     */
+    static int getWordsPerRow(int width)
+    {
+        return (width + 63) >> 6;
+    }
+
+    /**
+     * @brief pack packs a mask in 64-bit words; each row starts at a
+     * new word, and bits after the end of a row are zero. Rows are packed
+     * in parallel.
+     * @param words
      * @param dataIn
      * @param width
      * @param height
-     * @param kernelSize
-     * @return
+     * @param bNegative negates the mask.
      */
-    static bool *erode(bool *dataOut, bool *dataIn, int width, int height,
-                       int kernelSize = 3)
+    static void pack(uint64_t *words, bool *dataIn, int width, int height,
+                     bool bNegative = false)
     {
-        if(dataIn == NULL) {
-            return dataOut;
+        int nWords = getWordsPerRow(width);
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int i) {
+            bool *row = &dataIn[i * width];
+            uint64_t *words_i = &words[i * nWords];
+
+            for(int w = 0; w < nWords; w++) {
+                int j0 = w << 6;
+                int j1 = MIN(j0 + 64, width);
+
+                uint64_t word = 0;
+                for(int j = j0; j < j1; j++) {
+                    if(row[j] != bNegative) {
+                        word |= uint64_t(1) << (j - j0);
+                    }
+                }
+
+                words_i[w] = word;
+            }
+        });
+    }
+
+    /**
+     * @brief unpack unpacks a mask from 64-bit words; rows are unpacked
+     * in parallel.
+     * @param dataOut
+     * @param words
+     * @param width
+     * @param height
+     * @param bNegative negates the mask.
+     */
+    static void unpack(bool *dataOut, uint64_t *words, int width, int height,
+                       bool bNegative = false)
+    {
+        int nWords = getWordsPerRow(width);
+
+        ThreadPool::getInstance()->parallelFor(height, [&](int i) {
+            bool *row = &dataOut[i * width];
+            uint64_t *words_i = &words[i * nWords];
+
+            for(int j = 0; j < width; j++) {
+                bool bit = ((words_i[j >> 6] >> (j & 63)) & 1) != 0;
+                row[j] = bit != bNegative;
+            }
+        });
+    }
+
+    /**
+     * @brief shiftRow shifts a packed row by d pixels: out[j] = in[j + d];
+     * pixels out of the row are zero.
+     * @param out
+     * @param in
+     * @param nWords
+     * @param d
+     */
+    static void shiftRow(uint64_t *out, uint64_t *in, int nWords, int d)
+    {
+        int wo = (d < 0 ? -d : d) >> 6;
+        int bo = (d < 0 ? -d : d) & 63;
+
+        for(int w = 0; w < nWords; w++) {
+            uint64_t word = 0;
+
+            if(d >= 0) {
+                int k = w + wo;
+
+                if(k < nWords) {
+                    word = in[k] >> bo;
+                }
+
+                if((bo > 0) && ((k + 1) < nWords)) {
+                    word |= in[k + 1] << (64 - bo);
+                }
+            } else {
+                int k = w - wo;
+
+                if(k >= 0) {
+                    word = in[k] << bo;
+                }
+
+                if((bo > 0) && ((k - 1) >= 0)) {
+                    word |= in[k - 1] >> (64 - bo);
+                }
+            }
+
+            out[w] = word;
         }
+    }
 
-        if(dataOut == NULL) {
-            dataOut = new bool[width * height];
+    /**
+     * @brief dilatePacked dilates a packed mask with a square window,
+     * which is split in a horizontal and a vertical pass; each pass ORs
+     * 64 pixels at once, and it covers a window of size s with log2(s)
+     * shifts. Out of the mask, pixels are zero; this is the same as
+     * clamping coordinates. The horizontal pass runs in parallel over
+     * rows, and the vertical one over strips of words, since a column of
+     * words does not depend on the other ones.
+     * @param words
+     * @param width
+     * @param height
+     * @param halfKernelSize
+     */
+    static void dilatePacked(uint64_t *words, int width, int height,
+                             int halfKernelSize)
+    {
+        if(halfKernelSize < 1) {
+            return;
         }
 
-        int halfKernelSize = kernelSize >> 1;
+        int nWords = getWordsPerRow(width);
+        int side = halfKernelSize + 1;
 
-        #pragma omp parallel for
+        uint64_t tailMask = (width & 63) ? ((uint64_t(1) << (width & 63)) - 1) : ~uint64_t(0);
 
-        for(int i = 0; i < height; i++) {
-            int ind = i * width;
+        //horizontal pass: the right side of the window, then the left one
+        ThreadPool::getInstance()->parallelFor(height, [&](int i) {
+            uint64_t *row = &words[i * nWords];
+            std::vector< uint64_t > tmp(nWords);
 
-            for(int j = 0; j < width; j++) {
-                int c = ind + j;
+            for(int dir = 1; dir >= -1; dir -= 2) {
+                for(int covered = 1; covered < side;) {
+                    int step = MIN(covered, side - covered);
 
-                bool out = false;
+                    shiftRow(&tmp[0], row, nWords, dir * step);
 
-                for(int k = -halfKernelSize; k <= halfKernelSize; k++) {
-                    int ci = CLAMP((i + k), height) * width;
+                    for(int w = 0; w < nWords; w++) {
+                        row[w] |= tmp[w];
+                    }
+
+                    covered += step;
+                }
+            }
+
+            row[nWords - 1] &= tailMask;
+        });
+
+        //vertical pass: rows below, then rows above
+        int stripSize = 8;
+        int nStrips = (nWords + stripSize - 1) / stripSize;
+
+        ThreadPool::getInstance()->parallelFor(nStrips, [&](int k) {
+            int w0 = k * stripSize;
+            int w1 = MIN(w0 + stripSize, nWords);
+
+            for(int covered = 1; covered < side;) {
+                int step = MIN(covered, side - covered);
+
+                for(int i = 0; i < (height - step); i++) {
+                    uint64_t *row = &words[i * nWords];
+                    uint64_t *row_s = &words[(i + step) * nWords];
 
-                    for(int l = -halfKernelSize; l <= halfKernelSize; l++) {
-                        int cj = CLAMP((j + l), width);
-                        out = out || (!dataIn[ci + cj]);
+                    for(int w = w0; w < w1; w++) {
+                        row[w] |= row_s[w];
                     }
                 }
 
-                dataOut[c] = !out;
+                covered += step;
             }
-        }
 
-        return dataOut;
+            for(int covered = 1; covered < side;) {
+                int step = MIN(covered, side - covered);
+
+                for(int i = height - 1; i >= step; i--) {
+                    uint64_t *row = &words[i * nWords];
+                    uint64_t *row_s = &words[(i - step) * nWords];
+
+                    for(int w = w0; w < w1; w++) {
+                        row[w] |= row_s[w];
+                    }
+                }
+
+                covered += step;
+            }
+        });
     }
 
     /**
-     * @brief MaskDilate dilates a mask.
+     * @brief erode erodes a mask; the mask is processed packed in 64-bit
+     * words as the dilation of its negative.
      * @param dataOut
      * @param dataIn
      * @param width
@@ -134,8 +290,8 @@ public:
      * @param kernelSize
      * @return
      */
-    static bool *dilate(bool *dataOut, bool *dataIn, int width, int height,
-                        int kernelSize = 3)
+    static bool *erode(bool *dataOut, bool *dataIn, int width, int height,
+                       int kernelSize = 3)
     {
         if(dataIn == NULL) {
             return dataOut;
@@ -145,30 +301,41 @@ public:
             dataOut = new bool[width * height];
         }
 
-        int halfKernelSize = kernelSize >> 1;
+        std::vector< uint64_t > words(getWordsPerRow(width) * height);
 
-        #pragma omp parallel for
+        pack(&words[0], dataIn, width, height, true);
+        dilatePacked(&words[0], width, height, kernelSize >> 1);
+        unpack(dataOut, &words[0], width, height, true);
 
-        for(int i = 0; i < height; i++) {
-            int ind = i * width;
-
-            for(int j = 0; j < width; j++) {
-                int c = ind + j;
+        return dataOut;
+    }
 
-                bool out = false;
+    /**
+     * @brief MaskDilate dilates a mask; the mask is processed packed in
+     * 64-bit words.
+     * @param dataOut
+     * @param dataIn
+     * @param width
+     * @param height
+     * @param kernelSize
+     * @return
+     */
+    static bool *dilate(bool *dataOut, bool *dataIn, int width, int height,
+                        int kernelSize = 3)
+    {
+        if(dataIn == NULL) {
+            return dataOut;
+        }
 
-                for(int k = -halfKernelSize; k <= halfKernelSize; k++) {
-                    int ci = CLAMP((i + k), height) * width;
+        if(dataOut == NULL) {
+            dataOut = new bool[width * height];
+        }
 
-                    for(int l = -halfKernelSize; l <= halfKernelSize; l++) {
-                        int cj = CLAMP((j + l), width);
-                        out = out || (dataIn[ci + cj]);
-                    }
-                }
+        std::vector< uint64_t > words(getWordsPerRow(width) * height);
 
-                dataOut[c] = out;
-            }
-        }
+        pack(&words[0], dataIn, width, height);
+        dilatePacked(&words[0], width, height, kernelSize >> 1);
+        unpack(dataOut, &words[0], width, height);
 
         return dataOut;
     }
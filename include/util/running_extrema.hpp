@@ -0,0 +1,155 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_RUNNING_EXTREMA_HPP
+#define PIC_UTIL_RUNNING_EXTREMA_HPP
+
+#include <string.h>
+
+#include "../base.hpp"
+#include "../util/span_ops.hpp"
+
+namespace pic {
+
+/**
+ * @brief The ExtremaMax struct is the maximum for RunningExtrema.
+ */
+struct ExtremaMax
+{
+    static inline float apply(float a, float b)
+    {
+        return a > b ? a : b;
+    }
+
+    static inline void apply(float *out, const float *in, int n)
+    {
+        SpanOps::maximum(out, in, n);
+    }
+};
+
+/**
+ * @brief The ExtremaMin struct is the minimum for RunningExtrema.
+ */
+struct ExtremaMin
+{
+    static inline float apply(float a, float b)
+    {
+        return a < b ? a : b;
+    }
+
+    static inline void apply(float *out, const float *in, int n)
+    {
+        SpanOps::minimum(out, in, n);
+    }
+};
+
+/**
+ * @brief The RunningExtrema class computes the maximum or the minimum
+ * (OP) in a sliding window with the van Herk/Gil-Werman algorithm.
+ * The input is split in blocks of the size of the window; prefix and
+ * suffix extrema are computed in each block, and a window, which covers
+ * at most two blocks, is the extremum of a suffix and a prefix. This
+ * costs three comparisons per value whatever the size of the window.
+ */
+template<class OP>
+class RunningExtrema
+{
+public:
+
+    /**
+     * @brief line computes out[x * outStride] = OP(in[x], ..., in[x + size - 1])
+     * for x in [0, n).
+     * @param out
+     * @param in has n + size - 1 values.
+     * @param n
+     * @param size is the size of the window.
+     * @param buffer has 2 * (n + size - 1) values.
+     * @param outStride is the distance in values between two outputs; e.g.
+     * the number of channels when out is a channel of an interleaved row.
+     */
+    static void line(float *out, const float *in, int n, int size, float *buffer,
+                     int outStride = 1)
+    {
+        int len = n + size - 1;
+        float *g = buffer;
+        float *h = buffer + len;
+
+        for(int b = 0; b < len; b += size) {
+            int e = (b + size) < len ? (b + size) : len;
+
+            g[b] = in[b];
+            for(int x = b + 1; x < e; x++) {
+                g[x] = OP::apply(g[x - 1], in[x]);
+            }
+
+            h[e - 1] = in[e - 1];
+            for(int x = e - 2; x >= b; x--) {
+                h[x] = OP::apply(h[x + 1], in[x]);
+            }
+        }
+
+        for(int x = 0; x < n; x++) {
+            out[x * outStride] = OP::apply(h[x], g[x + size - 1]);
+        }
+    }
+
+    /**
+     * @brief rows computes the extrema of rows of width values: the
+     * j-th output row is OP(in_j, ..., in_(j + size - 1)) for j in [0, n);
+     * rows are processed as spans, so this is vectorized.
+     * @param out
+     * @param outStride is the distance in values between two output rows.
+     * @param in has n + size - 1 rows; it is overwritten.
+     * @param width
+     * @param n
+     * @param size is the size of the window.
+     * @param buffer has (n + size - 1) * width values.
+     */
+    static void rows(float *out, int outStride, float *in, int width, int n,
+                     int size, float *buffer)
+    {
+        int len = n + size - 1;
+        float *g = buffer;
+        float *h = in;
+
+        for(int b = 0; b < len; b += size) {
+            int e = (b + size) < len ? (b + size) : len;
+
+            memcpy(&g[b * width], &in[b * width], sizeof(float) * width);
+            for(int x = b + 1; x < e; x++) {
+                memcpy(&g[x * width], &in[x * width], sizeof(float) * width);
+                OP::apply(&g[x * width], &g[(x - 1) * width], width);
+            }
+
+            //suffixes are computed in place
+            for(int x = e - 2; x >= b; x--) {
+                OP::apply(&h[x * width], &h[(x + 1) * width], width);
+            }
+        }
+
+        for(int x = 0; x < n; x++) {
+            float *out_x = &out[x * outStride];
+            memcpy(out_x, &h[x * width], sizeof(float) * width);
+            OP::apply(out_x, &g[(x + size - 1) * width], width);
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_RUNNING_EXTREMA_HPP */
+
@@ -0,0 +1,119 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_SORTING_NETWORK_HPP
+#define PIC_UTIL_SORTING_NETWORK_HPP
+
+#include <stddef.h>
+#include <algorithm>
+
+#include "../base.hpp"
+
+namespace pic {
+
+/**
+ * @brief The MedianNetwork class stores median selection networks for
+ * 3x3 and 5x5 windows (Paeth; Devillard). A network is a fixed sequence
+ * of compare-exchange operations: it has no branches, so it can be
+ * applied to many windows at once with vector instructions.
+ */
+class MedianNetwork
+{
+public:
+
+    /**
+     * @brief get
+     * @param n is the number of values.
+     * @param nPairs is the number of compare-exchange operations.
+     * @return It returns the pairs of the network for n values (9 or 25),
+     * otherwise NULL.
+     */
+    static const unsigned char *get(int n, int &nPairs)
+    {
+        static const unsigned char med9[] = {
+            1, 2,   4, 5,   7, 8,   0, 1,   3, 4,   6, 7,
+            1, 2,   4, 5,   7, 8,   0, 3,   5, 8,   4, 7,
+            3, 6,   1, 4,   2, 5,   4, 7,   2, 4,   4, 6,
+            2, 4
+        };
+
+        static const unsigned char med25[] = {
+            0, 1,   3, 4,   2, 4,   2, 3,   6, 7,   5, 7,
+            5, 6,   9, 10,  8, 10,  8, 9,   12, 13, 11, 13,
+            11, 12, 15, 16, 14, 16, 14, 15, 18, 19, 17, 19,
+            17, 18, 21, 22, 20, 22, 20, 21, 23, 24, 2, 5,
+            3, 6,   0, 6,   0, 3,   4, 7,   1, 7,   1, 4,
+            11, 14, 8, 14,  8, 11,  12, 15, 9, 15,  9, 12,
+            13, 16, 10, 16, 10, 13, 20, 23, 17, 23, 17, 20,
+            21, 24, 18, 24, 18, 21, 19, 22, 8, 17,  9, 18,
+            0, 18,  0, 9,   10, 19, 1, 19,  1, 10,  11, 20,
+            2, 20,  2, 11,  12, 21, 3, 21,  3, 12,  13, 22,
+            4, 22,  4, 13,  14, 23, 5, 23,  5, 14,  15, 24,
+            6, 24,  6, 15,  7, 16,  7, 19,  13, 21, 15, 23,
+            7, 13,  7, 15,  1, 9,   3, 11,  5, 17,  11, 17,
+            9, 17,  4, 10,  6, 12,  7, 14,  4, 6,   4, 7,
+            12, 14, 10, 14, 6, 7,   10, 12, 6, 10,  6, 17,
+            12, 17, 7, 17,  7, 10,  12, 18, 7, 12,  10, 18,
+            12, 20, 10, 20, 10, 12
+        };
+
+        switch(n) {
+        case 9:
+            nPairs = sizeof(med9) >> 1;
+            return med9;
+
+        case 25:
+            nPairs = sizeof(med25) >> 1;
+            return med25;
+
+        default:
+            nPairs = 0;
+            return NULL;
+        }
+    }
+
+    /**
+     * @brief apply applies a network to n windows at once; the k-th value
+     * of the i-th window is values[k * stride + i]. After the network,
+     * the median of the i-th window is values[(nValues / 2) * stride + i].
+     * @param values
+     * @param stride
+     * @param n
+     * @param pairs
+     * @param nPairs
+     */
+    static void apply(float *values, int stride, int n,
+                      const unsigned char *pairs, int nPairs)
+    {
+        for(int k = 0; k < nPairs; k++) {
+            float *a = &values[pairs[k << 1] * stride];
+            float *b = &values[pairs[(k << 1) + 1] * stride];
+
+            for(int i = 0; i < n; i++) {
+                float lo = std::min(a[i], b[i]);
+                float hi = std::max(a[i], b[i]);
+                a[i] = lo;
+                b[i] = hi;
+            }
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_SORTING_NETWORK_HPP */
+
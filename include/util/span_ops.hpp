@@ -0,0 +1,282 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_SPAN_OPS_HPP
+#define PIC_UTIL_SPAN_OPS_HPP
+
+#include "../base.hpp"
+
+#ifndef PIC_DISABLE_EIGEN
+
+#ifndef PIC_EIGEN_NOT_BUNDLED
+    #include "../externals/Eigen/Core"
+#else
+    #include <Eigen/Core>
+#endif
+
+#endif
+
+namespace pic {
+
+/**
+ * @brief SPAN_OPS_CHUNK is the number of floats processed at once by span
+ * kernels; a chunk of the output stays in the L1 cache across taps.
+ */
+#ifndef SPAN_OPS_CHUNK
+#define SPAN_OPS_CHUNK 1024
+#endif
+
+/**
+ * @brief The SpanOps class provides vectorized kernels on contiguous
+ * spans of floats. When Eigen is available, these are computed with
+ * Eigen's packet math (SSE/AVX/NEON depending on the compiler flags).
+ */
+class SpanOps
+{
+public:
+
+    /**
+     * @brief assign computes out[i] = in[i] * w.
+     * @param out
+     * @param in
+     * @param w
+     * @param n
+     */
+    static inline void assign(float *out, const float *in, float w, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> o(out, n);
+        o = Eigen::Map<const Eigen::ArrayXf>(in, n) * w;
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] = in[i] * w;
+        }
+#endif
+    }
+
+    /**
+     * @brief madd computes out[i] += in[i] * w.
+     * @param out
+     * @param in
+     * @param w
+     * @param n
+     */
+    static inline void madd(float *out, const float *in, float w, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> o(out, n);
+        o += Eigen::Map<const Eigen::ArrayXf>(in, n) * w;
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] += in[i] * w;
+        }
+#endif
+    }
+
+    /**
+     * @brief cmadd computes out[i] += in[i] * c on complex spans, which are
+     * stored as separate real and imaginary parts.
+     * @param outRe
+     * @param outIm
+     * @param inRe
+     * @param inIm
+     * @param cRe
+     * @param cIm
+     * @param n
+     */
+    static inline void cmadd(float *outRe, float *outIm,
+                             const float *inRe, const float *inIm,
+                             float cRe, float cIm, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> oRe(outRe, n), oIm(outIm, n);
+        Eigen::Map<const Eigen::ArrayXf> iRe(inRe, n), iIm(inIm, n);
+        oRe += iRe * cRe - iIm * cIm;
+        oIm += iRe * cIm + iIm * cRe;
+#else
+        for(int i = 0; i < n; i++) {
+            float re = inRe[i] * cRe - inIm[i] * cIm;
+            float im = inRe[i] * cIm + inIm[i] * cRe;
+            outRe[i] += re;
+            outIm[i] += im;
+        }
+#endif
+    }
+
+    /**
+     * @brief cmul computes out[i] = in[i] * c on complex spans, which are
+     * stored as separate real and imaginary parts; out and in must not
+     * overlap.
+     * @param outRe
+     * @param outIm
+     * @param inRe
+     * @param inIm
+     * @param cRe
+     * @param cIm
+     * @param n
+     */
+    static inline void cmul(float *outRe, float *outIm,
+                            const float *inRe, const float *inIm,
+                            float cRe, float cIm, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> oRe(outRe, n), oIm(outIm, n);
+        Eigen::Map<const Eigen::ArrayXf> iRe(inRe, n), iIm(inIm, n);
+        oRe = iRe * cRe - iIm * cIm;
+        oIm = iRe * cIm + iIm * cRe;
+#else
+        for(int i = 0; i < n; i++) {
+            outRe[i] = inRe[i] * cRe - inIm[i] * cIm;
+            outIm[i] = inRe[i] * cIm + inIm[i] * cRe;
+        }
+#endif
+    }
+
+    /**
+     * @brief sumDiff computes (a[i], b[i]) = (a[i] + b[i], a[i] - b[i]);
+     * i.e. a radix-2 butterfly.
+     * @param a
+     * @param b
+     * @param n
+     */
+    static inline void sumDiff(float *a, float *b, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        float sum[SPAN_OPS_CHUNK];
+
+        for(int i = 0; i < n; i += SPAN_OPS_CHUNK) {
+            int len = (n - i) < SPAN_OPS_CHUNK ? (n - i) : SPAN_OPS_CHUNK;
+
+            Eigen::Map<Eigen::ArrayXf> mA(a + i, len), mB(b + i, len), mS(sum, len);
+            mS = mA + mB;
+            mB = mA - mB;
+            mA = mS;
+        }
+#else
+        for(int i = 0; i < n; i++) {
+            float s = a[i] + b[i];
+            b[i] = a[i] - b[i];
+            a[i] = s;
+        }
+#endif
+    }
+
+    /**
+     * @brief maximum computes out[i] = max(out[i], in[i]).
+     * @param out
+     * @param in
+     * @param n
+     */
+    static inline void maximum(float *out, const float *in, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> o(out, n);
+        o = o.max(Eigen::Map<const Eigen::ArrayXf>(in, n));
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] = out[i] > in[i] ? out[i] : in[i];
+        }
+#endif
+    }
+
+    /**
+     * @brief minimum computes out[i] = min(out[i], in[i]).
+     * @param out
+     * @param in
+     * @param n
+     */
+    static inline void minimum(float *out, const float *in, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXf> o(out, n);
+        o = o.min(Eigen::Map<const Eigen::ArrayXf>(in, n));
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] = out[i] < in[i] ? out[i] : in[i];
+        }
+#endif
+    }
+
+    /**
+     * @brief add computes out[i] += in[i] on integers; e.g., histograms.
+     * @param out
+     * @param in
+     * @param n
+     */
+    static inline void add(int *out, const int *in, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXi> o(out, n);
+        o += Eigen::Map<const Eigen::ArrayXi>(in, n);
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] += in[i];
+        }
+#endif
+    }
+
+    /**
+     * @brief sub computes out[i] -= in[i] on integers.
+     * @param out
+     * @param in
+     * @param n
+     */
+    static inline void sub(int *out, const int *in, int n)
+    {
+#ifndef PIC_DISABLE_EIGEN
+        Eigen::Map<Eigen::ArrayXi> o(out, n);
+        o -= Eigen::Map<const Eigen::ArrayXi>(in, n);
+#else
+        for(int i = 0; i < n; i++) {
+            out[i] -= in[i];
+        }
+#endif
+    }
+
+    /**
+     * @brief convolve computes a 1D convolution on a span:
+     * out[i] = sum_k weights[k] * in[i + (k - nWeights / 2) * tapStride].
+     * Pixels read by the kernel have to be valid memory.
+     * @param out is the output span.
+     * @param in is the input span.
+     * @param n is the number of floats of the span.
+     * @param weights is the kernel.
+     * @param nWeights is the size of the kernel.
+     * @param tapStride is the distance in floats between two taps.
+     */
+    static inline void convolve(float *out, const float *in, int n,
+                                const float *weights, int nWeights,
+                                int tapStride)
+    {
+        const float *in_c = in - (nWeights >> 1) * tapStride;
+
+        for(int i = 0; i < n; i += SPAN_OPS_CHUNK) {
+            int len = (n - i) < SPAN_OPS_CHUNK ? (n - i) : SPAN_OPS_CHUNK;
+
+            assign(out + i, in_c + i, weights[0], len);
+
+            for(int k = 1; k < nWeights; k++) {
+                madd(out + i, in_c + i + k * tapStride, weights[k], len);
+            }
+        }
+    }
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_SPAN_OPS_HPP */
+
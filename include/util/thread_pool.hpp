@@ -0,0 +1,437 @@
+/*
+
+PICCANTE
+The hottest HDR imaging library!
+http://vcg.isti.cnr.it/piccante
+
+Copyright (C) 2014
+Visual Computing Laboratory - ISTI CNR
+http://vcg.isti.cnr.it
+First author: Francesco Banterle
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#ifndef PIC_UTIL_THREAD_POOL_HPP
+#define PIC_UTIL_THREAD_POOL_HPP
+
+#include <vector>
+#include <functional>
+
+#ifndef PIC_DISABLE_THREAD
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+#include "../base.hpp"
+
+namespace pic {
+
+/**
+ * @brief The ThreadPool class is a process-wide pool of persistent worker
+ * threads. Each worker owns a task queue; idle workers steal tasks from the
+ * back of other workers' queues. The pool is lazily started the first time
+ * getInstance() is called.
+ */
+class ThreadPool
+{
+#ifndef PIC_DISABLE_THREAD
+protected:
+
+    /**
+     * @brief The Worker struct is a worker thread with its own task queue.
+     */
+    struct Worker
+    {
+        std::deque< std::function<void()> > queue;
+        std::mutex mutex;
+        std::thread thread;
+    };
+
+    /**
+     * @brief The Job struct stores the state of a parallelFor call.
+     */
+    struct Job
+    {
+        std::atomic<int> next, done;
+        int n;
+        std::function<void(int)> func;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    std::vector<Worker *> workers;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<int> pending;
+    std::atomic<unsigned int> counter;
+    bool bStop;
+
+    /**
+     * @brief getWorkerIndex returns the index of the worker running on the
+     * calling thread; -1 if the calling thread is not a worker of the pool.
+     * @return
+     */
+    static int &getWorkerIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    /**
+     * @brief pop extracts a task; it looks first in the queue of the
+     * worker, and then it steals from the other workers' queues.
+     * @param index is the index of the worker.
+     * @param task is the extracted task.
+     * @return It returns true if a task was extracted.
+     */
+    bool pop(int index, std::function<void()> &task)
+    {
+        int n = int(workers.size());
+
+        for(int i = 0; i < n; i++) {
+            Worker *w = workers[(index + i) % n];
+            std::lock_guard<std::mutex> lock(w->mutex);
+
+            if(!w->queue.empty()) {
+                if(i == 0) {
+                    task = std::move(w->queue.front());
+                    w->queue.pop_front();
+                } else {
+                    task = std::move(w->queue.back());
+                    w->queue.pop_back();
+                }
+
+                pending--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief run is the main loop of a worker.
+     * @param index is the index of the worker.
+     */
+    void run(int index)
+    {
+        getWorkerIndex() = index;
+
+        while(true) {
+            std::function<void()> task;
+
+            if(pop(index, task)) {
+                task();
+            } else {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return bStop || (pending.load() > 0); });
+
+                if(bStop && (pending.load() <= 0)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief setAffinity pins a worker to a core.
+     * @param w is the worker.
+     * @param core is the core index.
+     */
+    static void setAffinity(Worker *w, int core)
+    {
+#ifdef __linux__
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(core, &cpuset);
+        pthread_setaffinity_np(w->thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+    }
+
+    /**
+     * @brief start launches the worker threads.
+     * @param nThreads is the total number of threads, the calling one included.
+     * @param bAffinity enables pinning each worker to a core.
+     */
+    void start(int nThreads, bool bAffinity)
+    {
+        bStop = false;
+        pending = 0;
+        counter = 0;
+
+        int nCores = std::thread::hardware_concurrency();
+        nCores = nCores > 0 ? nCores : 1;
+
+        if(nThreads < 1) {
+            nThreads = nCores;
+        }
+
+        for(int i = 0; i < (nThreads - 1); i++) {
+            workers.push_back(new Worker());
+        }
+
+        for(unsigned int i = 0; i < workers.size(); i++) {
+            workers[i]->thread = std::thread(&ThreadPool::run, this, int(i));
+
+            if(bAffinity) {
+                setAffinity(workers[i], (i + 1) % nCores);
+            }
+        }
+    }
+
+    /**
+     * @brief stop waits for queued tasks and joins the worker threads.
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bStop = true;
+        }
+
+        cv.notify_all();
+
+        for(unsigned int i = 0; i < workers.size(); i++) {
+            workers[i]->thread.join();
+            delete workers[i];
+        }
+
+        workers.clear();
+    }
+
+    /**
+     * @brief ThreadPool
+     * @param nThreads
+     * @param bAffinity
+     */
+    ThreadPool(int nThreads, bool bAffinity)
+    {
+        start(nThreads, bAffinity);
+    }
+
+    /**
+     * @brief The Settings struct stores the settings used for (re)starting
+     * the pool.
+     */
+    struct Settings
+    {
+        int nThreads;
+        bool bAffinity;
+        bool bStarted;
+    };
+
+    /**
+     * @brief getSettings
+     * @return
+     */
+    static Settings &getSettings()
+    {
+        static Settings settings = {0, false, false};
+        return settings;
+    }
+
+public:
+
+    ~ThreadPool()
+    {
+        stop();
+    }
+
+    /**
+     * @brief getInstance returns the process-wide pool; it is
+     * started at the first call.
+     * @return
+     */
+    static ThreadPool *getInstance()
+    {
+        Settings &settings = getSettings();
+
+        static ThreadPool pool(settings.nThreads, settings.bAffinity);
+        settings.bStarted = true;
+        return &pool;
+    }
+
+    /**
+     * @brief setup sets the number of threads and the CPU affinity of the pool.
+     * If the pool is already running, it is restarted; this must not be called
+     * while tasks are being processed.
+     * @param nThreads is the total number of threads, the calling one included.
+     * If it is lower than 1, std::thread::hardware_concurrency() is used.
+     * @param bAffinity enables pinning each worker to a core (Linux only).
+     */
+    static void setup(int nThreads, bool bAffinity = false)
+    {
+        Settings &settings = getSettings();
+
+        settings.nThreads = nThreads;
+        settings.bAffinity = bAffinity;
+
+        if(!settings.bStarted) {
+            //the first call starts the pool with the requested settings
+            getInstance();
+            return;
+        }
+
+        ThreadPool *pool = getInstance();
+        pool->stop();
+        pool->start(nThreads, bAffinity);
+    }
+
+    /**
+     * @brief getNumberOfThreads
+     * @return It returns the total number of threads, the calling one included.
+     */
+    int getNumberOfThreads()
+    {
+        return int(workers.size()) + 1;
+    }
+
+    /**
+     * @brief submit pushes a task into the pool. Tasks submitted by a worker
+     * are pushed in its own queue, otherwise queues are chosen round-robin.
+     * @param task
+     */
+    void submit(std::function<void()> task)
+    {
+        if(workers.empty()) {
+            task();
+            return;
+        }
+
+        int index = getWorkerIndex();
+
+        if(index < 0) {
+            index = int(counter++ % workers.size());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->queue.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending++;
+        }
+
+        cv.notify_one();
+    }
+
+    /**
+     * @brief parallelFor runs func(i) for i in [0, n). The calling thread
+     * takes part in the computation, so nested calls from inside a task
+     * cannot deadlock.
+     * @param n is the number of indices.
+     * @param func is the function to run.
+     * @param nLanes is the maximum number of threads to use; if it is
+     * lower than 1, all threads are used.
+     */
+    void parallelFor(int n, std::function<void(int)> func, int nLanes = -1)
+    {
+        if(n < 1) {
+            return;
+        }
+
+        int nThreads = getNumberOfThreads();
+
+        if((nLanes < 1) || (nLanes > nThreads)) {
+            nLanes = nThreads;
+        }
+
+        if(nLanes > n) {
+            nLanes = n;
+        }
+
+        if(nLanes == 1) {
+            for(int i = 0; i < n; i++) {
+                func(i);
+            }
+
+            return;
+        }
+
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->next = 0;
+        job->done = 0;
+        job->n = n;
+        job->func = func;
+
+        auto lane = [job]() {
+            int i;
+
+            while((i = job->next++) < job->n) {
+                job->func(i);
+
+                if((++job->done) == job->n) {
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->cv.notify_all();
+                }
+            }
+        };
+
+        for(int i = 0; i < (nLanes - 1); i++) {
+            submit(lane);
+        }
+
+        lane();
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->cv.wait(lock, [&job] { return job->done.load() >= job->n; });
+    }
+
+#else
+
+public:
+
+    static ThreadPool *getInstance()
+    {
+        static ThreadPool pool;
+        return &pool;
+    }
+
+    static void setup(int nThreads, bool bAffinity = false)
+    {
+        (void) nThreads;
+        (void) bAffinity;
+    }
+
+    int getNumberOfThreads()
+    {
+        return 1;
+    }
+
+    void submit(std::function<void()> task)
+    {
+        task();
+    }
+
+    void parallelFor(int n, std::function<void(int)> func, int nLanes = -1)
+    {
+        (void) nLanes;
+
+        for(int i = 0; i < n; i++) {
+            func(i);
+        }
+    }
+
+#endif
+};
+
+} // end namespace pic
+
+#endif /* PIC_UTIL_THREAD_POOL_HPP */
+
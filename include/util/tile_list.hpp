@@ -22,27 +22,44 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "../util/tile.hpp"
 
-#include <thread>
-#include <mutex>
+#ifndef PIC_DISABLE_THREAD
+#include <atomic>
+#endif
 
 namespace pic {
 
+/**
+ * @brief PIC_L2_CACHE_SIZE is the L2 cache size in bytes per core used
+ * for sizing tiles.
+ */
+#ifndef PIC_L2_CACHE_SIZE
+#define PIC_L2_CACHE_SIZE 262144
+#endif
+
+/**
+ * @brief The TILE_SHAPE enum is a hint on the shape of tiles:
+ * TS_SQUARE for 2D kernels, and TS_ROW_STRIP for full-width strips
+ * of rows; e.g. for horizontal 1D passes.
+ */
+enum TILE_SHAPE {TS_SQUARE, TS_ROW_STRIP};
+
 /**
  * @brief The TileList class
  */
 class TileList
 {
 protected:
-    unsigned int counter;
-
 #ifndef PIC_DISABLE_THREAD
-    std::mutex mutex;
+    std::atomic<unsigned int> counter;
+#else
+    unsigned int counter;
 #endif
 
 public:
     int width, height;
     int h_tile, w_tile;
     int mod_h, mod_w;
+    int tileWidth, tileHeight;
 
     /**
      * @brief tiles a list of tiles
@@ -62,8 +79,34 @@ public:
      */
     TileList(int tileSize, int width, int height);
 
+    /**
+     * @brief TileList creates a list of rectangular tiles.
+     * @param tileWidth is the width of a tile in pixels.
+     * @param tileHeight is the height of a tile in pixels.
+     * @param width is the horizontal size of the original image in pixels.
+     * @param height is the vertical size of the original image in pixels.
+     */
+    TileList(int tileWidth, int tileHeight, int width, int height);
+
     ~TileList();
 
+    /**
+     * @brief getTileSize computes the size of tiles such that the working
+     * set of a tile fits in half of the L2 cache, and such that there are
+     * enough tiles for balancing nThreads threads.
+     * @param width is the horizontal size of the image in pixels.
+     * @param height is the vertical size of the image in pixels.
+     * @param bytesPerPixel is the number of bytes touched for each pixel
+     * of a tile (i.e. both inputs and output).
+     * @param shape is the tile shape hint.
+     * @param nThreads is the number of threads.
+     * @param tileWidth is the output width of a tile.
+     * @param tileHeight is the output height of a tile.
+     */
+    static void getTileSize(int width, int height, int bytesPerPixel,
+                            TILE_SHAPE shape, int nThreads,
+                            int &tileWidth, int &tileHeight);
+
     /**
      * @brief genBBox
      * @param index
@@ -96,6 +139,15 @@ public:
      */
     void create(int tileSize, int width, int height);
 
+    /**
+     * @brief create creates a list of rectangular tiles.
+     * @param tileWidth is the width of a tile in pixels.
+     * @param tileHeight is the height of a tile in pixels.
+     * @param width is the horizontal size of the original image in pixels.
+     * @param height is the vertical size of the original image in pixels.
+     */
+    void create(int tileWidth, int tileHeight, int width, int height);
+
     /**
      * @brief read loads a TileList from a file.
      * @param name is the file name.
@@ -129,12 +181,58 @@ PIC_INLINE TileList::TileList()
 
     mod_h = 0;
     mod_w = 0;
+
+    tileWidth = 0;
+    tileHeight = 0;
 }
 
 PIC_INLINE TileList::TileList(int tileSize, int width, int height)
 {
     counter = 0;
-    create(tileSize, width, height);
+    create(tileSize, tileSize, width, height);
+}
+
+PIC_INLINE TileList::TileList(int tileWidth, int tileHeight, int width, int height)
+{
+    counter = 0;
+    create(tileWidth, tileHeight, width, height);
+}
+
+PIC_INLINE void TileList::getTileSize(int width, int height, int bytesPerPixel,
+                                      TILE_SHAPE shape, int nThreads,
+                                      int &tileWidth, int &tileHeight)
+{
+    int budget = PIC_L2_CACHE_SIZE / 2;
+    bytesPerPixel = bytesPerPixel > 0 ? bytesPerPixel : 1;
+
+    //at least four tiles per thread for balancing the load
+    int minTiles = nThreads > 1 ? (nThreads << 2) : 1;
+
+    if(shape == TS_ROW_STRIP) {
+        tileWidth = width;
+        tileHeight = budget / MAX(width * bytesPerPixel, 1);
+        tileHeight = CLAMPi(tileHeight, 4, 64);
+
+        int maxHeight = (height + minTiles - 1) / minTiles;
+        tileHeight = MAX(MIN(tileHeight, maxHeight), 1);
+    } else {
+        int side = int(sqrtf(float(budget / bytesPerPixel)));
+        side = CLAMPi((side >> 4) << 4, 16, 256);
+
+        while(side > 16) {
+            int nTiles = ((width  + side - 1) / side) *
+                         ((height + side - 1) / side);
+
+            if(nTiles >= minTiles) {
+                break;
+            }
+
+            side -= 16;
+        }
+
+        tileWidth = side;
+        tileHeight = side;
+    }
 }
 
 PIC_INLINE TileList::~TileList()
@@ -151,15 +249,7 @@ PIC_INLINE BBox TileList::getBBox(int index)
 
 PIC_INLINE unsigned int TileList::getNext()
 {
-    unsigned int ret = 0;
-    {
-#ifndef PIC_DISABLE_THREAD
-        std::lock_guard<std::mutex> lock(mutex);
-#endif
-        ret = counter;
-        counter++;
-    }
-    return ret;
+    return counter++;
 }
 
 PIC_INLINE unsigned int TileList::size()
@@ -169,21 +259,21 @@ PIC_INLINE unsigned int TileList::size()
 
 PIC_INLINE void TileList::resetCounter()
 {
-    {
-#ifndef PIC_DISABLE_THREAD
-        std::lock_guard<std::mutex> lock(mutex);
-#endif
-        counter = 0;
-    }
+    counter = 0;
 }
 
 PIC_INLINE void TileList::create(int tileSize, int width, int height)
+{
+    create(tileSize, tileSize, width, height);
+}
+
+PIC_INLINE void TileList::create(int tileWidth, int tileHeight, int width, int height)
 {
     resetCounter();
 
     if(!tiles.empty()) {
-        if((tiles[0].width == tileSize) && (this->width == width) &&
-           (this->height == height)) {
+        if((this->tileWidth == tileWidth) && (this->tileHeight == tileHeight) &&
+           (this->width == width) && (this->height == height)) {
             return;
         }
 
@@ -192,28 +282,30 @@ PIC_INLINE void TileList::create(int tileSize, int width, int height)
 
     this->width = width;
     this->height = height;
+    this->tileWidth = tileWidth;
+    this->tileHeight = tileHeight;
 
-    h_tile = height / tileSize;
-    w_tile = width  / tileSize;
-    mod_h  = height % tileSize;
-    mod_w  = width  % tileSize;
+    h_tile = height / tileHeight;
+    w_tile = width  / tileWidth;
+    mod_h  = height % tileHeight;
+    mod_w  = width  % tileWidth;
 
     //main blocks
     bool bWidth = mod_w != 0;
     for(int i = 0; i < h_tile; i++) {
         Tile tile;
-        tile.width = tileSize;
-        tile.height = tileSize;
-        tile.startY = i * tileSize;
+        tile.width = tileWidth;
+        tile.height = tileHeight;
+        tile.startY = i * tileHeight;
 
         for(int j = 0; j < w_tile; j++) {
-            tile.startX = j * tileSize;
+            tile.startX = j * tileWidth;
             tiles.push_back(tile);
         }
 
         //extra blocks
         if(bWidth) {
-            tile.startX = w_tile * tileSize;
+            tile.startX = w_tile * tileWidth;
             tile.width  = mod_w;
             tiles.push_back(tile);
         }
@@ -224,17 +316,17 @@ PIC_INLINE void TileList::create(int tileSize, int width, int height)
         int i = h_tile;
 
         Tile tile;
-        tile.startY = i * tileSize;
-        tile.width  = tileSize;
+        tile.startY = i * tileHeight;
+        tile.width  = tileWidth;
 
         for(int j = 0; j < w_tile; j++) {
-            tile.startX = j * tileSize;
+            tile.startX = j * tileWidth;
             tile.height  = mod_h;
             tiles.push_back(tile);
         }
 
         if(bWidth) {
-            tile.startX = w_tile * tileSize;
+            tile.startX = w_tile * tileWidth;
             tile.width  = mod_w;
             tile.height  = mod_h;
             tiles.push_back(tile);